@@ -0,0 +1,395 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "capture.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+using namespace std;
+
+namespace cli {
+
+Capture::Benchmark::Benchmark() :
+    enabled(false),
+    rate(0),
+    toggle_density(1000),
+    channels(0),
+    split(false),
+    speed(0),
+    loop(true)
+{
+}
+
+Capture::Capture(sr_context *sr_ctx) :
+    _sr_ctx(sr_ctx),
+    _samplerate(0),
+    _sample_count(0),
+    _meta_limit(0),
+    _cross_channel(0),
+    _cross_byte(0),
+    _edge_pos(0),
+    _edge_value(0),
+    _error(false)
+{
+}
+
+bool Capture::load(const string &path, string &error)
+{
+    if (sr_session_load(path.c_str()) != SR_OK)
+        return load_input(path, error);
+
+    GSList *devlist = NULL;
+    sr_session_dev_list(&devlist);
+    if (!devlist || !devlist->data) {
+        if (devlist)
+            g_slist_free(devlist);
+        sr_session_destroy();
+        error = "Failed to start session.";
+        return false;
+    }
+    sr_dev_inst *const sdi = (sr_dev_inst*)devlist->data;
+    g_slist_free(devlist);
+
+    bool ret = false;
+    if (sdi->mode != LOGIC)
+        error = "Not a logic analyzer capture.";
+    else
+        ret = run(sdi, error);
+
+    sr_dev_close(sdi);
+    sr_dev_clear(sdi->driver);
+    sr_session_destroy();
+    return ret;
+}
+
+/*
+ * Value Change Dumps come through their input module, which sends all
+ * of the file as SR_DF_LOGIC_EDGE packets from loadfile().
+ */
+bool Capture::load_input(const string &path, string &error)
+{
+    sr_input_format *format = NULL;
+    sr_input_format **const formats = sr_input_list();
+    for (sr_input_format **f = formats; f && *f; f++)
+        if (strcmp((*f)->id, "vcd") == 0 && (*f)->format_match(path.c_str()))
+            format = *f;
+    if (!format) {
+        error = "Failed to open file.";
+        return false;
+    }
+
+    sr_input input;
+    memset(&input, 0, sizeof(input));
+    input.format = format;
+    if (format->init(&input, path.c_str()) != SR_OK) {
+        error = "Failed to open file.";
+        return false;
+    }
+
+    sr_session_new();
+    bool ret = false;
+    if (sr_session_dev_add(input.sdi) != SR_OK)
+        error = "Failed to start session.";
+    else
+        ret = run(input.sdi, error, &input, path.c_str());
+    sr_session_destroy();
+    return ret;
+}
+
+bool Capture::capture_demo(uint64_t samplerate, uint64_t samples,
+    const Benchmark &bench, string &error)
+{
+    sr_dev_driver *driver = NULL;
+    sr_dev_driver **const drivers = sr_driver_list();
+    for (sr_dev_driver **d = drivers; *d; d++)
+        if (strcmp((*d)->name, "virtual-demo") == 0)
+            driver = *d;
+    if (!driver || sr_driver_init(_sr_ctx, driver) != SR_OK) {
+        error = "The demo device is not available.";
+        return false;
+    }
+
+    GSList *const devices = sr_driver_scan(driver, NULL);
+    if (!devices) {
+        error = "The demo device is not available.";
+        return false;
+    }
+    sr_dev_inst *const sdi = (sr_dev_inst*)devices->data;
+    g_slist_free(devices);
+
+    sr_session_new();
+    sr_dev_open(sdi);
+    bool ret = false;
+    if (sr_session_dev_add(sdi) != SR_OK) {
+        error = "Failed to use the demo device.";
+    } else {
+        if (sdi->mode != LOGIC)
+            sr_config_set(sdi, NULL, NULL, SR_CONF_DEVICE_MODE,
+                g_variant_new_int16(LOGIC));
+        if (samplerate)
+            sr_config_set(sdi, NULL, NULL, SR_CONF_SAMPLERATE,
+                g_variant_new_uint64(samplerate));
+        if (samples)
+            sr_config_set(sdi, NULL, NULL, SR_CONF_LIMIT_SAMPLES,
+                g_variant_new_uint64(samples));
+        if (bench.enabled && !set_benchmark(sdi, bench))
+            error = "Invalid benchmark settings.";
+        else
+            ret = run(sdi, error);
+    }
+
+    sr_session_destroy();
+    sr_dev_close(sdi);
+    sr_dev_clear(driver);
+    return ret;
+}
+
+bool Capture::set_benchmark(sr_dev_inst *sdi, const Benchmark &bench)
+{
+    bool ret = sr_config_set(sdi, NULL, NULL, SR_CONF_PATTERN_MODE,
+        g_variant_new_string("Benchmark")) == SR_OK;
+    ret = ret && sr_config_set(sdi, NULL, NULL, SR_CONF_BENCHMARK_RATE,
+        g_variant_new_uint64(bench.rate)) == SR_OK;
+    ret = ret && sr_config_set(sdi, NULL, NULL, SR_CONF_TOGGLE_DENSITY,
+        g_variant_new_uint64(bench.toggle_density)) == SR_OK;
+    ret = ret && sr_config_set(sdi, NULL, NULL, SR_CONF_LA_DATA_FORMAT,
+        g_variant_new_int16(bench.split ? LA_SPLIT_DATA : LA_CROSS_DATA)) == SR_OK;
+    ret = ret && sr_config_set(sdi, NULL, NULL, SR_CONF_CAPTUREFILE,
+        g_variant_new_string(bench.replay.c_str())) == SR_OK;
+    ret = ret && sr_config_set(sdi, NULL, NULL, SR_CONF_REPLAY_SPEED,
+        g_variant_new_uint64(bench.speed)) == SR_OK;
+    ret = ret && sr_config_set(sdi, NULL, NULL, SR_CONF_REPLAY_LOOP,
+        g_variant_new_boolean(bench.loop)) == SR_OK;
+    if (bench.channels)
+        ret = ret && sr_config_set(sdi, NULL, NULL, SR_CONF_CAPTURE_NUM_PROBES,
+            g_variant_new_uint64(bench.channels)) == SR_OK;
+    return ret;
+}
+
+uint64_t Capture::samplerate() const
+{
+    return _samplerate;
+}
+
+uint64_t Capture::sample_count() const
+{
+    return _sample_count;
+}
+
+const vector<Capture::Channel>& Capture::channels() const
+{
+    return _channels;
+}
+
+int Capture::find_channel(const string &id) const
+{
+    for (size_t i = 0; i < _channels.size(); i++)
+        if (_channels[i].name == id)
+            return i;
+
+    char *end;
+    const long index = strtol(id.c_str(), &end, 10);
+    if (id.empty() || *end)
+        return -1;
+    for (size_t i = 0; i < _channels.size(); i++)
+        if (_channels[i].index == index)
+            return i;
+    return -1;
+}
+
+bool Capture::run(sr_dev_inst *sdi, string &error,
+    sr_input *input, const char *path)
+{
+    assert(sdi);
+
+    _channels.clear();
+    for (const GSList *l = sdi->channels; l; l = l->next) {
+        const sr_channel *const probe = (const sr_channel*)l->data;
+        if (probe->type != SR_CHANNEL_LOGIC || !probe->enabled)
+            continue;
+        Channel ch;
+        ch.index = probe->index;
+        ch.name = probe->name ? probe->name : "";
+        _channels.push_back(ch);
+    }
+    if (_channels.empty()) {
+        error = "No logic channels enabled.";
+        return false;
+    }
+
+    GVariant *gvar = NULL;
+    _samplerate = 0;
+    if (sr_config_get(sdi->driver, sdi, NULL, NULL,
+                      SR_CONF_SAMPLERATE, &gvar) == SR_OK && gvar) {
+        _samplerate = g_variant_get_uint64(gvar);
+        g_variant_unref(gvar);
+    }
+    gvar = NULL;
+    uint64_t limit = UINT64_MAX;
+    if (sr_config_get(sdi->driver, sdi, NULL, NULL,
+                      SR_CONF_LIMIT_SAMPLES, &gvar) == SR_OK && gvar) {
+        limit = g_variant_get_uint64(gvar);
+        g_variant_unref(gvar);
+    }
+
+    _cross_channel = 0;
+    _cross_byte = 0;
+    _edge_pos = 0;
+    _edge_value = 0;
+    _meta_limit = 0;
+    _error = false;
+
+    sr_session_datafeed_callback_remove_all();
+    sr_session_datafeed_callback_add(data_feed_in_proc, this);
+    if (input) {
+        if (input->format->loadfile(input, path) != SR_OK)
+            _error = true;
+    } else if (sr_session_start() != SR_OK) {
+        sr_session_datafeed_callback_remove_all();
+        error = "Failed to start session.";
+        return false;
+    } else {
+        sr_session_run();
+    }
+    sr_session_datafeed_callback_remove_all();
+
+    if (_error) {
+        error = "Failed to read the sample data.";
+        return false;
+    }
+
+    // Samples the capture didn't fill up are not decoded
+    _sample_count = limit;
+    for (vector<Channel>::const_iterator i = _channels.begin();
+        i != _channels.end(); i++)
+        _sample_count = min<uint64_t>(_sample_count, (*i).data.size() * 8);
+    if (_meta_limit)
+        _sample_count = min(_sample_count, _meta_limit);
+    if (_edge_pos != 0)
+        _sample_count = min(_sample_count, _edge_pos);
+    return true;
+}
+
+void Capture::data_feed_in(const sr_datafeed_packet *packet)
+{
+    if (packet->type != SR_DF_END && packet->status != SR_PKT_OK) {
+        _error = true;
+        return;
+    }
+
+    switch (packet->type) {
+    case SR_DF_META:
+    {
+        // Input modules only tell the samplerate and length here
+        const sr_datafeed_meta &meta = *(const sr_datafeed_meta*)packet->payload;
+        for (const GSList *l = meta.config; l; l = l->next) {
+            const sr_config *const src = (const sr_config*)l->data;
+            if (src->key == SR_CONF_SAMPLERATE)
+                _samplerate = g_variant_get_uint64(src->data);
+            else if (src->key == SR_CONF_LIMIT_SAMPLES)
+                _meta_limit = g_variant_get_uint64(src->data);
+        }
+        break;
+    }
+
+    case SR_DF_LOGIC:
+    {
+        const sr_datafeed_logic &logic = *(const sr_datafeed_logic*)packet->payload;
+        const uint8_t *const data = (const uint8_t*)logic.data;
+        if (logic.format == LA_SPLIT_DATA) {
+            // The blocks of each channel in turn
+            if (logic.order < _channels.size())
+                _channels[logic.order].data.insert(
+                    _channels[logic.order].data.end(), data, data + logic.length);
+        } else {
+            for (uint64_t i = 0; i < logic.length; i++) {
+                _channels[_cross_channel].data.push_back(data[i]);
+                if (++_cross_byte == sizeof(uint64_t)) {
+                    _cross_byte = 0;
+                    _cross_channel = (_cross_channel + 1) % _channels.size();
+                }
+            }
+        }
+        break;
+    }
+
+    case SR_DF_LOGIC_EDGE:
+        feed_in_edges(*(const sr_datafeed_logic_edge*)packet->payload);
+        break;
+
+    case SR_DF_END:
+        if (packet->status != SR_PKT_OK)
+            _error = true;
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+ * Expand the runs between the changes into the packed bits of each
+ * channel, bit i of the cross sample being the i-th enabled channel.
+ */
+void Capture::feed_in_edges(const sr_datafeed_logic_edge &edge)
+{
+    const uint8_t *const data = (const uint8_t*)edge.data;
+    const size_t unitsize = min<size_t>(edge.unitsize, sizeof(uint64_t));
+    for (uint64_t i = 0; i <= edge.num_edges; i++) {
+        const uint64_t end = (i < edge.num_edges) ? edge.index[i] : edge.end;
+        if (end > _edge_pos) {
+            for (size_t ch = 0; ch < _channels.size(); ch++) {
+                vector<uint8_t> &bits = _channels[ch].data;
+                const bool value = ch < 64 && ((_edge_value >> ch) & 1);
+                bits.resize((end + 7) / 8, 0);
+                if (!value)
+                    continue;
+                uint64_t pos = _edge_pos;
+                for (; pos < end && (pos % 8); pos++)
+                    bits[pos / 8] |= 1 << (pos % 8);
+                for (; pos + 8 <= end; pos += 8)
+                    bits[pos / 8] = 0xff;
+                for (; pos < end; pos++)
+                    bits[pos / 8] |= 1 << (pos % 8);
+            }
+            _edge_pos = end;
+        }
+        if (i < edge.num_edges) {
+            _edge_value = 0;
+            memcpy(&_edge_value, data + i * edge.unitsize, unitsize);
+        }
+    }
+}
+
+void Capture::data_feed_in_proc(const sr_dev_inst *sdi,
+    const sr_datafeed_packet *packet, void *cb_data)
+{
+    (void)sdi;
+    assert(packet);
+    assert(cb_data);
+    ((Capture*)cb_data)->data_feed_in(packet);
+}
+
+} // namespace cli
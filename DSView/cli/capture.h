@@ -0,0 +1,123 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_CLI_CAPTURE_H
+#define DSVIEW_CLI_CAPTURE_H
+
+#include <libsigrok4DSL/libsigrok.h>
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace cli {
+
+/**
+ * The logic data of a session file, a VCD file or a demo device capture, each
+ * channel as one packed bit array (LSB first), in memory.
+ */
+class Capture
+{
+public:
+    struct Channel {
+        int index;
+        std::string name;
+        std::vector<uint8_t> data;
+    };
+
+    // Settings of the benchmark pattern of the demo device
+    struct Benchmark {
+        Benchmark();
+
+        bool enabled;
+        uint64_t rate;              // Samples per second, 0 for no pacing
+        uint64_t toggle_density;    // Toggles per million samples
+        unsigned int channels;      // 0 for all
+        bool split;                 // LA_SPLIT_DATA instead of LA_CROSS_DATA
+        std::string replay;         // .dsl file to send instead
+        uint64_t speed;             // Replay speed against the file, 0 for no pacing
+        bool loop;                  // Start the replay over at the end of the file
+    };
+
+public:
+    Capture(sr_context *sr_ctx);
+
+    /**
+     * Reads a .dsl session file, or a Value Change Dump.
+     */
+    bool load(const std::string &path, std::string &error);
+
+    /**
+     * Captures from the demo device, using its default samplerate and
+     * sample count when they are 0.
+     */
+    bool capture_demo(uint64_t samplerate, uint64_t samples,
+        const Benchmark &bench, std::string &error);
+
+    uint64_t samplerate() const;
+    uint64_t sample_count() const;
+    const std::vector<Channel>& channels() const;
+
+    /**
+     * Finds a channel by name, or by probe index, returns its position
+     * in channels() or -1.
+     */
+    int find_channel(const std::string &id) const;
+
+private:
+    static bool set_benchmark(sr_dev_inst *sdi, const Benchmark &bench);
+
+    bool load_input(const std::string &path, std::string &error);
+
+    bool run(sr_dev_inst *sdi, std::string &error,
+        sr_input *input = NULL, const char *path = NULL);
+
+    void data_feed_in(const sr_datafeed_packet *packet);
+    void feed_in_edges(const sr_datafeed_logic_edge &edge);
+
+    static void data_feed_in_proc(const sr_dev_inst *sdi,
+        const sr_datafeed_packet *packet, void *cb_data);
+
+private:
+    sr_context *const _sr_ctx;
+
+    uint64_t _samplerate;
+    uint64_t _sample_count;
+    uint64_t _meta_limit;
+    std::vector<Channel> _channels;
+
+    // Position in the LA_CROSS_DATA layout, 64 bit words of each
+    // channel in turn
+    size_t _cross_channel;
+    size_t _cross_byte;
+
+    // SR_DF_LOGIC_EDGE packets: next sample to fill and the cross
+    // sample held since the last change
+    uint64_t _edge_pos;
+    uint64_t _edge_value;
+
+    bool _error;
+};
+
+} // namespace cli
+
+#endif // DSVIEW_CLI_CAPTURE_H
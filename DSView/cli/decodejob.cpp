@@ -0,0 +1,335 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "decodejob.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <set>
+
+#include <boost/foreach.hpp>
+
+#include "capture.h"
+
+using namespace std;
+
+namespace cli {
+
+namespace {
+
+vector<string> split(const string &s, char sep)
+{
+    vector<string> parts;
+    size_t start = 0;
+    for (size_t pos; (pos = s.find(sep, start)) != string::npos; start = pos + 1)
+        parts.push_back(s.substr(start, pos - start));
+    parts.push_back(s.substr(start));
+    return parts;
+}
+
+const srd_channel* find_decoder_channel(const srd_decoder *dec, const string &id)
+{
+    for (const GSList *l = dec->channels; l; l = l->next)
+        if (id == ((const srd_channel*)l->data)->id)
+            return (const srd_channel*)l->data;
+    for (const GSList *l = dec->opt_channels; l; l = l->next)
+        if (id == ((const srd_channel*)l->data)->id)
+            return (const srd_channel*)l->data;
+    return NULL;
+}
+
+// Parses an option value as the type of the option's default value
+GVariant* option_value(const srd_decoder_option *opt, const string &value)
+{
+    char *end;
+    if (g_variant_is_of_type(opt->def, G_VARIANT_TYPE_INT64)) {
+        const int64_t v = g_ascii_strtoll(value.c_str(), &end, 0);
+        return (value.empty() || *end) ? NULL : g_variant_new_int64(v);
+    } else if (g_variant_is_of_type(opt->def, G_VARIANT_TYPE_DOUBLE)) {
+        const double v = g_ascii_strtod(value.c_str(), &end);
+        return (value.empty() || *end) ? NULL : g_variant_new_double(v);
+    } else if (g_variant_is_of_type(opt->def, G_VARIANT_TYPE_STRING)) {
+        return g_variant_new_string(value.c_str());
+    }
+    return NULL;
+}
+
+// Directories of a path, without empty and "." parts, ".." becomes
+// "__" to stay inside the output directory
+vector<string> dir_parts(const string &path)
+{
+    gchar *const dir = g_path_get_dirname(path.c_str());
+    const vector<string> all = split(dir, G_DIR_SEPARATOR);
+    g_free(dir);
+
+    vector<string> parts;
+    BOOST_FOREACH(const string &part, all)
+        if (!part.empty() && part != ".")
+            parts.push_back(part == ".." ? "__" : part);
+    return parts;
+}
+
+}
+
+DecodeJob::DecodeJob(const Capture &capture, FILE *out, const string &label) :
+    _capture(capture),
+    _out(out),
+    _label(label),
+    _native(true)
+{
+    assert(_out);
+}
+
+DecodeJob::~DecodeJob()
+{
+    BOOST_FOREACH(const Stack &stack, _stacks)
+        srd_session_destroy(stack.session);
+}
+
+bool DecodeJob::add_stack(const string &spec, string &error)
+{
+    srd_session *session = NULL;
+    srd_session_new(&session);
+    assert(session);
+    srd_session_native_set(session, _native);
+
+    srd_decoder_inst *bottom = NULL, *prev_di = NULL;
+    BOOST_FOREACH(const string &dec_spec, split(spec, ',')) {
+        srd_decoder_inst *const di = create_decoder_inst(session, dec_spec, error);
+        if (!di) {
+            srd_session_destroy(session);
+            return false;
+        }
+        if (prev_di)
+            srd_inst_stack(session, prev_di, di);
+        else
+            bottom = di;
+        prev_di = di;
+    }
+
+    srd_session_metadata_set(session, SRD_CONF_SAMPLERATE,
+        g_variant_new_uint64(_capture.samplerate()));
+    srd_pd_output_batch_callback_add(session, SRD_OUTPUT_ANN,
+        DecodeJob::annotation_callback, this);
+
+    char *srd_error = NULL;
+    if (srd_session_start(session, &srd_error) != SRD_OK) {
+        error = srd_error ? srd_error : "Failed to start decoder session.";
+        g_free(srd_error);
+        srd_session_destroy(session);
+        return false;
+    }
+
+    Stack stack;
+    stack.session = session;
+    stack.bottom = bottom;
+    _stacks.push_back(stack);
+    return true;
+}
+
+srd_decoder_inst* DecodeJob::create_decoder_inst(srd_session *session,
+    const string &spec, string &error)
+{
+    vector<string> tokens = split(spec, ':');
+
+    // DSView decoder ids may start with a number and a colon
+    string id = tokens[0];
+    size_t first_option = 1;
+    if (tokens.size() > 1 && !id.empty() &&
+        id.find_first_not_of("0123456789") == string::npos) {
+        id += ":" + tokens[1];
+        first_option = 2;
+    }
+
+    const srd_decoder *dec = srd_decoder_get_by_id(id.c_str());
+    if (!dec) {
+        // Only load the decoders which are used, modules are named
+        // like their ids with '-' instead of ':'
+        string module = id;
+        replace(module.begin(), module.end(), ':', '-');
+        srd_decoder_load(module.c_str());
+        dec = srd_decoder_get_by_id(id.c_str());
+    }
+    if (!dec) {
+        error = "Unknown decoder: " + id;
+        return NULL;
+    }
+
+    GHashTable *const opt_hash = g_hash_table_new_full(g_str_hash,
+        g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+    GHashTable *const probes = g_hash_table_new_full(g_str_hash,
+        g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+
+    for (size_t i = first_option; i < tokens.size() && error.empty(); i++) {
+        const size_t eq = tokens[i].find('=');
+        const string key = tokens[i].substr(0, eq);
+        const string value = (eq == string::npos) ? "" : tokens[i].substr(eq + 1);
+
+        if (const srd_channel *const ch = find_decoder_channel(dec, key)) {
+            const int index = _capture.find_channel(value);
+            if (index < 0) {
+                error = "Unknown channel: " + value;
+                break;
+            }
+            g_hash_table_insert(probes, g_strdup(ch->id),
+                g_variant_ref_sink(g_variant_new_int32(index)));
+            continue;
+        }
+
+        const srd_decoder_option *opt = NULL;
+        for (const GSList *l = dec->options; l; l = l->next)
+            if (key == ((const srd_decoder_option*)l->data)->id)
+                opt = (const srd_decoder_option*)l->data;
+        if (!opt) {
+            error = "Unknown option or channel of " + id + ": " + key;
+            break;
+        }
+        GVariant *const var = option_value(opt, value);
+        if (!var) {
+            error = "Invalid value of " + key + ": " + value;
+            break;
+        }
+        g_hash_table_insert(opt_hash, g_strdup(opt->id), g_variant_ref_sink(var));
+    }
+
+    for (const GSList *l = dec->channels; l && error.empty(); l = l->next)
+        if (!g_hash_table_contains(probes, ((const srd_channel*)l->data)->id))
+            error = string("Required channel of ") + id + " not given: " +
+                ((const srd_channel*)l->data)->id;
+
+    srd_decoder_inst *di = NULL;
+    if (error.empty()) {
+        di = srd_inst_new(session, dec->id, opt_hash);
+        if (di)
+            srd_inst_channel_set_all(di, probes);
+        else
+            error = "Failed to create decoder instance: " + id;
+    }
+
+    g_hash_table_destroy(opt_hash);
+    g_hash_table_destroy(probes);
+    return di;
+}
+
+void DecodeJob::set_native(bool native)
+{
+    _native = native;
+}
+
+bool DecodeJob::run(string &error)
+{
+    const vector<Capture::Channel> &channels = _capture.channels();
+    const uint64_t sample_count = _capture.sample_count();
+
+    BOOST_FOREACH(const Stack &stack, _stacks) {
+        const srd_decoder_inst *const di = stack.bottom;
+        vector<const uint8_t *> chunk(di->dec_num_channels);
+        vector<uint8_t> chunk_const(di->dec_num_channels);
+
+        // Chunks start at a byte boundary of the channel data
+        for (uint64_t i = 0; i < sample_count; i += ChunkSamples) {
+            const uint64_t chunk_end = min(i + ChunkSamples, sample_count);
+            for (int j = 0; j < di->dec_num_channels; j++) {
+                const int index = di->dec_channelmap[j];
+                chunk[j] = (index == -1) ? NULL : &channels[index].data[i / 8];
+                chunk_const[j] = 0;
+            }
+
+            char *srd_error = NULL;
+            if (srd_session_send(stack.session, i, chunk_end, chunk.data(),
+                    chunk_const.data(), chunk_end - i, &srd_error) != SRD_OK) {
+                error = srd_error ? srd_error : "Decoding failed.";
+                g_free(srd_error);
+                return false;
+            }
+            g_free(srd_error);
+        }
+    }
+
+    return true;
+}
+
+vector<string> DecodeJob::output_names(const string &dir,
+    const vector<string> &inputs)
+{
+    vector< vector<string> > dirs;
+    BOOST_FOREACH(const string &input, inputs)
+        dirs.push_back(dir_parts(input));
+
+    size_t common = dirs.empty() ? 0 : dirs[0].size();
+    BOOST_FOREACH(const vector<string> &d, dirs) {
+        size_t i = 0;
+        while (i < min(common, d.size()) && d[i] == dirs[0][i])
+            i++;
+        common = i;
+    }
+
+    vector<string> names;
+    set<string> taken;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        gchar *const base = g_path_get_basename(inputs[i].c_str());
+        string stem = base;
+        g_free(base);
+        const size_t dot = stem.rfind('.');
+        if (dot != string::npos && dot != 0)
+            stem.erase(dot);
+
+        string rel;
+        for (size_t k = common; k < dirs[i].size(); k++)
+            rel += dirs[i][k] + G_DIR_SEPARATOR_S;
+        rel += stem;
+
+        string name = rel + ".txt";
+        for (int n = 2; taken.count(name); n++)
+            name = rel + "-" + to_string(n) + ".txt";
+        taken.insert(name);
+
+        gchar *const path = g_build_filename(dir.c_str(), name.c_str(), NULL);
+        names.push_back(path);
+        g_free(path);
+    }
+    return names;
+}
+
+void DecodeJob::annotation_callback(srd_proto_data *pdata,
+    unsigned int num, void *job)
+{
+    assert(pdata);
+    assert(job);
+
+    DecodeJob *const d = (DecodeJob*)job;
+    for (unsigned int i = 0; i < num; i++) {
+        const srd_proto_data_annotation *const pda =
+            (const srd_proto_data_annotation*)pdata[i].data;
+        if (!pda->ann_text || !pda->ann_text[0])
+            continue;
+
+        // One call per line, decoders of a stack may put() concurrently
+        fprintf(d->_out, "%s%" PRIu64 "-%" PRIu64 " %s: %s\n",
+            d->_label.c_str(), pdata[i].start_sample, pdata[i].end_sample,
+            pdata[i].pdo->di->inst_id, pda->ann_text[0]);
+    }
+}
+
+} // namespace cli
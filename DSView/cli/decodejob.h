@@ -0,0 +1,100 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_CLI_DECODEJOB_H
+#define DSVIEW_CLI_DECODEJOB_H
+
+#include <libsigrokdecode4DSL/libsigrokdecode.h>
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+namespace cli {
+
+class Capture;
+
+/**
+ * Runs decoder stacks over a capture and prints their annotations,
+ * one line per annotation:
+ *
+ *   <start sample>-<end sample> <instance id>: <text>
+ */
+class DecodeJob
+{
+private:
+    static const uint64_t ChunkSamples = 1024 * 1024;
+
+    struct Stack {
+        srd_session *session;
+        srd_decoder_inst *bottom;
+    };
+
+public:
+    DecodeJob(const Capture &capture, FILE *out, const std::string &label);
+    ~DecodeJob();
+
+    /**
+     * Adds a decoder stack, in the form
+     *   <decoder>[:<key>=<value>...][,<decoder>[:<key>=<value>...]...]
+     * where the keys are option ids or channel ids, and channels are
+     * given by name or probe index.
+     */
+    bool add_stack(const std::string &spec, std::string &error);
+
+    /**
+     * Uses the native implementations of decoders where available
+     * (the default), or always the Python ones. Applies to the stacks
+     * added afterwards.
+     */
+    void set_native(bool native);
+
+    bool run(std::string &error);
+
+    /**
+     * The annotation files of the inputs in dir, "<name>.txt" without
+     * the extension of the input. The directories of the inputs below
+     * their common one are kept, and names which are still taken get
+     * a "-<n>" suffix, so no two inputs share a file.
+     */
+    static std::vector<std::string> output_names(const std::string &dir,
+        const std::vector<std::string> &inputs);
+
+private:
+    srd_decoder_inst* create_decoder_inst(srd_session *session,
+        const std::string &spec, std::string &error);
+
+    static void annotation_callback(srd_proto_data *pdata,
+        unsigned int num, void *job);
+
+private:
+    const Capture &_capture;
+    FILE *const _out;
+    const std::string _label;
+    bool _native;
+
+    std::vector<Stack> _stacks;
+};
+
+} // namespace cli
+
+#endif // DSVIEW_CLI_DECODEJOB_H
@@ -0,0 +1,411 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <libsigrok4DSL/libsigrok.h>
+#include <libsigrokdecode4DSL/libsigrokdecode.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "capture.h"
+#include "decodejob.h"
+
+#include "config.h"
+
+using namespace std;
+
+char DS_RES_PATH[256];
+
+namespace {
+
+struct Options {
+    vector<string> stacks;
+    string output_dir;
+    string output_file;     // Set by the parent of a worker process
+    bool demo;
+    uint64_t samplerate;
+    uint64_t samples;
+    bool label;
+    unsigned int jobs;
+    cli::Capture::Benchmark bench;
+};
+
+void usage()
+{
+    fprintf(stdout,
+        "Usage:\n"
+        "  %s-cli [OPTION…] -P DECODER[,DECODER…] FILE… — decode captures\n"
+        "\n"
+        "Options:\n"
+        "  -P, --decoder <spec>            Decoder stack, like 1:uart:rxtx=0:baudrate=9600\n"
+        "                                  (repeat for several stacks)\n"
+        "  -o, --output <dir>              Write annotations of each file to <dir>/<name>.txt\n"
+        "                                  (keeping the directories of the files apart)\n"
+        "  -d, --demo                      Capture from the demo device instead of files\n"
+        "  -r, --samplerate <Hz>           Samplerate of the demo capture\n"
+        "  -n, --samples <count>           Sample count of the demo capture\n"
+        "  -b, --benchmark                 Send the demo capture from the benchmark pattern,\n"
+        "                                  and report the capture and decode rates\n"
+        "  -B, --rate <samples/s>          Pace the benchmark pattern (default: no pacing)\n"
+        "  -t, --toggles <count>           Toggles per million samples of each channel\n"
+        "  -c, --channels <count>          Enabled channels of the benchmark pattern\n"
+        "  -s, --split                     Send the benchmark pattern as split channel data\n"
+        "  -f, --replay <file>             Send the logic data of a .dsl file as the pattern,\n"
+        "                                  at the samplerate of the file\n"
+        "  -S, --speed <factor>            Pace the replay at <factor> times real time\n"
+        "                                  (default: no pacing)\n"
+        "  -O, --once                      Stop at the end of the replay file\n"
+        "  -L, --label                     Start annotation lines with the file name\n"
+        "  -j, --jobs <count>              Files decoded in parallel (default: all cores)\n"
+        "  -l, --loglevel                  Set libsigrok/libsigrokdecode loglevel\n"
+        "  -V, --version                   Show release version\n"
+        "  -h, -?, --help                  Show help option\n"
+        "\n"
+        "FILEs are .dsl captures or Value Change Dumps (.vcd).\n"
+        "Channels are given by name or probe index, options are\n"
+        "converted to the type of their default value. A benchmark\n"
+        "needs no decoder stack.\n"
+        "\n", DS_BIN_NAME);
+}
+
+void report(const string &name, const char *stage,
+    const cli::Capture &capture, int64_t time)
+{
+    const double seconds = max<int64_t>(time, 1) / 1000000.0;
+    const uint64_t bytes = capture.sample_count() / 8 * capture.channels().size();
+    fprintf(stderr, "%s: %s of %" PRIu64 " samples x %u channels in %.3fs, "
+        "%.1f Msamples/s, %.1f MB/s\n", name.c_str(), stage,
+        capture.sample_count(), (unsigned int)capture.channels().size(),
+        seconds, capture.sample_count() / seconds / 1000000,
+        bytes / seconds / (1024 * 1024));
+}
+
+// Decodes one capture in this process, input is empty for the demo,
+// output is empty for stdout
+bool process(sr_context *sr_ctx, const Options &opts, const string &input,
+    const string &output)
+{
+    const string name = input.empty() ? string("demo") : input;
+    string error;
+
+    cli::Capture capture(sr_ctx);
+    int64_t start = g_get_monotonic_time();
+    const bool ok = input.empty() ?
+        capture.capture_demo(opts.samplerate, opts.samples, opts.bench, error) :
+        capture.load(input, error);
+    if (!ok) {
+        fprintf(stderr, "%s: %s\n", name.c_str(), error.c_str());
+        return false;
+    }
+    if (opts.bench.enabled) {
+        report(name, "capture", capture, g_get_monotonic_time() - start);
+        if (opts.stacks.empty())
+            return true;
+        start = g_get_monotonic_time();
+    }
+
+    FILE *out = stdout;
+    if (!output.empty()) {
+        gchar *const dir = g_path_get_dirname(output.c_str());
+        g_mkdir_with_parents(dir, 0755);
+        g_free(dir);
+        if (!(out = fopen(output.c_str(), "w"))) {
+            fprintf(stderr, "%s: Failed to open %s.\n", name.c_str(), output.c_str());
+            return false;
+        }
+    }
+
+    bool ret = true;
+    {
+        cli::DecodeJob job(capture, out, opts.label ? name + ": " : string());
+        BOOST_FOREACH(const string &spec, opts.stacks)
+            if (!(ret = job.add_stack(spec, error)))
+                break;
+        if (ret)
+            ret = job.run(error);
+    }
+    if (!ret)
+        fprintf(stderr, "%s: %s\n", name.c_str(), error.c_str());
+    else if (opts.bench.enabled)
+        report(name, "decode", capture, g_get_monotonic_time() - start);
+
+    if (out != stdout)
+        fclose(out);
+    else
+        fflush(stdout);
+    return ret;
+}
+
+// Decodes the files in worker processes, libsigrok has one global
+// session and Python decoders hold the GIL, so threads would not scale
+void spawn_worker(const vector<string> &worker_args,
+    const vector<string> &inputs, const vector<string> &outputs,
+    size_t &next, boost::mutex &mutex, bool &ok)
+{
+    while (true) {
+        vector<string> args = worker_args;
+        {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            if (next == inputs.size())
+                return;
+            if (!outputs.empty()) {
+                args.push_back("--output-file");
+                args.push_back(outputs[next]);
+            }
+            args.push_back(inputs[next++]);
+        }
+
+        vector<gchar*> argv;
+        BOOST_FOREACH(string &arg, args)
+            argv.push_back(&arg[0]);
+        argv.push_back(NULL);
+
+        gint status = 0;
+        GError *error = NULL;
+        if (!g_spawn_sync(NULL, argv.data(), NULL, G_SPAWN_SEARCH_PATH,
+                          NULL, NULL, NULL, NULL, &status, &error)) {
+            fprintf(stderr, "%s: %s\n", args.back().c_str(), error->message);
+            g_error_free(error);
+            status = 1;
+        }
+
+        if (status != 0) {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            ok = false;
+        }
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    struct sr_context *sr_ctx = NULL;
+    Options opts;
+    opts.demo = false;
+    opts.samplerate = 0;
+    opts.samples = 0;
+    opts.label = false;
+    opts.jobs = 0;
+
+    // Arguments passed on to worker processes
+    vector<string> worker_args;
+    worker_args.push_back(argv[0]);
+
+    // Parse arguments
+    while (1) {
+        static const struct option long_options[] = {
+            {"decoder", required_argument, 0, 'P'},
+            {"output", required_argument, 0, 'o'},
+            {"output-file", required_argument, 0, 'F'},
+            {"demo", no_argument, 0, 'd'},
+            {"samplerate", required_argument, 0, 'r'},
+            {"samples", required_argument, 0, 'n'},
+            {"benchmark", no_argument, 0, 'b'},
+            {"rate", required_argument, 0, 'B'},
+            {"toggles", required_argument, 0, 't'},
+            {"channels", required_argument, 0, 'c'},
+            {"split", no_argument, 0, 's'},
+            {"replay", required_argument, 0, 'f'},
+            {"speed", required_argument, 0, 'S'},
+            {"once", no_argument, 0, 'O'},
+            {"label", no_argument, 0, 'L'},
+            {"jobs", required_argument, 0, 'j'},
+            {"loglevel", required_argument, 0, 'l'},
+            {"version", no_argument, 0, 'V'},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0}
+        };
+
+        const int c = getopt_long(argc, argv,
+            "P:o:F:dr:n:bB:t:c:sf:S:OLj:l:Vh?", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'P':
+            opts.stacks.push_back(optarg);
+            break;
+
+        case 'o':
+            opts.output_dir = optarg;
+            break;
+
+        case 'F':
+            opts.output_file = optarg;
+            continue;
+
+        case 'd':
+            opts.demo = true;
+            break;
+
+        case 'r':
+            opts.samplerate = strtoull(optarg, NULL, 10);
+            break;
+
+        case 'n':
+            opts.samples = strtoull(optarg, NULL, 10);
+            break;
+
+        case 'b':
+            opts.bench.enabled = true;
+            break;
+
+        case 'B':
+            opts.bench.rate = strtoull(optarg, NULL, 10);
+            break;
+
+        case 't':
+            opts.bench.toggle_density = strtoull(optarg, NULL, 10);
+            break;
+
+        case 'c':
+            opts.bench.channels = strtoul(optarg, NULL, 10);
+            break;
+
+        case 's':
+            opts.bench.split = true;
+            break;
+
+        case 'f':
+            opts.bench.replay = optarg;
+            break;
+
+        case 'S':
+            opts.bench.speed = strtoull(optarg, NULL, 10);
+            break;
+
+        case 'O':
+            opts.bench.loop = false;
+            break;
+
+        case 'L':
+            opts.label = true;
+            break;
+
+        case 'j':
+            opts.jobs = strtoul(optarg, NULL, 10);
+            continue;
+
+        case 'l':
+        {
+            const int loglevel = atoi(optarg);
+            sr_log_loglevel_set(loglevel);
+            srd_log_loglevel_set(loglevel);
+            break;
+        }
+
+        case 'V':
+            // Print version info
+            fprintf(stdout, "%s %s\n", DS_TITLE, DS_VERSION_STRING);
+            return 0;
+
+        case 'h':
+        case '?':
+            usage();
+            return 0;
+        }
+
+        worker_args.push_back(string("-") + (char)c);
+        if (c != 'd' && c != 'L' && c != 'b' && c != 's' && c != 'O')
+            worker_args.push_back(optarg);
+    }
+
+    vector<string> inputs(argv + optind, argv + argc);
+    if ((opts.stacks.empty() && !opts.bench.enabled) ||
+        (inputs.empty() != opts.demo)) {
+        usage();
+        return 1;
+    }
+
+    if (opts.jobs == 0)
+        opts.jobs = g_get_num_processors();
+    if (inputs.size() > 1 && opts.output_dir.empty() && !opts.label) {
+        // Lines of several files go to stdout
+        opts.label = true;
+        worker_args.push_back("-L");
+    }
+
+    // Worked out here for all inputs, so they stay apart in workers
+    vector<string> outputs;
+    if (!opts.output_file.empty())
+        outputs.push_back(opts.output_file);
+    else if (!opts.output_dir.empty())
+        outputs = cli::DecodeJob::output_names(opts.output_dir,
+            opts.demo ? vector<string>(1, "demo") : inputs);
+
+    if (inputs.size() > 1 && opts.jobs > 1) {
+        // Lines of the workers are written whole
+        setvbuf(stdout, NULL, _IOLBF, 0);
+        fflush(stdout);
+
+        size_t next = 0;
+        boost::mutex mutex;
+        bool ok = true;
+        vector< boost::shared_ptr<boost::thread> > threads;
+        for (unsigned int i = 0; i < min<size_t>(opts.jobs, inputs.size()); i++)
+            threads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(
+                spawn_worker, boost::cref(worker_args), boost::cref(inputs),
+                boost::cref(outputs), boost::ref(next), boost::ref(mutex),
+                boost::ref(ok))));
+        BOOST_FOREACH(const boost::shared_ptr<boost::thread> &t, threads)
+            t->join();
+        return ok ? 0 : 1;
+    }
+
+    if (opts.label)
+        setvbuf(stdout, NULL, _IOLBF, 0);
+
+    // Initialise libsigrok
+    if (sr_init(&sr_ctx) != SR_OK) {
+        fprintf(stderr, "ERROR: libsigrok init failed.\n");
+        return 1;
+    }
+
+    bool ok = true;
+    if (srd_init(NULL) != SRD_OK) {
+        fprintf(stderr, "ERROR: libsigrokdecode init failed.\n");
+        ok = false;
+    } else {
+        if (opts.demo)
+            ok = process(sr_ctx, opts, string(),
+                outputs.empty() ? string() : outputs[0]);
+        for (size_t i = 0; i < inputs.size(); i++)
+            ok = process(sr_ctx, opts, inputs[i],
+                outputs.empty() ? string() : outputs[i]) && ok;
+        srd_exit();
+    }
+
+    sr_exit(sr_ctx);
+
+    return ok ? 0 : 1;
+}
@@ -84,11 +84,13 @@ void AnalogSnapshot::init()
             _envelope_levels[i][level].data_length = 0;
         }
     }
+    invalidate();
 }
 
 void AnalogSnapshot::clear()
 {
     boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    boost::unique_lock<boost::shared_mutex> access(_access_mutex);
     free_data();
     free_envelop();
     init();
@@ -96,6 +98,9 @@ void AnalogSnapshot::clear()
 
 void AnalogSnapshot::first_payload(const sr_datafeed_analog &analog, uint64_t total_sample_count, GSList *channels)
 {
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    boost::unique_lock<boost::shared_mutex> access(_access_mutex);
+
     _total_sample_count = total_sample_count;
     _unit_bytes = (analog.unit_bits + 7) / 8;
     assert(_unit_bytes > 0);
@@ -155,12 +160,15 @@ void AnalogSnapshot::first_payload(const sr_datafeed_analog &analog, uint64_t to
         }
         _capacity = size;
         _memory_failed = false;
+        invalidate();
+        access.unlock();
         append_payload(analog);
         _last_ended = false;
     } else {
         free_data();
         free_envelop();
         _memory_failed = true;
+        invalidate();
     }
 }
 
@@ -168,11 +176,20 @@ void AnalogSnapshot::append_payload(
 	const sr_datafeed_analog &analog)
 {
     boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+
+    // Once the ring is full the oldest samples and their envelope get
+    // overwritten, readers must not be in there meanwhile
+    boost::unique_lock<boost::shared_mutex> access(_access_mutex, boost::defer_lock);
+    if (_sample_count + analog.num_samples > _total_sample_count)
+        access.lock();
+
     append_data(analog.data, analog.num_samples, analog.unit_pitch);
 
 	// Generate the first mip-map from the data
     if (analog.num_samples != 0) // guarantee new samples to compute
         append_payload_to_envelope_levels();
+
+    publish();
 }
 
 void AnalogSnapshot::append_data(void *data, uint64_t samples, uint16_t pitch)
@@ -191,6 +208,7 @@ void AnalogSnapshot::append_data(void *data, uint64_t samples, uint16_t pitch)
             _ring_sample_count = (samples + _ring_sample_count - _total_sample_count) % _total_sample_count;
             memcpy((uint8_t*)_data,
                 data, _ring_sample_count * bytes_per_sample);
+            invalidate();
         } else {
             memcpy((uint8_t*)_data + _ring_sample_count * bytes_per_sample,
                 data, samples * bytes_per_sample);
@@ -205,6 +223,8 @@ void AnalogSnapshot::append_data(void *data, uint64_t samples, uint16_t pitch)
                     data, bytes_per_sample);
                 data = (uint8_t*)data + bytes_per_sample;
                 _ring_sample_count = (_ring_sample_count + 1) % _total_sample_count;
+                if (_ring_sample_count == 0)
+                    invalidate();
                 _unit_pitch = pitch;
             }
             _unit_pitch--;
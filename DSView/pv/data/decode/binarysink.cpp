@@ -0,0 +1,238 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+extern "C" {
+#include <libsigrokdecode4DSL/libsigrokdecode.h>
+}
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include <QDir>
+#include <QFile>
+#include <QObject>
+
+#include "binarysink.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#ifndef O_NONBLOCK
+#define O_NONBLOCK 0
+#endif
+
+using namespace std;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+BinarySink::BinarySink(const QString &dir) :
+    _dir(dir),
+    _bytes_written(0),
+    _cancelled(false)
+{
+}
+
+BinarySink::~BinarySink()
+{
+    close();
+}
+
+void BinarySink::write(const srd_proto_data *pdata)
+{
+    assert(pdata);
+    assert(pdata->pdo);
+
+    const srd_proto_data_binary *const pdb =
+        (const srd_proto_data_binary*)pdata->data;
+    assert(pdb);
+
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    const pair<const srd_decoder_inst*, int> key(pdata->pdo->di, pdb->bin_class);
+    map<pair<const srd_decoder_inst*, int>, File>::iterator i = _files.find(key);
+    if (i == _files.end()) {
+        File file;
+        file.fd = open(pdata->pdo->di, pdb->bin_class);
+        i = _files.insert(make_pair(key, file)).first;
+    }
+
+    File &file = (*i).second;
+    if (file.fd < 0)
+        return;
+
+    file.buf.insert(file.buf.end(), pdb->data, pdb->data + pdb->size);
+    if (file.buf.size() >= BufferSize)
+        flush(file);
+}
+
+void BinarySink::close()
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    for (map<pair<const srd_decoder_inst*, int>, File>::iterator i = _files.begin();
+        i != _files.end(); i++)
+        if ((*i).second.fd >= 0) {
+            flush((*i).second);
+            close((*i).second);
+        }
+    _files.clear();
+}
+
+void BinarySink::cancel()
+{
+    _cancelled = true;
+}
+
+QString BinarySink::error() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    return _error;
+}
+
+uint64_t BinarySink::bytes_written() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    return _bytes_written;
+}
+
+int BinarySink::open(const srd_decoder_inst *di, int bin_class)
+{
+    const char *const *const bin =
+        (const char**)g_slist_nth_data(di->decoder->binary, bin_class);
+    QString name = QString("%1-%2.bin")
+        .arg(di->inst_id)
+        .arg(bin ? bin[0] : QString::number(bin_class));
+
+    // Instance ids look like "1:uart-1", keep file names portable
+    for (int k = 0; k < name.size(); k++)
+        if (!name[k].isLetterOrNumber() && name[k] != '-' &&
+            name[k] != '_' && name[k] != '.')
+            name[k] = '_';
+
+    // A blocking open of a named pipe waits for a reader, which
+    // can't be interrupted, so open without blocking
+    const QString path = QDir(_dir).filePath(name);
+    const int fd = ::open(QFile::encodeName(path).constData(),
+        O_WRONLY | O_CREAT | O_TRUNC | O_BINARY | O_NONBLOCK, 0666);
+    if (fd < 0) {
+        set_error((errno == ENXIO) ?
+            QObject::tr("No reader on named pipe %1").arg(path) :
+            QObject::tr("Failed to open %1").arg(path));
+        return -1;
+    }
+#ifdef F_SETNOSIGPIPE
+    // macOS can leave out the SIGPIPE for this file altogether
+    fcntl(fd, F_SETNOSIGPIPE, 1);
+#endif
+    return fd;
+}
+
+bool BinarySink::flush(File &file)
+{
+    assert(file.fd >= 0);
+
+#ifndef _WIN32
+    // A reader which goes away would raise SIGPIPE, hold it back in
+    // this thread and take the EPIPE error instead
+    sigset_t sigpipe, old_mask;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, &old_mask);
+#endif
+
+    size_t done = 0;
+    int err = 0;
+    while (done < file.buf.size()) {
+        const ssize_t n = ::write(file.fd, &file.buf[done],
+            file.buf.size() - done);
+        if (n > 0) {
+            done += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+#ifndef _WIN32
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+            !_cancelled) {
+            // A pipe whose reader is behind, wait a little and look
+            // for cancel() in between
+            struct pollfd pfd;
+            pfd.fd = file.fd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            poll(&pfd, 1, PollTimeout);
+            continue;
+        }
+#endif
+        err = (n < 0) ? errno : EIO;
+        if (!_cancelled)
+            set_error(QObject::tr("Failed to write binary decoder output"));
+        break;
+    }
+    _bytes_written += done;
+    file.buf.clear();
+
+#ifndef _WIN32
+    if (err == EPIPE) {
+        // Take the pending SIGPIPE before unblocking it, sigwait()
+        // doesn't wait then (sigtimedwait() is missing on macOS)
+        sigset_t pending;
+        int sig;
+        sigemptyset(&pending);
+        if (sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE))
+            sigwait(&sigpipe, &sig);
+    }
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+#endif
+
+    if (err != 0)
+        close(file);
+    return err == 0;
+}
+
+void BinarySink::close(File &file)
+{
+    if (file.fd >= 0)
+        ::close(file.fd);
+    file.fd = -1;
+    vector<uint8_t>().swap(file.buf);
+}
+
+void BinarySink::set_error(const QString &error)
+{
+    if (_error.isEmpty())
+        _error = error;
+}
+
+} // namespace decode
+} // namespace data
+} // namespace pv
@@ -0,0 +1,113 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_PV_DATA_DECODE_BINARYSINK_H
+#define DSVIEW_PV_DATA_DECODE_BINARYSINK_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <QString>
+
+struct srd_proto_data;
+struct srd_decoder_inst;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+/**
+ * Writes the binary output of the decoders to one file per instance
+ * and binary class, "<instance id>-<class id>.bin" in a directory.
+ * The data is written as the decoders put() it, through a large
+ * buffer, so nothing is kept in memory. Existing named pipes are
+ * written to like files, but never waited on without a way out:
+ * a pipe without a reader is reported as an error, and a reader
+ * which stops reading only holds the decoders until cancel().
+ */
+class BinarySink
+{
+private:
+    static const size_t BufferSize = 1024 * 1024;
+    static const int PollTimeout = 100;
+
+    struct File
+    {
+        int fd;
+        std::vector<uint8_t> buf;
+    };
+
+public:
+    BinarySink(const QString &dir);
+    ~BinarySink();
+
+    /**
+     * Appends the data of an SRD_OUTPUT_BINARY packet to its file,
+     * which is created on the first write. Can be called from the
+     * threads of several decoder instances.
+     */
+    void write(const srd_proto_data *pdata);
+
+    /**
+     * Flushes and closes all files, the destructor does the same.
+     * Errors of the last writes show up in error() afterwards.
+     */
+    void close();
+
+    /**
+     * Makes writes which wait for a slow pipe reader give up, so
+     * stopping the decode doesn't hang. Can be called from any thread.
+     */
+    void cancel();
+
+    /**
+     * The first error which happened, empty when all went well.
+     */
+    QString error() const;
+
+    uint64_t bytes_written() const;
+
+private:
+    int open(const srd_decoder_inst *di, int bin_class);
+    bool flush(File &file);
+    void close(File &file);
+    void set_error(const QString &error);
+
+private:
+    const QString _dir;
+
+    mutable boost::mutex _mutex;
+    std::map<std::pair<const srd_decoder_inst*, int>, File> _files;
+    uint64_t _bytes_written;
+    QString _error;
+    std::atomic<bool> _cancelled;
+};
+
+} // namespace decode
+} // namespace data
+} // namespace pv
+
+#endif // DSVIEW_PV_DATA_DECODE_BINARYSINK_H
@@ -24,6 +24,7 @@
 
 #include <stdexcept>
 #include <algorithm>
+#include <string.h>
 
 #include <QDebug>
 
@@ -33,6 +34,7 @@
 #include <pv/data/logicsnapshot.h>
 #include <pv/data/decode/decoder.h>
 #include <pv/data/decode/annotation.h>
+#include <pv/data/decode/binarysink.h>
 #include <pv/sigsession.h>
 #include <pv/view/logicsignal.h>
 
@@ -61,7 +63,10 @@ DecoderStack::DecoderStack(pv::SigSession &session,
     _decode_state(Stopped),
     _options_changed(false),
     _no_memory(false),
-    _mark_index(-1)
+    _mark_index(-1),
+    _stitched(0),
+    _decode_start(0),
+    _decode_time(0)
 {
 	connect(&_session, SIGNAL(frame_began()),
 		this, SLOT(on_new_frame()));
@@ -382,6 +387,16 @@ void DecoderStack::stop_decode()
     //_snapshot.reset();
     if(_decode_state != Stopped) {
         if (_decode_thread.get()) {
+            {
+                // Don't wait for the decoders to finish a whole chunk
+                boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+                BOOST_FOREACH(const boost::shared_ptr<DecodeSegment> &seg, _segments)
+                    if (seg->session)
+                        srd_session_interrupt(seg->session);
+                // Nor for a pipe reader which has stopped reading
+                if (_binary_sink)
+                    _binary_sink->cancel();
+            }
             _decode_thread->interrupt();
             _decode_thread->join();
             _decode_state = Stopped;
@@ -437,6 +452,13 @@ void DecoderStack::begin_decode()
     if (_snapshot->empty())
         return;
 
+    // A roll moves its samples on while they'd be decoded, it's
+    // decoded once it has stopped
+    if (_snapshot->rolling()) {
+        _error_message = tr("Rolling captures are decoded when they stop.");
+        return;
+    }
+
     // Get the samplerate
 	_samplerate = data->samplerate();
     if (_samplerate == 0.0)
@@ -458,16 +480,14 @@ uint64_t DecoderStack::get_max_sample_count() const
 	return max_sample_count;
 }
 
-void DecoderStack::decode_data(
-    const uint64_t decode_start, const uint64_t decode_end,
-    srd_session *const session)
+bool DecoderStack::decode_data(DecodeSegment *seg)
 {
     //uint8_t *chunk = NULL;
-    uint64_t last_cnt = 0;
-    uint64_t notify_cnt = (decode_end - decode_start + 1)/100;
+    uint64_t last_cnt = seg->start;
+    uint64_t notify_cnt = (seg->end - seg->start + 1)/100;
     srd_decoder_inst *logic_di = NULL;
     // find the first level decoder instant
-    for (GSList *d = session->di_list; d; d = d->next) {
+    for (GSList *d = seg->session->di_list; d; d = d->next) {
         srd_decoder_inst *di = (srd_decoder_inst *)d->data;
         srd_decoder *decoder = di->decoder;
         const bool have_probes = (decoder->channels || decoder->opt_channels) != 0;
@@ -477,47 +497,67 @@ void DecoderStack::decode_data(
         }
     }
 
+    for (int j =0 ; j < logic_di->dec_num_channels; j++) {
+        int sig_index = logic_di->dec_channelmap[j];
+        if (sig_index != -1 && !_snapshot->has_data(sig_index)) {
+            boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+            _error_message = tr("At least one of selected channels are not enabled.");
+            return false;
+        }
+    }
+
+    // Chunks are whole leaves of the snapshot, passed without copying.
+    // Constant leaves are freed and passed as NULL with their value,
+    // the decoder skips them when waiting for an edge there.
+    std::vector<const uint8_t *> chunk(logic_di->dec_num_channels);
+    std::vector<uint8_t> chunk_const(logic_di->dec_num_channels);
     uint64_t entry_cnt = 0;
-    uint64_t i = decode_start;
+    uint64_t i = seg->start;
     char *error = NULL;
+    bool ok = true;
     while(!boost::this_thread::interruption_requested() &&
-          i < decode_end && !_no_memory)
+          i < seg->end && !_no_memory)
     {
         //lock_guard<mutex> decode_lock(_global_decode_mutex);
-        std::vector<const uint8_t *> chunk;
-        std::vector<uint8_t> chunk_const;
-        uint64_t chunk_end = decode_end;
+        // the leaves must outlive srd_session_send(), the recorder
+        // doesn't release them while they are pinned
+        if (!_snapshot->pin(seg, i)) {
+            boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+            _error_message = tr("The samples to decode have been released after recording.");
+            ok = false;
+            break;
+        }
+        boost::shared_lock<boost::shared_mutex> access(_snapshot->get_access_mutex());
+        uint64_t chunk_end = seg->end;
         for (int j =0 ; j < logic_di->dec_num_channels; j++) {
             int sig_index = logic_di->dec_channelmap[j];
             if (sig_index == -1) {
-                chunk.push_back(NULL);
-                chunk_const.push_back(0);
+                chunk[j] = NULL;
+                chunk_const[j] = 0;
             } else {
-                if (_snapshot->has_data(sig_index)) {
-                    chunk.push_back(_snapshot->get_samples(i, chunk_end, sig_index));
-                    chunk_const.push_back(_snapshot->get_sample(i, sig_index));
-                } else {
-                    _error_message = tr("At least one of selected channels are not enabled.");
-                    return;
-                }
+                chunk[j] = _snapshot->get_samples(i, chunk_end, sig_index);
+                chunk_const[j] = chunk[j] ? 0 : _snapshot->get_sample(i, sig_index);
             }
         }
-        if (chunk_end > decode_end)
-            chunk_end = decode_end;
-        if (chunk_end - i > MaxChunkSize)
-            chunk_end = i + MaxChunkSize;
+        if (chunk_end > seg->end)
+            chunk_end = seg->end;
 
-        if (srd_session_send(session, i, chunk_end,
+        if (srd_session_send(seg->session, i, chunk_end,
                              chunk.data(), chunk_const.data(), chunk_end - i, &error) != SRD_OK) {
-            _error_message = QString::fromLocal8Bit(error);
+            // an interrupted session has no message, keep the last one
+            boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+            if (error)
+                _error_message = QString::fromLocal8Bit(error);
+            ok = false;
             break;
         }
-        i = chunk_end;
+        access.unlock();
 
         {
             boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
-            _samples_decoded = i - decode_start + 1;
+            _samples_decoded += chunk_end - i;
         }
+        i = chunk_end;
 
         if ((i - last_cnt) > notify_cnt) {
             last_cnt = i;
@@ -527,32 +567,23 @@ void DecoderStack::decode_data(
     }
     if (error)
         g_free(error);
-    decode_done();
+    // stopped before seg->end
+    if (boost::this_thread::interruption_requested() || _no_memory)
+        ok = false;
+    return ok;
 }
 
-void DecoderStack::decode_proc()
+srd_session* DecoderStack::create_session(DecodeSegment *seg)
 {
-    boost::lock_guard<boost::mutex> decode_lock(_global_decode_mutex);
-
-    optional<uint64_t> sample_count;
 	srd_session *session;
 	srd_decoder_inst *prev_di = NULL;
-    uint64_t decode_start = 0;
-    uint64_t decode_end = 0;
-
-	assert(_snapshot);
 
 	// Create the session
 	srd_session_new(&session);
 	assert(session);
 
-    _decode_state = Running;
-
-    // Get the intial sample count
-    {
-        //unique_lock<mutex> input_lock(_input_mutex);
-        sample_count = _sample_count = _snapshot->get_sample_count();
-    }
+    if (pipelined())
+        srd_session_pipeline_set(session, PipelineDepth);
 
     // Create the decoders
     BOOST_FOREACH(const boost::shared_ptr<decode::Decoder> &dec, _stack)
@@ -563,35 +594,419 @@ void DecoderStack::decode_proc()
 		{
 			_error_message = tr("Failed to create decoder instance");
 			srd_session_destroy(session);
-			return;
+			return NULL;
 		}
 
 		if (prev_di)
 			srd_inst_stack (session, prev_di, di);
 
 		prev_di = di;
-        decode_start = dec->decode_start();
-        decode_end = min(dec->decode_end(), _sample_count-1);
 	}
 
 	// Start the session
 	srd_session_metadata_set(session, SRD_CONF_SAMPLERATE,
 		g_variant_new_uint64((uint64_t)_samplerate));
 
-	srd_pd_output_callback_add(session, SRD_OUTPUT_ANN,
-		DecoderStack::annotation_callback, this);
+	srd_pd_output_batch_callback_add(session, SRD_OUTPUT_ANN,
+		DecoderStack::annotation_callback, seg);
+
+    // Registering this makes the decoders put() their binary output,
+    // and keeps them from switching to a native implementation
+    if (_binary_sink)
+        srd_pd_output_callback_add(session, SRD_OUTPUT_BINARY,
+            DecoderStack::binary_callback, seg);
 
     char *error = NULL;
-    if (srd_session_start(session, &error) == SRD_OK)
-        decode_data(decode_start, decode_end, session);
-    else
-        _error_message = QString::fromLocal8Bit(error);
+    if (srd_session_start(session, &error) != SRD_OK) {
+        if (error) {
+            _error_message = QString::fromLocal8Bit(error);
+            g_free(error);
+        }
+        srd_session_destroy(session);
+        return NULL;
+    }
 
-	// Destroy the session
-    if (error) {
-        g_free(error);
+    return session;
+}
+
+void DecoderStack::decode_segment(DecodeSegment *seg)
+{
+    const bool ok = decode_data(seg);
+    _snapshot->unpin(seg);
+
+    boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+    seg->ok = ok;
+    seg->done = true;
+    stitch_segments();
+}
+
+void DecoderStack::stitch_segments()
+{
+    // Called with _output_mutex held. Segments pass their annotations
+    // to _rows in order, so each RowData stays sorted
+    while (_stitched < _segments.size()) {
+        DecodeSegment &seg = *_segments[_stitched];
+        if (!seg.direct) {
+            for (map<const Row, RowData>::const_iterator i = seg.rows.begin();
+                i != seg.rows.end(); i++) {
+                RowData &dest = _rows[(*i).first];
+                Annotation ann;
+                for (uint64_t k = 0; k < (*i).second.get_annotation_size(); k++) {
+                    (*i).second.get_annotation(ann, k);
+                    if (!dest.push_annotation(ann)) {
+                        _no_memory = true;
+                        break;
+                    }
+                }
+            }
+            seg.rows.clear();
+            seg.direct = true;
+        }
+        if (!seg.done)
+            break;
+        _stitched++;
+    }
+}
+
+namespace {
+
+// Where a protocol can be resynchronized: all channels idle for at
+// least min_idle_time seconds, or frame_bits bits at the rate option
+struct SegmentRule {
+    const char *decoder_id;
+    const char *channel_ids[2];
+    const char *rate_option;
+    double frame_bits;
+    double min_idle_time;
+    // Option and value which invert the idle level (high by default)
+    const char *invert_option;
+    const char *invert_value;
+};
+
+const SegmentRule SegmentRules[] = {
+    {"0:uart", {"rxtx", NULL}, "baudrate", 12, 0, "invert", "yes"},
+    {"1:uart", {"rxtx", NULL}, "baudrate", 12, 0, "invert", "yes"},
+    {"0:i2c", {"scl", "sda"}, NULL, 0, 10e-6, NULL, NULL},
+    {"1:i2c", {"scl", "sda"}, NULL, 0, 10e-6, NULL, NULL},
+    {"0:spi", {"cs", NULL}, NULL, 0, 0, "cs_polarity", "active-high"},
+    {"1:spi", {"cs", NULL}, NULL, 0, 0, "cs_polarity", "active-high"},
+    {"can", {"can_rx", NULL}, "bitrate", 11, 0, NULL, NULL},
+};
+
+// Decoders which replace the objects they put() instead of changing
+// them later, so the decoders stacked on them can run in other threads
+const char *const PipelineDecoders[] = {"1:i2c", "1:spi", "1:uart"};
+
+GVariant* decoder_option(const decode::Decoder &dec, const char *id)
+{
+    const map<string, GVariant*> &options = dec.options();
+    map<string, GVariant*>::const_iterator i = options.find(id);
+    if (i != options.end())
+        return (*i).second;
+
+    for (const GSList *l = dec.decoder()->options; l; l = l->next) {
+        const srd_decoder_option *const opt = (srd_decoder_option*)l->data;
+        if (strcmp(opt->id, id) == 0)
+            return opt->def;
+    }
+    return NULL;
+}
+
+double option_number(GVariant *var)
+{
+    if (!var)
+        return 0;
+    if (g_variant_is_of_type(var, G_VARIANT_TYPE_INT64))
+        return g_variant_get_int64(var);
+    if (g_variant_is_of_type(var, G_VARIANT_TYPE_UINT64))
+        return g_variant_get_uint64(var);
+    if (g_variant_is_of_type(var, G_VARIANT_TYPE_INT32))
+        return g_variant_get_int32(var);
+    if (g_variant_is_of_type(var, G_VARIANT_TYPE_DOUBLE))
+        return g_variant_get_double(var);
+    return 0;
+}
+
+}
+
+bool DecoderStack::pipelined() const
+{
+    if (_stack.size() < 2)
+        return false;
+
+    // The top decoder only gets its input, it isn't read by others
+    list< boost::shared_ptr<decode::Decoder> >::const_iterator top = _stack.end();
+    --top;
+    for (list< boost::shared_ptr<decode::Decoder> >::const_iterator i = _stack.begin();
+        i != top; i++) {
+        const char *const id = (*i)->decoder()->id;
+        bool safe = false;
+        for (size_t j = 0; j < sizeof(PipelineDecoders) / sizeof(PipelineDecoders[0]); j++)
+            if (strcmp(PipelineDecoders[j], id) == 0)
+                safe = true;
+        if (!safe)
+            return false;
+    }
+    return true;
+}
+
+void DecoderStack::find_segment_bounds(uint64_t start, uint64_t end,
+    std::vector<uint64_t> &bounds)
+{
+    bounds.clear();
+    bounds.push_back(start);
+
+    uint64_t n = (end - start) / MinSegmentSamples;
+    if (n > boost::thread::hardware_concurrency())
+        n = boost::thread::hardware_concurrency();
+    if (n > MaxDecodeSegments)
+        n = MaxDecodeSegments;
+    if (n < 2 || _stack.empty()) {
+        bounds.push_back(end);
+        return;
+    }
+
+    const decode::Decoder &dec = *_stack.front();
+    const SegmentRule *rule = NULL;
+    for (size_t i = 0; i < sizeof(SegmentRules) / sizeof(SegmentRules[0]); i++)
+        if (strcmp(SegmentRules[i].decoder_id, dec.decoder()->id) == 0)
+            rule = &SegmentRules[i];
+
+    // The channels which have to be idle, all must be assigned
+    std::vector<int> probes;
+    for (int k = 0; rule && k < 2 && rule->channel_ids[k]; k++) {
+        int probe = -1;
+        for (map<const srd_channel*, int>::const_iterator i = dec.channels().begin();
+            i != dec.channels().end(); i++)
+            if (strcmp((*i).first->id, rule->channel_ids[k]) == 0)
+                probe = (*i).second;
+        if (probe == -1 || !_snapshot->has_data(probe)) {
+            rule = NULL;
+            break;
+        }
+        probes.push_back(probe);
+    }
+
+    double min_idle = 0;
+    if (rule && rule->rate_option) {
+        const double rate = option_number(decoder_option(dec, rule->rate_option));
+        if (rate <= 0)
+            rule = NULL;
+        else
+            min_idle = rule->frame_bits * _samplerate / rate;
+    } else if (rule) {
+        min_idle = rule->min_idle_time * _samplerate;
+    }
+    if (!rule) {
+        bounds.push_back(end);
+        return;
+    }
+
+    bool idle = true;
+    if (rule->invert_option) {
+        GVariant *const var = decoder_option(dec, rule->invert_option);
+        if (var && g_variant_is_of_type(var, G_VARIANT_TYPE_STRING) &&
+            strcmp(g_variant_get_string(var, NULL), rule->invert_value) == 0)
+            idle = false;
+    }
+
+    // Split at the middle of the longest idle time near each target
+    const uint64_t seg_len = (end - start) / n;
+    const uint64_t window = seg_len / 4;
+    for (uint64_t k = 1; k < n; k++) {
+        const uint64_t target = start + k * seg_len;
+        uint64_t run_start, run_end;
+        if (!find_idle_run(probes, idle, target - window, target + window,
+                           run_start, run_end))
+            continue;
+        if (run_end - run_start <= min_idle)
+            continue;
+        const uint64_t split = run_start + (run_end - run_start) / 2;
+        if (split > bounds.back())
+            bounds.push_back(split);
+    }
+    bounds.push_back(end);
+}
+
+bool DecoderStack::find_idle_run(const std::vector<int> &probes, bool idle,
+    uint64_t start, uint64_t end,
+    uint64_t &run_start, uint64_t &run_end)
+{
+    bool found = false;
+    uint64_t index = start;
+
+    while (index < end) {
+        // Move to a sample where all channels are idle
+        bool all_idle = true;
+        BOOST_FOREACH(int probe, probes) {
+            if (_snapshot->get_sample(index, probe) != idle) {
+                uint64_t edge = index;
+                if (!_snapshot->get_nxt_edge(edge, !idle, end, 1, probe))
+                    return found;
+                index = edge;
+                all_idle = false;
+            }
+        }
+        if (!all_idle)
+            continue;
+
+        // The idle time ends when the first channel changes
+        uint64_t stop = end;
+        BOOST_FOREACH(int probe, probes) {
+            uint64_t edge = index;
+            if (_snapshot->get_nxt_edge(edge, idle, end, 1, probe))
+                stop = min(stop, edge);
+        }
+        if (stop <= index)
+            break;
+        if (!found || stop - index > run_end - run_start) {
+            run_start = index;
+            run_end = stop;
+            found = true;
+        }
+        index = stop;
+    }
+    return found;
+}
+
+void DecoderStack::decode_proc()
+{
+    boost::lock_guard<boost::mutex> decode_lock(_global_decode_mutex);
+
+    uint64_t decode_start = 0;
+    uint64_t decode_end = 0;
+
+	assert(_snapshot);
+
+    _decode_state = Running;
+
+    // Get the intial sample count
+    {
+        //unique_lock<mutex> input_lock(_input_mutex);
+        _sample_count = _snapshot->get_sample_count();
+    }
+
+    BOOST_FOREACH(const boost::shared_ptr<decode::Decoder> &dec, _stack)
+	{
+        decode_start = dec->decode_start();
+        decode_end = min(dec->decode_end(), _sample_count-1);
+	}
+
+    // A recorded capture only keeps its last blocks in memory, the
+    // pin holds them until the segments have pinned their own
+    if (!_snapshot->pin(this, decode_start)) {
+        do {
+            decode_start = _snapshot->get_released_samples();
+        } while (!_snapshot->pin(this, decode_start));
+        decode_end = max(decode_end, decode_start);
+        boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+        _error_message = tr("Samples before %1 are only in the record file "
+                            "and are not decoded.").arg(decode_start);
+    }
+
+    if (!_binary_dir.isEmpty()) {
+        boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+        _binary_sink.reset(new decode::BinarySink(_binary_dir));
+    }
+
+    // Long captures of protocols which resynchronize at idle times
+    // are split there, and the parts are decoded concurrently.
+    // Binary output has to be written in order, so it's not split
+    std::vector<uint64_t> bounds;
+    if (_binary_sink) {
+        bounds.push_back(decode_start);
+        bounds.push_back(decode_end);
+    } else {
+        find_segment_bounds(decode_start, decode_end, bounds);
+    }
+
+    {
+        boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+        _samples_decoded = 1;
+        _segments.clear();
+        _stitched = 0;
+        _stats.clear();
+        _decode_start = g_get_monotonic_time();
+        _decode_time = 0;
+        for (size_t k = 0; k + 1 < bounds.size(); k++) {
+            boost::shared_ptr<DecodeSegment> seg(new DecodeSegment());
+            seg->stack = this;
+            seg->session = NULL;
+            seg->start = bounds[k];
+            seg->end = bounds[k + 1];
+            seg->direct = (k == 0);
+            seg->done = false;
+            seg->ok = true;
+            _snapshot->pin(seg.get(), seg->start);
+            _segments.push_back(seg);
+        }
+    }
+    _snapshot->unpin(this);
+
+    // Sessions are created here, libsigrokdecode's session list
+    // is not thread safe
+    bool ok = true;
+    BOOST_FOREACH(const boost::shared_ptr<DecodeSegment> &seg, _segments) {
+        srd_session *const session = create_session(seg.get());
+        if (!session) {
+            ok = false;
+            break;
+        }
+        boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+        seg->session = session;
+    }
+
+    if (ok) {
+        std::vector< boost::shared_ptr<boost::thread> > threads;
+        for (size_t k = 1; k < _segments.size(); k++)
+            threads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(
+                &DecoderStack::decode_segment, this, _segments[k].get())));
+
+        decode_segment(_segments[0].get());
+
+        // Wait for the other segments, passing on a stop request
+        boost::this_thread::disable_interruption no_interrupt;
+        BOOST_FOREACH(const boost::shared_ptr<boost::thread> &t, threads) {
+            while (!t->timed_join(boost::posix_time::milliseconds(10))) {
+                if (!boost::this_thread::interruption_requested())
+                    continue;
+                BOOST_FOREACH(const boost::shared_ptr<boost::thread> &u, threads)
+                    u->interrupt();
+            }
+        }
+
+        BOOST_FOREACH(const boost::shared_ptr<DecodeSegment> &seg, _segments)
+            ok = ok && seg->ok;
+        if (ok)
+            decode_done();
+    }
+
+	// Destroy the sessions
+    std::vector<srd_session*> sessions;
+    {
+        boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+        BOOST_FOREACH(const boost::shared_ptr<DecodeSegment> &seg, _segments) {
+            _snapshot->unpin(seg.get());
+            if (seg->session) {
+                add_session_stats(seg->session, _stats);
+                sessions.push_back(seg->session);
+            }
+        }
+        _decode_time = g_get_monotonic_time() - _decode_start;
+        _segments.clear();
+    }
+    BOOST_FOREACH(srd_session *session, sessions)
+        srd_session_destroy(session);
+
+    // Flushes and closes the binary output files
+    if (_binary_sink) {
+        _binary_sink->close();
+        const QString error = _binary_sink->error();
+        boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+        _binary_sink.reset();
+        if (!error.isEmpty() && _error_message.isEmpty())
+            _error_message = error;
     }
-	srd_session_destroy(session);
 
     _decode_state = Stopped;
 }
@@ -609,53 +1024,83 @@ uint64_t DecoderStack::sample_rate() const
     return _samplerate;
 }
 
-void DecoderStack::annotation_callback(srd_proto_data *pdata, void *decoder)
+void DecoderStack::annotation_callback(srd_proto_data *pdata,
+    unsigned int num, void *segment)
 {
 	assert(pdata);
-	assert(decoder);
+	assert(segment);
 
-	DecoderStack *const d = (DecoderStack*)decoder;
+    DecodeSegment *const seg = (DecodeSegment*)segment;
+	DecoderStack *const d = seg->stack;
 	assert(d);
 
-    //lock_guard<mutex> lock(d->_output_mutex);
-
     if (d->_no_memory) {
         return;
     }
 
-	const Annotation a(pdata);
+    // A batch normally comes from one decoder, consecutive annotations
+    // mostly share a class, so remember the last row looked up
+    const srd_decoder *last_decc = NULL;
+    int last_format = -1;
+    map<const Row, decode::RowData>::iterator row_iter = d->_rows.end();
+    decode::RowData *dest = NULL;
 
-	// Find the row
-	assert(pdata->pdo);
-	assert(pdata->pdo->di);
-	const srd_decoder *const decc = pdata->pdo->di->decoder;
-	assert(decc);
+    boost::lock_guard<boost::recursive_mutex> lock(d->_output_mutex);
+    map<const Row, decode::RowData> &rows = seg->direct ? d->_rows : seg->rows;
+    for (unsigned int i = 0; i < num; i++) {
+        const Annotation a(&pdata[i]);
+
+        // Find the row
+        assert(pdata[i].pdo);
+        assert(pdata[i].pdo->di);
+        const srd_decoder *const decc = pdata[i].pdo->di->decoder;
+        assert(decc);
+
+        if (decc != last_decc || a.format() != last_format) {
+            // Try looking up the sub-row of this class
+            const map<pair<const srd_decoder*, int>, Row>::const_iterator r =
+                d->_class_rows.find(make_pair(decc, a.format()));
+            if (r != d->_class_rows.end())
+                row_iter = d->_rows.find((*r).second);
+            else
+            {
+                // Failing that, use the decoder as a key
+                row_iter = d->_rows.find(Row(decc));
+            }
+            last_decc = decc;
+            last_format = a.format();
+            if (row_iter != d->_rows.end())
+                dest = &rows[(*row_iter).first];
+        }
 
-    map<const Row, decode::RowData>::iterator row_iter = d->_rows.end();
-	
-	// Try looking up the sub-row of this class
-	const map<pair<const srd_decoder*, int>, Row>::const_iterator r =
-		d->_class_rows.find(make_pair(decc, a.format()));
-	if (r != d->_class_rows.end())
-        row_iter = d->_rows.find((*r).second);
-	else
-	{
-		// Failing that, use the decoder as a key
-        row_iter = d->_rows.find(Row(decc));
-	}
+        assert(row_iter != d->_rows.end());
+        if (row_iter == d->_rows.end()) {
+            qDebug() << "Unexpected annotation: decoder = " << decc <<
+                ", format = " << a.format();
+            assert(0);
+            last_decc = NULL;
+            continue;
+        }
 
-    assert(row_iter != d->_rows.end());
-    if (row_iter == d->_rows.end()) {
-        qDebug() << "Unexpected annotation: decoder = " << decc <<
-            ", format = " << a.format();
-        assert(0);
-        return;
+        // Add the annotation
+        if (!dest->push_annotation(a)) {
+            d->_no_memory = true;
+            return;
+        }
     }
+}
 
-	// Add the annotation
-    boost::lock_guard<boost::recursive_mutex> lock(d->_output_mutex);
-    if (!(*row_iter).second.push_annotation(a))
-        d->_no_memory = true;
+void DecoderStack::binary_callback(srd_proto_data *pdata, void *segment)
+{
+    assert(pdata);
+    assert(segment);
+
+    DecodeSegment *const seg = (DecodeSegment*)segment;
+    DecoderStack *const d = seg->stack;
+    assert(d);
+    assert(d->_binary_sink);
+
+    d->_binary_sink->write(pdata);
 }
 
 void DecoderStack::on_new_frame()
@@ -723,5 +1168,61 @@ int64_t DecoderStack::get_mark_index() const
     return _mark_index;
 }
 
+void DecoderStack::add_session_stats(srd_session *session,
+    std::vector<srd_inst_stats> &stats)
+{
+    if (!session->di_list)
+        return;
+
+    // The decoders are stacked one on top of the other
+    srd_decoder_inst *di = (srd_decoder_inst*)session->di_list->data;
+    for (size_t level = 0; di; level++) {
+        srd_inst_stats s;
+        if (srd_inst_stats_get(di, &s) == SRD_OK) {
+            if (stats.size() <= level) {
+                srd_inst_stats zero;
+                memset(&zero, 0, sizeof(zero));
+                stats.resize(level + 1, zero);
+            }
+            srd_inst_stats &sum = stats[level];
+            sum.samples += s.samples;
+            sum.match_iterations += s.match_iterations;
+            sum.wait_returns += s.wait_returns;
+            for (size_t i = 0; i < G_N_ELEMENTS(s.puts); i++)
+                sum.puts[i] += s.puts[i];
+            sum.python_time += s.python_time;
+            sum.handoff_time += s.handoff_time;
+        }
+        di = di->next_di ? (srd_decoder_inst*)di->next_di->data : NULL;
+    }
+}
+
+void DecoderStack::set_binary_dir(const QString &dir)
+{
+    _binary_dir = dir;
+}
+
+QString DecoderStack::binary_dir() const
+{
+    return _binary_dir;
+}
+
+void DecoderStack::get_stats(std::vector<srd_inst_stats> &stats,
+    uint64_t &decode_time) const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_output_mutex);
+    if (_segments.empty()) {
+        stats = _stats;
+        decode_time = _decode_time;
+        return;
+    }
+
+    stats.clear();
+    BOOST_FOREACH(const boost::shared_ptr<DecodeSegment> &seg, _segments)
+        if (seg->session)
+            add_session_stats(seg->session, stats);
+    decode_time = g_get_monotonic_time() - _decode_start;
+}
+
 } // namespace data
 } // namespace pv
@@ -54,6 +54,7 @@ class LogicSnapshot;
 
 namespace decode {
 class Annotation;
+class BinarySink;
 class Decoder;
 }
 
@@ -68,7 +69,24 @@ private:
 	static const double DecodeThreshold;
 	static const int64_t DecodeChunkLength;
 	static const unsigned int DecodeNotifyPeriod;
-    static const uint64_t MaxChunkSize = 1024 * 16;
+    static const uint64_t MinSegmentSamples = 16 * 1024 * 1024;
+    static const unsigned int MaxDecodeSegments = 8;
+    // Queued outputs per stacked decoder in pipelined mode
+    static const unsigned int PipelineDepth = 64;
+
+    // A part of the decode range, decoded by its own decoder stack
+    struct DecodeSegment {
+        DecoderStack *stack;
+        srd_session *session;
+        uint64_t start;
+        uint64_t end;
+        // Annotations go to _rows, otherwise they're kept in rows
+        // until all segments before this one are finished
+        bool direct;
+        bool done;
+        bool ok;
+        std::map<const decode::Row, decode::RowData> rows;
+    };
 
 public:
     enum decode_state {
@@ -144,13 +162,49 @@ public:
     void set_mark_index(int64_t index);
     int64_t get_mark_index() const;
 
+    /**
+     * Gets the work counters of the decoders in the stack (bottom
+     * first), summed over the segments, and the decode time in us.
+     * While decoding, these are the counters so far.
+     */
+    void get_stats(std::vector<srd_inst_stats> &stats,
+        uint64_t &decode_time) const;
+
+    /**
+     * Sets the directory the binary output of the decoders is written
+     * to while decoding, an empty string disables it.
+     */
+    void set_binary_dir(const QString &dir);
+    QString binary_dir() const;
+
 private:
-    void decode_data(const uint64_t decode_start, const uint64_t decode_end, srd_session *const session);
+    bool decode_data(DecodeSegment *seg);
 
 	void decode_proc();
 
+    srd_session* create_session(DecodeSegment *seg);
+
+    // Whether the stacked decoders can run in their own threads
+    bool pipelined() const;
+
+    void decode_segment(DecodeSegment *seg);
+
+    void stitch_segments();
+
+    void find_segment_bounds(uint64_t start, uint64_t end,
+        std::vector<uint64_t> &bounds);
+
+    bool find_idle_run(const std::vector<int> &probes, bool idle,
+        uint64_t start, uint64_t end,
+        uint64_t &run_start, uint64_t &run_end);
+
+    static void add_session_stats(srd_session *session,
+        std::vector<srd_inst_stats> &stats);
+
 	static void annotation_callback(srd_proto_data *pdata,
-		void *decoder);
+		unsigned int num, void *segment);
+
+    static void binary_callback(srd_proto_data *pdata, void *segment);
 
 private slots:
 	void on_new_frame();
@@ -202,6 +256,16 @@ private:
 
     int64_t _mark_index;
 
+    std::vector< boost::shared_ptr<DecodeSegment> > _segments;
+    size_t _stitched;
+
+    std::vector<srd_inst_stats> _stats;
+    int64_t _decode_start;
+    uint64_t _decode_time;
+
+    QString _binary_dir;
+    boost::shared_ptr<decode::BinarySink> _binary_sink;
+
 	friend class DecoderStackTest::TwoDecoderStack;
 };
 
@@ -50,7 +50,9 @@ DsoSnapshot::DsoSnapshot() :
     Snapshot(sizeof(uint16_t), 1, 1),
     _envelope_en(false),
     _envelope_done(false),
-    _instant(false)
+    _instant(false),
+    _history_num(0),
+    _history_head(0)
 {
 	memset(_envelope_levels, 0, sizeof(_envelope_levels));
 }
@@ -58,6 +60,7 @@ DsoSnapshot::DsoSnapshot() :
 DsoSnapshot::~DsoSnapshot()
 {
     free_envelop();
+    free_history();
 }
 
 void DsoSnapshot::free_envelop()
@@ -79,6 +82,8 @@ void DsoSnapshot::init()
     _memory_failed = false;
     _last_ended = true;
     _envelope_done = false;
+    _history_num = 0;
+    _history_head = 0;
     _ch_enable.clear();
     for (unsigned int i = 0; i < _channel_num; i++) {
         for (unsigned int level = 0; level < ScaleStepCount; level++) {
@@ -86,19 +91,25 @@ void DsoSnapshot::init()
             _envelope_levels[i][level].data_length = 0;
         }
     }
+    invalidate();
 }
 
 void DsoSnapshot::clear()
 {
     boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    boost::unique_lock<boost::shared_mutex> access(_access_mutex);
     free_data();
     free_envelop();
+    free_history();
     init();
 }
 
 void DsoSnapshot::first_payload(const sr_datafeed_dso &dso, uint64_t total_sample_count,
                                 std::map<int, bool> ch_enable, bool instant)
 {
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    boost::unique_lock<boost::shared_mutex> access(_access_mutex);
+
     bool re_alloc = false;
     unsigned int channel_num = 0;
     for (auto& iter:ch_enable) {
@@ -120,6 +131,7 @@ void DsoSnapshot::first_payload(const sr_datafeed_dso &dso, uint64_t total_sampl
     uint64_t size = _total_sample_count * _channel_num + sizeof(uint64_t);
     if (re_alloc || size != _capacity) {
         free_data();
+        free_history();
         _data = malloc(size);
         if (_data) {
             free_envelop();
@@ -146,12 +158,15 @@ void DsoSnapshot::first_payload(const sr_datafeed_dso &dso, uint64_t total_sampl
     if (isOk) {
         _capacity = size;
         _memory_failed = false;
+        invalidate();
+        access.unlock();
         append_payload(dso);
         _last_ended = false;
     } else {
         free_data();
         free_envelop();
         _memory_failed = true;
+        invalidate();
     }
 }
 
@@ -159,6 +174,11 @@ void DsoSnapshot::append_payload(const sr_datafeed_dso &dso)
 {
     boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 
+    // A new frame replaces the current one and the oldest history frame
+    boost::unique_lock<boost::shared_mutex> access(_access_mutex, boost::defer_lock);
+    if (!_instant)
+        access.lock();
+
     if (_channel_num > 0 && dso.num_samples != 0) {
         append_data(dso.data, dso.num_samples, _instant);
 
@@ -168,6 +188,8 @@ void DsoSnapshot::append_payload(const sr_datafeed_dso &dso)
         if (_envelope_en)
             append_payload_to_envelope_levels(true);
     }
+
+    publish();
 }
 
 void DsoSnapshot::append_data(void *data, uint64_t samples, bool instant)
@@ -178,8 +200,10 @@ void DsoSnapshot::append_data(void *data, uint64_t samples, bool instant)
         memcpy((uint8_t*)_data + _sample_count * _channel_num, data, samples*_channel_num);
         _sample_count += samples;
     } else {
+        push_history();
         memcpy((uint8_t*)_data, data, samples*_channel_num);
         _sample_count = samples;
+        invalidate();
     }
 
 }
@@ -192,10 +216,66 @@ void DsoSnapshot::enable_envelope(bool enable)
     _envelope_en = enable;
 }
 
+void DsoSnapshot::free_history()
+{
+    BOOST_FOREACH(uint8_t *frame, _history) {
+        free(frame);
+    }
+    std::fill(_history.begin(), _history.end(), (uint8_t*)NULL);
+    _history_num = 0;
+    _history_head = 0;
+}
+
+void DsoSnapshot::set_history_depth(unsigned int depth)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    boost::unique_lock<boost::shared_mutex> access(_access_mutex);
+    if (depth == _history.size())
+        return;
+    free_history();
+    _history.assign(depth, NULL);
+    _history_samples.assign(depth, 0);
+}
+
+void DsoSnapshot::push_history()
+{
+    if (_history.empty() || _sample_count == 0)
+        return;
+
+    // The frames have the size of the data, allocated once
+    uint8_t *&frame = _history[_history_head];
+    if (!frame) {
+        frame = (uint8_t*)malloc(_capacity);
+        if (!frame)
+            return;
+    }
+    memcpy(frame, _data, _sample_count * _channel_num);
+    _history_samples[_history_head] = _sample_count;
+    _history_head = (_history_head + 1) % _history.size();
+    _history_num = min(_history_num + 1, (unsigned int)_history.size());
+}
+
+unsigned int DsoSnapshot::get_history_num() const
+{
+    return _history_num;
+}
+
+const uint8_t *DsoSnapshot::get_history_samples(unsigned int frame,
+    int64_t start_sample, int64_t end_sample, uint16_t index) const
+{
+    // 0 is the oldest frame kept
+    assert(frame < _history_num);
+    const unsigned int i = (_history_head + _history.size() - _history_num + frame) %
+                           _history.size();
+    if (start_sample < 0 || end_sample >= (int64_t)_history_samples[i] ||
+        start_sample > end_sample)
+        return NULL;
+    return _history[i] + start_sample * _channel_num + index * (_channel_num != 1);
+}
+
 const uint8_t *DsoSnapshot::get_samples(
     int64_t start_sample, int64_t end_sample, uint16_t index) const
 {
-    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
     (void)end_sample;
 
 	assert(start_sample >= 0);
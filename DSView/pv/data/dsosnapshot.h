@@ -95,6 +95,11 @@ public:
 
     void enable_envelope(bool enable);
 
+    void set_history_depth(unsigned int depth);
+    unsigned int get_history_num() const;
+    const uint8_t* get_history_samples(unsigned int frame,
+        int64_t start_sample, int64_t end_sample, uint16_t index) const;
+
     double cal_vrms(double zero_off, int index) const;
     double cal_vmean(int index) const;
 
@@ -105,6 +110,8 @@ public:
 private:
     void append_data(void *data, uint64_t samples, bool instant);
     void free_envelop();
+    void free_history();
+    void push_history();
 	void reallocate_envelope(Envelope &l);
     void append_payload_to_envelope_levels(bool header);
 
@@ -115,6 +122,12 @@ private:
     bool _instant;
     std::map<int, bool> _ch_enable;
 
+    // ring of the last frames replaced, for persistence
+    std::vector<uint8_t*> _history;
+    std::vector<uint64_t> _history_samples;
+    unsigned int _history_num;
+    unsigned int _history_head;
+
     friend class DsoSnapshotTest::Basic;
 };
 
@@ -0,0 +1,138 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "logicexport.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include <boost/thread.hpp>
+
+#include "logicsnapshot.h"
+
+using namespace std;
+
+namespace pv {
+namespace data {
+
+const uint64_t LogicExport::EdgeBatch;
+const uint64_t LogicExport::ChunkSamples;
+
+void LogicExport::transpose_cross(uint8_t *xbuf, uint16_t unitsize,
+                                  const std::vector<const uint8_t *> &buf_vec,
+                                  const std::vector<uint8_t> &buf_fill,
+                                  uint64_t byte_offset, uint64_t bytes)
+{
+    const unsigned int ch_num = buf_vec.size();
+    for (unsigned int lane = 0; lane < unitsize; lane++) {
+        const unsigned int ch_start = lane * 8;
+        const unsigned int ch_end = min(ch_start + 8, ch_num);
+        uint8_t *dest = xbuf + lane;
+        for (uint64_t b = 0; b < bytes; b++) {
+            // row k: 8 samples of channel ch_start + k
+            uint64_t x = 0;
+            for (unsigned int k = ch_start; k < ch_end; k++) {
+                const uint8_t v = buf_vec[k] ? buf_vec[k][byte_offset + b] : buf_fill[k];
+                x |= (uint64_t)v << ((k - ch_start) * 8);
+            }
+
+            // 8x8 bit matrix transpose, row j becomes sample j
+            if (x != 0 && x != ~0ULL) {
+                uint64_t t;
+                t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+                x = x ^ t ^ (t << 7);
+                t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+                x = x ^ t ^ (t << 14);
+                t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+                x = x ^ t ^ (t << 28);
+            }
+
+            for (unsigned int j = 0; j < 8; j++) {
+                *dest = (uint8_t)(x >> (j * 8));
+                dest += unitsize;
+            }
+        }
+    }
+}
+
+void LogicExport::edges(LogicSnapshot &snapshot, const std::vector<int> &ch_vec,
+                        const boost::function<void (const sr_datafeed_logic_edge&)> &send)
+{
+    const uint16_t unitsize = ceil(ch_vec.size() / 8.0);
+    const uint64_t sample_count = snapshot.get_sample_count();
+    if (ch_vec.empty() || sample_count == 0)
+        return;
+    const uint64_t end = sample_count - 1;
+
+    // current value and next change position of each channel
+    std::vector<uint8_t> value(unitsize, 0);
+    std::vector<uint64_t> nxt_edge(ch_vec.size());
+    for (unsigned int k = 0; k < ch_vec.size(); k++) {
+        const bool sample = snapshot.get_sample(0, ch_vec[k]);
+        if (sample)
+            value[k / 8] |= 1 << (k % 8);
+        nxt_edge[k] = 1;
+        if (!snapshot.get_nxt_edge(nxt_edge[k], sample, end, 1, ch_vec[k]))
+            nxt_edge[k] = UINT64_MAX;
+    }
+
+    std::vector<uint64_t> edge_index;
+    std::vector<uint8_t> edge_data;
+    edge_index.reserve(EdgeBatch);
+    edge_data.reserve(EdgeBatch * unitsize);
+    edge_index.push_back(0);
+    edge_data.insert(edge_data.end(), value.begin(), value.end());
+
+    struct sr_datafeed_logic_edge ep;
+    bool done = false;
+    while (!done && !boost::this_thread::interruption_requested()) {
+        const uint64_t index = *std::min_element(nxt_edge.begin(), nxt_edge.end());
+        done = (index > end);
+        if (!done) {
+            for (unsigned int k = 0; k < ch_vec.size(); k++) {
+                if (nxt_edge[k] != index)
+                    continue;
+                value[k / 8] ^= 1 << (k % 8);
+                const bool sample = (value[k / 8] & (1 << (k % 8))) != 0;
+                nxt_edge[k] = index + 1;
+                if (!snapshot.get_nxt_edge(nxt_edge[k], sample, end, 1, ch_vec[k]))
+                    nxt_edge[k] = UINT64_MAX;
+            }
+            edge_index.push_back(index);
+            edge_data.insert(edge_data.end(), value.begin(), value.end());
+        }
+
+        if (done || edge_index.size() == EdgeBatch) {
+            ep.num_edges = edge_index.size();
+            ep.end = done ? sample_count : index + 1;
+            ep.unitsize = unitsize;
+            ep.index = edge_index.data();
+            ep.data = edge_data.data();
+            send(ep);
+            edge_index.clear();
+            edge_data.clear();
+        }
+    }
+}
+
+} // namespace data
+} // namespace pv
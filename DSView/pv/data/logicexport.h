@@ -0,0 +1,73 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_PV_DATA_LOGICEXPORT_H
+#define DSVIEW_PV_DATA_LOGICEXPORT_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include <libsigrok4DSL/libsigrok.h>
+
+namespace pv {
+namespace data {
+
+class LogicSnapshot;
+
+/**
+ * The conversions of logic data StoreSession does for the output
+ * modules, apart from the session so they can be run on their own.
+ */
+class LogicExport
+{
+public:
+    // Changes per SR_DF_LOGIC_EDGE packet
+    static const uint64_t EdgeBatch = 8192;
+    // Samples per SR_DF_LOGIC packet
+    static const uint64_t ChunkSamples = 256 * 1024;
+
+public:
+    /**
+     * Interleaves per-channel sample bits (LA_SPLIT_DATA layout) into
+     * unitsize wide samples (LA_CROSS_DATA layout). A NULL channel
+     * buffer is a constant leaf, filled from buf_fill.
+     */
+    static void transpose_cross(uint8_t *xbuf, uint16_t unitsize,
+                                const std::vector<const uint8_t *> &buf_vec,
+                                const std::vector<uint8_t> &buf_fill,
+                                uint64_t byte_offset, uint64_t bytes);
+
+    /**
+     * Sends the changes of the cross sample of the channels in ch_vec,
+     * found through the snapshot mipmap, in packets of up to EdgeBatch
+     * changes. Stops early when the thread is interrupted.
+     */
+    static void edges(LogicSnapshot &snapshot, const std::vector<int> &ch_vec,
+                      const boost::function<void (const sr_datafeed_logic_edge&)> &send);
+};
+
+} // namespace data
+} // namespace pv
+
+#endif // DSVIEW_PV_DATA_LOGICEXPORT_H
@@ -54,7 +54,13 @@ const uint64_t LogicSnapshot::LevelOffset[LogicSnapshot::ScaleLevel] = {
 
 LogicSnapshot::LogicSnapshot() :
     Snapshot(1, 0, 0),
-    _block_num(0)
+    _block_num(0),
+    _released_blocks(0),
+    _mipmap_time(0),
+    _ring(false),
+    _ring_leaves(0),
+    _ring_first(0),
+    _ring_base(0)
 {
 }
 
@@ -66,15 +72,18 @@ void LogicSnapshot::free_data()
 {
     Snapshot::free_data();
     for(auto& iter:_ch_data) {
+        uint64_t leaf = 0;
         for(auto& iter_rn:iter) {
-            for (unsigned int k = 0; k < Scale; k++)
-                if (iter_rn.lbp[k] != NULL)
+            // the second half of a ring only mirrors the first one
+            for (unsigned int k = 0; k < Scale; k++, leaf++)
+                if (iter_rn.lbp[k] != NULL && (!_ring || leaf < _ring_leaves))
                     free(iter_rn.lbp[k]);
         }
         std::vector<struct RootNode> void_vector;
         iter.swap(void_vector);
     }
     _ch_data.clear();
+    free_released();
     _sample_count = 0;
 }
 
@@ -84,6 +93,9 @@ void LogicSnapshot::init()
     _sample_count = 0;
     _ring_sample_count = 0;
     _block_num = 0;
+    _released_blocks = 0;
+    _ring_first = 0;
+    _ring_base = 0;
     _byte_fraction = 0;
     _ch_fraction = 0;
     _src_ptr = NULL;
@@ -91,23 +103,26 @@ void LogicSnapshot::init()
     _data = NULL;
     _memory_failed = false;
     _last_ended = true;
+    invalidate();
 }
 
 void LogicSnapshot::clear()
 {
     boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    boost::unique_lock<boost::shared_mutex> access(_access_mutex);
     free_data();
     init();
 }
 
 void LogicSnapshot::capture_ended()
 {
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
     Snapshot::capture_ended();
 
     //assert(_ch_fraction == 0);
     //assert(_byte_fraction == 0);
-    uint64_t block_index = _ring_sample_count / LeafBlockSamples;
-    uint64_t block_offset = (_ring_sample_count % LeafBlockSamples) / Scale;
+    uint64_t block_index = ring_pos(_ring_sample_count) / LeafBlockSamples;
+    uint64_t block_offset = ((_ring_sample_count % LeafBlockSamples) + Scale - 1) / Scale;
     if (block_offset != 0) {
         uint64_t index0 = block_index / RootScale;
         uint64_t index1 = block_index % RootScale;
@@ -118,28 +133,32 @@ void LogicSnapshot::capture_ended()
             while (ptr < end_ptr)
                 *ptr++ = 0;
 
-            // calc mipmap of current block
-            calc_mipmap(order, index0, index1, block_offset * Scale);
-
-            // calc root of current block
-            if (*((uint64_t *)iter[index0].lbp[index1]) != 0)
-                iter[index0].value += 1ULL << index1;
-            if (*((uint64_t *)iter[index0].lbp[index1] + LeafBlockSpace / sizeof(uint64_t) - 1) != 0) {
-                iter[index0].tog += 1ULL << index1;
-            } else {
-               // trim leaf to free space
-               free(iter[index0].lbp[index1]);
-               iter[index0].lbp[index1] = NULL;
-            }
-
+            finish_leaf(order, index0, index1, block_offset * Scale);
             order++;
         }
     }
-    _sample_count = _ring_sample_count;
+    _sample_count = _ring ? ring_count() : _ring_sample_count;
+    publish();
+}
+
+/*
+ * With ring, the capture goes on past total_sample_count and only keeps
+ * its last get_ring_capacity() samples or so, see roll().
+ */
+void LogicSnapshot::first_payload(const sr_datafeed_logic &logic, uint64_t total_sample_count,
+                                  GSList *channels, bool ring)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+
+    begin_payload(total_sample_count, channels, ring);
+    append_payload(logic);
+    _last_ended = false;
 }
 
-void LogicSnapshot::first_payload(const sr_datafeed_logic &logic, uint64_t total_sample_count, GSList *channels)
+void LogicSnapshot::begin_payload(uint64_t total_sample_count, GSList *channels, bool ring)
 {
+    boost::unique_lock<boost::shared_mutex> access(_access_mutex);
+
     bool channel_changed = false;
     uint16_t channel_num = 0;
     for (const GSList *l = channels; l; l = l->next) {
@@ -155,11 +174,15 @@ void LogicSnapshot::first_payload(const sr_datafeed_logic &logic, uint64_t total
 
     if (total_sample_count != _total_sample_count ||
         channel_num != _channel_num ||
-        channel_changed) {
+        channel_changed ||
+        ring != _ring) {
         free_data();
         _total_sample_count = total_sample_count;
         _channel_num = channel_num;
-        uint64_t rootnode_size = (_total_sample_count + RootNodeSamples - 1) / RootNodeSamples;
+        _ring = ring;
+        _ring_leaves = ring ? get_ring_capacity(total_sample_count) / LeafBlockSamples : 0;
+        uint64_t rootnode_size = ring ? (2 * _ring_leaves + RootScale - 1) / RootScale :
+                                        (_total_sample_count + RootNodeSamples - 1) / RootNodeSamples;
         for (const GSList *l = channels; l; l = l->next) {
             sr_channel *const probe = (sr_channel*)l->data;
             if (probe->type == SR_CHANNEL_LOGIC && probe->enabled) {
@@ -185,19 +208,22 @@ void LogicSnapshot::first_payload(const sr_datafeed_logic &logic, uint64_t total
     }
 
     _sample_count = 0;
+    _released_blocks = 0;
+    _ring_first = 0;
+    _ring_base = 0;
     _last_sample.clear();
     _sample_cnt.clear();
     _block_cnt.clear();
     _ring_sample_cnt.clear();
+    _edge_value.clear();
     for (unsigned int i = 0; i < _channel_num; i++) {
         _last_sample.push_back(0);
         _sample_cnt.push_back(0);
         _block_cnt.push_back(0);
         _ring_sample_cnt.push_back(0);
+        _edge_value.push_back(0);
     }
-
-    append_payload(logic);
-    _last_ended = false;
+    invalidate();
 }
 
 void LogicSnapshot::append_payload(
@@ -209,6 +235,8 @@ void LogicSnapshot::append_payload(
         append_cross_payload(logic);
     else if (logic.format == LA_SPLIT_DATA)
         append_split_payload(logic);
+
+    publish();
 }
 
 void LogicSnapshot::append_cross_payload(
@@ -217,7 +245,7 @@ void LogicSnapshot::append_cross_payload(
     assert(logic.format == LA_CROSS_DATA);
     assert(logic.length >= ScaleSize * _channel_num);
 
-    if (_sample_count >= _total_sample_count)
+    if (!_ring && _sample_count >= _total_sample_count)
         return;
 
     _src_ptr = logic.data;
@@ -226,27 +254,28 @@ void LogicSnapshot::append_cross_payload(
     // _sample_count should be fixed in the last packet
     // so _total_sample_count must be align to LeafBlock
     uint64_t samples = ceil(logic.length * 8.0 / _channel_num);
-    if (_sample_count + samples < _total_sample_count) {
-        _sample_count += samples;
+    uint64_t alloc_count;
+    if (_ring) {
+        // a ring has no end, only allocate ahead of the data,
+        // including the fraction left by the last packet
+        alloc_count = _ring_sample_count + samples;
+        if (_ch_fraction != 0 || _byte_fraction != 0)
+            alloc_count += Scale;
     } else {
-        //len = ceil((_total_sample_count - _sample_count) * _channel_num / 8.0);
-        _sample_count = _total_sample_count;
+        if (_sample_count + samples < _total_sample_count) {
+            _sample_count += samples;
+        } else {
+            //len = ceil((_total_sample_count - _sample_count) * _channel_num / 8.0);
+            _sample_count = _total_sample_count;
+        }
+        alloc_count = _sample_count;
     }
 
-    while (_sample_count > _block_num * LeafBlockSamples) {
-        uint8_t index0 = _block_num / RootScale;
-        uint8_t index1 = _block_num % RootScale;
-        for(auto& iter:_ch_data) {
-            if (iter[index0].lbp[index1] == NULL)
-                iter[index0].lbp[index1] = malloc(LeafBlockSpace);
-            if (iter[index0].lbp[index1] == NULL) {
-                _memory_failed = true;
+    while (alloc_count > _block_num * LeafBlockSamples) {
+        roll(_block_num);
+        for (unsigned int order = 0; order < _ch_data.size(); order++)
+            if (!alloc_leaf(order, _block_num, false))
                 return;
-            }
-            uint64_t *mipmap_ptr = (uint64_t *)iter[index0].lbp[index1] +
-                                   (LeafBlockSamples / Scale);
-            memset(mipmap_ptr, 0, LeafBlockSpace - (LeafBlockSamples / 8));
-        }
         _block_num++;
     }
 
@@ -263,9 +292,10 @@ void LogicSnapshot::append_cross_payload(
         _dest_ptr = dp_tmp;
         _src_ptr = sp_tmp;
         if (_byte_fraction == 0) {
-            const uint64_t index0 = _ring_sample_count / RootNodeSamples;
-            const uint64_t index1 = (_ring_sample_count >> LeafBlockPower) % RootScale;
-            const uint64_t offset = (_ring_sample_count % LeafBlockSamples) / Scale;
+            const uint64_t pos = ring_pos(_ring_sample_count);
+            const uint64_t index0 = pos / RootNodeSamples;
+            const uint64_t index1 = (pos >> LeafBlockPower) % RootScale;
+            const uint64_t offset = (pos % LeafBlockSamples) / Scale;
 
 //            _dest_ptr = (uint64_t *)_ch_data[i][index0].lbp[index1] + offset;
 //            uint64_t mipmap_index = offset / 8 / Scale;
@@ -287,9 +317,10 @@ void LogicSnapshot::append_cross_payload(
         assert(_ch_fraction == 0);
         assert(_byte_fraction == 0);
         assert(_ring_sample_count % Scale == 0);
-        uint64_t pre_index0 = _ring_sample_count / RootNodeSamples;
-        uint64_t pre_index1 = (_ring_sample_count >> LeafBlockPower) % RootScale;
-        uint64_t pre_offset = (_ring_sample_count % LeafBlockSamples) / Scale;
+        const uint64_t pre_pos = ring_pos(_ring_sample_count);
+        uint64_t pre_index0 = pre_pos / RootNodeSamples;
+        uint64_t pre_index1 = (pre_pos >> LeafBlockPower) % RootScale;
+        uint64_t pre_offset = (pre_pos % LeafBlockSamples) / Scale;
         uint64_t *src_ptr = NULL;
         uint64_t *dest_ptr;
         int order = 0;
@@ -316,25 +347,17 @@ void LogicSnapshot::append_cross_payload(
                 src_ptr += _channel_num;
                 //mipmap
                 if (dest_ptr == (uint64_t *)_dest_ptr + (LeafBlockSamples / Scale)) {
-                    // calc mipmap of current block
-                    calc_mipmap(order, index0, index1, LeafBlockSamples);
-
-                    // calc root of current block
-                    if (*((uint64_t *)iter[index0].lbp[index1]) != 0)
-                        iter[index0].value +=  1ULL<< index1;
-                    if (*((uint64_t *)iter[index0].lbp[index1] + LeafBlockSpace / sizeof(uint64_t) - 1) != 0) {
-                        iter[index0].tog += 1ULL << index1;
-                    } else {
-                        // trim leaf to free space
-                        free(iter[index0].lbp[index1]);
-                        iter[index0].lbp[index1] = NULL;
-                    }
+                    finish_leaf(order, index0, index1, LeafBlockSamples);
 
                     index1++;
                     if (index1 == RootScale) {
                         index0++;
                         index1 = 0;
                     }
+                    if (_ring && index0 * RootScale + index1 == _ring_leaves) {
+                        index0 = 0;
+                        index1 = 0;
+                    }
                     _dest_ptr = iter[index0].lbp[index1];
                     dest_ptr = (uint64_t *)_dest_ptr;
                 }
@@ -347,9 +370,10 @@ void LogicSnapshot::append_cross_payload(
 
     // fraction data append
     {
-        uint64_t index0 = _ring_sample_count / RootNodeSamples;
-        uint64_t index1 = (_ring_sample_count >> LeafBlockPower) % RootScale;
-        uint64_t offset = (_ring_sample_count % LeafBlockSamples) / 8;
+        const uint64_t pos = ring_pos(_ring_sample_count);
+        uint64_t index0 = pos / RootNodeSamples;
+        uint64_t index1 = (pos >> LeafBlockPower) % RootScale;
+        uint64_t offset = (pos % LeafBlockSamples) / 8;
         _dest_ptr = (uint8_t *)_ch_data[_ch_fraction][index0].lbp[index1] + offset;
 
         uint8_t *dp_tmp = (uint8_t *)_dest_ptr;
@@ -365,7 +389,7 @@ void LogicSnapshot::append_cross_payload(
             }
         }
         //_dest_ptr = (uint8_t *)_dest_ptr + _byte_fraction;
-        _dest_ptr = dp_tmp + _byte_fraction;
+        _dest_ptr = dp_tmp;
     }
 }
 
@@ -378,10 +402,10 @@ void LogicSnapshot::append_split_payload(
     uint16_t order = logic.order;
     assert(order < _ch_data.size());
 
-    if (_sample_cnt[order] >= _total_sample_count)
+    if (!_ring && _sample_cnt[order] >= _total_sample_count)
         return;
 
-    if (_sample_cnt[order] + samples < _total_sample_count) {
+    if (_ring || _sample_cnt[order] + samples < _total_sample_count) {
         _sample_cnt[order] += samples;
     } else {
         samples = _total_sample_count - _sample_cnt[order];
@@ -389,52 +413,302 @@ void LogicSnapshot::append_split_payload(
     }
 
     while (_sample_cnt[order] > _block_cnt[order] * LeafBlockSamples) {
-        uint8_t index0 = _block_cnt[order] / RootScale;
-        uint8_t index1 = _block_cnt[order] % RootScale;
-        if (_ch_data[order][index0].lbp[index1] == NULL)
-            _ch_data[order][index0].lbp[index1] = malloc(LeafBlockSpace);
-        if (_ch_data[order][index0].lbp[index1] == NULL) {
-            _memory_failed = true;
+        roll(_block_cnt[order]);
+        if (!alloc_leaf(order, _block_cnt[order], true))
             return;
-        }
-        memset(_ch_data[order][index0].lbp[index1], 0, LeafBlockSpace);
         _block_cnt[order]++;
     }
 
+    const uint8_t *src_ptr = (const uint8_t *)logic.data;
     while(samples > 0) {
-        const uint64_t index0 = _ring_sample_cnt[order] / RootNodeSamples;
-        const uint64_t index1 = (_ring_sample_cnt[order] >> LeafBlockPower) % RootScale;
-        const uint64_t offset = (_ring_sample_cnt[order] % LeafBlockSamples) / 8;
+        const uint64_t pos = ring_pos(_ring_sample_cnt[order]);
+        const uint64_t index0 = pos / RootNodeSamples;
+        const uint64_t index1 = (pos >> LeafBlockPower) % RootScale;
+        const uint64_t offset = (pos % LeafBlockSamples) / 8;
         _dest_ptr = (uint8_t *)_ch_data[order][index0].lbp[index1] + offset;
 
         uint64_t bblank = (LeafBlockSamples - (_ring_sample_cnt[order] & LeafMask));
         if (samples >= bblank) {
-            memcpy((uint8_t*)_dest_ptr, (uint8_t *)logic.data, bblank/8);
+            memcpy((uint8_t*)_dest_ptr, src_ptr, bblank/8);
+            src_ptr += bblank/8;
             _ring_sample_cnt[order] += bblank;
             samples -= bblank;
 
-            // calc mipmap of current block
-            calc_mipmap(order, index0, index1, LeafBlockSamples);
-
-            // calc root of current block
-            if (*((uint64_t *)_ch_data[order][index0].lbp[index1]) != 0)
-                _ch_data[order][index0].value +=  1ULL<< index1;
-            if (*((uint64_t *)_ch_data[order][index0].lbp[index1] + LeafBlockSpace / sizeof(uint64_t) - 1) != 0) {
-                _ch_data[order][index0].tog += 1ULL << index1;
-            } else {
-                // trim leaf to free space
-                free(_ch_data[order][index0].lbp[index1]);
-                _ch_data[order][index0].lbp[index1] = NULL;
-            }
+            finish_leaf(order, index0, index1, LeafBlockSamples);
         } else {
-            memcpy((uint8_t*)_dest_ptr, (uint8_t *)logic.data, samples/8);
+            memcpy((uint8_t*)_dest_ptr, src_ptr, samples/8);
             _ring_sample_cnt[order] += samples;
             samples = 0;
         }
     }
 
-    _sample_count = *min_element(_sample_cnt.begin(), _sample_cnt.end());
     _ring_sample_count = *min_element(_ring_sample_cnt.begin(), _ring_sample_cnt.end());
+    if (_ring)
+        _sample_count = ring_count();
+    else
+        _sample_count = *min_element(_sample_cnt.begin(), _sample_cnt.end());
+}
+
+void LogicSnapshot::first_edges(const sr_datafeed_logic_edge &edge, uint64_t total_sample_count,
+                                GSList *channels, bool ring)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+
+    begin_payload(total_sample_count, channels, ring);
+    append_edges(edge);
+    _last_ended = false;
+}
+
+/*
+ * Write a run length encoded payload straight into the leaves. Each
+ * channel is filled run by run, and a leaf that stays at the previous
+ * level for its whole length is never allocated.
+ */
+void LogicSnapshot::append_edges(const sr_datafeed_logic_edge &edge)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+
+    const uint64_t end = _ring ? edge.end : min(edge.end, _total_sample_count);
+    if (end <= _ring_sample_count)
+        return;
+
+    const uint8_t *data = (const uint8_t *)edge.data;
+    for (unsigned int order = 0; order < _ch_data.size(); order++) {
+        const unsigned int byte = order / 8;
+        const uint8_t mask = 1 << (order % 8);
+        uint64_t start = _ring_sample_count;
+        bool value = _edge_value[order];
+        for (uint64_t i = 0; i < edge.num_edges && byte < edge.unitsize; i++) {
+            const bool sample = (data[i * edge.unitsize + byte] & mask) != 0;
+            if (sample == value)
+                continue;
+            const uint64_t index = max(min(edge.index[i], end), start);
+            fill_run(order, start, index, value);
+            start = index;
+            value = sample;
+        }
+        fill_run(order, start, end, value);
+        _edge_value[order] = value;
+        if (_memory_failed)
+            return;
+    }
+
+    _ring_sample_count = end;
+    _sample_count = _ring ? ring_count() : end;
+    publish();
+}
+
+void LogicSnapshot::fill_run(unsigned int order, uint64_t start, uint64_t end, bool value)
+{
+    while (start < end && !_memory_failed) {
+        const uint64_t block = start >> LeafBlockPower;
+        const uint64_t leaf_pos = ring_pos(start);
+        const uint64_t index0 = leaf_pos / RootNodeSamples;
+        const uint64_t index1 = (leaf_pos >> LeafBlockPower) % RootScale;
+        const uint64_t leaf_start = start & ~LeafMask;
+        const uint64_t leaf_end = min(leaf_start + LeafBlockSamples, end);
+        struct RootNode &rn = _ch_data[order][index0];
+
+        if (start == leaf_start)
+            roll(block);
+
+        if (start == leaf_start && leaf_end == leaf_start + LeafBlockSamples &&
+            value == (_last_sample[order] != 0)) {
+            // whole leaf without toggle, keep the level in the root only
+            void *const lbp = rn.lbp[index1];
+            rn.tog &= ~(1ULL << index1);
+            rn.lbp[index1] = NULL;
+            if (value)
+                rn.value |= 1ULL << index1;
+            else
+                rn.value &= ~(1ULL << index1);
+            mirror_leaf(order, index0, index1);
+            free(lbp);
+            // calc_mipmap() keeps it for the leaves which are written
+            _last_sample[order] = value ? ~0ULL : 0ULL;
+            start = leaf_end;
+            continue;
+        }
+
+        if (start == leaf_start && !alloc_leaf(order, block, true))
+            return;
+
+        uint64_t *ptr = (uint64_t *)rn.lbp[index1];
+        const uint64_t fill = value ? ~0ULL : 0ULL;
+        uint64_t pos = start - leaf_start;
+        const uint64_t pos_end = leaf_end - leaf_start;
+        while (pos < pos_end) {
+            const uint64_t offset = pos % Scale;
+            const uint64_t bits = min(Scale - offset, pos_end - pos);
+            const uint64_t mask = (bits == Scale) ? ~0ULL :
+                                  (~(~0ULL << bits) << offset);
+            ptr[pos / Scale] = (ptr[pos / Scale] & ~mask) | (fill & mask);
+            pos += bits;
+        }
+
+        start = leaf_end;
+        if ((start & LeafMask) == 0)
+            finish_leaf(order, index0, index1, LeafBlockSamples);
+    }
+}
+
+/*
+ * Gets the leaf of block ready to be written. In a ring it may still
+ * hold a block which has left the window, whose root bits go first.
+ */
+bool LogicSnapshot::alloc_leaf(unsigned int order, uint64_t block, bool clear)
+{
+    const uint64_t pos = _ring ? block % _ring_leaves : block;
+    const uint64_t index0 = pos / RootScale;
+    const uint64_t index1 = pos % RootScale;
+    struct RootNode &rn = _ch_data[order][index0];
+
+    rn.tog &= ~(1ULL << index1);
+    rn.value &= ~(1ULL << index1);
+    mirror_leaf(order, index0, index1);
+
+    if (rn.lbp[index1] == NULL)
+        rn.lbp[index1] = malloc(LeafBlockSpace);
+    if (rn.lbp[index1] == NULL) {
+        _memory_failed = true;
+        return false;
+    }
+    if (clear)
+        memset(rn.lbp[index1], 0, LeafBlockSpace);
+    else
+        memset((uint64_t *)rn.lbp[index1] + (LeafBlockSamples / Scale), 0,
+               LeafBlockSpace - (LeafBlockSamples / 8));
+    mirror_leaf(order, index0, index1);
+    return true;
+}
+
+void LogicSnapshot::finish_leaf(unsigned int order, uint64_t index0, uint64_t index1, uint64_t samples)
+{
+    // calc mipmap of current block
+    calc_mipmap(order, index0, index1, samples);
+
+    // calc root of current block
+    struct RootNode &rn = _ch_data[order][index0];
+    void *trimmed = NULL;
+    if (*((uint64_t *)rn.lbp[index1]) != 0)
+        rn.value += 1ULL << index1;
+    if (*((uint64_t *)rn.lbp[index1] + LeafBlockSpace / sizeof(uint64_t) - 1) != 0) {
+        rn.tog += 1ULL << index1;
+    } else {
+        // trim leaf to free space
+        trimmed = rn.lbp[index1];
+        rn.lbp[index1] = NULL;
+    }
+    mirror_leaf(order, index0, index1);
+    free(trimmed);
+}
+
+/*
+ * Copies a leaf of a ring to its second place in _ch_data. Readers go
+ * by the tog bit, so it is cleared before and set after the pointer.
+ */
+void LogicSnapshot::mirror_leaf(unsigned int order, uint64_t index0, uint64_t index1)
+{
+    if (!_ring)
+        return;
+
+    const uint64_t leaf = index0 * RootScale + index1 + _ring_leaves;
+    const struct RootNode &src = _ch_data[order][index0];
+    struct RootNode &dest = _ch_data[order][leaf / RootScale];
+    const uint64_t src_mask = 1ULL << index1;
+    const uint64_t dest_mask = 1ULL << (leaf % RootScale);
+
+    dest.tog &= ~dest_mask;
+    dest.lbp[leaf % RootScale] = src.lbp[index1];
+    if (src.value & src_mask)
+        dest.value |= dest_mask;
+    else
+        dest.value &= ~dest_mask;
+    if (src.tog & src_mask)
+        dest.tog |= dest_mask;
+}
+
+/*
+ * The writers are about to start block. In a ring it takes the leaf of
+ * the oldest block, which leaves the window of the readers first.
+ */
+void LogicSnapshot::roll(uint64_t block)
+{
+    if (!_ring || block < _ring_first + _ring_leaves)
+        return;
+
+    // Readers holding the access lock keep their window until they
+    // are done, the others get the new one in one piece, see
+    // get_window(). The leaf of block is out of both windows, so it
+    // is rewritten without the lock.
+    boost::unique_lock<boost::shared_mutex> access(_access_mutex);
+    begin_invalidate();
+    _ring_first = block + 1 - _ring_leaves;
+    _ring_base.store((_ring_first % _ring_leaves) * LeafBlockSamples,
+                     std::memory_order_relaxed);
+    _sample_count = ring_count();
+
+    // it reads as low until then
+    const uint64_t leaf = block % _ring_leaves;
+    for (unsigned int order = 0; order < _ch_data.size(); order++) {
+        struct RootNode &rn = _ch_data[order][leaf / RootScale];
+        rn.tog &= ~(1ULL << (leaf % RootScale));
+        rn.value &= ~(1ULL << (leaf % RootScale));
+        mirror_leaf(order, leaf / RootScale, leaf % RootScale);
+    }
+    end_invalidate();
+}
+
+/*
+ * The sample count, and in base where the window of a ring starts in
+ * _ch_data. They change together when the ring rolls on.
+ */
+uint64_t LogicSnapshot::get_window(uint64_t &base) const
+{
+    uint64_t epoch, count;
+    do {
+        epoch = _epoch.load(std::memory_order_acquire);
+        base = _ring_base.load(std::memory_order_relaxed);
+        count = _published_count.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((epoch & 1) || epoch != _epoch.load(std::memory_order_relaxed));
+    return count;
+}
+
+/*
+ * Where the current window of a ring starts in the whole capture, the
+ * samples before it have been dropped.
+ */
+uint64_t LogicSnapshot::get_ring_offset()
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    return _ring ? _ring_first * LeafBlockSamples : 0;
+}
+
+// A ring which still drops samples as it goes
+bool LogicSnapshot::rolling() const
+{
+    return _ring && !last_ended();
+}
+
+// Where the writers keep sample index in _ch_data
+uint64_t LogicSnapshot::ring_pos(uint64_t index) const
+{
+    return _ring ? index % (_ring_leaves * LeafBlockSamples) : index;
+}
+
+// Samples in the window of a ring, from the oldest block on
+uint64_t LogicSnapshot::ring_count() const
+{
+    const uint64_t first = _ring_first * LeafBlockSamples;
+    return _ring_sample_count > first ? _ring_sample_count - first : 0;
+}
+
+uint64_t LogicSnapshot::get_ring_capacity(uint64_t total_sample_count)
+{
+    // one more leaf than the samples need, it is the one being written
+    return ((total_sample_count + LeafBlockSamples - 1) / LeafBlockSamples + 1) *
+           LeafBlockSamples;
 }
 
 void LogicSnapshot::calc_mipmap(unsigned int order, uint8_t index0, uint8_t index1, uint64_t samples)
@@ -443,6 +717,7 @@ void LogicSnapshot::calc_mipmap(unsigned int order, uint8_t index0, uint8_t inde
     uint64_t *src_ptr;
     uint64_t *dest_ptr;
     unsigned int i;
+    const int64_t start = g_get_monotonic_time();
 
     // level 1
     src_ptr = (uint64_t *)_ch_data[order][index0].lbp[index1];
@@ -467,24 +742,34 @@ void LogicSnapshot::calc_mipmap(unsigned int order, uint8_t index0, uint8_t inde
         *dest_ptr += (*src_ptr != 0 ? 1ULL : 0ULL) << offset;
         src_ptr++;
     }
+
+    _mipmap_time += g_get_monotonic_time() - start;
+}
+
+uint64_t LogicSnapshot::get_mipmap_time() const
+{
+    return _mipmap_time;
 }
 
 const uint8_t *LogicSnapshot::get_samples(uint64_t start_sample, uint64_t &end_sample,
                                      int sig_index)
 {
     //assert(data);
-    assert(start_sample < get_sample_count());
-    assert(end_sample <= get_sample_count());
+    uint64_t base;
+    const uint64_t sample_count = get_window(base);
+    assert(start_sample < sample_count);
+    assert(end_sample <= sample_count);
     assert(start_sample <= end_sample);
 
     int order = get_ch_order(sig_index);
-    uint64_t root_index = start_sample >> (LeafBlockPower + RootScalePower);
-    uint8_t root_pos = (start_sample & RootMask) >> LeafBlockPower;
-    uint64_t block_offset = (start_sample & LeafMask) / 8;
+    const uint64_t index = start_sample + base;
+    uint64_t root_index = index >> (LeafBlockPower + RootScalePower);
+    uint8_t root_pos = (index & RootMask) >> LeafBlockPower;
+    uint64_t block_offset = (index & LeafMask) / 8;
     end_sample = (root_index << (LeafBlockPower + RootScalePower)) +
                  (root_pos << LeafBlockPower) +
                  ~(~0ULL << LeafBlockPower);
-    end_sample = min(end_sample + 1, get_sample_count());
+    end_sample = min(end_sample + 1 - base, sample_count);
 
     if (order == -1 ||
         _ch_data[order][root_index].lbp[root_pos] == NULL)
@@ -500,20 +785,26 @@ bool LogicSnapshot::get_sample(uint64_t index, int sig_index)
     assert(_ch_data[order].size() != 0);
     //assert(index < get_sample_count());
 
-    if (index < get_sample_count()) {
-        uint64_t index_mask = 1ULL << (index & LevelMask[0]);
-        uint64_t root_index = index >> (LeafBlockPower + RootScalePower);
-        uint8_t root_pos = (index & RootMask) >> LeafBlockPower;
-        uint64_t root_pos_mask = 1ULL << root_pos;
+    uint64_t base;
+    if (index < get_window(base))
+        return leaf_sample(order, index + base);
+    else
+        return false;
+}
 
-        if ((_ch_data[order][root_index].tog & root_pos_mask) == 0) {
-            return (_ch_data[order][root_index].value & root_pos_mask) != 0;
-        } else {
-            uint64_t *lbp = (uint64_t *)_ch_data[order][root_index].lbp[root_pos];
-            return *(lbp + ((index & LeafMask) >> ScalePower)) & index_mask;
-        }
+// A sample by its index in _ch_data
+bool LogicSnapshot::leaf_sample(int order, uint64_t index)
+{
+    uint64_t index_mask = 1ULL << (index & LevelMask[0]);
+    uint64_t root_index = index >> (LeafBlockPower + RootScalePower);
+    uint8_t root_pos = (index & RootMask) >> LeafBlockPower;
+    uint64_t root_pos_mask = 1ULL << root_pos;
+
+    if ((_ch_data[order][root_index].tog & root_pos_mask) == 0) {
+        return (_ch_data[order][root_index].value & root_pos_mask) != 0;
     } else {
-        return false;
+        uint64_t *lbp = (uint64_t *)_ch_data[order][root_index].lbp[root_pos];
+        return *(lbp + ((index & LeafMask) >> ScalePower)) & index_mask;
     }
 }
 
@@ -587,6 +878,10 @@ bool LogicSnapshot::get_nxt_edge(
 
     //const unsigned int min_level = max((int)floorf(logf(min_length) / logf(Scale)) - 1, 0);
     const unsigned int min_level = max((int)(log2f(min_length) - 1) / (int)ScalePower, 0);
+    uint64_t base;
+    get_window(base);
+    index += base;
+    end += base;
     uint64_t root_index = index >> (LeafBlockPower + RootScalePower);
     uint8_t root_pos = (index & RootMask) >> LeafBlockPower;
     bool edge_hit = false;
@@ -618,6 +913,7 @@ bool LogicSnapshot::get_nxt_edge(
         } while (!edge_hit && index < end);
         root_pos = 0;
     }
+    index -= base;
     return edge_hit;
 }
 
@@ -632,6 +928,9 @@ bool LogicSnapshot::get_pre_edge(uint64_t &index, bool last_sample,
 
     //const unsigned int min_level = max((int)floorf(logf(min_length) / logf(Scale)) - 1, 1);
     const unsigned int min_level = max((int)(log2f(min_length) - 1) / (int)ScalePower, 0);
+    uint64_t base;
+    get_window(base);
+    index += base;
     int root_index = index >> (LeafBlockPower + RootScalePower);
     uint8_t root_pos = (index & RootMask) >> LeafBlockPower;
     bool edge_hit = false;
@@ -662,6 +961,12 @@ bool LogicSnapshot::get_pre_edge(uint64_t &index, bool last_sample,
         root_pos = RootScale - 1;
     }
 
+    // the leaves before the window of a ring hold newer blocks
+    if (base != 0 && index <= base) {
+        index = 0;
+        return false;
+    }
+    index -= base;
     return edge_hit;
 }
 
@@ -776,8 +1081,8 @@ bool LogicSnapshot::block_pre_edge(uint64_t *lbp, uint64_t &index, bool last_sam
             else
                 index--;
 
-            // using get_sample() to avoid out of block case
-            bool sample = get_sample(index, sig_index);
+            // using leaf_sample() to avoid out of block case
+            bool sample = leaf_sample(get_ch_order(sig_index), index);
             if (sample ^ last_sample) {
                 index++;
                 return true;
@@ -1050,21 +1355,23 @@ bool LogicSnapshot::has_data(int sig_index)
 
 int LogicSnapshot::get_block_num()
 {
-    return (_ring_sample_count >> LeafBlockPower) +
-           ((_ring_sample_count & LeafMask) != 0);
+    // the window of a ring starts at a block
+    const uint64_t count = _ring ? get_sample_count() : _ring_sample_count;
+    return (count >> LeafBlockPower) + ((count & LeafMask) != 0);
 }
 
 uint64_t LogicSnapshot::get_block_size(int block_index)
 {
     assert(block_index < get_block_num());
 
+    const uint64_t count = _ring ? get_sample_count() : _ring_sample_count;
     if (block_index < get_block_num() - 1) {
         return LeafBlockSamples / 8;
     } else {
-        if (_ring_sample_count % LeafBlockSamples == 0)
+        if (count % LeafBlockSamples == 0)
             return LeafBlockSamples / 8;
         else
-            return (_ring_sample_count % LeafBlockSamples) / 8;
+            return (count % LeafBlockSamples) / 8;
     }
 }
 
@@ -1077,8 +1384,11 @@ uint8_t *LogicSnapshot::get_block_buf(int block_index, int sig_index, bool &samp
         sample = 0;
         return NULL;
     }
-    uint64_t index = block_index / RootScale;
-    uint8_t pos = block_index % RootScale;
+    uint64_t base;
+    get_window(base);
+    const uint64_t block = block_index + (base >> LeafBlockPower);
+    uint64_t index = block / RootScale;
+    uint8_t pos = block % RootScale;
     uint8_t *lbp = (uint8_t *)_ch_data[order][index].lbp[pos];
 
     if (lbp == NULL)
@@ -1087,6 +1397,87 @@ uint8_t *LogicSnapshot::get_block_buf(int block_index, int sig_index, bool &samp
     return lbp;
 }
 
+/*
+ * Blocks which have all their samples, of every channel. They don't
+ * change any more.
+ */
+int LogicSnapshot::get_full_block_num()
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    return _ring_sample_count >> LeafBlockPower;
+}
+
+/*
+ * Drops the first block_num blocks, once they have been stored
+ * somewhere else. They read as the level at the start of each block
+ * afterwards. Readers don't lock, so the leaves are only freed on the
+ * next call, a painter which got hold of one has the time of a block
+ * to finish with it. Blocks a reader has pinned are kept, they are
+ * dropped by a later call once it has moved on.
+ */
+void LogicSnapshot::release_blocks(int block_num)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    assert(!_ring);
+    assert(block_num <= get_full_block_num());
+
+    for (auto& iter:_pins)
+        block_num = min(block_num, (int)(iter.second >> LeafBlockPower));
+    if (block_num <= _released_blocks)
+        return;
+
+    free_released();
+    for (; _released_blocks < block_num; _released_blocks++) {
+        const uint64_t index0 = _released_blocks / RootScale;
+        const uint64_t index1 = _released_blocks % RootScale;
+        for(auto& iter:_ch_data) {
+            struct RootNode &rn = iter[index0];
+            if (rn.lbp[index1] == NULL)
+                continue;
+            rn.tog &= ~(1ULL << index1);
+            _released_leaves.push_back(rn.lbp[index1]);
+            rn.lbp[index1] = NULL;
+        }
+    }
+    invalidate();
+}
+
+/*
+ * Samples before this one have been released, they don't hold the
+ * captured levels any more.
+ */
+uint64_t LogicSnapshot::get_released_samples()
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    return (uint64_t)_released_blocks << LeafBlockPower;
+}
+
+/*
+ * Keeps the blocks from sample on until the reader moves its pin or
+ * removes it. Fails when sample has been released already.
+ */
+bool LogicSnapshot::pin(const void *reader, uint64_t sample)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    if (sample < ((uint64_t)_released_blocks << LeafBlockPower))
+        return false;
+    _pins[reader] = sample;
+    return true;
+}
+
+void LogicSnapshot::unpin(const void *reader)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    _pins.erase(reader);
+}
+
+void LogicSnapshot::free_released()
+{
+    for (auto& iter:_released_leaves)
+        free(iter);
+    _released_leaves.clear();
+}
+
 int LogicSnapshot::get_ch_order(int sig_index)
 {
     uint16_t order = 0;
@@ -30,15 +30,15 @@
 
 #include <QString>
 
+#include <map>
 #include <utility>
 #include <vector>
 
 namespace LogicSnapshotTest {
-class Pow2;
-class Basic;
 class LargeData;
-class Pulses;
-class LongPulses;
+class Edges;
+class Reuse;
+class Pin;
 }
 
 namespace pv {
@@ -84,10 +84,16 @@ public:
     void clear();
     void init();
 
-    void first_payload(const sr_datafeed_logic &logic, uint64_t total_sample_count, GSList *channels);
+    void first_payload(const sr_datafeed_logic &logic, uint64_t total_sample_count,
+                       GSList *channels, bool ring);
 
 	void append_payload(const sr_datafeed_logic &logic);
 
+    void first_edges(const sr_datafeed_logic_edge &edge, uint64_t total_sample_count,
+                     GSList *channels, bool ring);
+
+    void append_edges(const sr_datafeed_logic_edge &edge);
+
     const uint8_t * get_samples(uint64_t start_sample, uint64_t& end_sample, int sig_index);
 
     bool get_sample(uint64_t index, int sig_index);
@@ -110,13 +116,38 @@ public:
     int get_block_num();
     uint64_t get_block_size(int block_index);
     uint8_t *get_block_buf(int block_index, int sig_index, bool &sample);
+    int get_full_block_num();
+    void release_blocks(int block_num);
+    uint64_t get_released_samples();
+
+    // Keeps the blocks from sample on while reader works on them
+    bool pin(const void *reader, uint64_t sample);
+    void unpin(const void *reader);
 
     bool pattern_search(int64_t start, int64_t end, bool nxt, int64_t& index,
                         std::map<uint16_t, QString> pattern);
 
+    // Time spent building mipmaps, in us
+    uint64_t get_mipmap_time() const;
+
+    // Most samples kept by a ring of total_sample_count samples
+    static uint64_t get_ring_capacity(uint64_t total_sample_count);
+    uint64_t get_ring_offset();
+    bool rolling() const;
+
 private:
     int get_ch_order(int sig_index);
     void calc_mipmap(unsigned int order, uint8_t index0, uint8_t index1, uint64_t samples);
+    void begin_payload(uint64_t total_sample_count, GSList *channels, bool ring);
+    bool alloc_leaf(unsigned int order, uint64_t block, bool clear);
+    void finish_leaf(unsigned int order, uint64_t index0, uint64_t index1, uint64_t samples);
+    void mirror_leaf(unsigned int order, uint64_t index0, uint64_t index1);
+    void roll(uint64_t block);
+    uint64_t get_window(uint64_t &base) const;
+    uint64_t ring_pos(uint64_t index) const;
+    uint64_t ring_count() const;
+    void free_released();
+    void fill_run(unsigned int order, uint64_t start, uint64_t end, bool value);
 
     void append_cross_payload(const sr_datafeed_logic &logic);
     void append_split_payload(const sr_datafeed_logic &logic);
@@ -127,6 +158,8 @@ private:
     bool block_pre_edge(uint64_t *lbp, uint64_t &index, bool last_sample,
                         unsigned int min_level, int sig_index);
 
+    bool leaf_sample(int order, uint64_t index);
+
     inline uint64_t bsf_folded (uint64_t bb)
     {
         static const int lsb_64_table[64] = {
@@ -181,6 +214,9 @@ private:
 private:
     std::vector<std::vector<struct RootNode>> _ch_data;
     uint64_t _block_num;
+    int _released_blocks;
+    std::vector<void *> _released_leaves;
+    std::map<const void *, uint64_t> _pins;
     uint8_t _byte_fraction;
     uint16_t _ch_fraction;
     void *_src_ptr;
@@ -190,12 +226,22 @@ private:
     std::vector<uint64_t> _block_cnt;
     std::vector<uint64_t> _ring_sample_cnt;
     std::vector<uint64_t> _last_sample;
+    std::vector<uint8_t> _edge_value;
+    uint64_t _mipmap_time;
+
+    // Roll mode: the blocks take turns in a ring of _ring_leaves leaves,
+    // which _ch_data holds twice so that a window across the end of the
+    // ring is still contiguous. Readers add _ring_base to their indexes,
+    // they load it with the sample count through get_window().
+    bool _ring;
+    uint64_t _ring_leaves;
+    uint64_t _ring_first;
+    std::atomic<uint64_t> _ring_base;
 
-	friend class LogicSnapshotTest::Pow2;
-	friend class LogicSnapshotTest::Basic;
 	friend class LogicSnapshotTest::LargeData;
-	friend class LogicSnapshotTest::Pulses;
-	friend class LogicSnapshotTest::LongPulses;
+	friend class LogicSnapshotTest::Edges;
+	friend class LogicSnapshotTest::Reuse;
+	friend class LogicSnapshotTest::Pin;
 };
 
 } // namespace data
@@ -327,6 +327,7 @@ void MathStack::calc_math()
 
     const boost::shared_ptr<pv::data::DsoSnapshot> &snapshot =
         snapshots.front();
+    boost::shared_lock<boost::shared_mutex> access(snapshot->get_access_mutex());
     if (snapshot->empty())
         return;
 
@@ -0,0 +1,108 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "powerspectrum.h"
+
+#include <math.h>
+
+#define PI 3.1415
+
+using namespace std;
+
+namespace pv {
+namespace data {
+
+PowerSpectrum::PowerSpectrum() :
+    _sample_num(0),
+    _fft_plan(NULL)
+{
+}
+
+PowerSpectrum::~PowerSpectrum()
+{
+    if (_fft_plan)
+        fftw_destroy_plan(_fft_plan);
+}
+
+uint64_t PowerSpectrum::get_sample_num() const
+{
+    return _sample_num;
+}
+
+void PowerSpectrum::set_sample_num(uint64_t num)
+{
+    if (_fft_plan)
+        fftw_destroy_plan(_fft_plan);
+
+    _sample_num = num;
+    _xn.resize(_sample_num);
+    _xk.resize(_sample_num);
+    _power_spectrum.resize(_sample_num/2+1);
+    _fft_plan = fftw_plan_r2r_1d(_sample_num, _xn.data(), _xk.data(),
+                                 FFTW_R2HC, FFTW_ESTIMATE);
+}
+
+void PowerSpectrum::calc(const uint8_t *samples, uint64_t step, int offset,
+                         double vscale, int window_type)
+{
+    // prepare _xn data
+    double wsum = 0;
+    for (uint64_t i = 0; i < _sample_num; i++) {
+        double w = window(i, _sample_num, window_type);
+        _xn[i] = (samples[i*step] - offset) * vscale * w;
+        wsum += w;
+    }
+
+    // fft
+    fftw_execute(_fft_plan);
+
+    // calculate power spectrum
+    _power_spectrum[0] = fabs(_xk[0])/wsum;  /* DC component */
+    for (uint64_t k = 1; k < (_sample_num + 1) / 2; ++k)  /* (k < N/2 rounded up) */
+         _power_spectrum[k] = sqrt((_xk[k]*_xk[k] + _xk[_sample_num-k]*_xk[_sample_num-k]) * 2) / wsum;
+    if (_sample_num % 2 == 0) /* N is even */
+         _power_spectrum[_sample_num/2] = fabs(_xk[_sample_num/2])/wsum;  /* Nyquist freq. */
+}
+
+const std::vector<double>& PowerSpectrum::get_spectrum() const
+{
+    return _power_spectrum;
+}
+
+double PowerSpectrum::window(uint64_t i, uint64_t num, int type)
+{
+    const double n_m_1 = num-1;
+    switch(type) {
+    case 1: // Hann window
+        return 0.5*(1-cos(2*PI*i/n_m_1));
+    case 2: // Hamming window
+        return 0.54-0.46*cos(2*PI*i/n_m_1);
+    case 3: // Blackman window
+        return 0.42659-0.49656*cos(2*PI*i/n_m_1) + 0.076849*cos(4*PI*i/n_m_1);
+    case 4: // Flat_top window
+        return 1-1.93*cos(2*PI*i/n_m_1)+1.29*cos(4*PI*i/n_m_1)-
+                 0.388*cos(6*PI*i/n_m_1)+0.028*cos(8*PI*i/n_m_1);
+    default:
+        return 1;
+    }
+}
+
+} // namespace data
+} // namespace pv
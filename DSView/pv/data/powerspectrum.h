@@ -0,0 +1,69 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_PV_DATA_POWERSPECTRUM_H
+#define DSVIEW_PV_DATA_POWERSPECTRUM_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <fftw3.h>
+
+namespace pv {
+namespace data {
+
+/**
+ * The computation of SpectrumStack: window, real FFT and power spectrum
+ * of a run of DSO samples. It needs no session, so it can be run on its
+ * own.
+ */
+class PowerSpectrum
+{
+public:
+    PowerSpectrum();
+    ~PowerSpectrum();
+
+    uint64_t get_sample_num() const;
+    void set_sample_num(uint64_t num);
+
+    /**
+     * Computes the spectrum of get_sample_num() samples, one in every
+     * step bytes, as (sample - offset) * vscale.
+     */
+    void calc(const uint8_t *samples, uint64_t step, int offset,
+              double vscale, int window_type);
+
+    const std::vector<double>& get_spectrum() const;
+
+    static double window(uint64_t i, uint64_t num, int type);
+
+private:
+    uint64_t _sample_num;
+    fftw_plan _fft_plan;
+    std::vector<double> _xn;
+    std::vector<double> _xk;
+    std::vector<double> _power_spectrum;
+};
+
+} // namespace data
+} // namespace pv
+
+#endif // DSVIEW_PV_DATA_POWERSPECTRUM_H
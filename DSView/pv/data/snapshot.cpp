@@ -43,7 +43,10 @@ Snapshot::Snapshot(int unit_size, uint64_t total_sample_count, unsigned int chan
     _ring_sample_count(0),
     _unit_size(unit_size),
     _memory_failed(false),
-    _last_ended(true)
+    _last_ended(true),
+    _published_count(0),
+    _published_ring(0),
+    _epoch(0)
 {
     assert(_unit_size > 0);
     _unit_bytes = 1;
@@ -66,6 +69,46 @@ void Snapshot::free_data()
     _ch_index.clear();
 }
 
+/*
+ * Make everything written so far visible to readers. The stores are
+ * append-only, so the published prefix stays valid until invalidate().
+ */
+void Snapshot::publish()
+{
+    _published_ring.store(_ring_sample_count, std::memory_order_relaxed);
+    _published_count.store(_sample_count, std::memory_order_release);
+}
+
+/*
+ * Called with _mutex and _access_mutex held when samples already handed
+ * out are going to be overwritten (ring wrap) or freed (clear).
+ */
+void Snapshot::invalidate()
+{
+    begin_invalidate();
+    end_invalidate();
+}
+
+/*
+ * The epoch is odd from begin_invalidate() to end_invalidate(), what
+ * is stored in between is published with the sample count. Readers of
+ * more than the count check the epoch around their loads, see
+ * LogicSnapshot::get_window().
+ */
+void Snapshot::begin_invalidate()
+{
+    _epoch.store(_epoch.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void Snapshot::end_invalidate()
+{
+    publish();
+    _epoch.store(_epoch.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+}
+
 bool Snapshot::memory_failed() const
 {
     return _memory_failed;
@@ -91,28 +134,38 @@ void Snapshot::set_last_ended(bool ended)
 
 uint64_t Snapshot::get_sample_count() const
 {
-    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
-    return _sample_count;
+    return _published_count.load(std::memory_order_acquire);
 }
 
 uint64_t Snapshot::get_ring_start() const
 {
-    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
-    if (_sample_count < _total_sample_count)
+    const uint64_t sample_count = get_sample_count();
+    if (sample_count < _total_sample_count)
         return 0;
     else
-        return _ring_sample_count;
+        return _published_ring.load(std::memory_order_relaxed);
 }
 
 uint64_t Snapshot::get_ring_end() const
 {
-    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
-    if (_sample_count == 0)
+    const uint64_t sample_count = get_sample_count();
+    const uint64_t ring_sample_count = _published_ring.load(std::memory_order_relaxed);
+    if (sample_count == 0)
         return 0;
-    else if (_ring_sample_count == 0)
+    else if (ring_sample_count == 0)
         return _total_sample_count - 1;
     else
-        return _ring_sample_count - 1;
+        return ring_sample_count - 1;
+}
+
+uint64_t Snapshot::get_epoch() const
+{
+    return _epoch.load(std::memory_order_acquire);
+}
+
+boost::shared_mutex &Snapshot::get_access_mutex() const
+{
+    return _access_mutex;
 }
 
 const void* Snapshot::get_data() const
@@ -25,6 +25,8 @@
 
 #include <boost/thread.hpp>
 
+#include <atomic>
+
 namespace pv {
 namespace data {
 
@@ -41,6 +43,13 @@ public:
 	uint64_t get_sample_count() const;
     uint64_t get_ring_start() const;
     uint64_t get_ring_end() const;
+    uint64_t get_epoch() const;
+
+    /*
+     * Readers keeping pointers into the store across a loop hold this
+     * shared. clear() and writes over published samples take it unique.
+     */
+    boost::shared_mutex &get_access_mutex() const;
 
     const void * get_data() const;
 
@@ -62,9 +71,18 @@ public:
 
 protected:
     virtual void free_data();
+    void publish();
+    void invalidate();
+    void begin_invalidate();
+    void end_invalidate();
 
 protected:
+    /*
+     * Writer lock: serializes append_payload() against clear()/init().
+     * Readers never take it, they see the prefix published by publish().
+     */
     mutable boost::recursive_mutex _mutex;
+    mutable boost::shared_mutex _access_mutex;
 
     //std::vector<uint8_t> _data;
     void* _data;
@@ -80,6 +98,11 @@ protected:
     uint16_t _unit_pitch;
     bool _memory_failed;
     bool _last_ended;
+
+    // lock-free view of the store for readers
+    std::atomic<uint64_t> _published_count;
+    std::atomic<uint64_t> _published_ring;
+    std::atomic<uint64_t> _epoch;
 };
 
 } // namespace data
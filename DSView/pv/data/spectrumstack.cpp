@@ -28,8 +28,6 @@
 #include <pv/sigsession.h>
 #include <pv/view/dsosignal.h>
 
-#define PI 3.1415
-
 using namespace boost;
 using namespace std;
 
@@ -57,18 +55,12 @@ SpectrumStack::SpectrumStack(pv::SigSession &session, int index) :
     _index(index),
     _dc_ignore(true),
     _sample_interval(1),
-    _spectrum_state(Init),
-    _fft_plan(NULL)
+    _spectrum_state(Init)
 {
 }
 
 SpectrumStack::~SpectrumStack()
 {
-    _xn.clear();
-    _xk.clear();
-    _power_spectrum.clear();
-    if (_fft_plan)
-        fftw_destroy_plan(_fft_plan);
 }
 
 void SpectrumStack::clear()
@@ -92,11 +84,7 @@ uint64_t SpectrumStack::get_sample_num() const
 void SpectrumStack::set_sample_num(uint64_t num)
 {
     _sample_num = num;
-    _xn.resize(_sample_num);
-    _xk.resize(_sample_num);
-    _power_spectrum.resize(_sample_num/2+1);
-    _fft_plan = fftw_plan_r2r_1d(_sample_num, _xn.data(), _xk.data(),
-                                 FFTW_R2HC, FFTW_ESTIMATE);
+    _spectrum.set_sample_num(_sample_num);
 }
 
 int SpectrumStack::get_windows_index() const
@@ -153,7 +141,7 @@ const std::vector<double> SpectrumStack::get_fft_spectrum() const
 {
     std::vector<double> empty;
     if (_spectrum_state == Stopped)
-        return _power_spectrum;
+        return _spectrum.get_spectrum();
     else
         return empty;
 }
@@ -161,8 +149,8 @@ const std::vector<double> SpectrumStack::get_fft_spectrum() const
 double SpectrumStack::get_fft_spectrum(uint64_t index)
 {
     double ret = -1;
-    if (_spectrum_state == Stopped && index < _power_spectrum.size())
-        ret = _power_spectrum[index];
+    if (_spectrum_state == Stopped && index < _spectrum.get_spectrum().size())
+        ret = _spectrum.get_spectrum()[index];
 
     return ret;
 }
@@ -192,6 +180,7 @@ void SpectrumStack::calc_fft()
         return;
     _snapshot = snapshots.front();
 
+    boost::shared_lock<boost::shared_mutex> access(_snapshot->get_access_mutex());
     if (_snapshot->get_sample_count() < _sample_num*_sample_interval)
         return;
 
@@ -200,47 +189,18 @@ void SpectrumStack::calc_fft()
     if (_samplerate == 0.0)
         _samplerate = 1.0;
 
-    // prepare _xn data
     const int offset = dsoSig->get_hw_offset();
     const double vscale = dsoSig->get_vDialValue() * dsoSig->get_factor() * DS_CONF_DSO_VDIVS / (1000*255.0);
     const uint16_t step = _snapshot->get_channel_num() * _sample_interval;
     const uint8_t *const samples = _snapshot->get_samples(0, _sample_num*_sample_interval-1, _index);
-    double wsum = 0;
-    for (unsigned int i = 0; i < _sample_num; i++) {
-        double w = window(i, _windows_index);
-        _xn[i] = (samples[i*step] - offset) * vscale * w;
-        wsum += w;
-    }
-
-    // fft
-    fftw_execute(_fft_plan);
-
-    // calculate power spectrum
-    _power_spectrum[0] = abs(_xk[0])/wsum;  /* DC component */
-    for (unsigned int k = 1; k < (_sample_num + 1) / 2; ++k)  /* (k < N/2 rounded up) */
-         _power_spectrum[k] = sqrt((_xk[k]*_xk[k] + _xk[_sample_num-k]*_xk[_sample_num-k]) * 2) / wsum;
-    if (_sample_num % 2 == 0) /* N is even */
-         _power_spectrum[_sample_num/2] = abs(_xk[_sample_num/2])/wsum;  /* Nyquist freq. */
+    _spectrum.calc(samples, step, offset, vscale, _windows_index);
 
     _spectrum_state = Stopped;
 }
 
 double SpectrumStack::window(uint64_t i, int type)
 {
-    const double n_m_1 = _sample_num-1;
-    switch(type) {
-    case 1: // Hann window
-        return 0.5*(1-cos(2*PI*i/n_m_1));
-    case 2: // Hamming window
-        return 0.54-0.46*cos(2*PI*i/n_m_1);
-    case 3: // Blackman window
-        return 0.42659-0.49656*cos(2*PI*i/n_m_1) + 0.076849*cos(4*PI*i/n_m_1);
-    case 4: // Flat_top window
-        return 1-1.93*cos(2*PI*i/n_m_1)+1.29*cos(4*PI*i/n_m_1)-
-                 0.388*cos(6*PI*i/n_m_1)+0.028*cos(8*PI*i/n_m_1);
-    default:
-        return 1;
-    }
+    return PowerSpectrum::window(i, _sample_num, type);
 }
 
 } // namespace data
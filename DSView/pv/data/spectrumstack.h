@@ -22,6 +22,7 @@
 #define DSVIEW_PV_DATA_SPECTRUMSTACK_H
 
 #include "signaldata.h"
+#include "powerspectrum.h"
 
 #include <list>
 
@@ -29,8 +30,6 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
-#include <fftw3.h>
-
 #include <QObject>
 #include <QString>
 
@@ -106,10 +105,7 @@ private:
     boost::shared_ptr<pv::data::DsoSnapshot> _snapshot;
     spectrum_state _spectrum_state;
 
-    fftw_plan _fft_plan;
-    std::vector<double> _xn;
-    std::vector<double> _xk;
-    std::vector<double> _power_spectrum;
+    PowerSpectrum _spectrum;
 };
 
 } // namespace data
@@ -20,6 +20,7 @@
  */
 
 #include <cassert>
+#include <cstring>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -45,21 +46,21 @@ sr_dev_inst* InputFile::dev_inst() const
 
 void InputFile::use(SigSession *owner)
 {
-    (void)owner;
 	assert(!_input);
 
-    // only *.dsl file is valid
-    // don't allow other types of file input
-    throw tr("Not a valid DSView data file.");
-    return;
+    // Besides *.dsl files, only Value Change Dumps can be opened, their
+    // input module feeds the changes as they are parsed
+    sr_input_format *const format = determine_input_file_format(_path);
+    if (!format || strcmp(format->id, "vcd") != 0)
+        throw tr("Not a valid DSView data file.");
 
-//	_input = load_input_file_format(_path, NULL);
-//	File::use(owner);
+	_input = load_input_file_format(_path, format);
+	File::use(owner);
 
-//	sr_session_new();
+	sr_session_new();
 
-//	if (sr_session_dev_add(_input->sdi) != SR_OK)
-//		throw tr("Failed to add session device.");
+	if (sr_session_dev_add(_input->sdi) != SR_OK)
+		throw tr("Failed to add session device.");
 }
 
 void InputFile::release()
@@ -71,6 +72,7 @@ void InputFile::release()
 	File::release();
 	sr_dev_close(_input->sdi);
 	sr_session_destroy();
+	delete _input;
 	_input = NULL;
 }
 
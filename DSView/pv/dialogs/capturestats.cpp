@@ -0,0 +1,63 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "capturestats.h"
+
+#include <QVBoxLayout>
+
+namespace pv {
+namespace dialogs {
+
+CaptureStats::CaptureStats(SigSession &session, QWidget *parent) :
+    DSDialog(parent, true),
+    _session(session)
+{
+    _text = new QTextBrowser(this);
+    _text->setFrameStyle(QFrame::NoFrame);
+    _text->setLineWrapMode(QTextEdit::NoWrap);
+
+    QVBoxLayout *xlayout = new QVBoxLayout();
+    xlayout->addWidget(_text);
+    layout()->addLayout(xlayout);
+
+    setTitle(tr("Capture Statistics"));
+    resize(800, 420);
+
+    connect(&_timer, SIGNAL(timeout()), this, SLOT(update_stats()));
+    _timer.start(SessionStats::TickInterval / 1000);
+    update_stats();
+}
+
+void CaptureStats::update_stats()
+{
+    SessionStats &stats = _session.get_stats();
+    QStringList lines = stats.summary();
+
+    lines << "";
+    lines << tr("Last %1 seconds (times are avg/p99/max):")
+             .arg(SessionStats::HistorySeconds);
+    lines << stats.history();
+
+    _text->setPlainText(lines.join("\n"));
+}
+
+} // namespace dialogs
+} // namespace pv
@@ -0,0 +1,57 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+
+#ifndef DSVIEW_PV_CAPTURESTATS_H
+#define DSVIEW_PV_CAPTURESTATS_H
+
+#include <QTextBrowser>
+#include <QTimer>
+
+#include "../sigsession.h"
+#include "dsdialog.h"
+
+namespace pv {
+namespace dialogs {
+
+// Shows the pipeline counters of the session while a capture runs
+class CaptureStats : public DSDialog
+{
+	Q_OBJECT
+
+public:
+    CaptureStats(SigSession &session, QWidget *parent);
+
+private slots:
+    void update_stats();
+
+private:
+    SigSession &_session;
+
+    QTextBrowser *_text;
+    QTimer _timer;
+};
+
+} // namespace dialogs
+} // namespace pv
+
+#endif // DSVIEW_PV_CAPTURESTATS_H
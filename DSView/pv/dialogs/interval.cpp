@@ -20,6 +20,7 @@
  */
 
 #include "interval.h"
+#include "../device/devinst.h"
 
 #include <QGridLayout>
 
@@ -44,14 +45,51 @@ Interval::Interval(SigSession &session, QWidget *parent) :
 
     _interval_slider->setValue(_session.get_repeat_intvl());
 
+    // captures kept in segmented memory
+    _segment_label = new QLabel(tr("Segments: "), this);
+    _segment_spinBox = new QSpinBox(this);
+    _segment_spinBox->setRange(1, SigSession::MaxSegments);
+    _segment_spinBox->setButtonSymbols(QAbstractSpinBox::NoButtons);
+    _segment_slider = new QSlider(Qt::Horizontal, this);
+    _segment_slider->setRange(1, SigSession::MaxSegments);
+    connect(_segment_slider, SIGNAL(valueChanged(int)), _segment_spinBox, SLOT(setValue(int)));
+    connect(_segment_spinBox, SIGNAL(valueChanged(int)), _segment_slider, SLOT(setValue(int)));
+
+    _segment_slider->setValue(_session.get_segment_limit());
+
     QGridLayout *glayout = new QGridLayout(this);
     glayout->addWidget(_interval_label, 0, 0);
     glayout->addWidget(_interval_spinBox, 0, 1);
     glayout->addWidget(_interval_slider, 1, 0, 1, 3);
-    glayout->addWidget(&_button_box, 2, 2);
+    glayout->addWidget(_segment_label, 2, 0);
+    glayout->addWidget(_segment_spinBox, 2, 1);
+    glayout->addWidget(_segment_slider, 3, 0, 1, 3);
+    glayout->addWidget(&_button_box, 4, 2);
 
     layout()->addLayout(glayout);
-    setTitle(tr("Repetitive Interval"));
+    if (_session.get_device()->dev_inst()->mode == DSO) {
+        _interval_label->hide();
+        _interval_spinBox->hide();
+        _interval_slider->hide();
+        // frames overlaid by the oscilloscope, a setting of its own
+        _segment_label->setText(tr("Frames: "));
+        _segment_spinBox->setRange(1, SigSession::MaxPersistenceFrames);
+        _segment_slider->setRange(1, SigSession::MaxPersistenceFrames);
+        _segment_slider->setValue(_session.get_persistence_frames());
+        setTitle(tr("Persistence"));
+    } else if (_session.get_run_mode() == SigSession::Roll) {
+        // how far back a capture in roll mode keeps its samples
+        _interval_label->setText(tr("Window(s): "));
+        _interval_spinBox->setRange(1, SigSession::MaxRollWindow);
+        _interval_slider->setRange(1, SigSession::MaxRollWindow);
+        _interval_slider->setValue(_session.get_roll_window());
+        _segment_label->hide();
+        _segment_spinBox->hide();
+        _segment_slider->hide();
+        setTitle(tr("Roll Window"));
+    } else {
+        setTitle(tr("Repetitive Interval"));
+    }
 
     connect(&_button_box, SIGNAL(accepted()), this, SLOT(accept()));
 }
@@ -59,7 +97,14 @@ Interval::Interval(SigSession &session, QWidget *parent) :
 void Interval::accept()
 {
     using namespace Qt;
-    _session.set_repeat_intvl(_interval_slider->value());
+    if (_session.get_device()->dev_inst()->mode == DSO) {
+        _session.set_persistence_frames(_segment_slider->value());
+    } else if (_session.get_run_mode() == SigSession::Roll) {
+        _session.set_roll_window(_interval_slider->value());
+    } else {
+        _session.set_repeat_intvl(_interval_slider->value());
+        _session.set_segment_limit(_segment_slider->value());
+    }
     QDialog::accept();
 }
 
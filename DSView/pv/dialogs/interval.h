@@ -53,6 +53,10 @@ private:
     QSpinBox *_interval_spinBox;
     QSlider *_interval_slider;
 
+    QLabel *_segment_label;
+    QSpinBox *_segment_spinBox;
+    QSlider *_segment_slider;
+
     QDialogButtonBox _button_box;
 };
 
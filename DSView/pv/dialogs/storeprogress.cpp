@@ -122,6 +122,11 @@ void StoreProgress::on_progress_updated()
     int percent = p.first * 1.0 / p.second * 100;
     _progress.setValue(percent);
 
+    const double speed = _store_session.throughput();
+    if (speed > 0)
+        _info.setText(tr("Exporting...") + " " +
+                      QString::number(speed, 'f', 1) + " MB/s");
+
     const QString err = _store_session.error();
 	if (!err.isEmpty()) {
 		show_error();
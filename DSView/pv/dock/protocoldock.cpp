@@ -25,6 +25,7 @@
 #include "../device/devinst.h"
 #include "../data/decodermodel.h"
 #include "../data/decoderstack.h"
+#include "../data/decode/decoder.h"
 #include "../dialogs/protocollist.h"
 #include "../dialogs/protocolexp.h"
 #include "../dialogs/dsmessagebox.h"
@@ -494,12 +495,42 @@ void ProtocolDock::decoded_progress(int progress)
         else
             _progress_label_list.at(index)->setStyleSheet("color:red;");
         _progress_label_list.at(index)->setText(progress_str);
+        _progress_label_list.at(index)->setToolTip(decoder_stats(d->decoder()));
         index++;
     }
     if (pg == 0 || pg % 10 == 1)
         update_model();
 }
 
+QString ProtocolDock::decoder_stats(
+    const boost::shared_ptr<data::DecoderStack> &decoder_stack) const
+{
+    std::vector<srd_inst_stats> stats;
+    uint64_t decode_time;
+    decoder_stack->get_stats(stats, decode_time);
+
+    QStringList lines;
+    size_t level = 0;
+    BOOST_FOREACH(const boost::shared_ptr<data::decode::Decoder> &dec,
+                  decoder_stack->stack()) {
+        if (level >= stats.size())
+            break;
+        const srd_inst_stats &s = stats[level++];
+        // Samples per microsecond are megasamples per second
+        const double rate = decode_time ? (double)s.samples / decode_time : 0;
+        lines << dec->decoder()->name;
+        lines << tr("  Samples: %1 (%2 MSa/s), checked one by one: %3")
+                 .arg(s.samples).arg(rate, 0, 'f', 1).arg(s.match_iterations);
+        lines << tr("  wait(): %1, put(): %2 ann, %3 python, %4 binary, %5 meta")
+                 .arg(s.wait_returns).arg(s.puts[SRD_OUTPUT_ANN])
+                 .arg(s.puts[SRD_OUTPUT_PYTHON]).arg(s.puts[SRD_OUTPUT_BINARY])
+                 .arg(s.puts[SRD_OUTPUT_META]);
+        lines << tr("  Python (with GIL waits): %1 ms, hand-off: %2 ms")
+                 .arg(s.python_time / 1000).arg(s.handoff_time / 1000);
+    }
+    return lines.join("\n");
+}
+
 void ProtocolDock::set_model()
 {
     pv::dialogs::ProtocolList *protocollist_dlg = new pv::dialogs::ProtocolList(this, _session);
@@ -48,6 +48,7 @@ class SigSession;
 
 namespace data {
 class DecoderModel;
+class DecoderStack;
 }
 
 namespace view {
@@ -102,6 +103,8 @@ private slots:
 private:
     static int decoder_name_cmp(const void *a, const void *b);
     void resize_table_view(data::DecoderModel *decoder_model);
+    QString decoder_stats(
+        const boost::shared_ptr<data::DecoderStack> &decoder_stack) const;
 
 private:
     SigSession &_session;
@@ -156,6 +156,8 @@ void MainWindow::setup_ui()
             SLOT(on_save()));
     connect(_file_bar, SIGNAL(on_export()), this,
             SLOT(on_export()));
+    connect(_file_bar, SIGNAL(on_record()), this,
+            SLOT(on_record()));
     connect(_file_bar, SIGNAL(on_screenShot()), this,
             SLOT(on_screenShot()), Qt::QueuedConnection);
     connect(_file_bar, SIGNAL(load_session(QString)), this,
@@ -684,6 +686,12 @@ void MainWindow::show_error()
         title = tr("Data Overflow");
         details = tr("USB bandwidth can not support current sample rate! \nPlease reduce the sample rate!");
         break;
+    case SigSession::Record_err:
+        _session.set_repeating(false);
+        _session.stop_capture();
+        title = tr("Record Error");
+        details = _session.get_record_error();
+        break;
     default:
         title = tr("Undefined Error");
         details = tr("Not expected error!");
@@ -725,6 +733,8 @@ void MainWindow::capture_state_changed(int state)
     if (state == SigSession::Stopped) {
         prgRate(0);
         _view->repeat_unshow();
+        if (_session.recording())
+            record_end();
     }
 }
 
@@ -906,6 +916,66 @@ void MainWindow::on_export()
     dlg->export_run();
 }
 
+/*
+ * Starts a capture which is written to a file while it runs, for
+ * captures longer than the memory holds.
+ */
+void MainWindow::on_record()
+{
+    if (_session.get_device()->dev_inst()->mode != LOGIC) {
+        show_session_error(tr("Record"),
+                           tr("Recording is only available in logic analyzer mode."));
+        return;
+    }
+    if (_session.get_run_mode() == SigSession::Roll) {
+        show_session_error(tr("Record"),
+                           tr("Recording keeps the whole capture, it is not available in roll mode."));
+        return;
+    }
+
+    const QString DIR_KEY("SavePath");
+    QSettings settings(QApplication::organizationName(), QApplication::applicationName());
+    const QString default_name = settings.value(DIR_KEY).toString() + "/" +
+                                 _session.get_device()->name() + "-LA" +
+                                 QDateTime::currentDateTime().toString("-yyMMdd-hhmmss");
+    QString file_name = QFileDialog::getSaveFileName(
+                            this, tr("Record File"), default_name,
+                            tr("DSView Data (*.dsl)"));
+    if (file_name.isEmpty())
+        return;
+
+    QFileInfo f(file_name);
+    if(f.suffix().compare("dsl"))
+        file_name.append(tr(".dsl"));
+    QDir CurrentDir;
+    settings.setValue(DIR_KEY, CurrentDir.filePath(file_name));
+
+    _session.set_record_file(file_name);
+    run_stop();
+}
+
+// Completes the file of a recorded capture, with the current settings
+void MainWindow::record_end()
+{
+    QString session_file;
+    QDir dir;
+    #if QT_VERSION >= 0x050400
+    QString path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    #else
+    QString path = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
+    #endif
+    if(dir.mkpath(path)) {
+        dir.cd(path);
+
+        session_file = dir.absolutePath() + "/DSView-session-XXXXXX";
+        store_session(session_file);
+    }
+
+    QString error;
+    if (!_session.record_finish(session_file, error))
+        show_session_error(tr("Record Error"), error);
+}
+
 bool MainWindow::load_session(QString name)
 {
     QFile sessionFile(name);
@@ -82,6 +82,7 @@ private:
 	void setup_ui();
     void retranslateUi();
 	void session_error(const QString text, const QString info_text);
+    void record_end();
     bool eventFilter(QObject *object, QEvent *event);
 
 public slots:
@@ -132,6 +133,8 @@ private slots:
 
     void on_export();
 
+    void on_record();
+
     bool load_session(QString name);
     bool load_session_json(QJsonDocument json, bool file_dev);
     bool store_session(QString name);
@@ -0,0 +1,248 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "sessionstats.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTextStream>
+
+using namespace std;
+
+namespace pv {
+
+namespace {
+
+// The capture log is started over when it gets larger
+const qint64 MaxLogSize = 1024 * 1024;
+
+// Counts of b which came after a, the max is the top of the highest bucket
+sr_histogram hist_delta(const sr_histogram &a, const sr_histogram &b)
+{
+    sr_histogram d;
+    d.count = b.count - a.count;
+    d.sum = b.sum - a.sum;
+    d.max = 0;
+    for (int i = 0; i < SR_HISTOGRAM_BUCKETS; i++) {
+        d.buckets[i] = b.buckets[i] - a.buckets[i];
+        if (d.buckets[i] != 0)
+            d.max = (i == 0) ? 0 : (1ULL << i) - 1;
+    }
+    d.max = min(d.max, b.max);
+    return d;
+}
+
+QString hist_text(const sr_histogram &hist)
+{
+    if (hist.count == 0)
+        return "-";
+    return QString("%1/%2/%3us")
+        .arg(hist.sum / hist.count)
+        .arg(sr_histogram_percentile(&hist, 99))
+        .arg(hist.max);
+}
+
+QString rate_text(uint64_t bytes, double seconds)
+{
+    return QString::number(seconds > 0 ? bytes / seconds / (1024 * 1024) : 0, 'f', 1) + "MB/s";
+}
+
+}
+
+SessionStats::SessionStats()
+{
+    reset();
+}
+
+void SessionStats::reset()
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    memset(&_totals, 0, sizeof(_totals));
+    _history.clear();
+}
+
+void SessionStats::add(Stage stage, int64_t time)
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    sr_histogram_add(&_totals.stages[stage], max<int64_t>(time, 0));
+}
+
+void SessionStats::add_ingest_bytes(uint64_t bytes)
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    _totals.ingest_bytes += bytes;
+}
+
+void SessionStats::tick()
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    if (!_history.empty() &&
+        g_get_monotonic_time() - _history.back().time < TickInterval)
+        return;
+
+    _history.push_back(current());
+    while (_history.size() > (size_t)HistorySeconds + 1)
+        _history.pop_front();
+}
+
+SessionStats::Totals SessionStats::get_totals() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    return current();
+}
+
+SessionStats::Totals SessionStats::current() const
+{
+    Totals t = _totals;
+    t.time = g_get_monotonic_time();
+    if (sr_session_stats_get(&t.lib) != SR_OK)
+        memset(&t.lib, 0, sizeof(t.lib));
+    return t;
+}
+
+QString SessionStats::stage_name(Stage stage)
+{
+    switch (stage) {
+    case MutexWait: return "mutex wait";
+    case Ingest: return "ingest";
+    case Mipmap: return "mipmap";
+    case Paint: return "paint";
+    default: return "";
+    }
+}
+
+// One line with the rates and times between two totals,
+// times are avg/p99/max per packet
+QString SessionStats::describe(const Totals &from, const Totals &to)
+{
+    const double seconds = (to.time - from.time) / 1000000.0;
+
+    QString line = QString("usb %1 %2 transfers, gap %3, %4x%5us in flight, backlog %6")
+        .arg(rate_text(to.lib.usb_bytes - from.lib.usb_bytes, seconds))
+        .arg(to.lib.usb_transfers - from.lib.usb_transfers)
+        .arg(hist_text(hist_delta(from.lib.usb_interval, to.lib.usb_interval)))
+        .arg(to.lib.transfer_count)
+        .arg(to.lib.transfer_time)
+        .arg(to.lib.ingest_backlog);
+    line += QString(" | feed %1 %2 packets, %3")
+        .arg(rate_text(to.lib.bytes - from.lib.bytes, seconds))
+        .arg(to.lib.packets - from.lib.packets)
+        .arg(hist_text(hist_delta(from.lib.callback_time, to.lib.callback_time)));
+    line += QString(" | ingest %1").arg(rate_text(to.ingest_bytes - from.ingest_bytes, seconds));
+    for (int i = 0; i < StageCount; i++)
+        line += QString(" | %1 %2").arg(stage_name((Stage)i))
+            .arg(hist_text(hist_delta(from.stages[i], to.stages[i])));
+    if (to.lib.overflows != from.lib.overflows)
+        line += QString(" | %1 overflows").arg(to.lib.overflows - from.lib.overflows);
+
+    return line;
+}
+
+QStringList SessionStats::summary() const
+{
+    const Totals t = get_totals();
+    const double seconds = t.lib.start_time ?
+        (t.time - t.lib.start_time) / 1000000.0 : 0;
+    QStringList lines;
+
+    lines << QString("USB: %1 transfers, %2 average, gap %3, backlog peak %4")
+        .arg(t.lib.usb_transfers)
+        .arg(rate_text(t.lib.usb_bytes, seconds))
+        .arg(hist_text(t.lib.usb_interval))
+        .arg(t.lib.ingest_backlog_max);
+    lines << QString("Feed: %1 packets, %2 average, %3")
+        .arg(t.lib.packets)
+        .arg(rate_text(t.lib.bytes, seconds))
+        .arg(hist_text(t.lib.callback_time));
+    lines << QString("Ingest: %1 average").arg(rate_text(t.ingest_bytes, seconds));
+    for (int i = 0; i < StageCount; i++)
+        lines << QString("%1: %2 times, %3").arg(stage_name((Stage)i))
+            .arg(t.stages[i].count)
+            .arg(hist_text(t.stages[i]));
+    lines << QString("Overflows: %1").arg(t.lib.overflows);
+
+    return lines;
+}
+
+QStringList SessionStats::history() const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    QStringList lines;
+
+    if (_history.empty())
+        return lines;
+
+    const Totals now = current();
+    for (size_t i = 0; i < _history.size(); i++) {
+        const Totals &to = (i + 1 < _history.size()) ? _history[i + 1] : now;
+        lines << QString("%1s: ").arg((_history[i].time - now.time) / 1000000.0, 0, 'f', 1) +
+                 describe(_history[i], to);
+    }
+
+    return lines;
+}
+
+QStringList SessionStats::report(const QString &reason) const
+{
+    QStringList lines;
+    lines << QString("%1: capture failed, %2")
+        .arg(QDateTime::currentDateTime().toString(Qt::ISODate))
+        .arg(reason);
+    lines << summary();
+    lines << history();
+    return lines;
+}
+
+void SessionStats::write_log(const QStringList &lines)
+{
+    BOOST_FOREACH(const QString &line, lines)
+        qDebug("%s", qPrintable(line));
+
+    #if QT_VERSION >= 0x050400
+    QDir dir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    #else
+    QDir dir(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+    #endif
+    if (!dir.exists() && !dir.mkpath("."))
+        return;
+
+    QFile file(dir.absoluteFilePath("capture.log"));
+    QIODevice::OpenMode mode = QIODevice::WriteOnly | QIODevice::Text;
+    if (file.size() < MaxLogSize)
+        mode |= QIODevice::Append;
+    if (!file.open(mode))
+        return;
+
+    QTextStream out(&file);
+    BOOST_FOREACH(const QString &line, lines)
+        out << line << "\n";
+    out << "\n";
+}
+
+} // namespace pv
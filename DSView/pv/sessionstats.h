@@ -0,0 +1,102 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef DSVIEW_PV_SESSIONSTATS_H
+#define DSVIEW_PV_SESSIONSTATS_H
+
+#include <stdint.h>
+#include <deque>
+
+#include <boost/thread.hpp>
+
+#include <QString>
+#include <QStringList>
+
+#include <libsigrok4DSL/libsigrok.h>
+
+namespace pv {
+
+// Counters of the acquisition pipeline, from the USB transfers in
+// libsigrok to the painting of the view. The totals are kept once a
+// second for the last HistorySeconds, so a failed capture can be
+// explained after the fact.
+class SessionStats
+{
+public:
+    static const int HistorySeconds = 10;
+    static const int64_t TickInterval = 1000000;
+
+    enum Stage {
+        MutexWait = 0,  // data_feed_in() waiting for the data mutex
+        Ingest,         // Appending a packet to the snapshot
+        Mipmap,         // Building the mipmap of the appended data
+        Paint,          // Painting a viewport
+        StageCount
+    };
+
+    struct Totals {
+        int64_t time;
+        sr_session_stats lib;
+        uint64_t ingest_bytes;
+        sr_histogram stages[StageCount];
+    };
+
+public:
+    SessionStats();
+
+    // Clears the counters for a new capture
+    void reset();
+
+    void add(Stage stage, int64_t time);
+    void add_ingest_bytes(uint64_t bytes);
+
+    // Called for each packet, keeps the totals once a second
+    void tick();
+
+    Totals get_totals() const;
+
+    // Rates and times since the start of the capture
+    QStringList summary() const;
+    // Rates and times of each second in the history
+    QStringList history() const;
+
+    // The summary and history of a failed capture
+    QStringList report(const QString &reason) const;
+    // Writes a report to the debug output and the capture log, done
+    // without the data lock of the session held
+    static void write_log(const QStringList &lines);
+
+    static QString stage_name(Stage stage);
+
+private:
+    Totals current() const;
+    static QString describe(const Totals &from, const Totals &to);
+
+private:
+    mutable boost::mutex _mutex;
+    Totals _totals;
+    std::deque<Totals> _history;
+};
+
+} // namespace pv
+
+#endif // DSVIEW_PV_SESSIONSTATS_H
@@ -27,6 +27,7 @@
 #include "sigsession.h"
 #include "mainwindow.h"
 #include "devicemanager.h"
+#include "storesession.h"
 #include "device/device.h"
 #include "device/file.h"
 
@@ -97,6 +98,10 @@ SigSession::SigSession(DeviceManager &device_manager) :
     _repeat_intvl(1),
     _repeating(false),
     _repeat_hold_prg(0),
+    _segment_limit(1),
+    _cur_segment(-1),
+    _persistence_frames(1),
+    _roll_window(10),
     _map_zoom(0)
 {
 	// TODO: This should not be necessary
@@ -107,6 +112,7 @@ SigSession::SigSession(DeviceManager &device_manager) :
 	register_hotplug_callback();
     _feed_timer.stop();
     _noData_cnt = 0;
+    _meta_sample_limit = 0;
     _data_lock = false;
     _data_updated = false;
     #ifdef ENABLE_DECODE
@@ -351,9 +357,14 @@ void SigSession::capture_init()
 
     set_cur_snap_samplerate(_dev_inst->get_sample_rate());
     set_cur_samplelimits(_dev_inst->get_sample_limit());
+    // the views span what a roll keeps
+    if (rolling())
+        set_cur_samplelimits(min(_cur_samplelimits,
+            data::LogicSnapshot::get_ring_capacity(roll_samples())));
     _data_updated = false;
     _trigger_flag = false;
     _hw_replied = false;
+    _stats.reset();
     if (_dev_inst->dev_inst()->mode != LOGIC)
         _feed_timer.start(FeedInterval);
     else
@@ -362,6 +373,9 @@ void SigSession::capture_init()
     _noData_cnt = 0;
     data_unlock();
 
+    // segmented memory
+    segment_init();
+
     // container init
     container_init();
 
@@ -473,6 +487,21 @@ void SigSession::start_capture(bool instant,
 		return;
 	}
 
+    // Write this capture to disk while it runs
+    if (!_record_file.isEmpty() && _dev_inst->dev_inst()->mode == LOGIC) {
+        _recorder.reset(new StoreSession(*this));
+        if (!_recorder->record_start(_record_file, _cur_logic_snapshot)) {
+            error_handler(_recorder->error());
+            _recorder.reset();
+            _record_file.clear();
+            set_repeating(false);
+            capture_state_changed(SigSession::Stopped);
+            return;
+        }
+        set_repeating(false);
+    }
+    _record_file.clear();
+
 	// Begin the session
 	_sampling_thread.reset(new boost::thread(
         &SigSession::sample_thread_proc, this, _dev_inst,
@@ -692,6 +721,7 @@ void SigSession::init_signals()
     unsigned int dso_probe_count = 0;
     unsigned int analog_probe_count = 0;
 
+    clear_segments();
     if (_logic_data)
         _logic_data->clear();
     if (_dso_data)
@@ -922,6 +952,7 @@ void SigSession::feed_in_header(const sr_dev_inst *sdi)
 {
     (void)sdi;
     _trigger_pos = 0;
+    _meta_sample_limit = 0;
     receive_header();
 }
 
@@ -937,6 +968,10 @@ void SigSession::feed_in_meta(const sr_dev_inst *sdi,
 			/// @todo handle samplerate changes
 			/// samplerate = (uint64_t *)src->value;
 			break;
+		case SR_CONF_LIMIT_SAMPLES:
+			// sources without a device config, such as file inputs
+			_meta_sample_limit = g_variant_get_uint64(src->data);
+			break;
 		default:
 			// Unknown metadata is not an error.
 			break;
@@ -951,6 +986,7 @@ void SigSession::feed_in_trigger(const ds_trigger_pos &trigger_pos)
         _trigger_flag = (trigger_pos.status & 0x01);
         if (_trigger_flag) {
             _trigger_pos = trigger_pos.real_pos;
+            _trigger_time = QDateTime::currentDateTime();
             receive_trigger(_trigger_pos);
         }
     } else {
@@ -984,8 +1020,12 @@ void SigSession::feed_in_logic(const sr_datafeed_logic &logic)
         session_error();
     }
 
+    const uint64_t mipmap_time = _cur_logic_snapshot->get_mipmap_time();
+    uint64_t roll_offset = 0;
     if (_cur_logic_snapshot->last_ended()) {
-        _cur_logic_snapshot->first_payload(logic, _dev_inst->get_sample_limit(), _dev_inst->dev_inst()->channels);
+        _cur_logic_snapshot->first_payload(logic,
+            rolling() ? roll_samples() : _dev_inst->get_sample_limit(),
+            _dev_inst->dev_inst()->channels, rolling());
         // @todo Putting this here means that only listeners querying
         // for logic will be notified. Currently the only user of
         // frame_began is DecoderStack, but in future we need to signal
@@ -993,8 +1033,11 @@ void SigSession::feed_in_logic(const sr_datafeed_logic &logic)
         frame_began();
     } else {
 		// Append to the existing data snapshot
+        roll_offset = _cur_logic_snapshot->get_ring_offset();
         _cur_logic_snapshot->append_payload(logic);
     }
+    _stats.add(SessionStats::Mipmap, _cur_logic_snapshot->get_mipmap_time() - mipmap_time);
+    _stats.add_ingest_bytes(logic.length);
 
     if (_cur_logic_snapshot->memory_failed()) {
         _error = Malloc_err;
@@ -1002,12 +1045,66 @@ void SigSession::feed_in_logic(const sr_datafeed_logic &logic)
         return;
     }
 
+    record_data();
+    roll_trigger(roll_offset);
+
     emit receive_data(logic.length * 8 / get_ch_num(SR_CHANNEL_LOGIC));
     data_received();
     //data_updated();
     _data_updated = true;
 }
 
+void SigSession::feed_in_logic_edge(const sr_datafeed_logic_edge &edge)
+{
+    if (!_logic_data || _cur_logic_snapshot->memory_failed()) {
+        qDebug() << "Unexpected logic edge packet";
+        return;
+    }
+
+    const uint64_t pre_count = _cur_logic_snapshot->get_sample_count();
+    uint64_t roll_offset = 0;
+    if (_cur_logic_snapshot->last_ended()) {
+        const uint64_t sample_limit = _meta_sample_limit ?
+            _meta_sample_limit : _dev_inst->get_sample_limit();
+        _cur_logic_snapshot->first_edges(edge, rolling() ? roll_samples() : sample_limit,
+            _dev_inst->dev_inst()->channels, rolling());
+        frame_began();
+    } else {
+        roll_offset = _cur_logic_snapshot->get_ring_offset();
+        _cur_logic_snapshot->append_edges(edge);
+    }
+
+    if (_cur_logic_snapshot->memory_failed()) {
+        _error = Malloc_err;
+        session_error();
+        return;
+    }
+
+    record_data();
+    roll_trigger(roll_offset);
+
+    // a roll drops its oldest samples, the count can go down
+    const uint64_t count = _cur_logic_snapshot->get_sample_count();
+    emit receive_data(count > pre_count ? count - pre_count : 0);
+    data_received();
+    _data_updated = true;
+}
+
+/*
+ * The trigger position is kept in the window of a roll. It moves with
+ * its sample as the window rolls on, and stays at the start of the
+ * window once the sample has been dropped.
+ */
+void SigSession::roll_trigger(uint64_t pre_offset)
+{
+    const uint64_t offset = _cur_logic_snapshot->get_ring_offset();
+    if (!_trigger_flag || offset == pre_offset)
+        return;
+
+    _trigger_pos -= min(_trigger_pos, offset - pre_offset);
+    receive_trigger(_trigger_pos);
+}
+
 void SigSession::feed_in_dso(const sr_datafeed_dso &dso)
 {
     //boost::lock_guard<boost::mutex> lock(_data_mutex);
@@ -1122,16 +1219,31 @@ void SigSession::feed_in_analog(const sr_datafeed_analog &analog)
 
 void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
     const struct sr_datafeed_packet *packet)
+{
+    QStringList stats_report;
+    feed_in_packet(sdi, packet, stats_report);
+    if (!stats_report.isEmpty())
+        SessionStats::write_log(stats_report);
+}
+
+void SigSession::feed_in_packet(const struct sr_dev_inst *sdi,
+    const struct sr_datafeed_packet *packet, QStringList &stats_report)
 {
 	assert(sdi);
 	assert(packet);
 
+    const int64_t wait_start = g_get_monotonic_time();
     boost::lock_guard<boost::mutex> lock(_data_mutex);
+    const int64_t start = g_get_monotonic_time();
+    _stats.add(SessionStats::MutexWait, start - wait_start);
+    _stats.tick();
 
     if (_data_lock && packet->type != SR_DF_END)
         return;
     if (packet->type != SR_DF_END &&
         packet->status != SR_PKT_OK) {
+        if (_error != Pkt_data_err)
+            stats_report = _stats.report("packet data error");
         _error = Pkt_data_err;
         session_error();
         return;
@@ -1156,22 +1268,32 @@ void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
 	case SR_DF_LOGIC:
 		assert(packet->payload);
         feed_in_logic(*(const sr_datafeed_logic*)packet->payload);
+        _stats.add(SessionStats::Ingest, g_get_monotonic_time() - start);
 		break;
 
+    case SR_DF_LOGIC_EDGE:
+        assert(packet->payload);
+        feed_in_logic_edge(*(const sr_datafeed_logic_edge*)packet->payload);
+        _stats.add(SessionStats::Ingest, g_get_monotonic_time() - start);
+        break;
+
     case SR_DF_DSO:
         assert(packet->payload);
         feed_in_dso(*(const sr_datafeed_dso*)packet->payload);
+        _stats.add(SessionStats::Ingest, g_get_monotonic_time() - start);
         break;
 
 	case SR_DF_ANALOG:
 		assert(packet->payload);
         feed_in_analog(*(const sr_datafeed_analog*)packet->payload);
+        _stats.add(SessionStats::Ingest, g_get_monotonic_time() - start);
 		break;
 
     case SR_DF_OVERFLOW:
     {
         if (_error == No_err) {
             _error = Data_overflow;
+            stats_report = _stats.report("data overflow");
             session_error();
         }
         break;
@@ -1180,17 +1302,8 @@ void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
 	{
 		{
             //boost::lock_guard<boost::mutex> lock(_data_mutex);
-            if (!_cur_logic_snapshot->empty()) {
-                BOOST_FOREACH(const boost::shared_ptr<view::GroupSignal> g, _group_traces)
-                {
-                    assert(g);
-
-                    _cur_group_snapshot = boost::shared_ptr<data::GroupSnapshot>(
-                                new data::GroupSnapshot(_logic_data->get_snapshots().front(), g->get_index_list()));
-                    _group_data->push_snapshot(_cur_group_snapshot);
-                    _cur_group_snapshot.reset();
-                }
-            }
+            if (!_cur_logic_snapshot->empty())
+                update_group_snapshots();
             _cur_logic_snapshot->capture_ended();
             _cur_dso_snapshot->capture_ended();
             _cur_analog_snapshot->capture_ended();
@@ -1201,9 +1314,12 @@ void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
 		}
 
         if (packet->status != SR_PKT_OK) {
+            if (_error != Pkt_data_err)
+                stats_report = _stats.report("packet data error at the end");
             _error = Pkt_data_err;
             session_error();
         }
+        segment_archive();
         frame_ended();
         if (get_device()->dev_inst()->mode != LOGIC)
             set_session_time(QDateTime::currentDateTime());
@@ -1640,6 +1756,11 @@ uint64_t SigSession::get_error_pattern() const
     return _error_pattern;
 }
 
+SessionStats& SigSession::get_stats()
+{
+    return _stats;
+}
+
 SigSession::run_mode SigSession::get_run_mode() const
 {
     return _run_mode;
@@ -1710,6 +1831,175 @@ int SigSession::get_repeat_hold() const
         return 0;
 }
 
+int SigSession::get_segment_limit() const
+{
+    return _segment_limit;
+}
+
+void SigSession::set_segment_limit(int limit)
+{
+    _segment_limit = max(1, min(limit, (int)MaxSegments));
+}
+
+int SigSession::get_persistence_frames() const
+{
+    return _persistence_frames;
+}
+
+void SigSession::set_persistence_frames(int frames)
+{
+    _persistence_frames = max(1, min(frames, (int)MaxPersistenceFrames));
+    // the frames before the current one are kept by the snapshot
+    _cur_dso_snapshot->set_history_depth(_persistence_frames - 1);
+}
+
+bool SigSession::segmented() const
+{
+    return _segment_limit > 1 &&
+           get_run_mode() == Repetitive &&
+           !_instant &&
+           _dev_inst && _dev_inst->dev_inst()->mode == LOGIC;
+}
+
+int SigSession::get_roll_window() const
+{
+    return _roll_window;
+}
+
+void SigSession::set_roll_window(int window)
+{
+    _roll_window = max(1, min(window, (int)MaxRollWindow));
+}
+
+/*
+ * A logic capture in roll mode runs to its sample limit, or until it
+ * is stopped, and only keeps about the last roll window of it.
+ */
+bool SigSession::rolling() const
+{
+    return get_run_mode() == Roll &&
+           !_instant &&
+           _dev_inst && _dev_inst->dev_inst()->mode == LOGIC;
+}
+
+uint64_t SigSession::roll_samples() const
+{
+    return min(_dev_inst->get_sample_limit(),
+               (uint64_t)_roll_window * _dev_inst->get_sample_rate());
+}
+
+int SigSession::get_segment_num() const
+{
+    return _segments.size();
+}
+
+int SigSession::get_cur_segment() const
+{
+    return _cur_segment;
+}
+
+void SigSession::segment_init()
+{
+    if (!segmented()) {
+        clear_segments();
+        return;
+    }
+
+    boost::shared_ptr<data::LogicSnapshot> oldest;
+    while ((int)_segments.size() >= _segment_limit) {
+        oldest = _segments.front().snapshot;
+        _segments.pop_front();
+    }
+
+    // The last capture stays in its segment, the next one goes to a
+    // new snapshot or reuses the memory of the oldest segment
+    BOOST_FOREACH(const Segment &s, _segments) {
+        if (s.snapshot == _cur_logic_snapshot) {
+            if (!oldest)
+                oldest.reset(new data::LogicSnapshot());
+            set_logic_snapshot(oldest);
+            break;
+        }
+    }
+
+    _cur_segment = -1;
+    segments_changed();
+}
+
+void SigSession::segment_archive()
+{
+    if (!segmented() || _cur_logic_snapshot->empty())
+        return;
+
+    Segment s;
+    s.snapshot = _cur_logic_snapshot;
+    s.trigger_pos = _trigger_pos;
+    s.samplerate = _cur_snap_samplerate;
+    s.samplelimits = _cur_samplelimits;
+    s.time = _trigger_flag ? _trigger_time : QDateTime::currentDateTime();
+    _segments.push_back(s);
+    _cur_segment = _segments.size() - 1;
+    segments_changed();
+}
+
+void SigSession::clear_segments()
+{
+    if (_segments.empty())
+        return;
+
+    // only the snapshot shown is left
+    _segments.clear();
+    _cur_segment = -1;
+    segments_changed();
+}
+
+void SigSession::set_logic_snapshot(boost::shared_ptr<data::LogicSnapshot> snapshot)
+{
+    _cur_logic_snapshot = snapshot;
+    _logic_data->get_snapshots().front() = snapshot;
+}
+
+bool SigSession::select_segment(int index)
+{
+    if (get_capture_state() == Running ||
+        index < 0 || index >= (int)_segments.size())
+        return false;
+    if (index == _cur_segment)
+        return true;
+
+    const Segment &s = _segments[index];
+    set_logic_snapshot(s.snapshot);
+    set_cur_snap_samplerate(s.samplerate);
+    set_cur_samplelimits(s.samplelimits);
+    set_session_time(s.time);
+    _trigger_pos = s.trigger_pos;
+    _cur_segment = index;
+
+    update_group_snapshots();
+#ifdef ENABLE_DECODE
+    BOOST_FOREACH(const boost::shared_ptr<view::DecodeTrace> d, _decode_traces)
+        d->frame_ended();
+#endif
+    segments_changed();
+    receive_trigger(_trigger_pos);
+    frame_ended();
+    data_updated();
+    return true;
+}
+
+void SigSession::update_group_snapshots()
+{
+    BOOST_FOREACH(const boost::shared_ptr<view::GroupSignal> g, _group_traces)
+    {
+        assert(g);
+
+        _cur_group_snapshot = boost::shared_ptr<data::GroupSnapshot>(
+                    new data::GroupSnapshot(_logic_data->get_snapshots().front(), g->get_index_list()));
+        _group_data->push_snapshot(_cur_group_snapshot);
+        _cur_group_snapshot.reset();
+    }
+}
+
 void SigSession::set_map_zoom(int index)
 {
     _map_zoom = index;
@@ -1760,4 +2050,48 @@ void SigSession::set_saving(bool saving)
     _saving = saving;
 }
 
+/*
+ * The next capture is written to file_name as it comes in, only its
+ * end stays in memory. For logic captures.
+ */
+void SigSession::set_record_file(QString file_name)
+{
+    _record_file = file_name;
+}
+
+bool SigSession::recording() const
+{
+    return _recorder.get() != NULL;
+}
+
+QString SigSession::get_record_error() const
+{
+    return _recorder ? _recorder->error() : QString();
+}
+
+// Passes the blocks filled up to the recorder
+void SigSession::record_data()
+{
+    if (_recorder && !_recorder->record_data(false)) {
+        _error = Record_err;
+        session_error();
+    }
+}
+
+/*
+ * Completes the record file once the capture has stopped, with the
+ * settings in session_file.
+ */
+bool SigSession::record_finish(QString session_file, QString &error)
+{
+    if (!_recorder)
+        return true;
+
+    const bool ok = _recorder->record_finish(session_file);
+    if (!ok)
+        error = _recorder->error();
+    _recorder.reset();
+    return ok;
+}
+
 } // namespace pv
@@ -30,6 +30,7 @@
 
 #include <string>
 #include <utility>
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
@@ -51,6 +52,7 @@
 
 #include "view/mathtrace.h"
 #include "data/mathstack.h"
+#include "sessionstats.h"
 
 struct srd_decoder;
 struct srd_channel;
@@ -58,6 +60,7 @@ struct srd_channel;
 namespace pv {
 
 class DeviceManager;
+class StoreSession;
 
 namespace data {
 class SignalData;
@@ -104,6 +107,9 @@ private:
 public:
     static const int FeedInterval = 50;
     static const int WaitShowTime = 500;
+    static const int MaxSegments = 32;
+    static const int MaxPersistenceFrames = 32;
+    static const int MaxRollWindow = 3600;
 
 public:
 	enum capture_state {
@@ -114,7 +120,8 @@ public:
 
     enum run_mode {
         Single,
-        Repetitive
+        Repetitive,
+        Roll
     };
 
     enum error_state {
@@ -124,7 +131,17 @@ public:
         Test_data_err,
         Test_timeout_err,
         Pkt_data_err,
-        Data_overflow
+        Data_overflow,
+        Record_err
+    };
+
+    // A capture kept in segmented memory
+    struct Segment {
+        boost::shared_ptr<data::LogicSnapshot> snapshot;
+        uint64_t trigger_pos;
+        uint64_t samplerate;
+        uint64_t samplelimits;
+        QDateTime time;
     };
 
 public:
@@ -238,6 +255,7 @@ public:
     void set_error(error_state state);
     void clear_error();
     uint64_t get_error_pattern() const;
+    SessionStats& get_stats();
 
     run_mode get_run_mode() const;
     void set_run_mode(run_mode mode);
@@ -247,6 +265,25 @@ public:
     bool repeat_check();
     int get_repeat_hold() const;
 
+    int get_segment_limit() const;
+    void set_segment_limit(int limit);
+    int get_persistence_frames() const;
+    void set_persistence_frames(int frames);
+    bool segmented() const;
+    int get_segment_num() const;
+    int get_cur_segment() const;
+    bool select_segment(int index);
+
+    int get_roll_window() const;
+    void set_roll_window(int window);
+    bool rolling() const;
+    uint64_t roll_samples() const;
+
+    void set_record_file(QString file_name);
+    bool recording() const;
+    QString get_record_error() const;
+    bool record_finish(QString session_file, QString &error);
+
     int get_map_zoom() const;
 
     void set_save_start(uint64_t start);
@@ -259,6 +296,13 @@ public:
 private:
 	void set_capture_state(capture_state state);
 
+    void segment_init();
+    void segment_archive();
+    void clear_segments();
+    void set_logic_snapshot(boost::shared_ptr<data::LogicSnapshot> snapshot);
+    void update_group_snapshots();
+    void record_data();
+
 private:
     /**
      * Attempts to autodetect the format. Failing that
@@ -283,11 +327,17 @@ private:
 	void feed_in_meta(const sr_dev_inst *sdi,
 		const sr_datafeed_meta &meta);
     void feed_in_trigger(const ds_trigger_pos &trigger_pos);
+    void roll_trigger(uint64_t pre_offset);
 	void feed_in_logic(const sr_datafeed_logic &logic);
+    void feed_in_logic_edge(const sr_datafeed_logic_edge &edge);
     void feed_in_dso(const sr_datafeed_dso &dso);
 	void feed_in_analog(const sr_datafeed_analog &analog);
 	void data_feed_in(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+    // Handles a packet under _data_mutex, the capture statistics of
+    // an error go to stats_report, to be written after the unlock
+    void feed_in_packet(const struct sr_dev_inst *sdi,
+        const struct sr_datafeed_packet *packet, QStringList &stats_report);
 	static void data_feed_in_proc(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet, void *cb_data);
 
@@ -347,17 +397,34 @@ private:
 
     QDateTime _session_time;
     uint64_t _trigger_pos;
+    uint64_t _meta_sample_limit;
     bool _trigger_flag;
     bool _hw_replied;
 
     error_state _error;
     uint64_t _error_pattern;
+    SessionStats _stats;
 
     run_mode _run_mode;
     int _repeat_intvl;
     bool _repeating;
     int _repeat_hold_prg;
 
+    // oldest first
+    std::deque<Segment> _segments;
+    int _segment_limit;
+    int _cur_segment;
+    // oscilloscope frames overlaid, the current one included
+    int _persistence_frames;
+    QDateTime _trigger_time;
+
+    // seconds kept by a logic capture in roll mode
+    int _roll_window;
+
+    // next capture goes to this file as it comes in
+    QString _record_file;
+    boost::shared_ptr<StoreSession> _recorder;
+
     int _map_zoom;
 
     uint64_t _save_start;
@@ -408,6 +475,8 @@ signals:
     void repeat_hold(int percent);
     void repeat_resume();
 
+    void segments_changed();
+
     void cur_snap_samplerate_changed();
 
     void update_capture();
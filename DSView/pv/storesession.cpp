@@ -27,6 +27,7 @@
 #include <pv/sigsession.h>
 #include <pv/data/logic.h>
 #include <pv/data/logicsnapshot.h>
+#include <pv/data/logicexport.h>
 #include <pv/data/dsosnapshot.h>
 #include <pv/data/analogsnapshot.h>
 #include <pv/data/decoderstack.h>
@@ -39,11 +40,15 @@
 #include <pv/view/decodetrace.h>
 #include <pv/device/devinst.h>
 #include <pv/dock/protocoldock.h>
+#include <pv/dialogs/dsmessagebox.h>
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
 #include <QApplication>
 #include <QFileDialog>
+#include <QTextStream>
+#include <QPushButton>
 
 using boost::dynamic_pointer_cast;
 using boost::mutex;
@@ -52,6 +57,7 @@ using boost::thread;
 using boost::lock_guard;
 using std::deque;
 using std::make_pair;
+using std::max;
 using std::min;
 using std::pair;
 using std::set;
@@ -65,14 +71,20 @@ StoreSession::StoreSession(SigSession &session) :
     _outModule(NULL),
 	_units_stored(0),
     _unit_count(0),
+    _bytes_written(0),
     _has_error(false),
-    _canceled(false)
+    _canceled(false),
+    _rle(true),
+    _writer(NULL),
+    _record_blocks(0)
 {
 }
 
 StoreSession::~StoreSession()
 {
 	wait();
+    if (_writer)
+        sr_session_writer_free(_writer);
 }
 
 SigSession& StoreSession::session()
@@ -86,6 +98,17 @@ pair<uint64_t, uint64_t> StoreSession::progress() const
 	return make_pair(_units_stored, _unit_count);
 }
 
+/*
+ * Output bytes per second of the running export, in MB/s.
+ */
+double StoreSession::throughput() const
+{
+    const qint64 elapsed = _timer.isValid() ? _timer.elapsed() : 0;
+    if (elapsed <= 0)
+        return 0;
+    return _bytes_written / (elapsed * 1000.0);
+}
+
 const QString& StoreSession::error() const
 {
     //lock_guard<mutex> lock(_mutex);
@@ -316,6 +339,123 @@ void StoreSession::save_proc(shared_ptr<data::Snapshot> snapshot)
         QFile::remove(_file_name);
 }
 
+/*
+ * Writes a logic capture to file_name while it is running. The blocks
+ * of the snapshot go to the file as they fill up, only the last
+ * RecordWindowBlocks of them are kept in memory.
+ */
+bool StoreSession::record_start(QString file_name,
+                                shared_ptr<data::LogicSnapshot> snapshot)
+{
+    assert(snapshot);
+
+    _file_name = file_name;
+    _record_snapshot = snapshot;
+    _record_blocks = 0;
+    _units_stored = 0;
+    _has_error = false;
+    _error.clear();
+    _timer.start();
+
+    // leave a core to the sampling thread
+    const int threads = max(1, (int)boost::thread::hardware_concurrency() - 1);
+    if (sr_session_writer_new(_file_name.toLocal8Bit().data(),
+                              threads, &_writer) != SR_OK) {
+        _writer = NULL;
+        _error = tr("Failed to create zip file. Please check write permission of this path.");
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Hands the blocks filled up since the last call to the writer, or all
+ * of them at the end. Called by the sampling thread, which waits here
+ * when the disk falls behind. After a failure the file is dropped and
+ * the calls do nothing.
+ */
+bool StoreSession::record_data(bool all)
+{
+    if (!_writer)
+        return true;
+
+    const shared_ptr<data::LogicSnapshot> &snapshot = _record_snapshot;
+    const int num = all ? snapshot->get_block_num() :
+                          snapshot->get_full_block_num();
+    vector<uint8_t> fill;
+    bool sample;
+
+    for (; _record_blocks < num; _record_blocks++) {
+        const uint64_t size = snapshot->get_block_size(_record_blocks);
+        BOOST_FOREACH(const boost::shared_ptr<view::Signal> s, _session.get_signals()) {
+            const int ch_index = s->get_index();
+            if (s->get_type() != SR_CHANNEL_LOGIC || !s->enabled() ||
+                !snapshot->has_data(ch_index))
+                continue;
+
+            const uint8_t *buf = snapshot->get_block_buf(_record_blocks, ch_index, sample);
+            if (buf == NULL) {
+                fill.assign(size, sample ? 0xff : 0x0);
+                buf = fill.data();
+            }
+            if (sr_session_writer_append(_writer, buf, size, _record_blocks,
+                                         ch_index, SR_CHANNEL_LOGIC) != SR_OK) {
+                _has_error = true;
+                _error = tr("Failed to write the record file. Please check the free space of this path.");
+                sr_session_writer_free(_writer);
+                _writer = NULL;
+                return false;
+            }
+            _units_stored += size;
+        }
+    }
+
+    if (!all && _record_blocks > RecordWindowBlocks)
+        snapshot->release_blocks(_record_blocks - RecordWindowBlocks);
+    return true;
+}
+
+/*
+ * Writes the rest of the capture and the header once it has stopped.
+ * A failure during the capture has been reported by record_data()
+ * already, nothing is left to do then.
+ */
+bool StoreSession::record_finish(QString session_file)
+{
+    if (!_writer)
+        return true;
+
+    if (record_data(true)) {
+        const QString meta_file = meta_gen(_record_snapshot);
+    #ifdef ENABLE_DECODE
+        const QString decoders_file = decoders_gen();
+    #else
+        const QString decoders_file;
+    #endif
+        if (meta_file == NULL) {
+            _has_error = true;
+            _error = tr("Generate temp file failed.");
+        } else {
+            const QByteArray meta = meta_file.toLocal8Bit();
+            const QByteArray decoders = decoders_file.toLocal8Bit();
+            const QByteArray session = session_file.toLocal8Bit();
+            if (sr_session_writer_finish(_writer, meta.data(),
+                    decoders_file.isEmpty() ? NULL : decoders.data(),
+                    session_file.isEmpty() ? NULL : session.data()) != SR_OK) {
+                _has_error = true;
+                _error = tr("Failed to create zip file. Please check write permission of this path.");
+            }
+        }
+    }
+
+    if (_writer) {
+        sr_session_writer_free(_writer);
+        _writer = NULL;
+    }
+    _record_snapshot.reset();
+    return !_has_error;
+}
+
 QString StoreSession::meta_gen(boost::shared_ptr<data::Snapshot> snapshot)
 {
     GSList *l;
@@ -582,6 +722,25 @@ bool StoreSession::export_start()
         if(_outModule == NULL) {
             _error = tr("Invalid export format.");
         } else {
+            if (*type_set.begin() == SR_CHANNEL_LOGIC &&
+                !strcmp(_outModule->id, "csv")) {
+                const QString RLE_KEY("ExportCsvRle");
+                _rle = settings.value(RLE_KEY, true).toBool();
+                dialogs::DSMessageBox msg(NULL);
+                msg.mBox()->setText(tr("Export CSV"));
+                msg.mBox()->setInformativeText(tr("Write a row only where a channel changes, "
+                                                  "or one row for every sample?"));
+                QPushButton *changesButton = msg.mBox()->addButton(tr("Changes Only"), QMessageBox::AcceptRole);
+                QPushButton *allButton = msg.mBox()->addButton(tr("All Samples"), QMessageBox::AcceptRole);
+                msg.mBox()->setDefaultButton(_rle ? changesButton : allButton);
+                msg.mBox()->setIcon(QMessageBox::Question);
+                msg.exec();
+                _rle = (msg.mBox()->clickedButton() != allButton);
+                settings.setValue(RLE_KEY, _rle);
+            }
+
+            _bytes_written = 0;
+            _timer.start();
             _thread = boost::thread(&StoreSession::export_proc, this, snapshot);
             return !_has_error;
         }
@@ -617,6 +776,8 @@ void StoreSession::export_proc(shared_ptr<data::Snapshot> snapshot)
     g_hash_table_insert(params, (char*)"filename", filenameGVariant);
     GVariant* typeGVariant = g_variant_new_int16(channel_type);
     g_hash_table_insert(params, (char*)"type", typeGVariant);
+    GVariant* rleGVariant = g_variant_new_boolean(_rle);
+    g_hash_table_insert(params, (char*)"rle", rleGVariant);
 
     struct sr_output output;
     output.module = (sr_output_module*) _outModule;
@@ -624,11 +785,9 @@ void StoreSession::export_proc(shared_ptr<data::Snapshot> snapshot)
     output.param = NULL;
     if(_outModule->init)
         _outModule->init(&output, params);
+    // output modules emit UTF-8 text, write it out unconverted
     QFile file(_file_name);
     file.open(QIODevice::WriteOnly | QIODevice::Text);
-    QTextStream out(&file);
-    out.setCodec("UTF-8");
-    //out.setGenerateByteOrderMark(true);  // UTF-8 without BOM
 
     // Meta
     GString *data_out;
@@ -645,27 +804,30 @@ void StoreSession::export_proc(shared_ptr<data::Snapshot> snapshot)
     p.status = SR_PKT_OK;
     p.payload = &meta;
     _outModule->receive(&output, &p, &data_out);
-    if(data_out){
-        out << QString::fromUtf8((char*) data_out->str);
-        g_string_free(data_out,TRUE);
-    }
+    write_output(file, data_out);
     for (GSList *l = meta.config; l; l = l->next) {
         src = (struct sr_config *)l->data;
         sr_config_free(src);
     }
     g_slist_free(meta.config);
 
-    if (channel_type == SR_CHANNEL_LOGIC) {
+    if (channel_type == SR_CHANNEL_LOGIC &&
+        (strcmp(_outModule->id, "vcd") == 0 ||
+         strcmp(_outModule->id, "csv") == 0)) {
+        export_logic_edges(logic_snapshot, &output, file);
+    } else if (channel_type == SR_CHANNEL_LOGIC) {
         _unit_count = logic_snapshot->get_sample_count();
         int blk_num = logic_snapshot->get_block_num();
         bool sample;
-        std::vector<uint8_t *> buf_vec;
-        std::vector<bool> buf_sample;
+        std::vector<const uint8_t *> buf_vec;
+        std::vector<uint8_t> buf_fill;
+        const unsigned int usize = data::LogicExport::ChunkSamples;
+        std::vector<uint8_t> xbuf;
         for (int blk = 0; !boost::this_thread::interruption_requested()  &&
                           blk < blk_num; blk++) {
             uint64_t buf_sample_num = logic_snapshot->get_block_size(blk) * 8;
             buf_vec.clear();
-            buf_sample.clear();
+            buf_fill.clear();
             BOOST_FOREACH(const boost::shared_ptr<view::Signal> s, _session.get_signals()) {
                 int ch_type = s->get_type();
                 if (ch_type == SR_CHANNEL_LOGIC) {
@@ -674,55 +836,38 @@ void StoreSession::export_proc(shared_ptr<data::Snapshot> snapshot)
                         continue;
                     uint8_t *buf = logic_snapshot->get_block_buf(blk, ch_index, sample);
                     buf_vec.push_back(buf);
-                    buf_sample.push_back(sample);
+                    buf_fill.push_back(sample ? 0xff : 0x00);
                 }
             }
 
             uint16_t unitsize = ceil(buf_vec.size() / 8.0);
-            unsigned int usize = 8192;
             unsigned int size = usize;
             struct sr_datafeed_logic lp;
+            if (xbuf.size() < usize * unitsize)
+                xbuf.resize(usize * unitsize);
             for(uint64_t i = 0; !boost::this_thread::interruption_requested() &&
                                 i < buf_sample_num; i+=usize){
                 if(buf_sample_num - i < usize)
                     size = buf_sample_num - i;
-                uint8_t *xbuf = (uint8_t *)malloc(size * unitsize);
-                if (xbuf == NULL) {
-                    _has_error = true;
-                    _error = tr("xbuffer malloc failed.");
-                    return;
-                }
-                memset(xbuf, 0, size * unitsize);
-                for (uint64_t j = 0; j < size; j++) {
-                    for (unsigned int k = 0; k < buf_vec.size(); k++) {
-                        if (buf_vec[k] == NULL && buf_sample[k])
-                            xbuf[j*unitsize+k/8] +=  1 << k%8;
-                        else if (buf_vec[k] && (buf_vec[k][(i+j)/8] & (1 << j%8)))
-                            xbuf[j*unitsize+k/8] +=  1 << k%8;
-                    }
-                }
-                lp.data = xbuf;
+                data::LogicExport::transpose_cross(xbuf.data(), unitsize,
+                                                   buf_vec, buf_fill, i / 8, size / 8);
+                lp.data = xbuf.data();
                 lp.length = size * unitsize;
                 lp.unitsize = unitsize;
                 p.type = SR_DF_LOGIC;
                 p.status = SR_PKT_OK;
                 p.payload = &lp;
                 _outModule->receive(&output, &p, &data_out);
-                if(data_out){
-                    out << QString::fromUtf8((char*) data_out->str);
-                    g_string_free(data_out,TRUE);
-                }
+                write_output(file, data_out);
 
                 _units_stored += size;
-                if (xbuf)
-                    free(xbuf);
                 progress_updated();
             }
         }
     } else if (channel_type == SR_CHANNEL_DSO) {
         _unit_count = snapshot->get_sample_count();
         unsigned char* datat = (unsigned char*)snapshot->get_data();
-        unsigned int usize = 8192;
+        unsigned int usize = ExportChunkSamples;
         unsigned int size = usize;
         struct sr_datafeed_dso dp;
         for(uint64_t i = 0; !boost::this_thread::interruption_requested() && i < _unit_count; i+=usize){
@@ -734,10 +879,7 @@ void StoreSession::export_proc(shared_ptr<data::Snapshot> snapshot)
             p.status = SR_PKT_OK;
             p.payload = &dp;
             _outModule->receive(&output, &p, &data_out);
-            if(data_out){
-                out << (char*) data_out->str;
-                g_string_free(data_out,TRUE);
-            }
+            write_output(file, data_out);
 
             _units_stored += size;
             progress_updated();
@@ -745,7 +887,7 @@ void StoreSession::export_proc(shared_ptr<data::Snapshot> snapshot)
     } else if (channel_type == SR_CHANNEL_ANALOG) {
         _unit_count = snapshot->get_sample_count();
         unsigned char* datat = (unsigned char*)snapshot->get_data();
-        unsigned int usize = 8192;
+        unsigned int usize = ExportChunkSamples;
         unsigned int size = usize;
         struct sr_datafeed_analog ap;
         for(uint64_t i = 0; !boost::this_thread::interruption_requested() && i < _unit_count; i+=usize){
@@ -757,10 +899,7 @@ void StoreSession::export_proc(shared_ptr<data::Snapshot> snapshot)
             p.status = SR_PKT_OK;
             p.payload = &ap;
             _outModule->receive(&output, &p, &data_out);
-            if(data_out){
-                out << (char*) data_out->str;
-                g_string_free(data_out,TRUE);
-            }
+            write_output(file, data_out);
 
             _units_stored += size;
             progress_updated();
@@ -777,6 +916,50 @@ void StoreSession::export_proc(shared_ptr<data::Snapshot> snapshot)
     progress_updated();
 }
 
+void StoreSession::write_output(QFile &file, GString *data_out)
+{
+    if (!data_out)
+        return;
+    file.write(data_out->str, data_out->len);
+    _bytes_written += data_out->len;
+    g_string_free(data_out, TRUE);
+}
+
+/*
+ * Feed the output module with the changes of the cross sample only,
+ * found through the snapshot mipmap, so sparse captures are exported in
+ * time proportional to their number of transitions.
+ */
+void StoreSession::export_logic_edges(shared_ptr<data::LogicSnapshot> snapshot,
+                                      struct sr_output *output, QFile &file)
+{
+    std::vector<int> ch_vec;
+    BOOST_FOREACH(const boost::shared_ptr<view::Signal> s, _session.get_signals()) {
+        if (s->get_type() == SR_CHANNEL_LOGIC &&
+            snapshot->has_data(s->get_index()))
+            ch_vec.push_back(s->get_index());
+    }
+
+    _unit_count = snapshot->get_sample_count();
+    data::LogicExport::edges(*snapshot, ch_vec,
+        boost::bind(&StoreSession::send_logic_edges, this, output, boost::ref(file), _1));
+}
+
+void StoreSession::send_logic_edges(struct sr_output *output, QFile &file,
+                                    const sr_datafeed_logic_edge &ep)
+{
+    struct sr_datafeed_packet p;
+    GString *data_out;
+    p.type = SR_DF_LOGIC_EDGE;
+    p.status = SR_PKT_OK;
+    p.payload = &ep;
+    _outModule->receive(output, &p, &data_out);
+    write_output(file, data_out);
+
+    _units_stored = ep.end;
+    progress_updated();
+}
+
 #ifdef ENABLE_DECODE
 QString StoreSession::decoders_gen()
 {
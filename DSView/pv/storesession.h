@@ -28,6 +28,8 @@
 #include <boost/thread.hpp>
 
 #include <QObject>
+#include <QElapsedTimer>
+#include <QFile>
 
 #include <libsigrok4DSL/libsigrok.h>
 #include <libsigrokdecode4DSL/libsigrokdecode.h>
@@ -38,6 +40,7 @@ class SigSession;
 
 namespace data {
 class Snapshot;
+class LogicSnapshot;
 }
 
 namespace dock {
@@ -50,6 +53,9 @@ class StoreSession : public QObject
 
 private:
     const static int File_Version = 2;
+    const static uint64_t ExportChunkSamples = 256 * 1024;
+    // Blocks kept in memory while recording, the others are on disk only
+    const static int RecordWindowBlocks = 8;
 
 public:
     StoreSession(SigSession &session);
@@ -60,12 +66,19 @@ public:
 
 	std::pair<uint64_t, uint64_t> progress() const;
 
+    double throughput() const;
+
 	const QString& error() const;
 
     bool save_start(QString session_file);
 
     bool export_start();
 
+    bool record_start(QString file_name,
+                      boost::shared_ptr<data::LogicSnapshot> snapshot);
+    bool record_data(bool all);
+    bool record_finish(QString session_file);
+
 	void wait();
 
 	void cancel();
@@ -74,6 +87,11 @@ private:
     void save_proc(boost::shared_ptr<pv::data::Snapshot> snapshot);
     QString meta_gen(boost::shared_ptr<data::Snapshot> snapshot);
     void export_proc(boost::shared_ptr<pv::data::Snapshot> snapshot);
+    void export_logic_edges(boost::shared_ptr<pv::data::LogicSnapshot> snapshot,
+                            struct sr_output *output, QFile &file);
+    void write_output(QFile &file, GString *data_out);
+    void send_logic_edges(struct sr_output *output, QFile &file,
+                          const sr_datafeed_logic_edge &ep);
     #ifdef ENABLE_DECODE
     QString decoders_gen();
     #endif
@@ -103,9 +121,17 @@ private:
     //mutable boost::mutex _mutex;
 	uint64_t _units_stored;
 	uint64_t _unit_count;
+    uint64_t _bytes_written;
+    QElapsedTimer _timer;
     bool _has_error;
 	QString _error;
     bool _canceled;
+    // csv export of logic data: only rows where a channel changes
+    bool _rle;
+
+    struct sr_session_writer *_writer;
+    boost::shared_ptr<data::LogicSnapshot> _record_snapshot;
+    int _record_blocks;
 };
 
 } // pv
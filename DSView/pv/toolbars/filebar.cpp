@@ -76,6 +76,10 @@ FileBar::FileBar(SigSession &session, QWidget *parent) :
     _action_export->setObjectName(QString::fromUtf8("actionExport"));
     connect(_action_export, SIGNAL(triggered()), this, SIGNAL(on_export()));
 
+    _action_record = new QAction(this);
+    _action_record->setObjectName(QString::fromUtf8("actionRecord"));
+    connect(_action_record, SIGNAL(triggered()), this, SIGNAL(on_record()));
+
 
     _action_capture = new QAction(this);
     _action_capture->setObjectName(QString::fromUtf8("actionCapture"));
@@ -89,6 +93,7 @@ FileBar::FileBar(SigSession &session, QWidget *parent) :
     _menu->addAction(_action_open);
     _menu->addAction(_action_save);
     _menu->addAction(_action_export);
+    _menu->addAction(_action_record);
     _menu->addAction(_action_capture);
     _file_button.setMenu(_menu);
     addWidget(&_file_button);
@@ -115,6 +120,7 @@ void FileBar::retranslateUi()
     _action_open->setText(tr("&Open..."));
     _action_save->setText(tr("&Save..."));
     _action_export->setText(tr("&Export..."));
+    _action_record->setText(tr("&Record..."));
     _action_capture->setText(tr("&Capture..."));
 }
 
@@ -129,6 +135,7 @@ void FileBar::reStyle()
     _action_open->setIcon(QIcon(iconPath+"/open.png"));
     _action_save->setIcon(QIcon(iconPath+"/save.png"));
     _action_export->setIcon(QIcon(iconPath+"/export.png"));
+    _action_record->setIcon(QIcon(iconPath+"/start.png"));
     _action_capture->setIcon(QIcon(iconPath+"/capture.png"));
     _file_button.setIcon(QIcon(iconPath+"/file.png"));
 }
@@ -140,7 +147,7 @@ void FileBar::on_actionOpen_triggered()
     // Show the dialog
     const QString file_name = QFileDialog::getOpenFileName(
         this, tr("Open File"), settings.value(DIR_KEY).toString(), tr(
-            "DSView Data (*.dsl)"));
+            "DSView Data (*.dsl);;Value Change Dump (*.vcd)"));
     if (!file_name.isEmpty()) {
         QDir CurrentDir;
         settings.setValue(DIR_KEY, CurrentDir.absoluteFilePath(file_name));
@@ -58,6 +58,7 @@ signals:
     void load_file(QString);
     void on_save();
     void on_export();
+    void on_record();
     void on_screenShot();
     void load_session(QString);
     void store_session(QString);
@@ -85,6 +86,7 @@ private:
     QAction *_action_open;
     QAction *_action_save;
     QAction *_action_export;
+    QAction *_action_record;
     QAction *_action_capture;
 };
 
@@ -30,6 +30,7 @@
 
 #include "logobar.h"
 #include "../dialogs/about.h"
+#include "../dialogs/capturestats.h"
 #include "../dialogs/dsmessagebox.h"
 
 namespace pv {
@@ -77,11 +78,17 @@ LogoBar::LogoBar(SigSession &session, QWidget *parent) :
     _logo_button.addAction(_issue);
     connect(_issue, SIGNAL(triggered()), this, SLOT(on_actionIssue_triggered()));
 
+    _stats = new QAction(this);
+    _stats->setObjectName(QString::fromUtf8("actionStats"));
+    _logo_button.addAction(_stats);
+    connect(_stats, SIGNAL(triggered()), this, SLOT(on_actionStats_triggered()));
+
     _menu = new QMenu(this);
     _menu->addMenu(_language);
     _menu->addAction(_about);
     _menu->addAction(_manual);
     _menu->addAction(_issue);
+    _menu->addAction(_stats);
     _logo_button.setMenu(_menu);
 
     _logo_button.setToolButtonStyle(Qt::ToolButtonTextUnderIcon);
@@ -116,6 +123,7 @@ void LogoBar::retranslateUi()
     _about->setText(tr("&About..."));
     _manual->setText(tr("&Manual"));
     _issue->setText(tr("&Bug Report"));
+    _stats->setText(tr("Capture &Statistics..."));
 
     if (qApp->property("Language") == QLocale::Chinese)
         _language->setIcon(QIcon(":/icons/Chinese.png"));
@@ -204,6 +212,12 @@ void LogoBar::on_actionIssue_triggered()
                 QUrl(QLatin1String("https://github.com/DreamSourceLab/DSView/issues")));
 }
 
+void LogoBar::on_actionStats_triggered()
+{
+    dialogs::CaptureStats dlg(_session, this);
+    dlg.exec();
+}
+
 void LogoBar::enable_toggle(bool enable)
 {
     _logo_button.setDisabled(!enable);
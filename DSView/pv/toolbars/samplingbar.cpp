@@ -122,9 +122,13 @@ SamplingBar::SamplingBar(SigSession &session, QWidget *parent) :
     _action_repeat = new QAction(this);
     connect(_action_repeat, SIGNAL(triggered()), this, SLOT(on_mode()));
 
+    _action_roll = new QAction(this);
+    connect(_action_roll, SIGNAL(triggered()), this, SLOT(on_mode()));
+
     _mode_menu = new QMenu(this);
     _mode_menu->addAction(_action_single);
     _mode_menu->addAction(_action_repeat);
+    _mode_menu->addAction(_action_roll);
     _mode_button.setMenu(_mode_menu);
 
     _mode_button.setToolButtonStyle(Qt::ToolButtonTextUnderIcon);
@@ -191,6 +195,7 @@ void SamplingBar::retranslateUi()
 
     _action_single->setText(tr("&Single"));
     _action_repeat->setText(tr("&Repetitive"));
+    _action_roll->setText(tr("R&oll"));
 }
 
 void SamplingBar::reStyle()
@@ -218,13 +223,13 @@ void SamplingBar::reStyle()
         }
     }
     _configure_button.setIcon(QIcon(iconPath+"/params.png"));
-    _mode_button.setIcon(_session.get_run_mode() == pv::SigSession::Single ? QIcon(iconPath+"/modes.png") :
-                                                                             QIcon(iconPath+"/moder.png"));
+    _mode_button.setIcon(mode_icon());
     _run_stop_button.setIcon(_sampling ? QIcon(iconPath+"/stop.png") :
                                          QIcon(iconPath+"/start.png"));
     _instant_button.setIcon(QIcon(iconPath+"/instant.png"));
     _action_single->setIcon(QIcon(iconPath+"/oneloop.png"));
     _action_repeat->setIcon(QIcon(iconPath+"/repeat.png"));
+    _action_roll->setIcon(QIcon(iconPath+"/next.png"));
 }
 
 void SamplingBar::set_device_list(
@@ -404,8 +409,7 @@ void SamplingBar::set_sampling(bool sampling)
     }
 
     _mode_button.setEnabled(!sampling);
-    _mode_button.setIcon(_session.get_run_mode() == pv::SigSession::Single ? QIcon(iconPath+"/modes.png") :
-                                                                             QIcon(iconPath+"/moder.png"));
+    _mode_button.setIcon(mode_icon());
     _configure_button.setEnabled(!sampling);
     _device_selector.setEnabled(!sampling);
 
@@ -994,13 +998,11 @@ void SamplingBar::show_session_error(
 
 void SamplingBar::reload()
 {
-    QString iconPath = ":/icons/" + qApp->property("Style").toString();
     if (_session.get_device()->dev_inst()->mode == LOGIC) {
         if (_session.get_device()->name() == "virtual-session") {
             _mode_action->setVisible(false);
         } else {
-            _mode_button.setIcon(_session.get_run_mode() == pv::SigSession::Single ? QIcon(iconPath+"/modes.png") :
-                                                                                     QIcon(iconPath+"/moder.png"));
+            _mode_button.setIcon(mode_icon());
             _mode_action->setVisible(true);
         }
         _run_stop_action->setVisible(true);
@@ -1023,6 +1025,20 @@ void SamplingBar::reload()
     update();
 }
 
+// The icon of the run mode's action
+QIcon SamplingBar::mode_icon() const
+{
+    QString iconPath = ":/icons/" + qApp->property("Style").toString();
+    switch (_session.get_run_mode()) {
+    case pv::SigSession::Repetitive:
+        return QIcon(iconPath+"/moder.png");
+    case pv::SigSession::Roll:
+        return QIcon(iconPath+"/next.png");
+    default:
+        return QIcon(iconPath+"/modes.png");
+    }
+}
+
 void SamplingBar::on_mode()
 {
     QString iconPath = ":/icons/" + qApp->property("Style").toString();
@@ -1035,6 +1051,11 @@ void SamplingBar::on_mode()
         pv::dialogs::Interval interval_dlg(_session, this);
         interval_dlg.exec();
         _session.set_run_mode(pv::SigSession::Repetitive);
+    } else if (act == _action_roll) {
+        _mode_button.setIcon(QIcon(iconPath+"/next.png"));
+        _session.set_run_mode(pv::SigSession::Roll);
+        pv::dialogs::Interval interval_dlg(_session, this);
+        interval_dlg.exec();
     }
 }
 
@@ -115,6 +115,7 @@ private:
     void update_sample_count_selector_value();
     void commit_settings();
     void setting_adj();
+    QIcon mode_icon() const;
 
 private slots:
     void on_mode();
@@ -163,6 +164,7 @@ private:
     QMenu *_mode_menu;
     QAction *_action_repeat;
     QAction *_action_single;
+    QAction *_action_roll;
 
     bool _instant;
 };
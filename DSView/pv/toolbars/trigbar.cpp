@@ -23,6 +23,7 @@
 #include "../sigsession.h"
 #include "../device/devinst.h"
 #include "../dialogs/fftoptions.h"
+#include "../dialogs/interval.h"
 #include "../dialogs/lissajousoptions.h"
 #include "../dialogs/mathoptions.h"
 #include "../view/trace.h"
@@ -87,6 +88,10 @@ TrigBar::TrigBar(SigSession &session, QWidget *parent) :
     _action_lissajous->setObjectName(QString::fromUtf8("actionLissajous"));
     connect(_action_lissajous, SIGNAL(triggered()), this, SLOT(on_actionLissajous_triggered()));
 
+    _action_persistence = new QAction(this);
+    _action_persistence->setObjectName(QString::fromUtf8("actionPersistence"));
+    connect(_action_persistence, SIGNAL(triggered()), this, SLOT(on_actionPersistence_triggered()));
+
     _dark_style = new QAction(this);
     _dark_style->setObjectName(QString::fromUtf8("actionDark"));
     connect(_dark_style, SIGNAL(triggered()), this, SLOT(on_actionDark_triggered()));
@@ -104,6 +109,7 @@ TrigBar::TrigBar(SigSession &session, QWidget *parent) :
     _display_menu->setContentsMargins(0,0,0,0);
     _display_menu->addMenu(_themes);
     _display_menu->addAction(_action_lissajous);
+    _display_menu->addAction(_action_persistence);
     _display_button.setPopupMode(QToolButton::InstantPopup);
     _display_button.setMenu(_display_menu);
 
@@ -147,6 +153,7 @@ void TrigBar::retranslateUi()
     _dark_style->setText(tr("Dark"));
     _light_style->setText(tr("Light"));
     _action_lissajous->setText(tr("&Lissajous"));
+    _action_persistence->setText(tr("&Persistence"));
 
     _action_fft->setText(tr("FFT"));
     _action_math->setText(tr("Math"));
@@ -256,6 +263,7 @@ void TrigBar::reload()
         _search_action->setVisible(true);
         _function_action->setVisible(false);
         _action_lissajous->setVisible(false);
+        _action_persistence->setVisible(false);
     } else if (_session.get_device()->dev_inst()->mode == ANALOG) {
         _trig_action->setVisible(false);
         _protocol_action->setVisible(false);
@@ -263,6 +271,7 @@ void TrigBar::reload()
         _search_action->setVisible(false);
         _function_action->setVisible(false);
         _action_lissajous->setVisible(false);
+        _action_persistence->setVisible(false);
     } else if (_session.get_device()->dev_inst()->mode == DSO) {
         _trig_action->setVisible(true);
         _protocol_action->setVisible(false);
@@ -270,6 +279,7 @@ void TrigBar::reload()
         _search_action->setVisible(false);
         _function_action->setVisible(true);
         _action_lissajous->setVisible(true);
+        _action_persistence->setVisible(true);
     }
     enable_toggle(true);
     update();
@@ -305,5 +315,11 @@ void TrigBar::on_actionLissajous_triggered()
     lissajous_dlg.exec();
 }
 
+void TrigBar::on_actionPersistence_triggered()
+{
+    pv::dialogs::Interval persistence_dlg(_session, this);
+    persistence_dlg.exec();
+}
+
 } // namespace toolbars
 } // namespace pv
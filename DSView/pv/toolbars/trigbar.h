@@ -67,6 +67,7 @@ private slots:
     void on_actionDark_triggered();
     void on_actionLight_triggered();
     void on_actionLissajous_triggered();
+    void on_actionPersistence_triggered();
 
 public slots:
     void protocol_clicked();
@@ -107,6 +108,7 @@ private:
     QAction *_dark_style;
     QAction *_light_style;
     QAction* _action_lissajous;
+    QAction* _action_persistence;
 };
 
 } // namespace toolbars
@@ -268,6 +268,7 @@ QPointF AnalogSignal::get_point(uint64_t index, float &value)
     const double samplerate = _view->session().cur_snap_samplerate();
     const double samples_per_pixel = samplerate * scale;
 
+    boost::shared_lock<boost::shared_mutex> access(snapshot->get_access_mutex());
     if (index >= snapshot->get_sample_count())
         return pt;
 
@@ -517,6 +518,7 @@ void AnalogSignal::paint_mid(QPainter &p, int left, int right, QColor fore, QCol
 
     const boost::shared_ptr<pv::data::AnalogSnapshot> &snapshot =
         snapshots.front();
+    boost::shared_lock<boost::shared_mutex> access(snapshot->get_access_mutex());
     if (snapshot->empty())
         return;
 
@@ -37,6 +37,8 @@ extern "C" {
 #include <QPushButton>
 #include <QDialog>
 #include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QLineEdit>
 #include <QScrollArea>
 
 #include "decodetrace.h"
@@ -128,6 +130,7 @@ DecodeTrace::DecodeTrace(pv::SigSession &session,
     _end_index(0),
     _start_count(0),
     _end_count(0),
+    _binary_edit(NULL),
     _progress(0),
     _popup_form(NULL),
     _popup()
@@ -353,6 +356,12 @@ bool DecodeTrace::create_popup()
 
     if (QDialog::Accepted == _popup->exec())
     {
+        if (_binary_edit &&
+            _binary_edit->text() != _decoder_stack->binary_dir()) {
+            _decoder_stack->set_binary_dir(_binary_edit->text());
+            _decoder_stack->set_options_changed(true);
+        }
+
         BOOST_FOREACH(boost::shared_ptr<data::decode::Decoder> dec,
             _decoder_stack->stack())
         {
@@ -365,6 +374,7 @@ bool DecodeTrace::create_popup()
         }
     }
 
+    _binary_edit = NULL;
     delete _popup_form;
     delete _popup;
     _popup = NULL;
@@ -458,6 +468,24 @@ void DecodeTrace::populate_popup_form(QWidget *parent, QFormLayout *form)
     form->addRow(_end_comboBox, new QLabel(
                      tr("Decode End to")));
 
+    // Add binary output directory, for decoders which have binary classes
+    _binary_edit = NULL;
+    BOOST_FOREACH(boost::shared_ptr<Decoder> dec, stack) {
+        if (!dec->decoder()->binary)
+            continue;
+        _binary_edit = new QLineEdit(_decoder_stack->binary_dir(), parent);
+        _binary_edit->setPlaceholderText(tr("Not saved"));
+        QPushButton *const binary_button = new QPushButton("...", parent);
+        connect(binary_button, SIGNAL(clicked()),
+            this, SLOT(on_binary_dir()));
+        QHBoxLayout *binary_box = new QHBoxLayout;
+        binary_box->addWidget(_binary_edit);
+        binary_box->addWidget(binary_button);
+        form->addRow(binary_box, new QLabel(
+                         tr("Binary Output Directory")));
+        break;
+    }
+
 	// Add stacking button
 	pv::widgets::DecoderMenu *const decoder_menu =
 		new pv::widgets::DecoderMenu(parent);
@@ -1007,6 +1035,15 @@ void DecodeTrace::on_region_set(int index)
     }
 }
 
+void DecodeTrace::on_binary_dir()
+{
+    assert(_binary_edit);
+    const QString dir = QFileDialog::getExistingDirectory(_popup,
+        tr("Binary Output Directory"), _binary_edit->text());
+    if (!dir.isEmpty())
+        _binary_edit->setText(dir);
+}
+
 void DecodeTrace::frame_ended()
 {
     const uint64_t last_samples = _session.cur_samplelimits() - 1;
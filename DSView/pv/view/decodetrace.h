@@ -39,6 +39,7 @@ struct srd_channel;
 struct srd_decoder;
 
 class QComboBox;
+class QLineEdit;
 
 namespace pv {
 
@@ -205,6 +206,8 @@ private slots:
 
     void on_region_set(int index);
 
+    void on_binary_dir();
+
 private:
 	pv::SigSession &_session;
 	boost::shared_ptr<pv::data::DecoderStack> _decoder_stack;
@@ -213,6 +216,7 @@ private:
     int _start_index, _end_index;
     int _start_count, _end_count;
     QComboBox *_start_comboBox, *_end_comboBox;
+    QLineEdit *_binary_edit;
     int _progress;
 
 	std::list< boost::shared_ptr<pv::prop::binding::DecoderOptions> >
@@ -805,6 +805,17 @@ void DsoSignal::paint_mid(QPainter &p, int left, int right, QColor fore, QColor
             return;
         const boost::shared_ptr<pv::data::DsoSnapshot> &snapshot =
             snapshots.front();
+
+        const double pixels_offset = offset;
+        const double samplerate = _data->samplerate();
+        //const double samplerate = _dev_inst->get_sample_rate();
+        //const double samplerate = _view->session().cur_snap_samplerate();
+        const double samples_per_pixel = samplerate * scale;
+        const bool envelope = (samples_per_pixel >= EnvelopeThreshold);
+        // takes the writer lock, so before the access lock
+        snapshot->enable_envelope(envelope);
+
+        boost::shared_lock<boost::shared_mutex> access(snapshot->get_access_mutex());
         if (snapshot->empty())
             return;
 
@@ -812,12 +823,7 @@ void DsoSignal::paint_mid(QPainter &p, int left, int right, QColor fore, QColor
             return;
 
         const uint16_t enabled_channels = snapshot->get_channel_num();
-        const double pixels_offset = offset;
-        const double samplerate = _data->samplerate();
-        //const double samplerate = _dev_inst->get_sample_rate();
-        //const double samplerate = _view->session().cur_snap_samplerate();
         const int64_t last_sample = max((int64_t)(snapshot->get_sample_count() - 1), (int64_t)0);
-        const double samples_per_pixel = samplerate * scale;
         const double start = offset * samples_per_pixel;
         const double end = start + samples_per_pixel * width;
 
@@ -827,17 +833,22 @@ void DsoSignal::paint_mid(QPainter &p, int left, int right, QColor fore, QColor
             (int64_t)0), last_sample);
         const int hw_offset = get_hw_offset();
 
-        if (samples_per_pixel < EnvelopeThreshold) {
-            snapshot->enable_envelope(false);
-            paint_trace(p, snapshot, zeroY, left,
+        if (snapshot->get_history_num() != 0)
+            paint_history(p, snapshot, zeroY, left,
+                start_sample, end_sample, hw_offset,
+                pixels_offset, samples_per_pixel, enabled_channels);
+
+        if (!envelope) {
+            paint_trace(p, snapshot->get_samples(start_sample, end_sample, index),
+                View::ForeAlpha, zeroY, left,
                 start_sample, end_sample, hw_offset,
                 pixels_offset, samples_per_pixel, enabled_channels);
         } else {
-            snapshot->enable_envelope(true);
             paint_envelope(p, snapshot, zeroY, left,
                 start_sample, end_sample, hw_offset,
                 pixels_offset, samples_per_pixel, enabled_channels);
         }
+        access.unlock();
 
         sr_status status;
         if (sr_status_get(_dev_inst->dev_inst(), &status, false, 0, 0) == SR_OK) {
@@ -979,19 +990,17 @@ QRectF DsoSignal::get_trig_rect(int left, int right) const
                   SquareWidth, SquareWidth);
 }
 
-void DsoSignal::paint_trace(QPainter &p,
-    const boost::shared_ptr<pv::data::DsoSnapshot> &snapshot,
+void DsoSignal::paint_trace(QPainter &p, const uint8_t *samples, int alpha,
     int zeroY, int left, const int64_t start, const int64_t end, int hw_offset,
     const double pixels_offset, const double samples_per_pixel, uint64_t num_channels)
 {
     const int64_t sample_count = end - start + 1;
 
     if (sample_count > 0) {
-        const uint8_t *const samples = snapshot->get_samples(start, end, get_index());
         assert(samples);
 
         QColor trace_colour = _colour;
-        trace_colour.setAlpha(View::ForeAlpha);
+        trace_colour.setAlpha(alpha);
         p.setPen(trace_colour);
 
         QPointF *points = new QPointF[sample_count];
@@ -1018,6 +1027,60 @@ void DsoSignal::paint_trace(QPainter &p,
     }
 }
 
+void DsoSignal::paint_history(QPainter &p,
+    const boost::shared_ptr<pv::data::DsoSnapshot> &snapshot,
+    int zeroY, int left, const int64_t start, const int64_t end, int hw_offset,
+    const double pixels_offset, const double samples_per_pixel, uint64_t num_channels)
+{
+    const unsigned int num = snapshot->get_history_num();
+    const int64_t sample_count = end - start + 1;
+    const float top = get_view_rect().top();
+    const float bottom = get_view_rect().bottom();
+
+    // The frames kept fade out with their age, the live one is on top
+    for (unsigned int i = 0; i < num; i++) {
+        const uint8_t *const samples =
+            snapshot->get_history_samples(i, start, end, get_index());
+        if (!samples)
+            continue;
+
+        const int alpha = View::ForeAlpha * (i + 1) / (num + 2);
+        if (samples_per_pixel < EnvelopeThreshold) {
+            paint_trace(p, samples, alpha, zeroY, left, start, end, hw_offset,
+                pixels_offset, samples_per_pixel, num_channels);
+            continue;
+        }
+
+        // Zoomed out, a line for each pixel from the min to the max
+        QColor trace_colour = _colour;
+        trace_colour.setAlpha(alpha);
+        p.setPen(trace_colour);
+
+        QLineF *const lines = new QLineF[(int64_t)(sample_count / samples_per_pixel) + 2];
+        QLineF *line = lines;
+        float x = (start / samples_per_pixel - pixels_offset) + left;
+        double next = samples_per_pixel;
+        uint8_t low = UINT8_MAX;
+        uint8_t high = 0;
+        for (int64_t sample = 0; sample < sample_count; sample++) {
+            const uint8_t value = samples[sample * num_channels];
+            low = min(low, value);
+            high = max(high, value);
+            if (sample + 1 >= next || sample + 1 == sample_count) {
+                *line++ = QLineF(x, min(max(top, zeroY + (low - hw_offset) * _scale), bottom),
+                                 x, min(max(top, zeroY + (high - hw_offset) * _scale), bottom));
+                x += 1;
+                next += samples_per_pixel;
+                low = UINT8_MAX;
+                high = 0;
+            }
+        }
+
+        p.drawLines(lines, line - lines);
+        delete[] lines;
+    }
+}
+
 void DsoSignal::paint_envelope(QPainter &p,
     const boost::shared_ptr<pv::data::DsoSnapshot> &snapshot,
     int zeroY, int left, const int64_t start, const int64_t end, int hw_offset,
@@ -1477,6 +1540,7 @@ QPointF DsoSignal::get_point(uint64_t index, float &value)
     const double samplerate = _view->session().cur_snap_samplerate();
     const double samples_per_pixel = samplerate * scale;
 
+    boost::shared_lock<boost::shared_mutex> access(snapshot->get_access_mutex());
     if (index >= snapshot->get_sample_count())
         return pt;
 
@@ -1506,6 +1570,7 @@ double DsoSignal::get_voltage(uint64_t index)
     if (snapshot->empty())
         return 1;
 
+    boost::shared_lock<boost::shared_mutex> access(snapshot->get_access_mutex());
     if (index >= snapshot->get_sample_count())
         return 1;
 
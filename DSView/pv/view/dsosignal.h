@@ -207,7 +207,12 @@ protected:
     void paint_type_options(QPainter &p, int right, const QPoint pt, QColor fore);
 
 private:
-    void paint_trace(QPainter &p,
+    void paint_trace(QPainter &p, const uint8_t *samples, int alpha,
+        int zeroY, int left, const int64_t start, const int64_t end, int hw_offset,
+        const double pixels_offset, const double samples_per_pixel,
+        uint64_t num_channels);
+
+    void paint_history(QPainter &p,
         const boost::shared_ptr<pv::data::DsoSnapshot> &snapshot,
         int zeroY, int left, const int64_t start, const int64_t end, int hw_offset,
         const double pixels_offset, const double samples_per_pixel,
@@ -157,6 +157,7 @@ void LissajousTrace::paint_mid(QPainter &p, int left, int right, QColor fore, QC
             return;
         const boost::shared_ptr<pv::data::DsoSnapshot> &snapshot =
             snapshots.front();
+        boost::shared_lock<boost::shared_mutex> access(snapshot->get_access_mutex());
         if (snapshot->empty())
             return;
 
@@ -145,6 +145,7 @@ void LogicSignal::paint_mid(QPainter &p, int left, int right, QColor fore, QColo
 
 	const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
 		snapshots.front();
+    boost::shared_lock<boost::shared_mutex> access(snapshot->get_access_mutex());
     if (snapshot->empty() || !snapshot->has_data(_probe->index))
         return;
 
@@ -165,6 +166,7 @@ void LogicSignal::paint_mid(QPainter &p, int left, int right, QColor fore, QColo
                                                           start_index, end_index, width, max_togs,
                                                           offset,
                                                           samples_per_pixel, _probe->index);
+    access.unlock();
     assert(_cur_pulses.size() >= width);
 
     int preX = 0;
@@ -300,6 +302,7 @@ bool LogicSignal::measure(const QPointF &p, uint64_t &index0, uint64_t &index1,
 
         const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
             snapshots.front();
+        boost::shared_lock<boost::shared_mutex> access(snapshot->get_access_mutex());
         if (snapshot->empty() || !snapshot->has_data(_probe->index))
             return false;
 
@@ -355,6 +358,7 @@ bool LogicSignal::edge(const QPointF &p, uint64_t &index, int radius) const
 
         const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
             snapshots.front();
+        boost::shared_lock<boost::shared_mutex> access(snapshot->get_access_mutex());
         if (snapshot->empty() || !snapshot->has_data(_probe->index))
             return false;
 
@@ -417,6 +421,7 @@ bool LogicSignal::edges(uint64_t end, uint64_t start, uint64_t &rising, uint64_t
 
     const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
         snapshots.front();
+    boost::shared_lock<boost::shared_mutex> access(snapshot->get_access_mutex());
     if (snapshot->empty() || !snapshot->has_data(_probe->index))
         return false;
 
@@ -176,6 +176,8 @@ View::View(SigSession &session, pv::toolbars::SamplingBar *sampling_bar, QWidget
             this, SLOT(receive_end()));
     connect(&_session, SIGNAL(frame_began()),
             this, SLOT(frame_began()));
+    connect(&_session, SIGNAL(segments_changed()),
+            this, SLOT(segments_changed()));
     connect(&_session, SIGNAL(show_region(uint64_t, uint64_t, bool)),
             this, SLOT(show_region(uint64_t, uint64_t, bool)));
     connect(&_session, SIGNAL(show_wait_trigger()),
@@ -471,6 +473,14 @@ void View::frame_began()
     set_search_pos(_search_pos, _search_hit);
 }
 
+void View::segments_changed()
+{
+    // each segment has its own trigger time
+    if (_session.get_cur_segment() >= 0)
+        _viewbottom->set_trig_time(_session.get_session_time());
+    _viewbottom->update();
+}
+
 void View::set_trig_time()
 {
     if (!_trig_time_setted && _session.get_device()->dev_inst()->mode == LOGIC) {
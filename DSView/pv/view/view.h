@@ -310,6 +310,8 @@ private slots:
 
     void frame_began();
 
+    void segments_changed();
+
     // calibration for oscilloscope
     void show_calibration();
     // lissajous figure
@@ -136,6 +136,7 @@ void Viewport::paintEvent(QPaintEvent *event)
 
     using pv::view::Signal;
 
+    const int64_t start = g_get_monotonic_time();
     QStyleOption o;
     o.initFrom(this);
     QPainter p(this);
@@ -191,6 +192,9 @@ void Viewport::paintEvent(QPaintEvent *event)
             _curSignalHeight = _view.get_signalHeight();
 
 	p.end();
+
+    _view.session().get_stats().add(SessionStats::Paint,
+                                    g_get_monotonic_time() - start);
 }
 
 void Viewport::paintSignals(QPainter &p, QColor fore, QColor back)
@@ -60,7 +60,15 @@ void ViewStatus::paintEvent(QPaintEvent *)
     if (_session.get_device()->dev_inst()->mode == LOGIC) {
         fore.setAlpha(View::ForeAlpha);
         p.setPen(fore);
-        p.drawText(this->rect(), Qt::AlignLeft | Qt::AlignVCenter, _rle_depth);
+        QRect left_rect = this->rect();
+        _segment_rect = QRect();
+        if (_session.get_segment_num() != 0) {
+            const QString text = segment_text();
+            _segment_rect = p.boundingRect(left_rect, Qt::AlignLeft | Qt::AlignVCenter, text);
+            p.drawText(_segment_rect, Qt::AlignCenter, text);
+            left_rect.setLeft(_segment_rect.right() + SegmentMargin);
+        }
+        p.drawText(left_rect, Qt::AlignLeft | Qt::AlignVCenter, _rle_depth);
         p.drawText(this->rect(), Qt::AlignRight | Qt::AlignVCenter, _trig_time);
 
         p.setPen(Qt::NoPen);
@@ -180,10 +188,33 @@ void ViewStatus::set_capture_status(bool triggered, int progess)
     }
 }
 
+QString ViewStatus::segment_text() const
+{
+    const int cur = _session.get_cur_segment();
+    const int num = _session.get_segment_num();
+    if (cur < 0)
+        return QString::number(num) + tr(" Segments");
+    else
+        return "<  " + tr("Segment ") + QString::number(cur + 1) + "/" +
+               QString::number(num) + "  >";
+}
+
 void ViewStatus::mousePressEvent(QMouseEvent *event)
 {
     assert(event);
 
+    if (_session.get_device()->dev_inst()->mode == LOGIC &&
+        event->button() == Qt::LeftButton &&
+        _segment_rect.contains(event->pos())) {
+        // the left half goes to the previous segment, the right half to the next one
+        const int cur = _session.get_cur_segment();
+        if (event->pos().x() < _segment_rect.center().x())
+            _session.select_segment(cur < 0 ? _session.get_segment_num() - 1 : cur - 1);
+        else
+            _session.select_segment(cur + 1);
+        return;
+    }
+
     if (_session.get_device()->dev_inst()->mode != DSO)
         return;
 
@@ -45,6 +45,10 @@ class DsoSignal;
 class ViewStatus : public QWidget
 {
     Q_OBJECT
+
+private:
+    static const int SegmentMargin = 20;
+
 public:
     ViewStatus(SigSession &session, View &parent);
 
@@ -67,6 +71,9 @@ public slots:
     void set_rle_depth(uint64_t depth);
     void set_capture_status(bool triggered, int progess);
 
+private:
+    QString segment_text() const;
+
 private:
     SigSession &_session;
     View &_view;
@@ -75,6 +82,7 @@ private:
     QString _trig_time;
     QString _rle_depth;
     QString _capture_status;
+    QRect _segment_rect;
 
     int _last_sig_index;
     std::vector<std::tuple<QRect, int, enum DSO_MEASURE_TYPE>> _mrects;
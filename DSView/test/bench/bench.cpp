@@ -0,0 +1,274 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "bench.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <boost/thread.hpp>
+
+#include "config.h"
+
+using namespace std;
+
+namespace bench {
+
+namespace {
+
+// The leaf block of LogicSnapshot, which StoreSession saves a file of
+const uint64_t SaveBlockSamples = 1 << 24;
+
+boost::mutex output_mutex;
+
+string json_string(const string &s)
+{
+    string out = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        const char c = s[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+uint32_t xorshift32(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Samples until the next toggle, geometric with the given density
+uint64_t toggle_gap(uint32_t &state, uint64_t density)
+{
+    const double u = (xorshift32(state) + 1.0) / 4294967297.0;
+    return 1 + (uint64_t)(-log(u) * 1000000.0 / density);
+}
+
+}
+
+Result::Result(const string &name) :
+    _name(name)
+{
+}
+
+Result& Result::param(const string &key, uint64_t value)
+{
+    char s[32];
+    snprintf(s, sizeof(s), "%" PRIu64, value);
+    _params.push_back(make_pair(key, string(s)));
+    return *this;
+}
+
+Result& Result::param(const string &key, const string &value)
+{
+    _params.push_back(make_pair(key, json_string(value)));
+    return *this;
+}
+
+void Result::report(double value, const string &unit)
+{
+    string line = "{\"version\":" + json_string(DS_VERSION_STRING) +
+                  ",\"benchmark\":" + json_string(_name) +
+                  ",\"params\":{";
+    for (size_t i = 0; i < _params.size(); i++) {
+        if (i)
+            line += ",";
+        line += json_string(_params[i].first) + ":" + _params[i].second;
+    }
+    char s[64];
+    snprintf(s, sizeof(s), "%.6g", value);
+    line += string("},\"value\":") + s + ",\"unit\":" + json_string(unit) + "}\n";
+
+    boost::lock_guard<boost::mutex> lock(output_mutex);
+    const char *const path = getenv("DSVIEW_BENCH_OUTPUT");
+    FILE *const out = (path && *path) ? fopen(path, "a") : stdout;
+    if (!out)
+        return;
+    fputs(line.c_str(), out);
+    if (out == stdout)
+        fflush(out);
+    else
+        fclose(out);
+}
+
+int64_t now()
+{
+    return g_get_monotonic_time();
+}
+
+double mega_rate(uint64_t count, int64_t time)
+{
+    return time > 0 ? (double)count / time : 0;
+}
+
+vector<Bits> random_logic(unsigned int channels, uint64_t samples,
+    uint64_t density, uint32_t seed)
+{
+    vector<Bits> data(channels);
+    const uint64_t words = (samples + 63) / 64;
+    uint32_t state = seed ? seed : 1;
+
+    for (unsigned int ch = 0; ch < channels; ch++) {
+        Bits &bits = data[ch];
+        bits.assign(words, 0);
+        bool value = xorshift32(state) & 1;
+        uint64_t pos = 0;
+        while (pos < words * 64) {
+            const uint64_t next = density ?
+                min(pos + toggle_gap(state, density), words * 64) : words * 64;
+            if (value) {
+                for (uint64_t i = pos; i < next; ) {
+                    const unsigned int bit = i % 64;
+                    const uint64_t n = min<uint64_t>(64 - bit, next - i);
+                    bits[i / 64] |= (n == 64 ? ~0ULL : ((1ULL << n) - 1)) << bit;
+                    i += n;
+                }
+            }
+            value = !value;
+            pos = next;
+        }
+    }
+
+    return data;
+}
+
+vector<uint64_t> cross_data(const vector<Bits> &channels)
+{
+    vector<uint64_t> data;
+    if (channels.empty())
+        return data;
+
+    const size_t words = channels[0].size();
+    data.reserve(words * channels.size());
+    for (size_t i = 0; i < words; i++)
+        for (size_t ch = 0; ch < channels.size(); ch++)
+            data.push_back(channels[ch][i]);
+    return data;
+}
+
+vector<uint8_t> sample_data(const vector<Bits> &channels,
+    uint64_t start, uint64_t count)
+{
+    const unsigned int unitsize = (channels.size() + 7) / 8;
+    vector<uint8_t> data(count * unitsize, 0);
+    for (uint64_t i = 0; i < count; i++) {
+        const uint64_t s = start + i;
+        for (size_t ch = 0; ch < channels.size(); ch++)
+            if ((channels[ch][s / 64] >> (s % 64)) & 1)
+                data[i * unitsize + ch / 8] |= 1 << (ch % 8);
+    }
+    return data;
+}
+
+bool save_dsl(const string &path, const vector<Bits> &channels,
+    uint64_t samples, uint64_t samplerate)
+{
+    const uint64_t block_bytes = SaveBlockSamples / 8;
+    const uint64_t bytes = (samples + 7) / 8;
+    const int blocks = (bytes + block_bytes - 1) / block_bytes;
+
+    const string meta_path = temp_path("meta");
+    FILE *const meta = fopen(meta_path.c_str(), "wb");
+    if (!meta)
+        return false;
+    char *const rate = sr_samplerate_string(samplerate);
+    fprintf(meta, "[version]\n");
+    fprintf(meta, "version = 2\n");
+    fprintf(meta, "[header]\n");
+    fprintf(meta, "driver = virtual-demo\n");
+    fprintf(meta, "device mode = %d\n", LOGIC);
+    fprintf(meta, "capturefile = data\n");
+    fprintf(meta, "total samples = %" PRIu64 "\n", samples);
+    fprintf(meta, "total probes = %d\n", (int)channels.size());
+    fprintf(meta, "total blocks = %d\n", blocks);
+    fprintf(meta, "samplerate = %s\n", rate);
+    fprintf(meta, "trigger pos = 0\n");
+    for (size_t ch = 0; ch < channels.size(); ch++)
+        fprintf(meta, "probe%d = %d\n", (int)ch, (int)ch);
+    fclose(meta);
+    g_free(rate);
+
+    if (sr_session_save_init(path.c_str(), meta_path.c_str(), NULL, NULL) != SR_OK)
+        return false;
+
+    for (size_t ch = 0; ch < channels.size(); ch++) {
+        const uint8_t *const data = (const uint8_t*)channels[ch].data();
+        for (int blk = 0; blk < blocks; blk++) {
+            const uint64_t offset = blk * block_bytes;
+            const uint64_t size = min(block_bytes, bytes - offset);
+            if (sr_session_append(path.c_str(), data + offset, size,
+                                  blk, ch, SR_CHANNEL_LOGIC, 2) != SR_OK)
+                return false;
+        }
+    }
+    return true;
+}
+
+Probes::Probes(unsigned int count, int type) :
+    _channels(count),
+    _names(count),
+    _list(NULL)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "%u", i);
+        _names[i] = name;
+
+        sr_channel &ch = _channels[i];
+        memset(&ch, 0, sizeof(ch));
+        ch.index = i;
+        ch.type = type;
+        ch.enabled = TRUE;
+        ch.name = (char*)_names[i].c_str();
+        _list = g_slist_append(_list, &ch);
+    }
+}
+
+Probes::~Probes()
+{
+    g_slist_free(_list);
+}
+
+GSList* Probes::list() const
+{
+    return _list;
+}
+
+string temp_path(const string &name)
+{
+    return string(g_get_tmp_dir()) + G_DIR_SEPARATOR_S + "DSView-bench-" + name;
+}
+
+} // namespace bench
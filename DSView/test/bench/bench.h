@@ -0,0 +1,129 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_TEST_BENCH_BENCH_H
+#define DSVIEW_TEST_BENCH_BENCH_H
+
+#include <libsigrok4DSL/libsigrok.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+/**
+ * One measurement, written as one JSON object per line to the file
+ * named by DSVIEW_BENCH_OUTPUT (appended), or to stdout:
+ *
+ *   {"version":"1.0.1","benchmark":"logic/append",
+ *    "params":{"channels":16,"format":"cross"},
+ *    "value":812.5,"unit":"Msamples/s"}
+ */
+class Result
+{
+public:
+    Result(const std::string &name);
+
+    Result& param(const std::string &key, uint64_t value);
+    Result& param(const std::string &key, const std::string &value);
+
+    void report(double value, const std::string &unit);
+
+private:
+    const std::string _name;
+    std::vector<std::pair<std::string, std::string> > _params;
+};
+
+// Monotonic time in us
+int64_t now();
+
+// Runs f the given times, returns the shortest time in us
+template<typename F>
+int64_t best_time(unsigned int runs, F f)
+{
+    int64_t best = INT64_MAX;
+    while (runs--) {
+        const int64_t start = now();
+        f();
+        best = std::min(best, now() - start);
+    }
+    return std::max<int64_t>(best, 1);
+}
+
+// Rate in millions per second of count items handled in time us
+double mega_rate(uint64_t count, int64_t time);
+
+/**
+ * The logic data of a channel, as a packed bit array (LSB first).
+ * The channels toggle at random, density times per million samples
+ * on average, the same for each seed.
+ */
+typedef std::vector<uint64_t> Bits;
+
+std::vector<Bits> random_logic(unsigned int channels, uint64_t samples,
+    uint64_t density, uint32_t seed);
+
+// The channels in the LA_CROSS_DATA layout, for each 64 samples one
+// word of each channel in turn
+std::vector<uint64_t> cross_data(const std::vector<Bits> &channels);
+
+// The samples as the output modules take them, unitsize bytes each
+std::vector<uint8_t> sample_data(const std::vector<Bits> &channels,
+    uint64_t start, uint64_t count);
+
+/**
+ * Writes the channels to a .dsl file, in blocks of a LogicSnapshot leaf
+ * like StoreSession does. The probes are named by their index.
+ */
+bool save_dsl(const std::string &path, const std::vector<Bits> &channels,
+    uint64_t samples, uint64_t samplerate);
+
+/**
+ * Logic channels to pass to first_payload(), like the probes of a
+ * device.
+ */
+class Probes
+{
+public:
+    Probes(unsigned int count, int type = SR_CHANNEL_LOGIC);
+    ~Probes();
+
+    GSList* list() const;
+
+private:
+    std::vector<sr_channel> _channels;
+    std::vector<std::string> _names;
+    GSList *_list;
+};
+
+// A file name in the temporary directory
+std::string temp_path(const std::string &name);
+
+// The libsigrok context of the benchmarks
+sr_context* sr_ctx();
+
+} // namespace bench
+
+#endif // DSVIEW_TEST_BENCH_BENCH_H
@@ -0,0 +1,247 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "../../cli/capture.h"
+#include "../../cli/decodejob.h"
+#include "bench.h"
+
+using namespace std;
+
+namespace {
+
+const uint64_t Samples = 1 << 22;
+const uint64_t Samplerate = 1000000;
+const unsigned int Runs = 3;
+
+/*
+ * Builds the channels of a capture sample by sample, from the levels
+ * of all channels as a bit mask.
+ */
+class Waveform
+{
+public:
+    Waveform(unsigned int channels) :
+        _channels(channels, bench::Bits((Samples + 63) / 64, 0)),
+        _pos(0),
+        _seed(1)
+    {
+    }
+
+    bool full() const
+    {
+        return _pos >= Samples;
+    }
+
+    void hold(unsigned int levels, uint64_t samples)
+    {
+        for (; samples && _pos < Samples; samples--, _pos++)
+            for (size_t ch = 0; ch < _channels.size(); ch++)
+                if ((levels >> ch) & 1)
+                    _channels[ch][_pos / 64] |= 1ULL << (_pos % 64);
+    }
+
+    uint8_t random_byte()
+    {
+        _seed = _seed * 1103515245 + 12345;
+        return _seed >> 16;
+    }
+
+    const vector<bench::Bits>& channels() const
+    {
+        return _channels;
+    }
+
+private:
+    vector<bench::Bits> _channels;
+    uint64_t _pos;
+    uint32_t _seed;
+};
+
+// 8N1 frames back to back, 8 samples a bit
+vector<bench::Bits> uart_capture()
+{
+    const uint64_t bit = 8;
+    Waveform w(1);
+    while (!w.full()) {
+        const uint8_t data = w.random_byte();
+        w.hold(0, bit);
+        for (int i = 0; i < 8; i++)
+            w.hold((data >> i) & 1, bit);
+        w.hold(1, 2 * bit);
+    }
+    return w.channels();
+}
+
+// clk, mosi, miso, cs#: mode 0 transfers of 8 bytes, 4 samples a bit
+vector<bench::Bits> spi_capture()
+{
+    Waveform w(4);
+    while (!w.full()) {
+        w.hold(0x8, 8);
+        for (int byte = 0; byte < 8; byte++) {
+            const uint8_t mosi = w.random_byte();
+            const uint8_t miso = w.random_byte();
+            for (int i = 7; i >= 0; i--) {
+                const unsigned int levels = (((mosi >> i) & 1) << 1) |
+                                            (((miso >> i) & 1) << 2);
+                w.hold(levels, 2);
+                w.hold(levels | 0x1, 2);
+            }
+        }
+        w.hold(0, 2);
+    }
+    return w.channels();
+}
+
+// scl, sda: writes of 4 bytes to a slave which acks them, 4 samples a bit
+vector<bench::Bits> i2c_capture()
+{
+    Waveform w(2);
+    while (!w.full()) {
+        w.hold(0x3, 8);
+        // start
+        w.hold(0x1, 2);
+        w.hold(0x0, 2);
+        for (int byte = 0; byte < 5; byte++) {
+            const uint8_t data = byte ? w.random_byte() : 0xa0;
+            for (int i = 8; i >= 0; i--) {
+                // the ack is low
+                const unsigned int sda = (i > 0) ? ((data >> (i - 1)) & 1) << 1 : 0;
+                w.hold(sda, 1);
+                w.hold(sda | 0x1, 2);
+                w.hold(sda, 1);
+            }
+        }
+        // stop
+        w.hold(0x0, 1);
+        w.hold(0x1, 2);
+        w.hold(0x3, 1);
+    }
+    return w.channels();
+}
+
+struct Protocol {
+    const char *name;
+    vector<bench::Bits> (*capture)();
+    const char *stack;
+};
+
+const Protocol protocols[] = {
+    {"uart", uart_capture, "1:uart:rxtx=0:baudrate=125000"},
+    {"spi", spi_capture, "1:spi:clk=0:mosi=1:miso=2:cs=3"},
+    {"i2c", i2c_capture, "1:i2c:scl=0:sda=1"},
+};
+
+}
+
+BOOST_AUTO_TEST_SUITE(DecodeBench)
+
+/*
+ * Canned captures of the common protocols, saved to a .dsl file and
+ * decoded like DSView-cli does it.
+ */
+BOOST_AUTO_TEST_CASE(Protocols)
+{
+    BOOST_REQUIRE(bench::sr_ctx());
+
+    for (unsigned int p = 0; p < sizeof(protocols) / sizeof(protocols[0]); p++) {
+        const Protocol &protocol = protocols[p];
+        const string path = bench::temp_path(string(protocol.name) + ".dsl");
+        BOOST_REQUIRE(bench::save_dsl(path, protocol.capture(), Samples, Samplerate));
+
+        string error;
+        cli::Capture capture(bench::sr_ctx());
+        BOOST_REQUIRE_MESSAGE(capture.load(path, error), error);
+        unlink(path.c_str());
+
+        long annotations = 0;
+        const int64_t time = bench::best_time(Runs, [&]{
+            FILE *const out = tmpfile();
+            BOOST_REQUIRE(out);
+            cli::DecodeJob job(capture, out, string());
+            BOOST_REQUIRE_MESSAGE(job.add_stack(protocol.stack, error), error);
+            BOOST_REQUIRE_MESSAGE(job.run(error), error);
+            fflush(out);
+            annotations = ftell(out);
+            fclose(out);
+        });
+        BOOST_CHECK(annotations > 0);
+
+        bench::Result("decode/protocol")
+            .param("decoder", protocol.name).param("samples", Samples)
+            .param("samplerate", Samplerate)
+            .report(bench::mega_rate(Samples, time), "Msamples/s");
+    }
+}
+
+/*
+ * The same captures decoded with the Python decoders and with their
+ * native implementations, which have to put the same annotations.
+ */
+BOOST_AUTO_TEST_CASE(Native)
+{
+    BOOST_REQUIRE(bench::sr_ctx());
+
+    for (unsigned int p = 0; p < sizeof(protocols) / sizeof(protocols[0]); p++) {
+        const Protocol &protocol = protocols[p];
+        const string path = bench::temp_path(string(protocol.name) + ".dsl");
+        BOOST_REQUIRE(bench::save_dsl(path, protocol.capture(), Samples, Samplerate));
+
+        string error;
+        cli::Capture capture(bench::sr_ctx());
+        BOOST_REQUIRE_MESSAGE(capture.load(path, error), error);
+        unlink(path.c_str());
+
+        string output[2];
+        for (int native = 0; native < 2; native++) {
+            const int64_t time = bench::best_time(Runs, [&]{
+                FILE *const out = tmpfile();
+                BOOST_REQUIRE(out);
+                cli::DecodeJob job(capture, out, string());
+                job.set_native(native);
+                BOOST_REQUIRE_MESSAGE(job.add_stack(protocol.stack, error), error);
+                BOOST_REQUIRE_MESSAGE(job.run(error), error);
+                output[native].resize(ftell(out));
+                rewind(out);
+                BOOST_REQUIRE(fread(&output[native][0], 1,
+                    output[native].size(), out) == output[native].size());
+                fclose(out);
+            });
+
+            bench::Result("decode/native")
+                .param("decoder", protocol.name).param("samples", Samples)
+                .param("native", (uint64_t)native)
+                .report(bench::mega_rate(Samples, time), "Msamples/s");
+        }
+        BOOST_CHECK(!output[0].empty());
+        BOOST_CHECK(output[0] == output[1]);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
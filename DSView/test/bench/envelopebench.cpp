@@ -0,0 +1,142 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <boost/shared_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <math.h>
+#include <string.h>
+
+#include <map>
+#include <vector>
+
+#include "../../pv/data/analogsnapshot.h"
+#include "../../pv/data/dsosnapshot.h"
+#include "bench.h"
+
+using namespace std;
+using pv::data::AnalogSnapshot;
+using pv::data::DsoSnapshot;
+
+namespace {
+
+const unsigned int Channels = 2;
+const unsigned int Runs = 3;
+
+const uint64_t AnalogSamples = 1 << 24;
+const uint64_t AnalogPacketSamples = 1 << 16;
+
+const uint64_t DsoSamples = 1 << 20;
+const unsigned int DsoFrames = 20;
+
+// 8 bit samples of each channel in turn, sine waves with some noise
+vector<uint8_t> waveform(uint64_t samples)
+{
+    vector<uint8_t> data(samples * Channels);
+    uint32_t seed = 1;
+    for (uint64_t i = 0; i < samples; i++) {
+        for (unsigned int ch = 0; ch < Channels; ch++) {
+            seed = seed * 1103515245 + 12345;
+            const double v = 128 + 100 * sin(i * (ch + 1) * 0.001) +
+                             (int)((seed >> 16) % 16) - 8;
+            data[i * Channels + ch] = (uint8_t)max(0.0, min(255.0, v));
+        }
+    }
+    return data;
+}
+
+boost::shared_ptr<AnalogSnapshot> analog_ingest(const vector<uint8_t> &data,
+    const bench::Probes &probes)
+{
+    boost::shared_ptr<AnalogSnapshot> snapshot(new AnalogSnapshot());
+    snapshot->init();
+
+    sr_datafeed_analog analog;
+    memset(&analog, 0, sizeof(analog));
+    analog.probes = probes.list();
+    analog.unit_bits = 8;
+    analog.num_samples = AnalogPacketSamples;
+    for (uint64_t i = 0; i < AnalogSamples; i += AnalogPacketSamples) {
+        analog.data = (void*)&data[i * Channels];
+        if (i == 0)
+            snapshot->first_payload(analog, AnalogSamples, probes.list());
+        else
+            snapshot->append_payload(analog);
+    }
+    snapshot->capture_ended();
+    return snapshot;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(EnvelopeBench)
+
+// Ingest of a data recorder capture, including its envelope levels
+BOOST_AUTO_TEST_CASE(AnalogAppend)
+{
+    const vector<uint8_t> data = waveform(AnalogSamples);
+    const bench::Probes probes(Channels, SR_CHANNEL_ANALOG);
+
+    boost::shared_ptr<AnalogSnapshot> snapshot;
+    const int64_t time = bench::best_time(Runs, [&]{
+        snapshot = analog_ingest(data, probes);
+    });
+    BOOST_REQUIRE_EQUAL(snapshot->get_sample_count(), AnalogSamples);
+
+    bench::Result("analog/append")
+        .param("channels", Channels).param("packet_samples", AnalogPacketSamples)
+        .report(bench::mega_rate(AnalogSamples, time), "Msamples/s");
+}
+
+// Oscilloscope frames, each one replaces the last one and rebuilds
+// the envelope
+BOOST_AUTO_TEST_CASE(DsoEnvelope)
+{
+    const vector<uint8_t> data = waveform(DsoSamples);
+    map<int, bool> ch_enable;
+    for (unsigned int ch = 0; ch < Channels; ch++)
+        ch_enable[ch] = true;
+
+    sr_datafeed_dso dso;
+    memset(&dso, 0, sizeof(dso));
+    dso.num_samples = DsoSamples;
+    dso.data = (void*)data.data();
+
+    for (int envelope = 0; envelope < 2; envelope++) {
+        boost::shared_ptr<DsoSnapshot> snapshot(new DsoSnapshot());
+        snapshot->init();
+        snapshot->first_payload(dso, DsoSamples, ch_enable, false);
+        snapshot->enable_envelope(envelope);
+
+        const int64_t time = bench::best_time(Runs, [&]{
+            for (unsigned int i = 0; i < DsoFrames; i++)
+                snapshot->append_payload(dso);
+        });
+        BOOST_REQUIRE_EQUAL(snapshot->get_sample_count(), DsoSamples);
+
+        bench::Result("dso/frame")
+            .param("channels", Channels).param("samples", DsoSamples)
+            .param("envelope", envelope ? "on" : "off")
+            .report((double)time / DsoFrames / 1000, "ms/frame");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,74 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <math.h>
+
+#include <vector>
+
+#include "../../pv/data/powerspectrum.h"
+#include "bench.h"
+
+using namespace std;
+
+
+namespace {
+
+const unsigned int Runs = 3;
+const unsigned int Transforms = 100;
+
+}
+
+BOOST_AUTO_TEST_SUITE(FftBench)
+
+/*
+ * The computation of SpectrumStack::calc_fft(), which needs a session
+ * with a signal: window, real FFT and power spectrum, for the lengths
+ * and windows the spectrum supports.
+ */
+BOOST_AUTO_TEST_CASE(PowerSpectrum)
+{
+    const uint64_t lengths[] = {1024, 2048, 4096, 8192, 16384};
+    const char *const windows[] = {"rectangle", "hann", "hamming", "blackman", "flat_top"};
+    for (unsigned int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        const uint64_t n = lengths[l];
+        vector<uint8_t> samples(n);
+        for (uint64_t i = 0; i < n; i++)
+            samples[i] = 128 + 100 * sin(i * 0.05);
+
+        pv::data::PowerSpectrum spectrum;
+        spectrum.set_sample_num(n);
+        for (int w = 0; w < 5; w++) {
+            const int64_t time = bench::best_time(Runs, [&]{
+                for (unsigned int t = 0; t < Transforms; t++)
+                    spectrum.calc(samples.data(), 1, 128, 1.0, w);
+            });
+            BOOST_CHECK_EQUAL(spectrum.get_spectrum().size(), n / 2 + 1);
+
+            bench::Result("fft/power_spectrum")
+                .param("length", n).param("window", windows[w])
+                .report((double)time / Transforms, "us/call");
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,276 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <boost/shared_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <string.h>
+
+#include <map>
+
+#include <QString>
+
+#include "../../pv/data/logicsnapshot.h"
+#include "bench.h"
+
+using namespace std;
+using pv::data::LogicSnapshot;
+
+namespace {
+
+// One leaf block of the snapshot for each channel
+const uint64_t Samples = 1 << 24;
+const uint64_t PacketSamples = 1 << 20;
+const unsigned int Runs = 3;
+
+const uint64_t QueryChannels = 16;
+const uint16_t ViewWidth = 1920;
+const unsigned int Queries = 200;
+
+// Sends the channels in packets like a device of the given format. With
+// laps, they go round that many times into a ring of Samples.
+boost::shared_ptr<LogicSnapshot> ingest(const vector<bench::Bits> &channels,
+    const bench::Probes &probes, bool split, unsigned int laps = 1)
+{
+    boost::shared_ptr<LogicSnapshot> snapshot(new LogicSnapshot());
+    snapshot->init();
+    const uint64_t packet_words = PacketSamples / 64;
+    vector<uint64_t> cross;
+    if (!split)
+        cross = bench::cross_data(channels);
+
+    sr_datafeed_logic logic;
+    memset(&logic, 0, sizeof(logic));
+    logic.format = split ? LA_SPLIT_DATA : LA_CROSS_DATA;
+    logic.unitsize = 1;
+
+    bool first = true;
+    for (uint64_t word = 0; word < laps * Samples / 64; word += packet_words) {
+        for (unsigned int ch = 0; ch < (split ? channels.size() : 1); ch++) {
+            const uint64_t lap_word = word % (Samples / 64);
+            if (split) {
+                logic.index = ch;
+                logic.order = ch;
+                logic.data = (void*)&channels[ch][lap_word];
+                logic.length = packet_words * sizeof(uint64_t);
+            } else {
+                logic.data = (void*)&cross[lap_word * channels.size()];
+                logic.length = packet_words * sizeof(uint64_t) * channels.size();
+            }
+            if (first)
+                snapshot->first_payload(logic, Samples, probes.list(), laps > 1);
+            else
+                snapshot->append_payload(logic);
+            first = false;
+        }
+    }
+    snapshot->capture_ended();
+    return snapshot;
+}
+
+// A snapshot to query, made once for each density
+boost::shared_ptr<LogicSnapshot> query_snapshot(uint64_t density)
+{
+    static map<uint64_t, boost::shared_ptr<LogicSnapshot> > snapshots;
+    static bench::Probes probes(QueryChannels);
+
+    if (!snapshots[density])
+        snapshots[density] = ingest(
+            bench::random_logic(QueryChannels, Samples, density, 1),
+            probes, false);
+    return snapshots[density];
+}
+
+uint64_t random_start(uint32_t &seed, uint64_t span)
+{
+    seed = seed * 1103515245 + 12345;
+    return span < Samples ? ((uint64_t)seed << 8) % (Samples - span) : 0;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(LogicBench)
+
+// Ingest of the packets into the snapshot, including its mipmap
+BOOST_AUTO_TEST_CASE(Append)
+{
+    const unsigned int channel_counts[] = {1, 8, 16, 32};
+    for (unsigned int c = 0; c < sizeof(channel_counts) / sizeof(channel_counts[0]); c++) {
+        const unsigned int count = channel_counts[c];
+        const vector<bench::Bits> channels =
+            bench::random_logic(count, Samples, 1000, count);
+        const bench::Probes probes(count);
+
+        for (int split = 0; split < 2; split++) {
+            int64_t best = INT64_MAX;
+            uint64_t mipmap_time = 0;
+            for (unsigned int run = 0; run < Runs; run++) {
+                const int64_t start = bench::now();
+                boost::shared_ptr<LogicSnapshot> snapshot = ingest(channels, probes, split);
+                const int64_t time = bench::now() - start;
+                BOOST_REQUIRE_EQUAL(snapshot->get_sample_count(), Samples);
+                if (time < best) {
+                    best = time;
+                    mipmap_time = snapshot->get_mipmap_time();
+                }
+            }
+
+            const char *const format = split ? "split" : "cross";
+            bench::Result("logic/append")
+                .param("channels", count).param("format", format)
+                .report(bench::mega_rate(Samples, best), "Msamples/s");
+            bench::Result("logic/append_bytes")
+                .param("channels", count).param("format", format)
+                .report(bench::mega_rate(Samples / 8 * count, best), "MB/s");
+            bench::Result("logic/mipmap")
+                .param("channels", count).param("format", format)
+                .report(bench::mega_rate(Samples * count, mipmap_time),
+                        "Msamples/s per channel");
+        }
+    }
+}
+
+// An endless capture in roll mode, which keeps about its last Samples
+BOOST_AUTO_TEST_CASE(RingAppend)
+{
+    const unsigned int count = 16;
+    const unsigned int laps = 4;
+    const vector<bench::Bits> channels = bench::random_logic(count, Samples, 1000, count);
+    const bench::Probes probes(count);
+
+    for (int split = 0; split < 2; split++) {
+        boost::shared_ptr<LogicSnapshot> snapshot;
+        const int64_t time = bench::best_time(Runs, [&]{
+            snapshot = ingest(channels, probes, split, laps);
+        });
+
+        // the window ends with the last lap
+        const uint64_t sample_count = snapshot->get_sample_count();
+        BOOST_REQUIRE(sample_count >= Samples);
+        BOOST_REQUIRE(sample_count <= LogicSnapshot::get_ring_capacity(Samples));
+        const uint64_t start = laps * Samples - sample_count;
+        uint32_t seed = 1;
+        for (unsigned int i = 0; i < Queries; i++) {
+            seed = seed * 1103515245 + 12345;
+            const uint64_t index = ((uint64_t)seed << 8) % sample_count;
+            const uint64_t pos = (start + index) % Samples;
+            const unsigned int ch = i % count;
+            BOOST_REQUIRE_EQUAL(snapshot->get_sample(index, ch),
+                                ((channels[ch][pos / 64] >> (pos % 64)) & 1) != 0);
+        }
+
+        bench::Result("logic/ring_append")
+            .param("channels", count).param("format", split ? "split" : "cross")
+            .param("laps", laps)
+            .report(bench::mega_rate(laps * Samples, time), "Msamples/s");
+    }
+}
+
+// Walks the edges of a channel, like the export and the decoders do,
+// and skips the short pulses, like the cursors do at wider zooms
+BOOST_AUTO_TEST_CASE(NextEdge)
+{
+    const uint64_t densities[] = {1000, 100000};
+    const double min_lengths[] = {1, 64, 4096};
+    for (unsigned int d = 0; d < 2; d++) {
+        boost::shared_ptr<LogicSnapshot> snapshot = query_snapshot(densities[d]);
+        const uint64_t end = Samples - 1;
+
+        for (unsigned int m = 0; m < 3; m++) {
+            uint64_t edges = 0;
+            const int64_t time = bench::best_time(Runs, [&]{
+                edges = 0;
+                uint64_t index = 1;
+                bool sample = snapshot->get_sample(0, 0);
+                while (index <= end &&
+                       snapshot->get_nxt_edge(index, sample, end, min_lengths[m], 0)) {
+                    sample = snapshot->get_sample(index, 0);
+                    index++;
+                    edges++;
+                }
+            });
+            BOOST_CHECK(edges > 0);
+
+            bench::Result("logic/nxt_edge")
+                .param("density", densities[d]).param("min_length", (uint64_t)min_lengths[m])
+                .report(edges ? (double)time / edges : 0, "us/call");
+        }
+    }
+}
+
+// Edges of one viewport of a channel, at a few zooms
+BOOST_AUTO_TEST_CASE(DisplayEdges)
+{
+    const uint64_t densities[] = {1000, 100000};
+    const uint64_t zooms[] = {1, 16, 256, 4096, 8192};
+    vector<pair<bool, bool> > pulses;
+    vector<pair<uint16_t, bool> > togs;
+
+    for (unsigned int d = 0; d < 2; d++) {
+        boost::shared_ptr<LogicSnapshot> snapshot = query_snapshot(densities[d]);
+
+        for (unsigned int z = 0; z < sizeof(zooms) / sizeof(zooms[0]); z++) {
+            const uint64_t span = min<uint64_t>(ViewWidth * zooms[z], Samples);
+            const uint16_t width = span / zooms[z];
+            const int64_t time = bench::best_time(Runs, [&]{
+                uint32_t seed = 1;
+                for (unsigned int i = 0; i < Queries; i++) {
+                    const uint64_t start = random_start(seed, span);
+                    snapshot->get_display_edges(pulses, togs, start,
+                        start + span - 1, width, width / 10,
+                        (double)start / zooms[z], zooms[z], i % QueryChannels);
+                }
+            });
+
+            bench::Result("logic/display_edges")
+                .param("density", densities[d]).param("samples_per_pixel", zooms[z])
+                .param("width", width)
+                .report((double)time / Queries, "us/call");
+        }
+    }
+}
+
+// A pattern which never matches, so the whole range is searched
+BOOST_AUTO_TEST_CASE(PatternSearch)
+{
+    const uint64_t densities[] = {1000, 100000};
+    const int64_t range = 1 << 20;
+    map<uint16_t, QString> pattern;
+    for (uint16_t ch = 0; ch < 8; ch++)
+        pattern[ch] = "R";
+
+    for (unsigned int d = 0; d < 2; d++) {
+        boost::shared_ptr<LogicSnapshot> snapshot = query_snapshot(densities[d]);
+        bool found = false;
+        const int64_t time = bench::best_time(Runs, [&]{
+            int64_t index = 0;
+            found = snapshot->pattern_search(0, range - 1, true, index, pattern);
+        });
+
+        BOOST_WARN(!found);
+
+        bench::Result("logic/pattern_search")
+            .param("density", densities[d]).param("channels", (uint64_t)pattern.size())
+            .report(bench::mega_rate(range, time), "Msamples/s");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
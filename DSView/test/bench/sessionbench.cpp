@@ -0,0 +1,368 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "../../cli/capture.h"
+#include "../../pv/data/logicexport.h"
+#include "../../pv/data/logicsnapshot.h"
+#include "bench.h"
+
+using namespace std;
+
+using pv::data::LogicExport;
+using pv::data::LogicSnapshot;
+
+namespace {
+
+const unsigned int Channels = 16;
+const uint64_t Samples = 1 << 25;
+const uint64_t Samplerate = 100000000;
+const unsigned int Runs = 3;
+
+const uint64_t ExportSamples = 1 << 22;
+const unsigned int Transposes = 20;
+
+uint64_t file_size(const string &path)
+{
+    FILE *const f = fopen(path.c_str(), "rb");
+    if (!f)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fclose(f);
+    return size > 0 ? size : 0;
+}
+
+const sr_output_module* find_output(const char *id)
+{
+    for (const sr_output_module **m = sr_output_list(); *m; m++)
+        if (strcmp((*m)->id, id) == 0)
+            return *m;
+    return NULL;
+}
+
+void write_output(FILE *file, GString *out)
+{
+    if (!out)
+        return;
+    fwrite(out->str, 1, out->len, file);
+    g_string_free(out, TRUE);
+}
+
+// The channels as a capture in a LogicSnapshot, sent in split packets
+boost::shared_ptr<LogicSnapshot> export_snapshot(const vector<bench::Bits> &channels,
+    const bench::Probes &probes)
+{
+    boost::shared_ptr<LogicSnapshot> snapshot(new LogicSnapshot());
+    snapshot->init();
+
+    sr_datafeed_logic logic;
+    memset(&logic, 0, sizeof(logic));
+    logic.format = LA_SPLIT_DATA;
+    logic.unitsize = 1;
+    logic.length = ExportSamples / 8;
+    for (unsigned int ch = 0; ch < channels.size(); ch++) {
+        logic.index = ch;
+        logic.order = ch;
+        logic.data = (void*)channels[ch].data();
+        if (ch == 0)
+            snapshot->first_payload(logic, ExportSamples, probes.list(), false);
+        else
+            snapshot->append_payload(logic);
+    }
+    snapshot->capture_ended();
+    return snapshot;
+}
+
+/*
+ * Runs an output module over the snapshot like StoreSession::export_proc
+ * does, through the same LogicExport conversions. Returns the bytes
+ * written.
+ */
+uint64_t export_file(const sr_output_module *module, const string &path,
+    LogicSnapshot &snapshot, const bench::Probes &probes, bool edges)
+{
+    sr_dev_inst sdi;
+    memset(&sdi, 0, sizeof(sdi));
+    sdi.mode = LOGIC;
+    sdi.channels = probes.list();
+
+    GHashTable *const params = g_hash_table_new(g_str_hash, g_str_equal);
+    GVariant *const filename = g_variant_new_bytestring(path.c_str());
+    g_hash_table_insert(params, (char*)"filename", filename);
+    g_hash_table_insert(params, (char*)"type", g_variant_new_int16(SR_CHANNEL_LOGIC));
+
+    sr_output output;
+    output.module = module;
+    output.sdi = &sdi;
+    output.param = NULL;
+    output.priv = NULL;
+    if (module->init)
+        module->init(&output, params);
+
+    FILE *const file = fopen(path.c_str(), "wb");
+    BOOST_REQUIRE(file);
+
+    GString *out = NULL;
+    sr_datafeed_packet p;
+    sr_datafeed_meta meta;
+    meta.config = g_slist_append(NULL,
+        sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(Samplerate)));
+    meta.config = g_slist_append(meta.config,
+        sr_config_new(SR_CONF_LIMIT_SAMPLES, g_variant_new_uint64(ExportSamples)));
+    p.type = SR_DF_META;
+    p.status = SR_PKT_OK;
+    p.payload = &meta;
+    module->receive(&output, &p, &out);
+    write_output(file, out);
+    for (GSList *l = meta.config; l; l = l->next)
+        sr_config_free((sr_config*)l->data);
+    g_slist_free(meta.config);
+
+    vector<int> ch_vec;
+    for (unsigned int ch = 0; ch < Channels; ch++)
+        if (snapshot.has_data(ch))
+            ch_vec.push_back(ch);
+
+    if (edges) {
+        LogicExport::edges(snapshot, ch_vec, [&](const sr_datafeed_logic_edge &ep) {
+            p.type = SR_DF_LOGIC_EDGE;
+            p.payload = &ep;
+            module->receive(&output, &p, &out);
+            write_output(file, out);
+        });
+    } else {
+        vector<const uint8_t *> buf_vec;
+        vector<uint8_t> buf_fill;
+        vector<uint8_t> xbuf;
+        sr_datafeed_logic lp;
+        memset(&lp, 0, sizeof(lp));
+        for (int blk = 0; blk < snapshot.get_block_num(); blk++) {
+            const uint64_t block_samples = snapshot.get_block_size(blk) * 8;
+            buf_vec.clear();
+            buf_fill.clear();
+            for (unsigned int k = 0; k < ch_vec.size(); k++) {
+                bool sample;
+                buf_vec.push_back(snapshot.get_block_buf(blk, ch_vec[k], sample));
+                buf_fill.push_back(sample ? 0xff : 0x00);
+            }
+
+            const uint16_t unitsize = (buf_vec.size() + 7) / 8;
+            xbuf.resize(LogicExport::ChunkSamples * unitsize);
+            for (uint64_t i = 0; i < block_samples; i += LogicExport::ChunkSamples) {
+                const uint64_t size = min(LogicExport::ChunkSamples, block_samples - i);
+                LogicExport::transpose_cross(xbuf.data(), unitsize, buf_vec,
+                                             buf_fill, i / 8, size / 8);
+                lp.data = xbuf.data();
+                lp.length = size * unitsize;
+                lp.unitsize = unitsize;
+                p.type = SR_DF_LOGIC;
+                p.payload = &lp;
+                module->receive(&output, &p, &out);
+                write_output(file, out);
+            }
+        }
+    }
+
+    fclose(file);
+    module->cleanup(&output);
+    g_hash_table_destroy(params);
+    g_variant_unref(filename);
+    return file_size(path);
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(SessionBench)
+
+// Saving a capture to a .dsl file and loading it again
+BOOST_AUTO_TEST_CASE(SaveLoad)
+{
+    BOOST_REQUIRE(bench::sr_ctx());
+    const string path = bench::temp_path("save.dsl");
+    const uint64_t densities[] = {1000, 100000};
+
+    for (unsigned int d = 0; d < 2; d++) {
+        const vector<bench::Bits> channels =
+            bench::random_logic(Channels, Samples, densities[d], 1);
+
+        const int64_t save_time = bench::best_time(Runs, [&]{
+            BOOST_REQUIRE(bench::save_dsl(path, channels, Samples, Samplerate));
+        });
+        const uint64_t size = file_size(path);
+
+        bench::Result("session/save")
+            .param("channels", Channels).param("samples", Samples)
+            .param("density", densities[d])
+            .report(bench::mega_rate(Samples, save_time), "Msamples/s");
+        bench::Result("session/file_size")
+            .param("channels", Channels).param("samples", Samples)
+            .param("density", densities[d])
+            .report(size / (1024.0 * 1024.0), "MB");
+
+        string error;
+        const int64_t load_time = bench::best_time(Runs, [&]{
+            cli::Capture capture(bench::sr_ctx());
+            BOOST_REQUIRE_MESSAGE(capture.load(path, error), error);
+            BOOST_REQUIRE_EQUAL(capture.sample_count(), Samples);
+        });
+
+        bench::Result("session/load")
+            .param("channels", Channels).param("samples", Samples)
+            .param("density", densities[d])
+            .report(bench::mega_rate(Samples, load_time), "Msamples/s");
+    }
+
+    unlink(path.c_str());
+}
+
+// A .dsl file sent by the demo device, once through and unpaced
+BOOST_AUTO_TEST_CASE(Replay)
+{
+    BOOST_REQUIRE(bench::sr_ctx());
+    const string path = bench::temp_path("replay.dsl");
+    const vector<bench::Bits> channels =
+        bench::random_logic(Channels, Samples, 1000, 1);
+    BOOST_REQUIRE(bench::save_dsl(path, channels, Samples, Samplerate));
+
+    cli::Capture::Benchmark bench;
+    bench.enabled = true;
+    bench.channels = Channels;
+    bench.replay = path;
+    bench.loop = false;
+
+    for (int split = 0; split < 2; split++) {
+        bench.split = split;
+        string error;
+        const int64_t time = bench::best_time(Runs, [&]{
+            cli::Capture capture(bench::sr_ctx());
+            // More than the file holds, the replay ends with it
+            BOOST_REQUIRE_MESSAGE(capture.capture_demo(0, 2 * Samples, bench, error),
+                error);
+            BOOST_REQUIRE_EQUAL(capture.samplerate(), Samplerate);
+            BOOST_REQUIRE_EQUAL(capture.sample_count(), Samples);
+            for (unsigned int ch = 0; ch < Channels; ch++)
+                BOOST_REQUIRE(memcmp(capture.channels()[ch].data.data(),
+                    channels[ch].data(), Samples / 8) == 0);
+        });
+
+        bench::Result("session/replay")
+            .param("channels", Channels).param("samples", Samples)
+            .param("format", split ? "split" : "cross")
+            .report(bench::mega_rate(Samples, time), "Msamples/s");
+    }
+
+    unlink(path.c_str());
+}
+
+// The export formats, through the output modules
+BOOST_AUTO_TEST_CASE(Export)
+{
+    BOOST_REQUIRE(bench::sr_ctx());
+    const bench::Probes probes(Channels);
+    const boost::shared_ptr<LogicSnapshot> snapshot = export_snapshot(
+        bench::random_logic(Channels, ExportSamples, 1000, 1), probes);
+
+    const char *const modules[] = {"csv", "vcd", "gnuplot"};
+    for (unsigned int m = 0; m < sizeof(modules) / sizeof(modules[0]); m++) {
+        const sr_output_module *const module = find_output(modules[m]);
+        if (!module)
+            continue;
+
+        // StoreSession only sends the changes to csv and vcd
+        const bool edges = strcmp(modules[m], "gnuplot") != 0;
+        const string path = bench::temp_path(string("export.") + modules[m]);
+        uint64_t size = 0;
+        const int64_t time = bench::best_time(Runs, [&]{
+            size = export_file(module, path, *snapshot, probes, edges);
+        });
+        BOOST_CHECK(size > 0);
+        unlink(path.c_str());
+
+        bench::Result("session/export")
+            .param("format", modules[m]).param("channels", Channels)
+            .param("samples", ExportSamples).param("edges", edges ? "yes" : "no")
+            .report(bench::mega_rate(ExportSamples, time), "Msamples/s");
+        bench::Result("session/export_size")
+            .param("format", modules[m]).param("channels", Channels)
+            .param("samples", ExportSamples)
+            .report(size / (1024.0 * 1024.0), "MB");
+    }
+}
+
+/*
+ * The split to cross sample conversion of the exports without edges,
+ * for the common channel counts, with busy and constant channels.
+ */
+BOOST_AUTO_TEST_CASE(Transpose)
+{
+    const unsigned int channel_counts[] = {8, 16, 32};
+    const uint64_t densities[] = {1000, 100000};
+    for (unsigned int c = 0; c < 3; c++) {
+        for (unsigned int d = 0; d < 2; d++) {
+            const unsigned int channels = channel_counts[c];
+            const vector<bench::Bits> bits = bench::random_logic(channels,
+                LogicExport::ChunkSamples, densities[d], 1);
+
+            vector<const uint8_t *> buf_vec;
+            vector<uint8_t> buf_fill;
+            for (unsigned int ch = 0; ch < channels; ch++) {
+                // Every other channel a constant leaf, as the snapshot has them
+                buf_vec.push_back((ch % 2) ? NULL : (const uint8_t*)bits[ch].data());
+                buf_fill.push_back((ch % 4 == 1) ? 0xff : 0x00);
+            }
+            const uint16_t unitsize = (channels + 7) / 8;
+            vector<uint8_t> xbuf(LogicExport::ChunkSamples * unitsize);
+
+            const int64_t time = bench::best_time(Runs, [&]{
+                for (unsigned int t = 0; t < Transposes; t++)
+                    LogicExport::transpose_cross(xbuf.data(), unitsize, buf_vec,
+                        buf_fill, 0, LogicExport::ChunkSamples / 8);
+            });
+
+            // Spot check against the bits
+            for (uint64_t i = 0; i < LogicExport::ChunkSamples; i += 4099)
+                for (unsigned int ch = 0; ch < channels; ch++) {
+                    const bool bit = buf_vec[ch] ?
+                        ((bits[ch][i / 64] >> (i % 64)) & 1) : (buf_fill[ch] != 0);
+                    BOOST_REQUIRE_EQUAL((xbuf[i * unitsize + ch / 8] >> (ch % 8)) & 1,
+                        (int)bit);
+                }
+
+            bench::Result("session/transpose")
+                .param("channels", channels).param("density", densities[d])
+                .report(bench::mega_rate(LogicExport::ChunkSamples * Transposes, time),
+                        "Msamples/s");
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
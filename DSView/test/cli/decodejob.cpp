@@ -0,0 +1,177 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <libsigrok4DSL/libsigrok.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../../cli/capture.h"
+#include "../../cli/decodejob.h"
+
+#include "clitest.h"
+
+using namespace std;
+
+namespace {
+
+string path(const char *a, const char *b = NULL, const char *c = NULL)
+{
+    gchar *const p = g_build_filename(a, b, c, NULL);
+    const string ret = p;
+    g_free(p);
+    return ret;
+}
+
+// Runs the stack over the capture, returns the annotation lines
+string decode(const cli::Capture &capture, const char *stack, bool native)
+{
+    string error;
+    FILE *const out = tmpfile();
+    BOOST_REQUIRE(out);
+    {
+        cli::DecodeJob job(capture, out, string());
+        job.set_native(native);
+        BOOST_REQUIRE_MESSAGE(job.add_stack(stack, error), error);
+        BOOST_REQUIRE_MESSAGE(job.run(error), error);
+    }
+
+    string text(ftell(out), '\0');
+    rewind(out);
+    BOOST_REQUIRE(fread(&text[0], 1, text.size(), out) == text.size());
+    fclose(out);
+    return text;
+}
+
+// "AB" as 8N1 frames at 100 kbaud, 10 samples per bit at 1 MHz
+string uart_vcd()
+{
+    string vcd = "$timescale 1us $end\n"
+                 "$var wire 1 ! rx $end\n"
+                 "$enddefinitions $end\n"
+                 "#0\n1!\n";
+
+    const char text[] = "AB";
+    uint64_t t = 100;
+    int level = 1;
+    for (const char *c = text; *c; c++) {
+        int bits[10];
+        bits[0] = 0;
+        for (int i = 0; i < 8; i++)
+            bits[i + 1] = (*c >> i) & 1;
+        bits[9] = 1;
+        for (int i = 0; i < 10; i++, t += 10)
+            if (bits[i] != level) {
+                level = bits[i];
+                vcd += "#" + to_string(t) + "\n" + to_string(level) + "!\n";
+            }
+        t += 50;
+    }
+    vcd += "#" + to_string(t + 100) + "\n";
+    return vcd;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(DecodeJobTest)
+
+BOOST_AUTO_TEST_CASE(OutputNames)
+{
+    vector<string> inputs;
+    inputs.push_back(path("caps", "a", "cap.dsl"));
+    inputs.push_back(path("caps", "b", "cap.dsl"));
+    inputs.push_back(path("caps", "b", "cap.vcd"));
+    inputs.push_back(path("caps", "b", "other.dsl"));
+
+    const vector<string> names = cli::DecodeJob::output_names("out", inputs);
+    BOOST_REQUIRE_EQUAL(names.size(), inputs.size());
+    BOOST_CHECK_EQUAL(names[0], path("out", "a", "cap.txt"));
+    BOOST_CHECK_EQUAL(names[1], path("out", "b", "cap.txt"));
+    BOOST_CHECK_EQUAL(names[2], path("out", "b", "cap-2.txt"));
+    BOOST_CHECK_EQUAL(names[3], path("out", "b", "other.txt"));
+
+    // Files of one directory keep their plain names
+    const vector<string> single = cli::DecodeJob::output_names("out",
+        vector<string>(1, path("caps", "a", "cap.dsl")));
+    BOOST_REQUIRE_EQUAL(single.size(), 1);
+    BOOST_CHECK_EQUAL(single[0], path("out", "cap.txt"));
+
+    // Parent directories stay inside the output directory
+    inputs.clear();
+    inputs.push_back(path("..", "cap.dsl"));
+    inputs.push_back("cap.dsl");
+    const vector<string> parent = cli::DecodeJob::output_names("out", inputs);
+    BOOST_REQUIRE_EQUAL(parent.size(), 2);
+    BOOST_CHECK_EQUAL(parent[0], path("out", "__", "cap.txt"));
+    BOOST_CHECK_EQUAL(parent[1], path("out", "cap.txt"));
+}
+
+BOOST_AUTO_TEST_CASE(Vcd)
+{
+    BOOST_REQUIRE(clitest::sr_ctx());
+
+    const string file = path(g_get_tmp_dir(), "DSView-cli-test-uart.vcd");
+    FILE *const f = fopen(file.c_str(), "w");
+    BOOST_REQUIRE(f);
+    const string vcd = uart_vcd();
+    fwrite(vcd.data(), 1, vcd.size(), f);
+    fclose(f);
+
+    string error;
+    cli::Capture capture(clitest::sr_ctx());
+    const bool loaded = capture.load(file, error);
+    unlink(file.c_str());
+    BOOST_REQUIRE_MESSAGE(loaded, error);
+    BOOST_CHECK_EQUAL(capture.samplerate(), 1000000);
+    BOOST_REQUIRE_EQUAL(capture.channels().size(), 1);
+    BOOST_CHECK(capture.find_channel("rx") == 0);
+
+    const char *const stack = "1:uart:rxtx=rx:baudrate=100000";
+    const string python = decode(capture, stack, false);
+    BOOST_CHECK(python.find(": 41\n") != string::npos);
+    BOOST_CHECK(python.find(": 42\n") != string::npos);
+    BOOST_CHECK(decode(capture, stack, true) == python);
+
+    // Unknown channels and decoders are reported, not decoded
+    cli::DecodeJob job(capture, stdout, string());
+    BOOST_CHECK(!job.add_stack("1:uart:rxtx=tx", error));
+    BOOST_CHECK(!job.add_stack("no-such-decoder", error));
+}
+
+BOOST_AUTO_TEST_CASE(Demo)
+{
+    BOOST_REQUIRE(clitest::sr_ctx());
+
+    string error;
+    cli::Capture capture(clitest::sr_ctx());
+    BOOST_REQUIRE_MESSAGE(capture.capture_demo(1000000, 1024 * 1024,
+        cli::Capture::Benchmark(), error), error);
+    BOOST_CHECK_EQUAL(capture.samplerate(), 1000000);
+    BOOST_CHECK(capture.sample_count() >= 1024 * 1024);
+    BOOST_CHECK(!capture.channels().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,69 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Tests of the parts DSView-cli is made of, with libsigrok and
+ * libsigrokdecode set up once for all of them.
+ */
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE DSView-cli tests
+#include <boost/test/unit_test.hpp>
+
+#include <libsigrok4DSL/libsigrok.h>
+#include <libsigrokdecode4DSL/libsigrokdecode.h>
+
+#include "clitest.h"
+
+char DS_RES_PATH[256];
+
+namespace {
+
+sr_context *context = NULL;
+
+struct Libraries {
+    Libraries() :
+        decode(false)
+    {
+        if (sr_init(&context) != SR_OK)
+            context = NULL;
+        decode = (srd_init(NULL) == SRD_OK);
+    }
+
+    ~Libraries()
+    {
+        if (decode)
+            srd_exit();
+        if (context)
+            sr_exit(context);
+    }
+
+    bool decode;
+};
+
+}
+
+BOOST_GLOBAL_FIXTURE(Libraries);
+
+sr_context* clitest::sr_ctx()
+{
+    return context;
+}
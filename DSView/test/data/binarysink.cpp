@@ -0,0 +1,195 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+extern "C" {
+#include <libsigrokdecode4DSL/libsigrokdecode.h>
+}
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <QDir>
+#include <QFile>
+
+#include "../../pv/data/decode/binarysink.h"
+
+using namespace std;
+
+using pv::data::decode::BinarySink;
+
+BOOST_AUTO_TEST_SUITE(BinarySinkTest)
+
+// The instance and output a decoder would put() its binary data from
+struct Source
+{
+    Source()
+    {
+        memset(&dec, 0, sizeof(dec));
+        memset(&di, 0, sizeof(di));
+        memset(&pdo, 0, sizeof(pdo));
+        di.inst_id = (char*)"1:uart-1";
+        di.decoder = &dec;
+        pdo.di = &di;
+    }
+
+    void put(BinarySink &sink, const vector<uint8_t> &data)
+    {
+        srd_proto_data_binary pdb;
+        pdb.bin_class = 0;
+        pdb.size = data.size();
+        pdb.data = &data[0];
+
+        srd_proto_data pdata;
+        memset(&pdata, 0, sizeof(pdata));
+        pdata.pdo = &pdo;
+        pdata.data = &pdb;
+
+        sink.write(&pdata);
+    }
+
+    srd_decoder dec;
+    srd_decoder_inst di;
+    srd_pd_output pdo;
+};
+
+// A directory of its own, with the path the sink writes the source to
+struct Dir
+{
+    Dir()
+    {
+        char name[] = "/tmp/binarysinkXXXXXX";
+        BOOST_REQUIRE(mkdtemp(name));
+        dir = name;
+        path = QDir(dir).filePath("1_uart-1-0.bin");
+    }
+
+    ~Dir()
+    {
+        unlink(QFile::encodeName(path).constData());
+        rmdir(QFile::encodeName(dir).constData());
+    }
+
+    QString dir;
+    QString path;
+};
+
+static vector<uint8_t> pattern(size_t size)
+{
+    vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+        data[i] = (uint8_t)(i * 7);
+    return data;
+}
+
+BOOST_AUTO_TEST_CASE(File)
+{
+    Dir d;
+    Source src;
+    BinarySink sink(d.dir);
+
+    // More than one buffer, so it's flushed in between
+    const vector<uint8_t> data = pattern(1536 * 1024);
+    const size_t half = data.size() / 2;
+    src.put(sink, vector<uint8_t>(data.begin(), data.begin() + half));
+    src.put(sink, vector<uint8_t>(data.begin() + half, data.end()));
+    sink.close();
+
+    BOOST_CHECK(sink.error().isEmpty());
+    BOOST_CHECK_EQUAL(sink.bytes_written(), data.size());
+
+    QFile file(d.path);
+    BOOST_REQUIRE(file.open(QIODevice::ReadOnly));
+    const QByteArray written = file.readAll();
+    BOOST_REQUIRE_EQUAL((size_t)written.size(), data.size());
+    BOOST_CHECK(memcmp(written.constData(), &data[0], data.size()) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(PipeWithoutReader)
+{
+    Dir d;
+    Source src;
+    BOOST_REQUIRE(mkfifo(QFile::encodeName(d.path).constData(), 0600) == 0);
+
+    // Must not wait for a reader to show up
+    BinarySink sink(d.dir);
+    src.put(sink, pattern(16));
+    sink.close();
+
+    BOOST_CHECK(!sink.error().isEmpty());
+    BOOST_CHECK_EQUAL(sink.bytes_written(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(PipeStalledReader)
+{
+    Dir d;
+    Source src;
+    BOOST_REQUIRE(mkfifo(QFile::encodeName(d.path).constData(), 0600) == 0);
+    const int reader = open(QFile::encodeName(d.path).constData(),
+        O_RDONLY | O_NONBLOCK);
+    BOOST_REQUIRE(reader >= 0);
+
+    // The reader never reads, the write gives up when cancelled
+    BinarySink sink(d.dir);
+    boost::thread canceller([&sink]() {
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(200));
+        sink.cancel();
+    });
+
+    const vector<uint8_t> data = pattern(2 * 1024 * 1024);
+    src.put(sink, data);
+    sink.close();
+    canceller.join();
+
+    BOOST_CHECK(sink.error().isEmpty());
+    BOOST_CHECK(sink.bytes_written() < data.size());
+    close(reader);
+}
+
+BOOST_AUTO_TEST_CASE(PipeReaderGone)
+{
+    Dir d;
+    Source src;
+    BOOST_REQUIRE(mkfifo(QFile::encodeName(d.path).constData(), 0600) == 0);
+    const int reader = open(QFile::encodeName(d.path).constData(),
+        O_RDONLY | O_NONBLOCK);
+    BOOST_REQUIRE(reader >= 0);
+
+    BinarySink sink(d.dir);
+    src.put(sink, pattern(16));
+    close(reader);
+
+    // Reported as an error, not raised as SIGPIPE
+    src.put(sink, pattern(1024 * 1024));
+    sink.close();
+
+    BOOST_CHECK(!sink.error().isEmpty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
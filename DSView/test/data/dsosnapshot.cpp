@@ -0,0 +1,148 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../../pv/data/dsosnapshot.h"
+
+using namespace std;
+
+using pv::data::DsoSnapshot;
+
+BOOST_AUTO_TEST_SUITE(DsoSnapshotTest)
+
+const uint64_t Samples = 1000;
+
+// A frame of two channels, interleaved, channel 1 is the frame number
+// and channel 2 the frame number + 100
+void push_frame(DsoSnapshot &s, uint8_t frame, uint64_t samples, bool first)
+{
+	vector<uint8_t> data(samples * 2);
+	for (uint64_t i = 0; i < samples; i++) {
+		data[i * 2] = frame;
+		data[i * 2 + 1] = frame + 100;
+	}
+
+	sr_datafeed_dso dso;
+	memset(&dso, 0, sizeof(dso));
+	dso.num_samples = samples;
+	dso.data = data.data();
+
+	if (first) {
+		map<int, bool> ch_enable;
+		ch_enable[0] = true;
+		ch_enable[1] = true;
+		s.first_payload(dso, Samples, ch_enable, false);
+	} else {
+		s.append_payload(dso);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(Basic)
+{
+	DsoSnapshot s;
+	s.set_history_depth(3);
+	BOOST_REQUIRE_EQUAL(s._history.size(), 3);
+
+	push_frame(s, 0, Samples, true);
+	BOOST_CHECK_EQUAL(s.get_history_num(), 0);
+
+	// The ring fills oldest first, then wraps and drops the oldest
+	for (uint8_t f = 1; f <= 5; f++) {
+		push_frame(s, f, Samples, false);
+		BOOST_CHECK_EQUAL(s.get_history_num(), min<unsigned int>(f, 3));
+		BOOST_CHECK_EQUAL(s._history_head, f % 3);
+	}
+
+	for (unsigned int k = 0; k < 3; k++) {
+		const uint8_t frame = 2 + k;
+		const uint8_t *const ch0 = s.get_history_samples(k, 0, Samples - 1, 0);
+		const uint8_t *const ch1 = s.get_history_samples(k, 0, Samples - 1, 1);
+		BOOST_REQUIRE(ch0 && ch1);
+		BOOST_CHECK_EQUAL(ch0[0], frame);
+		BOOST_CHECK_EQUAL(ch1[0], frame + 100);
+		BOOST_CHECK_EQUAL(ch0[(Samples - 1) * 2], frame);
+	}
+	BOOST_CHECK_EQUAL(s.get_samples(0, 0, 0)[0], 5);
+
+	// The frame buffers are allocated once, then reused
+	const vector<uint8_t*> buffers = s._history;
+	for (uint8_t f = 6; f <= 10; f++)
+		push_frame(s, f, Samples, false);
+	BOOST_CHECK(s._history == buffers);
+	BOOST_CHECK_EQUAL(s.get_history_samples(0, 0, 0, 0)[0], 7);
+	BOOST_CHECK_EQUAL(s.get_history_samples(2, 0, 0, 0)[0], 9);
+
+	// Same size captures keep the ring, a new depth empties it
+	push_frame(s, 11, Samples, true);
+	BOOST_CHECK_EQUAL(s.get_history_num(), 3);
+	BOOST_CHECK_EQUAL(s.get_history_samples(2, 0, 0, 0)[0], 10);
+
+	s.set_history_depth(2);
+	BOOST_CHECK_EQUAL(s.get_history_num(), 0);
+	push_frame(s, 12, Samples, false);
+	BOOST_CHECK_EQUAL(s.get_history_num(), 1);
+	BOOST_CHECK_EQUAL(s.get_history_samples(0, 0, 0, 0)[0], 11);
+
+	s.set_history_depth(0);
+	push_frame(s, 13, Samples, false);
+	BOOST_CHECK_EQUAL(s.get_history_num(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(HistoryBounds)
+{
+	DsoSnapshot s;
+	s.set_history_depth(2);
+	push_frame(s, 0, Samples, true);
+	push_frame(s, 1, Samples / 2, false);
+	push_frame(s, 2, Samples, false);
+	BOOST_REQUIRE_EQUAL(s.get_history_num(), 2);
+
+	// Each frame has its own length
+	BOOST_CHECK(s.get_history_samples(0, 0, Samples - 1, 0));
+	BOOST_CHECK(!s.get_history_samples(0, 0, Samples, 0));
+	BOOST_CHECK(s.get_history_samples(1, 0, Samples / 2 - 1, 0));
+	BOOST_CHECK(!s.get_history_samples(1, 0, Samples / 2, 0));
+	BOOST_CHECK_EQUAL(s.get_history_samples(1, 0, Samples / 2 - 1, 1)[0], 101);
+
+	BOOST_CHECK(!s.get_history_samples(0, -1, 10, 0));
+	BOOST_CHECK(!s.get_history_samples(0, 10, 9, 0));
+
+	const uint8_t *const first = s.get_history_samples(0, 0, 10, 0);
+	const uint8_t *const later = s.get_history_samples(0, 10, 20, 1);
+	BOOST_REQUIRE(first && later);
+	BOOST_CHECK_EQUAL(later - first, 10 * 2 + 1);
+
+	// Empty frames are not kept
+	DsoSnapshot e;
+	e.set_history_depth(2);
+	push_frame(e, 0, 0, true);
+	push_frame(e, 1, Samples, false);
+	BOOST_CHECK_EQUAL(e.get_history_num(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
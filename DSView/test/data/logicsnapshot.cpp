@@ -22,6 +22,10 @@
 
 #define __STDC_LIMIT_MACROS
 #include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 
@@ -33,395 +37,145 @@ using pv::data::LogicSnapshot;
 
 BOOST_AUTO_TEST_SUITE(LogicSnapshotTest)
 
-void push_logic(LogicSnapshot &s, unsigned int length, uint8_t value)
+// Logic channels 0 to num - 1, all enabled
+GSList *logic_probes(vector<sr_channel> &probes, unsigned int num)
 {
-	sr_datafeed_logic logic;
-	logic.unitsize = 1;
-	logic.length = length;
-	logic.data = new uint8_t[length];
-	memset(logic.data, value, length * logic.unitsize);
-	s.append_payload(logic);
-	delete[] (uint8_t*)logic.data;
+	GSList *l = NULL;
+	probes.resize(num);
+	for (unsigned int i = 0; i < num; i++) {
+		memset(&probes[i], 0, sizeof(sr_channel));
+		probes[i].index = i;
+		probes[i].type = SR_CHANNEL_LOGIC;
+		probes[i].enabled = TRUE;
+		l = g_slist_append(l, &probes[i]);
+	}
+	return l;
 }
 
-BOOST_AUTO_TEST_CASE(Pow2)
+// Cross data holds a word of 64 samples of each channel in turn
+void set_level(vector<uint64_t> &words, unsigned int channels,
+	unsigned int ch, uint64_t start, uint64_t end)
 {
-	BOOST_CHECK_EQUAL(LogicSnapshot::pow2_ceil(0, 0), 0);
-	BOOST_CHECK_EQUAL(LogicSnapshot::pow2_ceil(1, 0), 1);
-	BOOST_CHECK_EQUAL(LogicSnapshot::pow2_ceil(2, 0), 2);
-
-	BOOST_CHECK_EQUAL(
-		LogicSnapshot::pow2_ceil(INT64_MIN, 0), INT64_MIN);
-	BOOST_CHECK_EQUAL(
-		LogicSnapshot::pow2_ceil(INT64_MAX, 0), INT64_MAX);
-
-	BOOST_CHECK_EQUAL(LogicSnapshot::pow2_ceil(0, 1), 0);
-	BOOST_CHECK_EQUAL(LogicSnapshot::pow2_ceil(1, 1), 2);
-	BOOST_CHECK_EQUAL(LogicSnapshot::pow2_ceil(2, 1), 2);
-	BOOST_CHECK_EQUAL(LogicSnapshot::pow2_ceil(3, 1), 4);
+	for (uint64_t i = start; i < end; i++)
+		words[(i / 64) * channels + ch] |= 1ULL << (i % 64);
 }
 
-BOOST_AUTO_TEST_CASE(Basic)
+sr_datafeed_logic cross_logic(const uint8_t *data, uint64_t length)
 {
-	// Create an empty LogicSnapshot object
 	sr_datafeed_logic logic;
-	logic.length = 0;
+	memset(&logic, 0, sizeof(logic));
+	logic.format = LA_CROSS_DATA;
 	logic.unitsize = 1;
-	logic.data = NULL;
-
-	LogicSnapshot s(logic);
-
-	//----- Test LogicSnapshot::push_logic -----//
-
-	BOOST_CHECK(s.get_sample_count() == 0);
-	for (unsigned int i = 0; i < LogicSnapshot::ScaleStepCount; i++)
-	{
-		const LogicSnapshot::MipMapLevel &m = s._mip_map[i];
-		BOOST_CHECK_EQUAL(m.length, 0);
-		BOOST_CHECK_EQUAL(m.data_length, 0);
-		BOOST_CHECK(m.data == NULL);
-	}
-
-	// Push 8 samples of all zeros
-	push_logic(s, 8, 0);
-
-	BOOST_CHECK(s.get_sample_count() == 8);
-
-	// There should not be enough samples to have a single mip map sample
-	for (unsigned int i = 0; i < LogicSnapshot::ScaleStepCount; i++)
-	{
-		const LogicSnapshot::MipMapLevel &m = s._mip_map[i];
-		BOOST_CHECK_EQUAL(m.length, 0);
-		BOOST_CHECK_EQUAL(m.data_length, 0);
-		BOOST_CHECK(m.data == NULL);
-	}
-
-	// Push 8 samples of 0x11s to bring the total up to 16
-	push_logic(s, 8, 0x11);
-
-	// There should now be enough data for exactly one sample
-	// in mip map level 0, and that sample should be 0
-	const LogicSnapshot::MipMapLevel &m0 = s._mip_map[0];
-	BOOST_CHECK_EQUAL(m0.length, 1);
-	BOOST_CHECK_EQUAL(m0.data_length, LogicSnapshot::MipMapDataUnit);
-	BOOST_REQUIRE(m0.data != NULL);
-	BOOST_CHECK_EQUAL(((uint8_t*)m0.data)[0], 0x11);
-
-	// The higher levels should still be empty
-	for (unsigned int i = 1; i < LogicSnapshot::ScaleStepCount; i++)
-	{
-		const LogicSnapshot::MipMapLevel &m = s._mip_map[i];
-		BOOST_CHECK_EQUAL(m.length, 0);
-		BOOST_CHECK_EQUAL(m.data_length, 0);
-		BOOST_CHECK(m.data == NULL);
-	}
-
-	// Push 240 samples of all zeros to bring the total up to 256
-	push_logic(s, 240, 0);
-
-	BOOST_CHECK_EQUAL(m0.length, 16);
-	BOOST_CHECK_EQUAL(m0.data_length, LogicSnapshot::MipMapDataUnit);
-
-	BOOST_CHECK_EQUAL(((uint8_t*)m0.data)[1], 0x11);
-	for (unsigned int i = 2; i < m0.length; i++)
-		BOOST_CHECK_EQUAL(((uint8_t*)m0.data)[i], 0);
-
-	const LogicSnapshot::MipMapLevel &m1 = s._mip_map[1];
-	BOOST_CHECK_EQUAL(m1.length, 1);
-	BOOST_CHECK_EQUAL(m1.data_length, LogicSnapshot::MipMapDataUnit);
-	BOOST_REQUIRE(m1.data != NULL);
-	BOOST_CHECK_EQUAL(((uint8_t*)m1.data)[0], 0x11);
-
-	//----- Test LogicSnapshot::get_subsampled_edges -----//
-
-	// Test a full view at full zoom.
-	vector<LogicSnapshot::EdgePair> edges;
-	s.get_subsampled_edges(edges, 0, 255, 1, 0);
-	BOOST_REQUIRE_EQUAL(edges.size(), 4);
-
-	BOOST_CHECK_EQUAL(edges[0].first, 0);
-	BOOST_CHECK_EQUAL(edges[1].first, 8);
-	BOOST_CHECK_EQUAL(edges[2].first, 16);
-	BOOST_CHECK_EQUAL(edges[3].first, 255);
-
-	// Test a subset at high zoom
-	edges.clear();
-	s.get_subsampled_edges(edges, 6, 17, 0.05f, 0);
-	BOOST_REQUIRE_EQUAL(edges.size(), 4);
-
-	BOOST_CHECK_EQUAL(edges[0].first, 6);
-	BOOST_CHECK_EQUAL(edges[1].first, 8);
-	BOOST_CHECK_EQUAL(edges[2].first, 16);
-	BOOST_CHECK_EQUAL(edges[3].first, 17);
+	logic.length = length;
+	logic.data = (void*)data;
+	return logic;
 }
 
-BOOST_AUTO_TEST_CASE(LargeData)
+// Sends words in packets of at most packet bytes
+void push_logic(LogicSnapshot &s, const vector<uint64_t> &words,
+	uint64_t total_sample_count, GSList *probes, uint64_t packet)
 {
-	uint8_t prev_sample;
-	const unsigned int Length = 1000000;
-
-	sr_datafeed_logic logic;
-	logic.unitsize = 1;
-	logic.length = Length;
-	logic.data = new uint8_t[Length];
-	uint8_t *data = (uint8_t*)logic.data;
-
-	for (unsigned int i = 0; i < Length; i++)
-		*data++ = (uint8_t)(i >> 8);
-
-	LogicSnapshot s(logic);
-	delete[] (uint8_t*)logic.data;
-
-	BOOST_CHECK(s.get_sample_count() == Length);
-
-	// Check mip map level 0
-	BOOST_CHECK_EQUAL(s._mip_map[0].length, 62500);
-	BOOST_CHECK_EQUAL(s._mip_map[0].data_length,
-		LogicSnapshot::MipMapDataUnit);
-	BOOST_REQUIRE(s._mip_map[0].data != NULL);
-
-	prev_sample = 0;
-	for (unsigned int i = 0; i < s._mip_map[0].length;)
-	{
-		BOOST_TEST_MESSAGE("Testing mip_map[0].data[" << i << "]");
-
-		const uint8_t sample = (uint8_t)((i*16) >> 8);
-		BOOST_CHECK_EQUAL(s.get_subsample(0, i++) & 0xFF,
-			prev_sample ^ sample);
-		prev_sample = sample;
-
-		for (int j = 1; i < s._mip_map[0].length && j < 16; j++)
-		{
-			BOOST_TEST_MESSAGE("Testing mip_map[0].data[" << i << "]");
-			BOOST_CHECK_EQUAL(s.get_subsample(0, i++) & 0xFF, 0);
-		}
+	const uint8_t *const data = (const uint8_t*)words.data();
+	const uint64_t length = words.size() * sizeof(uint64_t);
+	for (uint64_t i = 0; i < length; i += packet) {
+		const sr_datafeed_logic logic =
+			cross_logic(data + i, min(packet, length - i));
+		if (i == 0)
+			s.first_payload(logic, total_sample_count, probes, false);
+		else
+			s.append_payload(logic);
 	}
-
-	// Check mip map level 1
-	BOOST_CHECK_EQUAL(s._mip_map[1].length, 3906);
-	BOOST_CHECK_EQUAL(s._mip_map[1].data_length,
-		LogicSnapshot::MipMapDataUnit);
-	BOOST_REQUIRE(s._mip_map[1].data != NULL);
-
-	prev_sample = 0;
-	for (unsigned int i = 0; i < s._mip_map[1].length; i++)
-	{
-		BOOST_TEST_MESSAGE("Testing mip_map[1].data[" << i << "]");
-
-		const uint8_t sample = i;
-		const uint8_t expected = sample ^ prev_sample;
-		prev_sample = i;
-
-		BOOST_CHECK_EQUAL(s.get_subsample(1, i) & 0xFF, expected);
-	}
-
-	// Check mip map level 2
-	BOOST_CHECK_EQUAL(s._mip_map[2].length, 244);
-	BOOST_CHECK_EQUAL(s._mip_map[2].data_length,
-		LogicSnapshot::MipMapDataUnit);
-	BOOST_REQUIRE(s._mip_map[2].data != NULL);
-
-	prev_sample = 0;
-	for (unsigned int i = 0; i < s._mip_map[2].length; i++)
-	{
-		BOOST_TEST_MESSAGE("Testing mip_map[2].data[" << i << "]");
-
-		const uint8_t sample = i << 4;
-		const uint8_t expected = (sample ^ prev_sample) | 0x0F;
-		prev_sample = sample;
-
-		BOOST_CHECK_EQUAL(s.get_subsample(2, i) & 0xFF, expected);
-	}
-
-	// Check mip map level 3
-	BOOST_CHECK_EQUAL(s._mip_map[3].length, 15);
-	BOOST_CHECK_EQUAL(s._mip_map[3].data_length,
-		LogicSnapshot::MipMapDataUnit);
-	BOOST_REQUIRE(s._mip_map[3].data != NULL);
-
-	for (unsigned int i = 0; i < s._mip_map[3].length; i++)
-		BOOST_CHECK_EQUAL(*((uint8_t*)s._mip_map[3].data + i),
-			0xFF);
-
-	// Check the higher levels
-	for (unsigned int i = 4; i < LogicSnapshot::ScaleStepCount; i++)
-	{
-		const LogicSnapshot::MipMapLevel &m = s._mip_map[i];
-		BOOST_CHECK_EQUAL(m.length, 0);
-		BOOST_CHECK_EQUAL(m.data_length, 0);
-		BOOST_CHECK(m.data == NULL);
-	}
-
-	//----- Test LogicSnapshot::get_subsampled_edges -----//
-	// Check in normal case
-	vector<LogicSnapshot::EdgePair> edges;
-	s.get_subsampled_edges(edges, 0, Length-1, 1, 7);
-
-	BOOST_CHECK_EQUAL(edges.size(), 32);
-
-	for (unsigned int i = 0; i < edges.size() - 1; i++)
-	{
-		BOOST_CHECK_EQUAL(edges[i].first, i * 32768);
-		BOOST_CHECK_EQUAL(edges[i].second, i & 1);
-	}
-
-	BOOST_CHECK_EQUAL(edges[31].first, 999999);
-
-	// Check in very low zoom case
-	edges.clear();
-	s.get_subsampled_edges(edges, 0, Length-1, 50e6f, 7);
-
-	BOOST_CHECK_EQUAL(edges.size(), 2);
+	s.capture_ended();
 }
 
-BOOST_AUTO_TEST_CASE(Pulses)
+BOOST_AUTO_TEST_CASE(Basic)
 {
-	const int Cycles = 3;
-	const int Period = 64;
-	const int Length = Cycles * Period;
-
-	vector<LogicSnapshot::EdgePair> edges;
-
-	//----- Create a LogicSnapshot -----//
-	sr_datafeed_logic logic;
-	logic.unitsize = 1;
-	logic.length = Length;
-	logic.data = (uint64_t*)new uint8_t[Length];
-	uint8_t *p = (uint8_t*)logic.data;
-
-	for (int i = 0; i < Cycles; i++) {
-		*p++ = 0xFF;
-		for (int j = 1; j < Period; j++)
-			*p++ = 0x00;
-	}
-
-	LogicSnapshot s(logic);
-	delete[] (uint8_t*)logic.data;
-
-	//----- Check the mip-map -----//
-	// Check mip map level 0
-	BOOST_CHECK_EQUAL(s._mip_map[0].length, 12);
-	BOOST_CHECK_EQUAL(s._mip_map[0].data_length,
-		LogicSnapshot::MipMapDataUnit);
-	BOOST_REQUIRE(s._mip_map[0].data != NULL);
-
-	for (unsigned int i = 0; i < s._mip_map[0].length;) {
-		BOOST_TEST_MESSAGE("Testing mip_map[0].data[" << i << "]");
-		BOOST_CHECK_EQUAL(s.get_subsample(0, i++) & 0xFF, 0xFF);
-
-		for (int j = 1;
-			i < s._mip_map[0].length &&
-			j < Period/LogicSnapshot::MipMapScaleFactor; j++) {
-			BOOST_TEST_MESSAGE(
-				"Testing mip_map[0].data[" << i << "]");
-			BOOST_CHECK_EQUAL(s.get_subsample(0, i++) & 0xFF, 0x00);
-		}
-	}
-
-	// Check the higher levels are all inactive
-	for (unsigned int i = 1; i < LogicSnapshot::ScaleStepCount; i++) {
-		const LogicSnapshot::MipMapLevel &m = s._mip_map[i];
-		BOOST_CHECK_EQUAL(m.length, 0);
-		BOOST_CHECK_EQUAL(m.data_length, 0);
-		BOOST_CHECK(m.data == NULL);
-	}
-
-	//----- Test get_subsampled_edges at reduced scale -----//
-	s.get_subsampled_edges(edges, 0, Length-1, 16.0f, 2);
-	BOOST_REQUIRE_EQUAL(edges.size(), Cycles + 2);
-
-	BOOST_CHECK_EQUAL(0, false);
-	for (unsigned int i = 1; i < edges.size(); i++)
-		BOOST_CHECK_EQUAL(edges[i].second, false);
+	vector<sr_channel> probe_list;
+	GSList *const probes = logic_probes(probe_list, 1);
+
+	LogicSnapshot s;
+	s.init();
+	BOOST_CHECK_EQUAL(s.get_sample_count(), 0);
+
+	// High from sample 8 to 15
+	vector<uint64_t> words(16, 0);
+	set_level(words, 1, 0, 8, 16);
+	push_logic(s, words, 1024, probes, words.size() * sizeof(uint64_t));
+
+	BOOST_REQUIRE_EQUAL(s.get_sample_count(), 1024);
+	BOOST_CHECK(!s.get_sample(7, 0));
+	BOOST_CHECK(s.get_sample(8, 0));
+	BOOST_CHECK(s.get_sample(15, 0));
+	BOOST_CHECK(!s.get_sample(16, 0));
+
+	uint64_t index = 0;
+	BOOST_CHECK(s.get_nxt_edge(index, false, 1023, 1, 0));
+	BOOST_CHECK_EQUAL(index, 8);
+	index++;
+	BOOST_CHECK(s.get_nxt_edge(index, true, 1023, 1, 0));
+	BOOST_CHECK_EQUAL(index, 16);
+	index++;
+	BOOST_CHECK(!s.get_nxt_edge(index, false, 1023, 1, 0));
+
+	index = 20;
+	BOOST_CHECK(s.get_pre_edge(index, false, 1, 0));
+	BOOST_CHECK_EQUAL(index, 16);
+	index = 15;
+	BOOST_CHECK(s.get_pre_edge(index, true, 1, 0));
+	BOOST_CHECK_EQUAL(index, 8);
+
+	g_slist_free(probes);
 }
 
-BOOST_AUTO_TEST_CASE(LongPulses)
+/*
+ * Edges across leaf blocks, with a block in between which has none and
+ * keeps its level in the root only.
+ */
+BOOST_AUTO_TEST_CASE(LargeData)
 {
-	const int Cycles = 3;
-	const int Period = 64;
-	const int PulseWidth = 16;
-	const int Length = Cycles * Period;
-
-	int j;
-	vector<LogicSnapshot::EdgePair> edges;
-
-	//----- Create a LogicSnapshot -----//
-	sr_datafeed_logic logic;
-	logic.unitsize = 8;
-	logic.length = Length * 8;
-	logic.data = (uint64_t*)new uint64_t[Length];
-	uint64_t *p = (uint64_t*)logic.data;
-
-	for (int i = 0; i < Cycles; i++) {
-		for (j = 0; j < PulseWidth; j++)
-			*p++ = ~0;
-		for (; j < Period; j++)
-			*p++ = 0;
-	}
-
-	LogicSnapshot s(logic);
-	delete[] (uint64_t*)logic.data;
-
-	//----- Check the mip-map -----//
-	// Check mip map level 0
-	BOOST_CHECK_EQUAL(s._mip_map[0].length, 12);
-	BOOST_CHECK_EQUAL(s._mip_map[0].data_length,
-		LogicSnapshot::MipMapDataUnit);
-	BOOST_REQUIRE(s._mip_map[0].data != NULL);
-
-	for (unsigned int i = 0; i < s._mip_map[0].length;) {
-		for (j = 0; i < s._mip_map[0].length && j < 2; j++) {
-			BOOST_TEST_MESSAGE(
-				"Testing mip_map[0].data[" << i << "]");
-			BOOST_CHECK_EQUAL(s.get_subsample(0, i++), ~0);
-		}
-
-		for (; i < s._mip_map[0].length &&
-			j < Period/LogicSnapshot::MipMapScaleFactor; j++) {
-			BOOST_TEST_MESSAGE(
-				"Testing mip_map[0].data[" << i << "]");
-			BOOST_CHECK_EQUAL(s.get_subsample(0, i++), 0);
-		}
-	}
-
-	// Check the higher levels are all inactive
-	for (unsigned int i = 1; i < LogicSnapshot::ScaleStepCount; i++) {
-		const LogicSnapshot::MipMapLevel &m = s._mip_map[i];
-		BOOST_CHECK_EQUAL(m.length, 0);
-		BOOST_CHECK_EQUAL(m.data_length, 0);
-		BOOST_CHECK(m.data == NULL);
-	}
-
-	//----- Test get_subsampled_edges at a full scale -----//
-	s.get_subsampled_edges(edges, 0, Length-1, 16.0f, 2);
-	BOOST_REQUIRE_EQUAL(edges.size(), Cycles * 2 + 1);
-
-	for (int i = 0; i < Cycles; i++) {
-		BOOST_CHECK_EQUAL(edges[i*2].first, i * Period);
-		BOOST_CHECK_EQUAL(edges[i*2].second, true);
-		BOOST_CHECK_EQUAL(edges[i*2+1].first, i * Period + PulseWidth);
-		BOOST_CHECK_EQUAL(edges[i*2+1].second, false);
+	const uint64_t Block = LogicSnapshot::LeafBlockSamples;
+	const uint64_t Length = 3 * Block + Block / 2;
+	const uint64_t Edges[] = {Block - 3, Block + 100, 3 * Block + 4103};
+
+	vector<sr_channel> probe_list;
+	GSList *const probes = logic_probes(probe_list, 1);
+
+	vector<uint64_t> words(Length / 64, 0);
+	set_level(words, 1, 0, Edges[0], Edges[1]);
+	set_level(words, 1, 0, Edges[2], Length);
+
+	LogicSnapshot s;
+	s.init();
+	push_logic(s, words, Length, probes, 1024 * 1024);
+	BOOST_REQUIRE_EQUAL(s.get_sample_count(), Length);
+	BOOST_CHECK(s._ch_data[0][0].lbp[2] == NULL);
+
+	BOOST_CHECK(!s.get_sample(Edges[0] - 1, 0));
+	BOOST_CHECK(s.get_sample(Edges[0], 0));
+	BOOST_CHECK(s.get_sample(Block, 0));
+	BOOST_CHECK(!s.get_sample(2 * Block + 5, 0));
+	BOOST_CHECK(s.get_sample(Length - 1, 0));
+
+	uint64_t index = 0;
+	bool last = false;
+	for (unsigned int i = 0; i < countof(Edges); i++) {
+		BOOST_CHECK(s.get_nxt_edge(index, last, Length - 1, 1, 0));
+		BOOST_CHECK_EQUAL(index, Edges[i]);
+		last = !last;
+		index++;
 	}
-
-	BOOST_CHECK_EQUAL(edges.back().first, Length-1);
-	BOOST_CHECK_EQUAL(edges.back().second, false);
-
-	//----- Test get_subsampled_edges at a simplified scale -----//
-	edges.clear();
-	s.get_subsampled_edges(edges, 0, Length-1, 17.0f, 2);
-
-	BOOST_CHECK_EQUAL(edges[0].first, 0);
-	BOOST_CHECK_EQUAL(edges[0].second, true);
-	BOOST_CHECK_EQUAL(edges[1].first, 16);
-	BOOST_CHECK_EQUAL(edges[1].second, false);
-	
-	for (int i = 1; i < Cycles; i++) {
-		BOOST_CHECK_EQUAL(edges[i+1].first, i * Period);
-		BOOST_CHECK_EQUAL(edges[i+1].second, false);
+	BOOST_CHECK(!s.get_nxt_edge(index, last, Length - 1, 1, 0));
+
+	index = Length - 1;
+	for (int i = countof(Edges) - 1; i >= 0; i--) {
+		BOOST_CHECK(s.get_pre_edge(index, last, 1, 0));
+		BOOST_CHECK_EQUAL(index, Edges[i]);
+		last = !last;
+		index--;
 	}
+	BOOST_CHECK(!s.get_pre_edge(index, last, 1, 0));
 
-	BOOST_CHECK_EQUAL(edges.back().first, Length-1);
-	BOOST_CHECK_EQUAL(edges.back().second, false);
+	g_slist_free(probes);
 }
 
 BOOST_AUTO_TEST_CASE(LisaMUsbHid)
@@ -430,107 +184,236 @@ BOOST_AUTO_TEST_CASE(LisaMUsbHid)
 	 * sigrok-dumps-usb/lisa_m_usbhid/lisa_m_usbhid.sr
 	 */
 
-	const int Edges[] = {
+	const uint64_t Edges[] = {
 		7028, 7033, 7036, 7041, 7044, 7049, 7053, 7066, 7073, 7079,
 		7086, 7095, 7103, 7108, 7111, 7116, 7119, 7124, 7136, 7141,
-		7148, 7162, 7500
+		7148, 7162
 	};
-	const int Length = Edges[countof(Edges) - 1];
+	const uint64_t Length = 7552;
 
-	bool state = false;
-	int lastEdgePos = 0;
+	// USB_DM is the second of two channels
+	vector<sr_channel> probe_list;
+	GSList *const probes = logic_probes(probe_list, 2);
 
-	//----- Create a LogicSnapshot -----//
-	sr_datafeed_logic logic;
-	logic.unitsize = 1;
-	logic.length = Length;
-	logic.data = new uint8_t[Length];
-	uint8_t *data = (uint8_t*)logic.data;
+	vector<uint64_t> words(Length / 64 * 2, 0);
+	for (unsigned int i = 0; i < countof(Edges); i += 2)
+		set_level(words, 2, 1, Edges[i], Edges[i + 1]);
 
-	for (unsigned int i = 0; i < countof(Edges); i++) {
-		const int edgePos = Edges[i];
-		memset(&data[lastEdgePos], state ? 0x02 : 0,
-			edgePos - lastEdgePos - 1);
+	LogicSnapshot s;
+	s.init();
+	push_logic(s, words, Length, probes, 256);
+	BOOST_REQUIRE_EQUAL(s.get_sample_count(), Length);
 
-		lastEdgePos = edgePos;
-		state = !state;
+	uint64_t index = 0;
+	bool last = false;
+	for (unsigned int i = 0; i < countof(Edges); i++) {
+		BOOST_CHECK(s.get_nxt_edge(index, last, Length - 1, 1, 1));
+		BOOST_CHECK_EQUAL(index, Edges[i]);
+		last = !last;
+		index++;
 	}
 
-	LogicSnapshot s(logic);
-	delete[] (uint64_t*)logic.data;
+	// The trailing edge of the pulse train is falling in the source data
+	BOOST_CHECK(!last);
+	BOOST_CHECK(!s.get_nxt_edge(index, last, Length - 1, 1, 1));
 
-	vector<LogicSnapshot::EdgePair> edges;
-
-
-	/* The trailing edge of the pulse train is falling in the source data.
-	 * Check this is always true at different scales
-	 */
+	index = 0;
+	BOOST_CHECK(!s.get_nxt_edge(index, false, Length - 1, 1, 0));
 
-	edges.clear();
-	s.get_subsampled_edges(edges, 0, Length-1, 33.333332f, 1);
-	BOOST_CHECK_EQUAL(edges[edges.size() - 2].second, false);
+	g_slist_free(probes);
 }
 
 /*
- * This test checks the rendering of wide data (more than 8 probes)
- * Probe signals are either all-high, or all-low, but are interleaved such that
- * they would toggle during every sample if treated like 8 probes.
- * The packet contains a large number of samples, so the mipmap generation kicks
- * in.
+ * This test checks wide data (more than 8 probes). Probe signals are
+ * either all-high, or all-low, and would toggle during every sample if
+ * treated like 8 probes. The packets don't end on a word of a channel.
  *
- * The signals should not toggle (have exactly two edges: the start and end)
+ * The signals should not toggle.
  */
 BOOST_AUTO_TEST_CASE(WideData)
 {
-	const int Length = 512<<10;
-	uint16_t *data = new uint16_t[Length];
-
-	sr_datafeed_logic logic;
-	logic.unitsize = sizeof(data[0]);
-	logic.length = Length * sizeof(data[0]);
-	logic.data = data;
-
-	for (int i = 0; i < Length; i++)
-		data[i] = 0x0FF0;
-
-	LogicSnapshot s(logic);
-
-	vector<LogicSnapshot::EdgePair> edges;
-
-	edges.clear();
-	s.get_subsampled_edges(edges, 0, Length-1, 1, 0);
-	BOOST_CHECK_EQUAL(edges.size(), 2);
-
-	edges.clear();
-	s.get_subsampled_edges(edges, 0, Length-1, 1, 8);
-	BOOST_CHECK_EQUAL(edges.size(), 2);
+	const unsigned int Channels = 16;
+	const uint64_t Length = 64 * 1024;
+
+	vector<sr_channel> probe_list;
+	GSList *const probes = logic_probes(probe_list, Channels);
+
+	vector<uint64_t> words(Length / 64 * Channels, 0);
+	for (unsigned int ch = 4; ch < 12; ch++)
+		set_level(words, Channels, ch, 0, Length);
+
+	LogicSnapshot s;
+	s.init();
+	// Packets must hold a word of each channel, the last one too
+	push_logic(s, words, Length, probes, 1100);
+	BOOST_REQUIRE_EQUAL(s.get_sample_count(), Length);
+
+	for (unsigned int ch = 0; ch < Channels; ch++) {
+		const bool high = (ch >= 4 && ch < 12);
+		BOOST_CHECK_EQUAL(s.get_sample(0, ch), high);
+		BOOST_CHECK_EQUAL(s.get_sample(Length / 2 + 1, ch), high);
+		BOOST_CHECK_EQUAL(s.get_sample(Length - 1, ch), high);
+
+		uint64_t index = 0;
+		BOOST_CHECK(!s.get_nxt_edge(index, high, Length - 1, 1, ch));
+	}
 
-	// Cleanup
-	delete [] data;
+	g_slist_free(probes);
 }
 
 /*
- * This test is a replica of sixteen.sr attached to Bug #33.
+ * Run length encoded data, whose leaves are filled run by run. A leaf
+ * without a change isn't allocated, the next one still starts at its
+ * level.
  */
-BOOST_AUTO_TEST_CASE(Sixteen)
+BOOST_AUTO_TEST_CASE(Edges)
 {
-	const int Length = 8;
-	uint16_t data[Length];
+	const uint64_t Block = LogicSnapshot::LeafBlockSamples;
+
+	vector<sr_channel> probe_list;
+	GSList *const probes = logic_probes(probe_list, 2);
+
+	const uint64_t index0[] = {0, 100, Block + 5};
+	const uint8_t data0[] = {0x01, 0x02, 0x03};
+	sr_datafeed_logic_edge edge;
+	edge.num_edges = countof(index0);
+	edge.end = 3 * Block;
+	edge.unitsize = 1;
+	edge.index = index0;
+	edge.data = data0;
+
+	LogicSnapshot s;
+	s.init();
+	s.first_edges(edge, 4 * Block, probes, false);
+
+	const uint64_t index1[] = {3 * Block + 10};
+	const uint8_t data1[] = {0x00};
+	edge.num_edges = countof(index1);
+	edge.end = 4 * Block;
+	edge.index = index1;
+	edge.data = data1;
+	s.append_edges(edge);
+	s.capture_ended();
+
+	BOOST_REQUIRE_EQUAL(s.get_sample_count(), 4 * Block);
+	BOOST_CHECK(s._ch_data[0][0].lbp[2] == NULL);
+	BOOST_CHECK(s._ch_data[1][0].lbp[2] == NULL);
+
+	BOOST_CHECK(s.get_sample(99, 0));
+	BOOST_CHECK(!s.get_sample(100, 0));
+	BOOST_CHECK(!s.get_sample(99, 1));
+	BOOST_CHECK(s.get_sample(100, 1));
+	BOOST_CHECK(s.get_sample(2 * Block + 7, 0));
+	BOOST_CHECK(s.get_sample(3 * Block + 9, 1));
+	BOOST_CHECK(!s.get_sample(3 * Block + 10, 1));
+
+	uint64_t index = 100;
+	BOOST_CHECK(s.get_nxt_edge(index, false, 4 * Block - 1, 1, 0));
+	BOOST_CHECK_EQUAL(index, Block + 5);
+	index++;
+	BOOST_CHECK(s.get_nxt_edge(index, true, 4 * Block - 1, 1, 0));
+	BOOST_CHECK_EQUAL(index, 3 * Block + 10);
+
+	index = 101;
+	BOOST_CHECK(s.get_nxt_edge(index, true, 4 * Block - 1, 1, 1));
+	BOOST_CHECK_EQUAL(index, 3 * Block + 10);
+
+	g_slist_free(probes);
+}
 
+/*
+ * A segment's snapshot is reused by the capture after the next ones,
+ * init() and a capture of the same size keep its leaf blocks.
+ */
+BOOST_AUTO_TEST_CASE(Reuse)
+{
+	const uint64_t Samples = 2 * LogicSnapshot::LeafBlockSamples;
+
+	sr_channel probe;
+	memset(&probe, 0, sizeof(probe));
+	probe.index = 0;
+	probe.type = SR_CHANNEL_LOGIC;
+	probe.enabled = TRUE;
+	GSList *const probes = g_slist_append(NULL, &probe);
+
+	// One channel, toggling in opposite phases, a leaf without a
+	// toggle would be trimmed
+	vector<uint8_t> data(Samples / 8);
 	sr_datafeed_logic logic;
-	logic.unitsize = sizeof(data[0]);
-	logic.length = Length * sizeof(data[0]);
-	logic.data = data;
-
-	for (int i = 0; i < Length; i++)
-		data[i] = 0xFFFE;
+	memset(&logic, 0, sizeof(logic));
+	logic.format = LA_CROSS_DATA;
+	logic.unitsize = 1;
+	logic.length = data.size();
+	logic.data = data.data();
+
+	LogicSnapshot s;
+	s.init();
+	memset(data.data(), 0xaa, data.size());
+	s.first_payload(logic, Samples, probes, false);
+	s.capture_ended();
+	BOOST_REQUIRE_EQUAL(s.get_sample_count(), Samples);
+	BOOST_CHECK(s.get_sample(Samples - 1, 0));
+
+	const void *const leaf0 = s._ch_data[0][0].lbp[0];
+	const void *const leaf1 = s._ch_data[0][0].lbp[1];
+	BOOST_REQUIRE(leaf0 && leaf1);
+
+	s.init();
+	BOOST_CHECK_EQUAL(s.get_sample_count(), 0);
+	memset(data.data(), 0x55, data.size());
+	s.first_payload(logic, Samples, probes, false);
+	s.capture_ended();
+
+	BOOST_CHECK_EQUAL(s._ch_data[0][0].lbp[0], leaf0);
+	BOOST_CHECK_EQUAL(s._ch_data[0][0].lbp[1], leaf1);
+	BOOST_REQUIRE_EQUAL(s.get_sample_count(), Samples);
+	BOOST_CHECK(s.get_sample(0, 0));
+	BOOST_CHECK(!s.get_sample(1, 0));
+	BOOST_CHECK(s.get_sample(Samples - 2, 0));
+	BOOST_CHECK(!s.get_sample(Samples - 1, 0));
+
+	g_slist_free(probes);
+}
 
-	LogicSnapshot s(logic);
+BOOST_AUTO_TEST_CASE(Pin)
+{
+	const uint64_t Block = LogicSnapshot::LeafBlockSamples;
+	const uint64_t Samples = 3 * Block;
 
-	vector<LogicSnapshot::EdgePair> edges;
-	s.get_subsampled_edges(edges, 0, 2, 0.0004, 1);
+	sr_channel probe;
+	memset(&probe, 0, sizeof(probe));
+	probe.index = 0;
+	probe.type = SR_CHANNEL_LOGIC;
+	probe.enabled = TRUE;
+	GSList *const probes = g_slist_append(NULL, &probe);
 
-	BOOST_CHECK_EQUAL(edges.size(), 2);
+	vector<uint8_t> data(Samples / 8, 0xaa);
+	sr_datafeed_logic logic;
+	memset(&logic, 0, sizeof(logic));
+	logic.format = LA_CROSS_DATA;
+	logic.unitsize = 1;
+	logic.length = data.size();
+	logic.data = data.data();
+
+	LogicSnapshot s;
+	s.init();
+	s.first_payload(logic, Samples, probes, false);
+	BOOST_REQUIRE_EQUAL(s.get_full_block_num(), 3);
+
+	// A reader in the second block keeps it and the ones after it
+	int reader;
+	BOOST_REQUIRE(s.pin(&reader, Block + 5));
+	s.release_blocks(3);
+	BOOST_CHECK_EQUAL(s.get_released_samples(), Block);
+	BOOST_CHECK(!s.pin(&probe, 0));
+	BOOST_CHECK(s.get_sample(Block + 1, 0));
+
+	// Released once the reader is done
+	s.unpin(&reader);
+	s.release_blocks(3);
+	BOOST_CHECK_EQUAL(s.get_released_samples(), Samples);
+
+	g_slist_free(probes);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
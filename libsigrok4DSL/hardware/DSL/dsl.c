@@ -1665,6 +1665,24 @@ SR_PRIV int dsl_header_size(const struct DSL_context *devc)
     return size;
 }
 
+SR_PRIV void dsl_transfer_ctl_init(struct DSL_context *devc)
+{
+    const unsigned int single = get_single_buffer_time(devc);
+
+    /* Start with 10/20ms buffers and 40/100ms in flight, and never
+     * use less than that. */
+    sr_transfer_ctl_init(&devc->transfer_ctl,
+                         single * 1000, single * 1000 * MAX_BUFFER_TIME_SCALE,
+                         (get_total_buffer_time(devc) + single - 1) / single,
+                         NUM_SIMUL_TRANSFERS);
+}
+
+static size_t get_stream_buffer_size(struct DSL_context *devc)
+{
+    const size_t s = (uint64_t)devc->transfer_ctl.buffer_time * to_bytes_per_ms(devc) / 1000;
+    return (s + 511ULL) & ~511ULL;
+}
+
 static size_t get_buffer_size(const struct sr_dev_inst *sdi)
 {
     size_t s;
@@ -1672,34 +1690,33 @@ static size_t get_buffer_size(const struct sr_dev_inst *sdi)
     devc = sdi->priv;
 
     /*
-     * The buffer should be large enough to hold 10ms of data and
-     * a multiple of 512.
+     * In stream mode the buffer holds the transfer controller's
+     * buffer time of data, all sizes are a multiple of 512.
      */
     if (sdi->mode == DSO) {
         s = (devc->instant) ? devc->profile->dev_caps.dso_depth : devc->actual_samples * dsl_en_ch_num(sdi) + dsl_header_size(devc);
     } else {
-        s = (devc->stream) ? get_single_buffer_time(devc) * to_bytes_per_ms(devc) : 1024*1024;
+        if (devc->stream)
+            return get_stream_buffer_size(devc);
+        s = 1024*1024;
     }
     return (s + 511ULL) & ~511ULL;
 }
 
 static unsigned int get_number_of_transfers(const struct sr_dev_inst *sdi)
 {
-    unsigned int n;
     struct DSL_context *devc;
     devc = sdi->priv;
 
+    if (devc->stream)
+        return devc->transfer_ctl.count;
+
+    /* Buffer mode, DSO and analog captures use a fixed count. */
     #ifndef _WIN32
-    /* Total buffer size should be able to hold about 100ms of data. */
-    n = (devc->stream) ? ceil(get_total_buffer_time(devc) * 1.0f * to_bytes_per_ms(devc) / get_buffer_size(sdi)) : 1;
+    return 1;
     #else
-    n = (devc->stream) ? ceil(get_total_buffer_time(devc) * 1.0f * to_bytes_per_ms(devc) / get_buffer_size(sdi)) : 4;
+    return 4;
     #endif
-
-    if (n > NUM_SIMUL_TRANSFERS)
-        return NUM_SIMUL_TRANSFERS;
-
-    return n;
 }
 
 SR_PRIV unsigned int dsl_get_timeout(const struct sr_dev_inst *sdi)
@@ -1722,6 +1739,14 @@ static void finish_acquisition(struct DSL_context *devc)
 {
     struct sr_datafeed_packet packet;
 
+    /* Data still waiting for the ingest thread goes first. */
+    if (devc->ingest) {
+        sr_info("%s: ingest backlog peaked at %u buffers", __func__,
+                sr_ingest_backlog_max(devc->ingest));
+        sr_ingest_free(devc->ingest);
+        devc->ingest = NULL;
+    }
+
     sr_info("%s: send SR_DF_END packet", __func__);
     /* Terminate session. */
     packet.type = SR_DF_END;
@@ -1759,6 +1784,26 @@ static void free_transfer(struct libusb_transfer *transfer)
         finish_acquisition(devc);
 }
 
+/* Runs on the ingest thread, in the order the buffers were received. */
+static void ingest_logic(void *buf, uint64_t length, int type, void *cb_data)
+{
+    struct DSL_context *devc = cb_data;
+    struct sr_datafeed_packet packet;
+    struct sr_datafeed_logic logic;
+
+    packet.status = SR_PKT_OK;
+    packet.type = type;
+    packet.payload = NULL;
+    if (type == SR_DF_LOGIC) {
+        packet.payload = &logic;
+        logic.length = length;
+        logic.format = LA_CROSS_DATA;
+        logic.data_error = 0;
+        logic.data = buf;
+    }
+    sr_session_send(devc->cb_data, &packet);
+}
+
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
     int ret;
@@ -1772,6 +1817,110 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
     sr_err("%s: %s", __func__, libusb_error_name(ret));
 }
 
+/* Gives the transfer a buffer of the current stream transfer size. */
+static void resize_transfer(struct DSL_context *devc,
+                            struct libusb_transfer *transfer)
+{
+    unsigned char *buf;
+
+    if ((size_t)transfer->length == devc->transfer_size)
+        return;
+    if (!(buf = g_try_malloc(devc->transfer_size)))
+        return;
+
+    g_free(transfer->buffer);
+    transfer->buffer = buf;
+    transfer->length = devc->transfer_size;
+}
+
+static void receive_transfer(struct libusb_transfer *transfer);
+
+/* Submits stream transfers until the controller's count are in flight. */
+static void add_transfers(struct DSL_context *devc)
+{
+    struct sr_dev_inst *sdi = devc->cb_data;
+    struct sr_usb_dev_inst *usb = sdi->conn;
+    struct libusb_transfer *transfer;
+    unsigned char *buf;
+    unsigned int i;
+    int ret;
+
+    while (devc->submitted_transfers < (int)devc->transfer_ctl.count) {
+        for (i = 1; i < devc->max_transfers && devc->transfers[i]; i++);
+        if (i == devc->max_transfers)
+            return;
+
+        if (!(buf = g_try_malloc(devc->transfer_size))) {
+            sr_err("%s: USB transfer buffer malloc failed.", __func__);
+            return;
+        }
+        transfer = libusb_alloc_transfer(0);
+        libusb_fill_bulk_transfer(transfer, usb->devhdl,
+                6 | LIBUSB_ENDPOINT_IN, buf, devc->transfer_size,
+                (libusb_transfer_cb_fn)receive_transfer, devc, 0);
+        if ((ret = libusb_submit_transfer(transfer)) != 0) {
+            sr_err("%s: Failed to submit transfer: %s.",
+                   __func__, libusb_error_name(ret));
+            libusb_free_transfer(transfer);
+            g_free(buf);
+            return;
+        }
+        devc->transfers[i] = transfer;
+        devc->submitted_transfers++;
+        devc->num_transfers = max(devc->num_transfers, i + 1);
+    }
+}
+
+/*
+ * Feeds the transfer controller with the timing of a stream transfer
+ * completion, which was handled from entry on.
+ */
+static void tune_transfers(struct DSL_context *devc, int64_t entry)
+{
+    struct sr_transfer_ctl *ctl = &devc->transfer_ctl;
+    const int64_t now = g_get_monotonic_time();
+    int64_t stall, lag;
+
+    /* Completions are buffer_time apart, as long as the host keeps up. */
+    stall = devc->last_completion ?
+        entry - devc->last_completion - ctl->buffer_time : 0;
+    stall = max(stall, now - entry);
+    if (devc->overflow)
+        stall = max(stall, (int64_t)ctl->buffer_time * ctl->count);
+    lag = devc->ingest ?
+        (int64_t)sr_ingest_backlog(devc->ingest) * ctl->buffer_time : 0;
+    devc->last_completion = entry;
+
+    if (!sr_transfer_ctl_sample(ctl, now, stall, lag))
+        return;
+
+    sr_info("%s: %s: %u transfers of %u us (stall %" PRId64 " us, lag %" PRId64 " us).",
+            __func__, ctl->reason, ctl->count, ctl->buffer_time, stall, lag);
+    devc->transfer_size = get_stream_buffer_size(devc);
+    add_transfers(devc);
+}
+
+static void update_stats(struct DSL_context *devc, int64_t entry, int length)
+{
+    struct sr_session_stats *stats;
+
+    if (!(stats = sr_session_stats()))
+        return;
+
+    stats->usb_transfers++;
+    stats->usb_bytes += length;
+    if (devc->last_receive)
+        sr_histogram_add(&stats->usb_interval, max(entry - devc->last_receive, 0));
+    devc->last_receive = entry;
+
+    stats->transfer_count = devc->submitted_transfers;
+    stats->transfer_time = devc->stream ? devc->transfer_ctl.buffer_time : 0;
+    if (devc->ingest) {
+        stats->ingest_backlog = sr_ingest_backlog(devc->ingest);
+        stats->ingest_backlog_max = sr_ingest_backlog_max(devc->ingest);
+    }
+}
+
 static void get_measure(const struct sr_dev_inst *sdi, uint8_t *buf, uint32_t offset)
 {
     uint64_t u64_tmp;
@@ -1836,6 +1985,9 @@ static void receive_transfer(struct libusb_transfer *transfer)
     uint8_t *cur_buf = transfer->buffer;
     struct DSL_context *devc = transfer->user_data;
     struct sr_dev_inst *sdi = devc->cb_data;
+    const int64_t entry = g_get_monotonic_time();
+    const gboolean tune = (sdi->mode == LOGIC && devc->stream);
+    size_t buf_size;
 
     if (devc->status == DSL_START)
         devc->status = DSL_DATA;
@@ -1920,7 +2072,15 @@ static void receive_transfer(struct libusb_transfer *transfer)
             logic.length = min(logic.length, remain_length);
 
             /* send data to session bus */
-            if (!devc->overflow) {
+            if (devc->ingest && sdi->mode == LOGIC) {
+                /* Queue the data and resubmit with a spare buffer at once,
+                 * sending it here would stall the transfer while the
+                 * session processes it. */
+                buf_size = transfer->length;
+                transfer->buffer = sr_ingest_swap(devc->ingest, cur_buf, &buf_size,
+                    logic.length, devc->overflow ? SR_DF_OVERFLOW : SR_DF_LOGIC);
+                transfer->length = buf_size;
+            } else if (!devc->overflow) {
                 if (packet.status == SR_PKT_OK)
                     sr_session_send(sdi, &packet);
             } else {
@@ -1952,10 +2112,21 @@ static void receive_transfer(struct libusb_transfer *transfer)
         }
     }
 
-    if (devc->status == DSL_DATA)
-        resubmit_transfer(transfer);
-    else
+    update_stats(devc, entry, transfer->actual_length);
+
+    if (devc->status != DSL_DATA) {
+        free_transfer(transfer);
+    } else if (tune && devc->submitted_transfers > (int)devc->transfer_ctl.count) {
+        /* The controller wants fewer transfers in flight */
         free_transfer(transfer);
+    } else {
+        if (tune)
+            resize_transfer(devc, transfer);
+        resubmit_transfer(transfer);
+    }
+
+    if (tune && devc->status == DSL_DATA)
+        tune_transfers(devc, entry);
 
     devc->trf_completed = 1;
 }
@@ -2014,7 +2185,7 @@ SR_PRIV int dsl_start_transfers(const struct sr_dev_inst *sdi)
     struct DSL_context *devc;
     struct sr_usb_dev_inst *usb;
     struct libusb_transfer *transfer;
-    unsigned int i, num_transfers;
+    unsigned int i, num_transfers, num_spare;
     int ret;
     unsigned char *buf;
     size_t size;
@@ -2023,8 +2194,20 @@ SR_PRIV int dsl_start_transfers(const struct sr_dev_inst *sdi)
     devc = sdi->priv;
     usb = sdi->conn;
 
+    if (devc->stream) {
+        /* Start from the settings of the last stream, within the memory
+         * limit at this rate. */
+        sr_transfer_ctl_start(&devc->transfer_ctl, g_get_monotonic_time(),
+            MAX_STREAM_MEMORY / (1 + NUM_INGEST_BUFFERS) * 1000 / max(to_bytes_per_ms(devc), 1));
+        devc->last_completion = 0;
+    }
+
+    devc->last_receive = 0;
     num_transfers = get_number_of_transfers(sdi);
     size = get_buffer_size(sdi);
+    devc->transfer_size = size;
+    devc->max_transfers = (sdi->mode == LOGIC && devc->stream) ?
+        max(num_transfers, devc->transfer_ctl.max_count) + 1 : num_transfers + 1;
 
     /* trigger packet transfer */
     if (!(trigger_pos = g_try_malloc0(dsl_header_size(devc)))) {
@@ -2032,7 +2215,7 @@ SR_PRIV int dsl_start_transfers(const struct sr_dev_inst *sdi)
         return SR_ERR_MALLOC;
     }
 
-    devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * (num_transfers + 1));
+    devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * devc->max_transfers);
     if (!devc->transfers) {
         sr_err("%s: USB transfer malloc failed.", __func__);
         return SR_ERR_MALLOC;
@@ -2054,6 +2237,20 @@ SR_PRIV int dsl_start_transfers(const struct sr_dev_inst *sdi)
         devc->submitted_transfers++;
     }
 
+    /* stream data is sent to the session by the ingest thread */
+    if (sdi->mode == LOGIC && devc->stream) {
+        /* Spare buffers for as many transfers as the controller may
+         * tune up to, within their share of the memory limit. */
+        num_spare = (devc->max_transfers - 1) * NUM_INGEST_BUFFERS;
+        num_spare = min(num_spare, MAX_STREAM_MEMORY / (1 + NUM_INGEST_BUFFERS) *
+                        NUM_INGEST_BUFFERS / size);
+        num_spare = max(num_spare, num_transfers * NUM_INGEST_BUFFERS);
+        devc->ingest = sr_ingest_new(num_spare, size, ingest_logic, devc);
+        if (!devc->ingest)
+            sr_warn("%s: Ingest buffer malloc failed, sending data from "
+                    "the USB callback.", __func__);
+    }
+
     /* data packet transfer */
     for (i = 1; i <= num_transfers; i++) {
         if (!(buf = g_try_malloc(size))) {
@@ -54,6 +54,12 @@
 #define USB_CONFIGURATION	1
 #define NUM_TRIGGER_STAGES	16
 #define NUM_SIMUL_TRANSFERS	64
+/* Spare buffers per transfer, for stream data waiting to be ingested */
+#define NUM_INGEST_BUFFERS	2
+/* Longest stream transfer buffer, times the shortest one */
+#define MAX_BUFFER_TIME_SCALE	8
+/* Stream transfer and spare buffers, at most */
+#define MAX_STREAM_MEMORY	SR_MB(512)
 
 #define DSL_REQUIRED_VERSION_MAJOR	2
 #define DSL_REQUIRED_VERSION_MINOR	0
@@ -849,6 +855,12 @@ struct DSL_context {
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
 	int *usbfd;
+    struct sr_ingest *ingest;
+    struct sr_transfer_ctl transfer_ctl;
+    size_t transfer_size;
+    unsigned int max_transfers;
+    int64_t last_completion;
+    int64_t last_receive;
 
     int pipe_fds[2];
     GIOChannel *channel;
@@ -1039,6 +1051,7 @@ SR_PRIV int dsl_dev_acquisition_stop(const struct sr_dev_inst *sdi, void *cb_dat
 SR_PRIV int dsl_dev_status_get(const struct sr_dev_inst *sdi, struct sr_status *status, gboolean prg, int begin, int end);
 
 SR_PRIV unsigned int dsl_get_timeout(const struct sr_dev_inst *sdi);
+SR_PRIV void dsl_transfer_ctl_init(struct DSL_context *devc);
 SR_PRIV int dsl_start_transfers(const struct sr_dev_inst *sdi);
 SR_PRIV int dsl_header_size(const struct DSL_context *devc);
 
@@ -205,7 +205,9 @@ static struct DSL_context *DSLogic_dev_new(const struct DSL_profile *prof)
         assert(channel_modes[i].id == i);
 
     devc->channel = NULL;
+    devc->ingest = NULL;
     devc->profile = prof;
+    dsl_transfer_ctl_init(devc);
 	devc->fw_updated = 0;
     devc->cur_samplerate = devc->profile->dev_caps.default_samplerate;
     devc->limit_samples = devc->profile->dev_caps.default_samplelimit;
@@ -0,0 +1,317 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+#include <glib.h>
+
+/*
+ * Hands completed USB buffers over to a consumer thread.
+ *
+ * The USB event thread swaps each completed buffer for a spare one and
+ * resubmits its transfer at once, the consumer thread sends the filled
+ * buffers to the session. Buffers travel between the two threads on a
+ * pair of single producer, single consumer rings, so neither side takes
+ * a lock while the other one is busy.
+ */
+
+/* Time a thread sleeps before it checks its ring again, in us. */
+#define INGEST_WAIT_TIME 10000
+
+struct sr_ingest_buffer {
+	void *data;
+	size_t size;
+	uint64_t length;
+	int type;
+};
+
+struct sr_ingest {
+	/* Filled buffers, written by the USB thread. */
+	struct sr_ring filled;
+	/* Buffers with a spare data block, written by the consumer. */
+	struct sr_ring spare;
+	struct sr_ingest_buffer *buffers;
+	unsigned int num_buffers;
+
+	sr_ingest_callback_t cb;
+	void *cb_data;
+
+	GThread *thread;
+	GMutex mutex;
+	GCond cond;
+	volatile gint consumer_waiting;
+	volatile gint producer_waiting;
+	volatile gint stop;
+
+	volatile gint backlog_max;
+};
+
+SR_PRIV int sr_ring_init(struct sr_ring *ring, unsigned int size)
+{
+	unsigned int n;
+
+	/* Round up to a power of two, positions wrap with a mask. */
+	for (n = 1; n < size; n <<= 1);
+
+	if (!(ring->items = g_try_malloc0(n * sizeof(void *))))
+		return SR_ERR_MALLOC;
+	ring->size = n;
+	ring->head = 0;
+	ring->tail = 0;
+
+	return SR_OK;
+}
+
+SR_PRIV void sr_ring_clear(struct sr_ring *ring)
+{
+	g_free(ring->items);
+	ring->items = NULL;
+	ring->size = 0;
+}
+
+/* Called by the producer only. */
+SR_PRIV gboolean sr_ring_push(struct sr_ring *ring, void *item)
+{
+	const guint head = (guint)g_atomic_int_get(&ring->head);
+
+	if (head - (guint)g_atomic_int_get(&ring->tail) == ring->size)
+		return FALSE;
+
+	ring->items[head & (ring->size - 1)] = item;
+	/* Publishes the item, g_atomic_int_set() is a full barrier. */
+	g_atomic_int_set(&ring->head, (gint)(head + 1));
+
+	return TRUE;
+}
+
+/* Called by the consumer only. */
+SR_PRIV void *sr_ring_pop(struct sr_ring *ring)
+{
+	const guint tail = (guint)g_atomic_int_get(&ring->tail);
+	void *item;
+
+	if ((guint)g_atomic_int_get(&ring->head) == tail)
+		return NULL;
+
+	item = ring->items[tail & (ring->size - 1)];
+	g_atomic_int_set(&ring->tail, (gint)(tail + 1));
+
+	return item;
+}
+
+SR_PRIV unsigned int sr_ring_count(struct sr_ring *ring)
+{
+	return (guint)g_atomic_int_get(&ring->head) -
+		(guint)g_atomic_int_get(&ring->tail);
+}
+
+static void ingest_wake(struct sr_ingest *ingest, volatile gint *waiting)
+{
+	if (!g_atomic_int_get(waiting))
+		return;
+
+	g_mutex_lock(&ingest->mutex);
+	g_cond_broadcast(&ingest->cond);
+	g_mutex_unlock(&ingest->mutex);
+}
+
+/*
+ * Sleeps until the ring has an item, or for INGEST_WAIT_TIME at most.
+ * The waiting flag is set before the ring is checked again, so a push
+ * in between is either seen here or followed by a wakeup.
+ */
+static void ingest_wait(struct sr_ingest *ingest, volatile gint *waiting,
+			struct sr_ring *ring)
+{
+	g_mutex_lock(&ingest->mutex);
+	g_atomic_int_set(waiting, 1);
+	if (sr_ring_count(ring) == 0 && !g_atomic_int_get(&ingest->stop))
+		g_cond_wait_until(&ingest->cond, &ingest->mutex,
+				  g_get_monotonic_time() + INGEST_WAIT_TIME);
+	g_atomic_int_set(waiting, 0);
+	g_mutex_unlock(&ingest->mutex);
+}
+
+static gpointer ingest_thread(gpointer data)
+{
+	struct sr_ingest *ingest = data;
+	struct sr_ingest_buffer *buffer;
+
+	while (TRUE) {
+		if (!(buffer = sr_ring_pop(&ingest->filled))) {
+			/* Everything queued before the stop is delivered. */
+			if (g_atomic_int_get(&ingest->stop))
+				break;
+			ingest_wait(ingest, &ingest->consumer_waiting,
+				    &ingest->filled);
+			continue;
+		}
+
+		ingest->cb(buffer->data, buffer->length, buffer->type,
+			   ingest->cb_data);
+
+		sr_ring_push(&ingest->spare, buffer);
+		ingest_wake(ingest, &ingest->producer_waiting);
+	}
+
+	return NULL;
+}
+
+/**
+ * Starts a consumer thread with a pool of spare buffers.
+ *
+ * @param num_buffers Number of spare buffers, the number of filled
+ *                    buffers which can wait for the consumer.
+ * @param buffer_size Size of each spare buffer, the size of the buffers
+ *                    handed to sr_ingest_swap().
+ * @param cb Called on the consumer thread for each filled buffer, in
+ *           the order they were queued.
+ * @param cb_data Passed to cb.
+ *
+ * @return The new instance, or NULL on allocation failure.
+ */
+SR_PRIV struct sr_ingest *sr_ingest_new(unsigned int num_buffers,
+		size_t buffer_size, sr_ingest_callback_t cb, void *cb_data)
+{
+	struct sr_ingest *ingest;
+	unsigned int i;
+
+	if (!(ingest = g_try_malloc0(sizeof(struct sr_ingest))))
+		return NULL;
+
+	ingest->cb = cb;
+	ingest->cb_data = cb_data;
+	ingest->num_buffers = num_buffers;
+	g_mutex_init(&ingest->mutex);
+	g_cond_init(&ingest->cond);
+
+	if (sr_ring_init(&ingest->filled, num_buffers) != SR_OK ||
+	    sr_ring_init(&ingest->spare, num_buffers) != SR_OK ||
+	    !(ingest->buffers = g_try_malloc0(num_buffers *
+					      sizeof(struct sr_ingest_buffer)))) {
+		sr_ingest_free(ingest);
+		return NULL;
+	}
+
+	for (i = 0; i < num_buffers; i++) {
+		if (!(ingest->buffers[i].data = g_try_malloc(buffer_size))) {
+			sr_ingest_free(ingest);
+			return NULL;
+		}
+		ingest->buffers[i].size = buffer_size;
+		sr_ring_push(&ingest->spare, &ingest->buffers[i]);
+	}
+
+	ingest->thread = g_thread_new("ingest", ingest_thread, ingest);
+
+	return ingest;
+}
+
+/**
+ * Queues a filled buffer for the consumer thread and returns a spare
+ * buffer in exchange.
+ *
+ * Only waits when all spare buffers are queued already, the consumer
+ * is then behind by num_buffers buffers.
+ *
+ * @param buf The filled buffer, owned by the ingest from now on.
+ * @param size Size of buf, set to the size of the returned buffer.
+ *             That is the size it was queued with, or the buffer_size
+ *             of sr_ingest_new().
+ * @param length Number of valid bytes in buf.
+ * @param type Passed to the callback, like the datafeed packet type.
+ *
+ * @return The spare buffer, owned by the caller from now on.
+ */
+SR_PRIV void *sr_ingest_swap(struct sr_ingest *ingest, void *buf,
+			     size_t *size, uint64_t length, int type)
+{
+	size_t spare_size;
+	struct sr_ingest_buffer *buffer;
+	unsigned int backlog;
+	void *spare;
+
+	while (!(buffer = sr_ring_pop(&ingest->spare)))
+		ingest_wait(ingest, &ingest->producer_waiting, &ingest->spare);
+
+	spare = buffer->data;
+	spare_size = buffer->size;
+	buffer->data = buf;
+	buffer->size = *size;
+	buffer->length = length;
+	buffer->type = type;
+
+	sr_ring_push(&ingest->filled, buffer);
+	ingest_wake(ingest, &ingest->consumer_waiting);
+
+	backlog = sr_ring_count(&ingest->filled);
+	if (backlog > (guint)g_atomic_int_get(&ingest->backlog_max))
+		g_atomic_int_set(&ingest->backlog_max, backlog);
+
+	*size = spare_size;
+	return spare;
+}
+
+/**
+ * Returns the number of filled buffers waiting for the consumer.
+ */
+SR_PRIV unsigned int sr_ingest_backlog(struct sr_ingest *ingest)
+{
+	return sr_ring_count(&ingest->filled);
+}
+
+/**
+ * Returns the largest number of filled buffers which were waiting for
+ * the consumer at once.
+ */
+SR_PRIV unsigned int sr_ingest_backlog_max(struct sr_ingest *ingest)
+{
+	return g_atomic_int_get(&ingest->backlog_max);
+}
+
+/**
+ * Delivers the queued buffers, stops the consumer thread and frees the
+ * spare buffers. Must not be called while sr_ingest_swap() runs.
+ */
+SR_PRIV void sr_ingest_free(struct sr_ingest *ingest)
+{
+	unsigned int i;
+
+	if (!ingest)
+		return;
+
+	if (ingest->thread) {
+		g_atomic_int_set(&ingest->stop, 1);
+		g_mutex_lock(&ingest->mutex);
+		g_cond_broadcast(&ingest->cond);
+		g_mutex_unlock(&ingest->mutex);
+		g_thread_join(ingest->thread);
+	}
+
+	if (ingest->buffers) {
+		for (i = 0; i < ingest->num_buffers; i++)
+			g_free(ingest->buffers[i].data);
+		g_free(ingest->buffers);
+	}
+	sr_ring_clear(&ingest->filled);
+	sr_ring_clear(&ingest->spare);
+	g_cond_clear(&ingest->cond);
+	g_mutex_clear(&ingest->mutex);
+	g_free(ingest);
+}
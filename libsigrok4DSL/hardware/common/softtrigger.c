@@ -0,0 +1,393 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+#include <string.h>
+#include <glib.h>
+
+/* Message logging helpers with subsystem-specific prefix string. */
+#define LOG_PREFIX "soft trigger: "
+#define sr_log(l, s, args...) sr_log(l, LOG_PREFIX s, ## args)
+#define sr_spew(s, args...) sr_spew(LOG_PREFIX s, ## args)
+#define sr_dbg(s, args...) sr_dbg(LOG_PREFIX s, ## args)
+#define sr_info(s, args...) sr_info(LOG_PREFIX s, ## args)
+#define sr_warn(s, args...) sr_warn(LOG_PREFIX s, ## args)
+#define sr_err(s, args...) sr_err(LOG_PREFIX s, ## args)
+
+/*
+ * Evaluates a struct ds_trigger on the host, for sources without a
+ * trigger in hardware.
+ *
+ * The data is in blocks of 64 samples, one word for each enabled
+ * channel, bit 0 is the first sample. This is the cross data of the
+ * logic analyzers. A condition is evaluated for the 64 samples of a
+ * block at once: the words of its channels, or their edges against the
+ * word shifted by one sample, are ANDed to a mask of the samples which
+ * match. The counts of a stage are then found in that mask.
+ *
+ * Like the FPGA, the stages are passed in turn. A stage is passed when
+ * its two conditions, combined by AND or OR, matched count times, or
+ * count samples in a row when it is contiguous. The next stage starts
+ * with the next sample, the trigger is on the sample where the last
+ * stage is passed.
+ *
+ * Until then, the last blocks are kept in a ring to be sent as the
+ * pre-trigger data.
+ */
+
+struct soft_cond {
+	/* Bit masks of the channels, in the order of the data */
+	uint64_t high;
+	uint64_t low;
+	uint64_t rise;
+	uint64_t fall;
+	uint64_t change;
+	gboolean inv;
+};
+
+struct soft_stage {
+	struct soft_cond cond[2];
+	gboolean and;
+	gboolean contiguous;
+	uint32_t count;
+};
+
+/* A block of the data being fed */
+struct soft_block {
+	const uint64_t *words;
+	uint64_t channel_stride;
+	uint64_t last;
+	gboolean started;
+};
+
+struct sr_soft_trigger {
+	struct soft_stage stages[TriggerStages + 1];
+	unsigned int num_stages;
+	unsigned int channels;
+
+	unsigned int stage;
+	uint32_t matched;
+	/* Levels of the last sample, to find the edges at the first one */
+	uint64_t last;
+	gboolean started;
+	gboolean fired;
+	uint64_t pos;
+
+	/* Pre-trigger blocks */
+	uint64_t *ring;
+	uint64_t ring_blocks;
+	uint64_t ring_head;
+	uint64_t ring_count;
+};
+
+static void cond_init(struct soft_cond *cond, const char *probes,
+		      unsigned char inv, const int *order)
+{
+	uint64_t bit;
+	int i;
+
+	memset(cond, 0, sizeof(*cond));
+	cond->inv = inv;
+	for (i = 0; i < TriggerProbes; i++) {
+		/* Disabled channels aren't captured, their conditions are left out. */
+		if (order[i] < 0)
+			continue;
+		bit = 1ULL << order[i];
+		switch (g_ascii_toupper(probes[i])) {
+		case '1': cond->high |= bit; break;
+		case '0': cond->low |= bit; break;
+		case 'R': cond->rise |= bit; break;
+		case 'F': cond->fall |= bit; break;
+		case 'C': cond->change |= bit; break;
+		}
+	}
+}
+
+static void stage_init(struct soft_stage *stage,
+		       const struct ds_trigger *trigger, int row,
+		       const int *order)
+{
+	cond_init(&stage->cond[0], trigger->trigger0[row],
+		  trigger->trigger0_inv[row], order);
+	cond_init(&stage->cond[1], trigger->trigger1[row],
+		  trigger->trigger1_inv[row], order);
+	stage->and = trigger->trigger_logic[row] & 1;
+	stage->contiguous = (trigger->trigger_logic[row] >> 1) & 1;
+	stage->count = MAX(trigger->trigger0_count[row], 1);
+}
+
+/* Mask of the samples of a block which match a condition. */
+static uint64_t cond_match(const struct soft_block *block,
+			   const struct soft_cond *cond)
+{
+	const uint64_t edges = cond->rise | cond->fall | cond->change;
+	uint64_t channels = cond->high | cond->low | edges;
+	uint64_t match = ~0ULL;
+	uint64_t w, prev, bit;
+	unsigned int c;
+
+	for (; channels; channels &= channels - 1) {
+		c = __builtin_ctzll(channels);
+		bit = 1ULL << c;
+		w = block->words[c * block->channel_stride];
+		prev = (w << 1) | ((block->last >> c) & 1);
+		if (cond->high & bit)
+			match &= w;
+		else if (cond->low & bit)
+			match &= ~w;
+		else if (cond->rise & bit)
+			match &= w & ~prev;
+		else if (cond->fall & bit)
+			match &= ~w & prev;
+		else
+			match &= w ^ prev;
+	}
+
+	/* No edges at the first sample of the capture */
+	if (edges && !block->started)
+		match &= ~1ULL;
+
+	return cond->inv ? ~match : match;
+}
+
+/*
+ * Finds the sample from pos on where the current stage is passed.
+ * Returns -1 and keeps the count when it isn't passed in this block.
+ */
+static int stage_scan(struct sr_soft_trigger *st,
+		      const struct soft_stage *stage, uint64_t match, int pos)
+{
+	uint64_t bits;
+	unsigned int n, ones;
+
+	if (!stage->contiguous) {
+		bits = match & (~0ULL << pos);
+		n = __builtin_popcountll(bits);
+		if (st->matched + n < stage->count) {
+			st->matched += n;
+			return -1;
+		}
+		for (n = stage->count - st->matched; n > 1; n--)
+			bits &= bits - 1;
+		return __builtin_ctzll(bits);
+	}
+
+	while (pos < 64) {
+		bits = match >> pos;
+		if (!(bits & 1)) {
+			st->matched = 0;
+			if (!bits)
+				return -1;
+			pos += __builtin_ctzll(bits);
+			continue;
+		}
+		ones = ~bits ? __builtin_ctzll(~bits) : 64;
+		if (st->matched + ones >= stage->count)
+			return pos + (stage->count - st->matched) - 1;
+		st->matched += ones;
+		pos += ones;
+	}
+	return -1;
+}
+
+static void ring_push(struct sr_soft_trigger *st,
+		      const struct soft_block *block)
+{
+	uint64_t *const dst = st->ring + st->ring_head * st->channels;
+	unsigned int c;
+
+	if (!st->ring_blocks)
+		return;
+	for (c = 0; c < st->channels; c++)
+		dst[c] = block->words[c * block->channel_stride];
+	st->ring_head = (st->ring_head + 1) % st->ring_blocks;
+	st->ring_count = MIN(st->ring_count + 1, st->ring_blocks);
+}
+
+static void reverse(uint64_t *words, uint64_t n)
+{
+	uint64_t i, tmp;
+
+	for (i = 0; i < n / 2; i++) {
+		tmp = words[i];
+		words[i] = words[n - 1 - i];
+		words[n - 1 - i] = tmp;
+	}
+}
+
+/**
+ * Sets up the trigger in its current settings.
+ *
+ * @param trigger The trigger settings, see ds_trigger_get().
+ * @param channels The channels of the device, the enabled logic channels
+ *                 are the words of a block in this order.
+ * @param pre_samples Samples to keep before the trigger, rounded down
+ *                    to whole blocks.
+ *
+ * @return The trigger, or NULL when it isn't supported or out of memory.
+ */
+SR_PRIV struct sr_soft_trigger *sr_soft_trigger_new(
+		const struct ds_trigger *trigger, const GSList *channels,
+		uint64_t pre_samples)
+{
+	struct sr_soft_trigger *st;
+	const struct sr_channel *probe;
+	int order[TriggerProbes];
+	unsigned int i;
+
+	if (trigger->trigger_mode == SERIAL_TRIGGER) {
+		sr_err("Serial triggers are not supported.");
+		return NULL;
+	}
+
+	if (!(st = g_try_malloc0(sizeof(struct sr_soft_trigger)))) {
+		sr_err("Trigger malloc failed.");
+		return NULL;
+	}
+
+	for (i = 0; i < TriggerProbes; i++)
+		order[i] = -1;
+	for (; channels; channels = channels->next) {
+		probe = channels->data;
+		if (!probe->enabled || probe->type != SR_CHANNEL_LOGIC)
+			continue;
+		if (probe->index < TriggerProbes)
+			order[probe->index] = st->channels;
+		st->channels++;
+	}
+
+	if (trigger->trigger_mode == SIMPLE_TRIGGER) {
+		st->num_stages = 1;
+		stage_init(&st->stages[0], trigger, TriggerStages, order);
+	} else {
+		st->num_stages = trigger->trigger_stages + 1;
+		for (i = 0; i < st->num_stages; i++)
+			stage_init(&st->stages[i], trigger, i, order);
+	}
+
+	st->ring_blocks = st->channels ? pre_samples / 64 : 0;
+	if (st->ring_blocks && !(st->ring = g_try_malloc(st->ring_blocks *
+				st->channels * sizeof(uint64_t)))) {
+		sr_err("Pre-trigger buffer malloc failed.");
+		g_free(st);
+		return NULL;
+	}
+
+	return st;
+}
+
+/**
+ * Runs the trigger over blocks of data. The word of channel c in block b
+ * is data[b * block_stride + c * channel_stride]: block_stride is the
+ * number of channels for cross data, channel_stride is the number of
+ * blocks for data which is split by channel.
+ *
+ * @return The blocks before the one with the trigger, which are now in
+ *         the pre-trigger data, or num_blocks when it didn't fire.
+ */
+SR_PRIV uint64_t sr_soft_trigger_feed(struct sr_soft_trigger *st,
+		const uint64_t *data, uint64_t num_blocks,
+		uint64_t block_stride, uint64_t channel_stride)
+{
+	struct soft_block block;
+	const struct soft_stage *stage;
+	uint64_t b, match;
+	unsigned int c;
+	int pos;
+
+	if (st->fired)
+		return 0;
+
+	block.channel_stride = channel_stride;
+	for (b = 0; b < num_blocks; b++) {
+		block.words = data + b * block_stride;
+		block.last = st->last;
+		block.started = st->started;
+
+		for (pos = 0; pos < 64; pos++) {
+			stage = &st->stages[st->stage];
+			match = cond_match(&block, &stage->cond[0]);
+			match = stage->and ?
+				match & cond_match(&block, &stage->cond[1]) :
+				match | cond_match(&block, &stage->cond[1]);
+			if ((pos = stage_scan(st, stage, match, pos)) < 0)
+				break;
+
+			st->matched = 0;
+			if (++st->stage == st->num_stages) {
+				st->fired = TRUE;
+				st->pos = st->ring_count * 64 + pos;
+				return b;
+			}
+		}
+
+		ring_push(st, &block);
+		st->last = 0;
+		for (c = 0; c < st->channels; c++)
+			st->last |= (block.words[c * channel_stride] >> 63) << c;
+		st->started = TRUE;
+	}
+
+	return num_blocks;
+}
+
+SR_PRIV gboolean sr_soft_trigger_fired(const struct sr_soft_trigger *st)
+{
+	return st->fired;
+}
+
+/**
+ * @return The sample of the trigger, counted from the first sample of
+ *         the pre-trigger data.
+ */
+SR_PRIV uint64_t sr_soft_trigger_pos(const struct sr_soft_trigger *st)
+{
+	return st->pos;
+}
+
+/**
+ * The blocks before the trigger, as cross data in the order they were
+ * captured. Only valid until the trigger is fed or freed.
+ */
+SR_PRIV const uint64_t *sr_soft_trigger_pre_data(struct sr_soft_trigger *st,
+						 uint64_t *num_blocks)
+{
+	const uint64_t n = st->ring_blocks * st->channels;
+	const uint64_t head = st->ring_head * st->channels;
+
+	/* Rotate the oldest block to the front, once the ring wrapped. */
+	if (st->ring_count == st->ring_blocks && head) {
+		reverse(st->ring, head);
+		reverse(st->ring + head, n - head);
+		reverse(st->ring, n);
+		st->ring_head = 0;
+	}
+
+	*num_blocks = st->ring_count;
+	return st->ring;
+}
+
+SR_PRIV void sr_soft_trigger_free(struct sr_soft_trigger *st)
+{
+	if (!st)
+		return;
+	g_free(st->ring);
+	g_free(st);
+}
@@ -0,0 +1,214 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+#include <glib.h>
+
+/*
+ * Sizes the USB transfers of a stream from the host's timing.
+ *
+ * A transfer in flight holds buffer_time of data, so the device can
+ * keep streaming for count * buffer_time while the host doesn't
+ * resubmit. Each completion reports how late the host was (the stall)
+ * and how much completed data waits for the consumer (the lag). The
+ * larger of both is the time the host needs to be covered for.
+ *
+ * When that need reaches half of the time in flight, more transfers
+ * are used at once, and longer buffers once the count is at its limit.
+ * When the need stays below a quarter of the time in flight for a few
+ * seconds, the buffers are made shorter first, which brings the data
+ * latency down, then fewer transfers are used.
+ */
+
+/* Length of a measurement window, in us. */
+#define CTL_WINDOW_TIME 500000
+/* Calm windows before the transfers are made smaller. */
+#define CTL_CALM_WINDOWS 10
+
+static uint64_t inflight_time(unsigned int buffer_time, unsigned int count)
+{
+	return (uint64_t)buffer_time * count;
+}
+
+/* The most transfers of buffer_time within the limits. */
+static unsigned int count_limit(const struct sr_transfer_ctl *ctl,
+				unsigned int buffer_time)
+{
+	const uint64_t n = ctl->max_inflight / buffer_time;
+
+	if (n < ctl->min_count)
+		return ctl->min_count;
+	return MIN(n, ctl->max_count);
+}
+
+static void window_reset(struct sr_transfer_ctl *ctl, int64_t now)
+{
+	ctl->window_start = now;
+	ctl->need_max = 0;
+}
+
+static gboolean grow(struct sr_transfer_ctl *ctl, int64_t need)
+{
+	unsigned int buffer_time, limit;
+	int64_t count;
+
+	/* Cover twice the need, more transfers first. */
+	count = (2 * need + ctl->buffer_time - 1) / ctl->buffer_time;
+	count = MAX(count, ctl->count + 1);
+	limit = count_limit(ctl, ctl->buffer_time);
+	if (ctl->count < limit) {
+		ctl->count = MIN(count, limit);
+		ctl->reason = "host stalls, more transfers in flight";
+		return TRUE;
+	}
+
+	/* Only helps when the count isn't limited by the time in flight. */
+	buffer_time = MIN(ctl->buffer_time * 2, ctl->max_time);
+	limit = MIN(ctl->count, count_limit(ctl, buffer_time));
+	if (inflight_time(buffer_time, limit) >
+	    inflight_time(ctl->buffer_time, ctl->count)) {
+		ctl->buffer_time = buffer_time;
+		ctl->count = limit;
+		ctl->reason = "host stalls, transfers at their limit, longer buffers";
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean shrink(struct sr_transfer_ctl *ctl, int64_t need)
+{
+	unsigned int buffer_time, count;
+
+	buffer_time = MAX(ctl->buffer_time / 2, ctl->min_time);
+	if (buffer_time < ctl->buffer_time &&
+	    (uint64_t)need * 4 < inflight_time(buffer_time, ctl->count)) {
+		ctl->buffer_time = buffer_time;
+		ctl->reason = "host keeps up, shorter buffers";
+		return TRUE;
+	}
+
+	count = MAX(ctl->count - MAX(ctl->count / 4, 1), ctl->min_count);
+	if (count < ctl->count &&
+	    (uint64_t)need * 4 < inflight_time(ctl->buffer_time, count)) {
+		ctl->count = count;
+		ctl->reason = "host keeps up, fewer transfers in flight";
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+ * Sets the limits and starts with the shortest buffers and the fewest
+ * transfers in flight.
+ *
+ * @param min_time Shortest buffer, in us of data.
+ * @param max_time Longest buffer, in us of data.
+ * @param min_count Fewest transfers in flight.
+ * @param max_count Most transfers in flight.
+ */
+SR_PRIV void sr_transfer_ctl_init(struct sr_transfer_ctl *ctl,
+		unsigned int min_time, unsigned int max_time,
+		unsigned int min_count, unsigned int max_count)
+{
+	ctl->min_time = min_time;
+	ctl->max_time = MAX(max_time, min_time);
+	ctl->min_count = min_count;
+	ctl->max_count = MAX(max_count, min_count);
+	ctl->max_inflight = inflight_time(ctl->max_time, ctl->max_count);
+	ctl->buffer_time = min_time;
+	ctl->count = min_count;
+	ctl->calm_windows = 0;
+	ctl->reason = NULL;
+	window_reset(ctl, 0);
+}
+
+/**
+ * Starts measuring a stream. The settings learned by earlier streams
+ * are kept, within the limits of this one.
+ *
+ * @param now Current time, in us.
+ * @param max_inflight Most data in flight, in us, 0 for no limit
+ *                     other than max_time and max_count.
+ */
+SR_PRIV void sr_transfer_ctl_start(struct sr_transfer_ctl *ctl, int64_t now,
+				   uint64_t max_inflight)
+{
+	ctl->max_inflight = inflight_time(ctl->max_time, ctl->max_count);
+	if (max_inflight)
+		ctl->max_inflight = MIN(max_inflight, ctl->max_inflight);
+	/* At least the smallest settings are always allowed. */
+	ctl->max_inflight = MAX(ctl->max_inflight,
+		inflight_time(ctl->min_time, ctl->min_count));
+
+	while (ctl->buffer_time > ctl->min_time &&
+	       inflight_time(ctl->buffer_time, ctl->min_count) > ctl->max_inflight)
+		ctl->buffer_time = MAX(ctl->buffer_time / 2, ctl->min_time);
+	ctl->count = MIN(ctl->count, count_limit(ctl, ctl->buffer_time));
+
+	ctl->calm_windows = 0;
+	ctl->reason = NULL;
+	window_reset(ctl, now);
+}
+
+/**
+ * Adds the measurements of one completed transfer.
+ *
+ * @param now Current time, in us.
+ * @param stall Time the host was late to handle the completion, in us.
+ * @param lag Time of the completed data waiting for the consumer, in us.
+ *
+ * @return TRUE if buffer_time or count changed, the reason is in
+ *         ctl->reason then.
+ */
+SR_PRIV gboolean sr_transfer_ctl_sample(struct sr_transfer_ctl *ctl,
+		int64_t now, int64_t stall, int64_t lag)
+{
+	const int64_t need = MAX(MAX(stall, lag), 0);
+	gboolean changed = FALSE;
+
+	ctl->need_max = MAX(ctl->need_max, need);
+
+	/* Grow at once, a stall longer than the time in flight overflows. */
+	if ((uint64_t)need * 2 > inflight_time(ctl->buffer_time, ctl->count)) {
+		ctl->calm_windows = 0;
+		changed = grow(ctl, need);
+		if (changed)
+			window_reset(ctl, now);
+		return changed;
+	}
+
+	if (now - ctl->window_start < CTL_WINDOW_TIME)
+		return FALSE;
+
+	if ((uint64_t)ctl->need_max * 4 <
+	    inflight_time(ctl->buffer_time, ctl->count)) {
+		if (++ctl->calm_windows >= CTL_CALM_WINDOWS) {
+			ctl->calm_windows = 0;
+			changed = shrink(ctl, ctl->need_max);
+		}
+	} else {
+		ctl->calm_windows = 0;
+	}
+	window_reset(ctl, now);
+
+	return changed;
+}
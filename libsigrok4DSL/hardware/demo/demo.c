@@ -27,6 +27,16 @@
 #define BUFSIZE                512*1024
 #define DSO_BUFSIZE            10*1024
 
+/* Samples of a benchmark pattern, sent over and over. */
+#define BENCH_PATTERN_SAMPLES  (4*BUFSIZE)
+/* Time (ms) of the samples of a replay packet. */
+#define BENCH_REPLAY_PACKET_TIME  10
+/* Poll interval (ms) and longest time (us) a poll sends data. */
+#define BENCH_POLL_TIME        1
+#define BENCH_SEND_TIME        20000
+/* The same pattern on every run, for comparable results. */
+#define BENCH_SEED             0x2545f491
+
 static const int hwoptions[] = {
     SR_CONF_PATTERN_MODE,
     SR_CONF_MAX_HEIGHT,
@@ -73,6 +83,7 @@ static struct sr_dev_driver *di = &demo_driver_info;
 extern struct ds_trigger *trigger;
 
 static int hw_dev_acquisition_stop(const struct sr_dev_inst *sdi, void *cb_data);
+static uint64_t replay_samplerate(const char *path);
 
 static int clear_instances(void)
 {
@@ -170,6 +181,16 @@ static GSList *hw_scan(GSList *options)
     devc->sample_generator = devc->profile->dev_caps.default_pattern;
     devc->timebase = devc->profile->dev_caps.default_timebase;
     devc->max_height = 0;
+    devc->bench_rate = 0;
+    devc->bench_density = 1000;
+    devc->bench_format = LA_CROSS_DATA;
+    devc->bench_replay = NULL;
+    devc->bench_buf = NULL;
+    devc->replay_speed = 1;
+    devc->replay_loop = TRUE;
+    devc->replay_archive = NULL;
+    devc->replay_probes = NULL;
+    devc->replay_chunk = NULL;
     adjust_samplerate(devc);
 
     sdi = sr_dev_inst_new(channel_modes[devc->ch_mode].mode, 0, SR_ST_INITIALIZING,
@@ -267,6 +288,8 @@ static int hw_cleanup(void)
 			ret = SR_ERR_BUG;
 			continue;
 		}
+		if (sdi->priv)
+			g_free(((struct demo_context *)sdi->priv)->bench_replay);
 		sr_dev_inst_free(sdi);
 	}
 	g_slist_free(drvc->instances);
@@ -401,6 +424,27 @@ static int config_get(int id, GVariant **data, const struct sr_dev_inst *sdi,
             return SR_ERR;
         *data = g_variant_new_boolean(devc->profile->dev_caps.feature_caps & CAPS_FEATURE_ZERO);
         break;
+    case SR_CONF_CAPTURE_NUM_PROBES:
+        *data = g_variant_new_uint64(en_ch_num(sdi));
+        break;
+    case SR_CONF_BENCHMARK_RATE:
+        *data = g_variant_new_uint64(devc->bench_rate);
+        break;
+    case SR_CONF_TOGGLE_DENSITY:
+        *data = g_variant_new_uint64(devc->bench_density);
+        break;
+    case SR_CONF_LA_DATA_FORMAT:
+        *data = g_variant_new_int16(devc->bench_format);
+        break;
+    case SR_CONF_CAPTUREFILE:
+        *data = g_variant_new_string(devc->bench_replay ? devc->bench_replay : "");
+        break;
+    case SR_CONF_REPLAY_SPEED:
+        *data = g_variant_new_uint64(devc->replay_speed);
+        break;
+    case SR_CONF_REPLAY_LOOP:
+        *data = g_variant_new_boolean(devc->replay_loop);
+        break;
     default:
 		return SR_ERR_NA;
 	}
@@ -416,6 +460,8 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
     int ret, num_probes;
 	const char *stropt;
     uint64_t tmp_u64;
+    int16_t tmp_i16;
+    GSList *l;
 
     (void) cg;
 
@@ -481,6 +527,8 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
             devc->sample_generator = PATTERN_SAWTOOTH;
         } else if (!strcmp(stropt, pattern_strings[PATTERN_RANDOM])) {
             devc->sample_generator = PATTERN_RANDOM;
+        } else if (!strcmp(stropt, pattern_strings[PATTERN_BENCHMARK])) {
+            devc->sample_generator = PATTERN_BENCHMARK;
 		} else {
             ret = SR_ERR;
 		}
@@ -586,6 +634,61 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
     } else if (id == SR_CONF_LANGUAGE) {
         devc->language = g_variant_get_int16(data);
         ret = SR_OK;
+    } else if (id == SR_CONF_CAPTURE_NUM_PROBES) {
+        /* Enables the first probes, like a device with fewer channels */
+        tmp_u64 = g_variant_get_uint64(data);
+        if (sdi->mode != LOGIC || tmp_u64 == 0 ||
+            tmp_u64 > g_slist_length(sdi->channels)) {
+            ret = SR_ERR_ARG;
+        } else {
+            for (l = sdi->channels; l; l = l->next) {
+                struct sr_channel *probe = (struct sr_channel *)l->data;
+                probe->enabled = (probe->index < tmp_u64);
+            }
+            sr_dbg("%s: setting %" PRIu64 " channels", __func__, tmp_u64);
+            ret = SR_OK;
+        }
+    } else if (id == SR_CONF_BENCHMARK_RATE) {
+        devc->bench_rate = g_variant_get_uint64(data);
+        sr_dbg("%s: setting benchmark rate to %" PRIu64, __func__,
+               devc->bench_rate);
+        ret = SR_OK;
+    } else if (id == SR_CONF_TOGGLE_DENSITY) {
+        devc->bench_density = min(g_variant_get_uint64(data), 1000000);
+        sr_dbg("%s: setting toggle density to %" PRIu64, __func__,
+               devc->bench_density);
+        ret = SR_OK;
+    } else if (id == SR_CONF_LA_DATA_FORMAT) {
+        tmp_i16 = g_variant_get_int16(data);
+        if (tmp_i16 == LA_CROSS_DATA || tmp_i16 == LA_SPLIT_DATA) {
+            devc->bench_format = tmp_i16;
+            ret = SR_OK;
+        } else {
+            ret = SR_ERR_ARG;
+        }
+        sr_dbg("%s: setting data format to %d", __func__, devc->bench_format);
+    } else if (id == SR_CONF_CAPTUREFILE) {
+        /* A replay runs at the samplerate of its file */
+        stropt = g_variant_get_string(data, NULL);
+        if (*stropt && !(tmp_u64 = replay_samplerate(stropt))) {
+            ret = SR_ERR_ARG;
+        } else {
+            g_free(devc->bench_replay);
+            devc->bench_replay = *stropt ? g_strdup(stropt) : NULL;
+            if (devc->bench_replay)
+                devc->cur_samplerate = tmp_u64;
+            sr_dbg("%s: setting replay file to %s", __func__, stropt);
+            ret = SR_OK;
+        }
+    } else if (id == SR_CONF_REPLAY_SPEED) {
+        devc->replay_speed = g_variant_get_uint64(data);
+        sr_dbg("%s: setting replay speed to %" PRIu64, __func__,
+               devc->replay_speed);
+        ret = SR_OK;
+    } else if (id == SR_CONF_REPLAY_LOOP) {
+        devc->replay_loop = g_variant_get_boolean(data);
+        sr_dbg("%s: setting replay loop to %d", __func__, devc->replay_loop);
+        ret = SR_OK;
     } else {
         ret = SR_ERR_NA;
 	}
@@ -826,6 +929,506 @@ static void samples_generator(uint16_t *buf, uint64_t size,
     }
 }
 
+/*
+ * Benchmark pattern
+ *
+ * The logic data is computed once at the start, in the layout of the
+ * packets, and sent over and over from a short poll interval. Without a
+ * rate the packets go out as fast as the session takes them, so the
+ * ingest path rather than the clock is the limit.
+ */
+
+static uint32_t bench_random(uint32_t *seed)
+{
+    /* xorshift32 */
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+/* Samples up to the next toggle, for density toggles per million samples. */
+static uint64_t bench_gap(uint64_t density, uint32_t *seed)
+{
+    double u;
+
+    if (density == 0)
+        return UINT64_MAX;
+    if (density >= 1000000)
+        return 1;
+
+    u = (bench_random(seed) + 1.0) / 4294967297.0;
+    return 1 + (uint64_t)(log(u) / log1p(-(double)density / 1000000));
+}
+
+/* Fills every stride-th word with the samples of one channel. */
+static void bench_fill(uint64_t *words, unsigned int stride, uint64_t num_words,
+                       uint64_t density, uint32_t seed)
+{
+    uint64_t i, word, level = 0;
+    uint64_t gap = bench_gap(density, &seed);
+    int bit;
+
+    for (i = 0; i < num_words; i++) {
+        word = 0;
+        for (bit = 0; bit < 64; bit++) {
+            if (--gap == 0) {
+                level ^= 1;
+                gap = bench_gap(density, &seed);
+            }
+            word |= level << bit;
+        }
+        words[i * stride] = word;
+    }
+}
+
+/*
+ * Reads the header of a version 2 logic session file: the indices of
+ * its probes, its samplerate and its sample count.
+ */
+static int replay_read_header(struct zip *archive, const char *path,
+                              GArray *probes, uint64_t *samplerate,
+                              uint64_t *samples)
+{
+    struct zip_stat zs;
+    struct zip_file *zf;
+    GKeyFile *kf;
+    char *metafile, *val, **keys;
+    unsigned int i, index;
+
+    if (zip_stat(archive, "header", 0, &zs) == -1 ||
+        !(metafile = g_try_malloc(zs.size))) {
+        sr_err("Replay file '%s' has no header.", path);
+        return SR_ERR;
+    }
+    zf = zip_fopen_index(archive, zs.index, 0);
+    zip_fread(zf, metafile, zs.size);
+    zip_fclose(zf);
+
+    *samplerate = 0;
+    *samples = 0;
+    kf = g_key_file_new();
+    if (g_key_file_load_from_data(kf, metafile, zs.size, 0, NULL) &&
+        g_key_file_get_integer(kf, "version", "version", NULL) == 2 &&
+        g_key_file_get_integer(kf, "header", "device mode", NULL) == LOGIC) {
+        if ((val = g_key_file_get_string(kf, "header", "samplerate", NULL)))
+            sr_parse_sizestring(val, samplerate);
+        g_free(val);
+        *samples = g_key_file_get_uint64(kf, "header", "total samples", NULL);
+        keys = g_key_file_get_keys(kf, "header", NULL, NULL);
+        for (i = 0; keys && keys[i]; i++) {
+            if (strncmp(keys[i], "probe", 5))
+                continue;
+            index = strtoul(keys[i] + 5, NULL, 10);
+            g_array_append_val(probes, index);
+        }
+        g_strfreev(keys);
+    }
+    g_key_file_free(kf);
+    g_free(metafile);
+
+    *samples &= ~63ULL;
+    if (probes->len == 0 || *samples == 0 || *samplerate == 0) {
+        sr_err("Replay file '%s' has no logic data.", path);
+        return SR_ERR;
+    }
+
+    return SR_OK;
+}
+
+/* The samplerate of a replay file, 0 when it can't be replayed. */
+static uint64_t replay_samplerate(const char *path)
+{
+    struct zip *archive;
+    GArray *probes;
+    uint64_t samplerate, samples;
+    int ret;
+
+    if (!(archive = zip_open(path, 0, &ret))) {
+        sr_err("Failed to open replay file '%s'.", path);
+        return 0;
+    }
+    probes = g_array_new(FALSE, FALSE, sizeof(unsigned int));
+    if (replay_read_header(archive, path, probes, &samplerate,
+                           &samples) != SR_OK)
+        samplerate = 0;
+    g_array_free(probes, TRUE);
+    zip_close(archive);
+
+    return samplerate;
+}
+
+/*
+ * Opens the replay file for the capture. The file is read one block at
+ * a time, the block size is the one of the chunks of its first probe.
+ */
+static int replay_open(struct demo_context *devc)
+{
+    struct zip_stat zs;
+    char file_name[32];
+    uint64_t samplerate;
+    int ret;
+
+    if (!(devc->replay_archive = zip_open(devc->bench_replay, 0, &ret))) {
+        sr_err("Failed to open replay file '%s'.", devc->bench_replay);
+        return SR_ERR;
+    }
+    devc->replay_probes = g_array_new(FALSE, FALSE, sizeof(unsigned int));
+    if ((ret = replay_read_header(devc->replay_archive, devc->bench_replay,
+                                  devc->replay_probes, &samplerate,
+                                  &devc->replay_samples)) != SR_OK)
+        return ret;
+
+    /* Each channel is stored in blocks, L-<probe index>/<block> */
+    snprintf(file_name, sizeof(file_name), "L-%u/0",
+             g_array_index(devc->replay_probes, unsigned int, 0));
+    if (zip_stat(devc->replay_archive, file_name, 0, &zs) == -1 ||
+        (devc->replay_block_samples = (zs.size * 8) & ~63ULL) == 0) {
+        sr_err("Replay file '%s' has no logic data.", devc->bench_replay);
+        return SR_ERR;
+    }
+    if (!(devc->replay_chunk = g_try_malloc(devc->replay_block_samples / 8))) {
+        sr_err("Replay buffer malloc failed.");
+        return SR_ERR_MALLOC;
+    }
+
+    return SR_OK;
+}
+
+/*
+ * Reads a block of the replay file into the pattern buffer, in the
+ * format of the capture. The channels of the file are used over again
+ * when more channels are enabled.
+ */
+static int replay_load(struct demo_context *devc, uint64_t block)
+{
+    const unsigned int replay_channels = devc->replay_probes->len;
+    const unsigned int stride = (devc->bench_format == LA_SPLIT_DATA) ?
+                                1 : devc->bench_channels;
+    struct zip_file *zf;
+    char file_name[32];
+    uint64_t num_words, i;
+    uint64_t *words, *src;
+    zip_int64_t len;
+    uint16_t ch;
+
+    devc->replay_block = block;
+    devc->bench_samples = min(devc->replay_block_samples,
+                              devc->replay_samples - block * devc->replay_block_samples);
+    devc->bench_pos = 0;
+    num_words = devc->bench_samples / 64;
+
+    for (ch = 0; ch < devc->bench_channels; ch++) {
+        words = (devc->bench_format == LA_SPLIT_DATA) ?
+                devc->bench_buf + ch * num_words : devc->bench_buf + ch;
+        if (ch >= replay_channels) {
+            src = (devc->bench_format == LA_SPLIT_DATA) ?
+                  devc->bench_buf + (ch % replay_channels) * num_words :
+                  devc->bench_buf + ch % replay_channels;
+            for (i = 0; i < num_words; i++)
+                words[i * stride] = src[i * stride];
+            continue;
+        }
+
+        snprintf(file_name, sizeof(file_name), "L-%u/%" PRIu64,
+                 g_array_index(devc->replay_probes, unsigned int, ch), block);
+        if (!(zf = zip_fopen(devc->replay_archive, file_name, 0))) {
+            sr_err("Replay file '%s' has no %s.", devc->bench_replay, file_name);
+            return SR_ERR;
+        }
+        len = zip_fread(zf, devc->replay_chunk, num_words * sizeof(uint64_t));
+        zip_fclose(zf);
+        if (len != (zip_int64_t)(num_words * sizeof(uint64_t))) {
+            sr_err("Failed to read %s of replay file '%s'.", file_name,
+                   devc->bench_replay);
+            return SR_ERR;
+        }
+        for (i = 0; i < num_words; i++)
+            words[i * stride] = devc->replay_chunk[i];
+    }
+
+    return SR_OK;
+}
+
+static void bench_free(struct demo_context *devc)
+{
+    g_free(devc->bench_buf);
+    devc->bench_buf = NULL;
+    g_free(devc->replay_chunk);
+    devc->replay_chunk = NULL;
+    if (devc->replay_probes)
+        g_array_free(devc->replay_probes, TRUE);
+    devc->replay_probes = NULL;
+    if (devc->replay_archive)
+        zip_close(devc->replay_archive);
+    devc->replay_archive = NULL;
+}
+
+/*
+ * Computes the pattern of the enabled channels from the toggle density,
+ * or opens the replay file and reads its first block.
+ *
+ * A replay is sent in packets of BENCH_REPLAY_PACKET_TIME of samples,
+ * like the transfers of a DSLogic in stream mode, and each packet is
+ * only sent once all of its samples are due.
+ */
+static int bench_prepare(const struct sr_dev_inst *sdi, struct demo_context *devc)
+{
+    uint64_t num_words;
+    uint16_t ch;
+    int ret;
+
+    if (!(devc->bench_channels = en_ch_num(sdi))) {
+        sr_err("No channels enabled.");
+        return SR_ERR;
+    }
+
+    devc->bench_pos = 0;
+    devc->bench_generated = 0;
+
+    if (devc->bench_replay) {
+        if ((ret = replay_open(devc)) != SR_OK)
+            return ret;
+        if (!(devc->bench_buf = g_try_malloc(devc->replay_block_samples / 8 *
+                                             devc->bench_channels))) {
+            sr_err("Benchmark pattern malloc failed.");
+            return SR_ERR_MALLOC;
+        }
+        devc->bench_packet = (devc->cur_samplerate *
+                              BENCH_REPLAY_PACKET_TIME / 1000 + 63) & ~63ULL;
+        devc->bench_packet = max(devc->bench_packet, 64);
+        return replay_load(devc, 0);
+    }
+
+    devc->bench_samples = BENCH_PATTERN_SAMPLES;
+    devc->bench_packet = BUFSIZE;
+    num_words = devc->bench_samples / 64;
+    if (!(devc->bench_buf = g_try_malloc(num_words * devc->bench_channels *
+                                         sizeof(uint64_t)))) {
+        sr_err("Benchmark pattern malloc failed.");
+        return SR_ERR_MALLOC;
+    }
+
+    /* Cross data interleaves the words of the channels */
+    for (ch = 0; ch < devc->bench_channels; ch++) {
+        if (devc->bench_format == LA_SPLIT_DATA)
+            bench_fill(devc->bench_buf + ch * num_words, 1, num_words,
+                       devc->bench_density, BENCH_SEED + ch);
+        else
+            bench_fill(devc->bench_buf + ch, devc->bench_channels, num_words,
+                       devc->bench_density, BENCH_SEED + ch);
+    }
+
+    return SR_OK;
+}
+
+static void bench_send(const struct sr_dev_inst *sdi, struct demo_context *devc,
+                       uint64_t samples)
+{
+    struct sr_datafeed_packet packet;
+    struct sr_datafeed_logic logic;
+    const uint64_t num_words = devc->bench_samples / 64;
+    const uint64_t word = devc->bench_pos / 64;
+    struct sr_channel *probe;
+    uint16_t order = 0;
+    GSList *l;
+
+    packet.type = SR_DF_LOGIC;
+    packet.status = SR_PKT_OK;
+    packet.payload = &logic;
+    memset(&logic, 0, sizeof(logic));
+    logic.format = devc->bench_format;
+
+    if (devc->bench_format == LA_CROSS_DATA) {
+        logic.length = samples / 8 * devc->bench_channels;
+        logic.data = devc->bench_buf + word * devc->bench_channels;
+        sr_session_send(sdi, &packet);
+        return;
+    }
+
+    /* One packet for each channel */
+    logic.length = samples / 8;
+    for (l = sdi->channels; l; l = l->next) {
+        probe = (struct sr_channel *)l->data;
+        if (!probe->enabled)
+            continue;
+        logic.index = probe->index;
+        logic.order = order;
+        logic.data = devc->bench_buf + order * num_words + word;
+        sr_session_send(sdi, &packet);
+        order++;
+    }
+}
+
+/*
+ * Sends the data kept before the trigger, in the format of the rest of
+ * the capture. Split data is gathered by channel into buf.
+ */
+static void trigger_send_pre(const struct sr_dev_inst *sdi,
+                             struct demo_context *devc, int format)
+{
+    struct sr_datafeed_packet packet;
+    struct sr_datafeed_logic logic;
+    const uint16_t channels = en_ch_num(sdi);
+    const uint64_t *pre;
+    uint64_t *const words = (uint64_t *)devc->buf;
+    uint64_t num_blocks, b, n, i;
+    struct sr_channel *probe;
+    uint16_t order;
+    GSList *l;
+
+    pre = sr_soft_trigger_pre_data(devc->soft_trigger, &num_blocks);
+
+    packet.type = SR_DF_LOGIC;
+    packet.status = SR_PKT_OK;
+    packet.payload = &logic;
+    memset(&logic, 0, sizeof(logic));
+    logic.format = format;
+
+    for (b = 0; b < num_blocks; b += n) {
+        n = min(num_blocks - b, BUFSIZE / 64);
+        if (format == LA_CROSS_DATA) {
+            logic.length = n * channels * sizeof(uint64_t);
+            logic.data = (void *)(pre + b * channels);
+            sr_session_send(sdi, &packet);
+            continue;
+        }
+
+        logic.length = n * sizeof(uint64_t);
+        logic.data = words;
+        order = 0;
+        for (l = sdi->channels; l; l = l->next) {
+            probe = (struct sr_channel *)l->data;
+            if (!probe->enabled)
+                continue;
+            for (i = 0; i < n; i++)
+                words[i] = pre[(b + i) * channels + order];
+            logic.index = probe->index;
+            logic.order = order;
+            sr_session_send(sdi, &packet);
+            order++;
+        }
+    }
+
+    devc->samples_counter += num_blocks * 64;
+}
+
+/*
+ * Runs the trigger over logic data, see sr_soft_trigger_feed() for the
+ * strides. When it fires, sends the trigger and the data before it, and
+ * returns the samples before the block of the trigger, which need not
+ * be sent any more. Returns all samples while it waits.
+ */
+static uint64_t trigger_scan(const struct sr_dev_inst *sdi,
+                             struct demo_context *devc, int format,
+                             const uint64_t *data, uint64_t samples,
+                             uint64_t block_stride, uint64_t channel_stride)
+{
+    struct sr_datafeed_packet packet;
+    struct ds_trigger_pos trigger_pos;
+    uint64_t blocks;
+
+    blocks = sr_soft_trigger_feed(devc->soft_trigger, data, samples / 64,
+                                  block_stride, channel_stride);
+    if (!sr_soft_trigger_fired(devc->soft_trigger))
+        return samples;
+
+    memset(&trigger_pos, 0, sizeof(trigger_pos));
+    trigger_pos.real_pos = sr_soft_trigger_pos(devc->soft_trigger);
+    trigger_pos.status = 1;
+    packet.type = SR_DF_TRIGGER;
+    packet.status = SR_PKT_OK;
+    packet.payload = &trigger_pos;
+    sr_session_send(sdi, &packet);
+
+    trigger_send_pre(sdi, devc, format);
+    sr_soft_trigger_free(devc->soft_trigger);
+    devc->soft_trigger = NULL;
+    devc->mstatus.trig_hit = 1;
+
+    return blocks * 64;
+}
+
+static int receive_bench(const struct sr_dev_inst *sdi, struct demo_context *devc)
+{
+    const int64_t start = g_get_monotonic_time();
+    const uint64_t rate = devc->replay_archive ?
+                          devc->replay_speed * devc->cur_samplerate :
+                          devc->bench_rate;
+    uint64_t num_words, samples, due, skip, word, block;
+    int64_t now = start;
+    gboolean end = FALSE;
+
+    while (!devc->stop && now - start < BENCH_SEND_TIME) {
+        /* The next block of a replay, or the end of it */
+        if (devc->replay_archive && devc->bench_pos == devc->bench_samples) {
+            block = devc->replay_block + 1;
+            if (block * devc->replay_block_samples >= devc->replay_samples) {
+                if (!devc->replay_loop) {
+                    sr_info("End of the replay file.");
+                    end = TRUE;
+                    break;
+                }
+                block = 0;
+            }
+            if (replay_load(devc, block) != SR_OK) {
+                end = TRUE;
+                break;
+            }
+        }
+
+        samples = devc->limit_samples ?
+                  devc->limit_samples - devc->samples_counter : UINT64_MAX;
+        samples = min(samples, devc->bench_packet);
+        samples = min(samples, devc->bench_samples - devc->bench_pos);
+        if (samples == 0)
+            break;
+        if (rate) {
+            due = (uint64_t)((now - devc->starttime) / 1000000.0 * rate) & ~63ULL;
+            /* Replay packets go out whole, once their last sample is due */
+            if (due < devc->bench_generated + (devc->replay_archive ? samples : 64))
+                break;
+            samples = min(samples, due - devc->bench_generated);
+        }
+        devc->bench_generated += samples;
+
+        /* Samples before the trigger are only kept for the pre-trigger data */
+        skip = 0;
+        if (devc->soft_trigger) {
+            num_words = devc->bench_samples / 64;
+            word = devc->bench_pos / 64;
+            if (devc->bench_format == LA_CROSS_DATA)
+                skip = trigger_scan(sdi, devc, LA_CROSS_DATA,
+                                    devc->bench_buf + word * devc->bench_channels,
+                                    samples, devc->bench_channels, 1);
+            else
+                skip = trigger_scan(sdi, devc, LA_SPLIT_DATA,
+                                    devc->bench_buf + word, samples, 1, num_words);
+            devc->bench_pos += skip;
+            samples -= skip;
+            if (devc->limit_samples)
+                samples = min(samples, devc->limit_samples - devc->samples_counter);
+        }
+
+        if (samples)
+            bench_send(sdi, devc, samples);
+        devc->samples_counter += samples;
+        devc->bench_pos += samples;
+        if (!devc->replay_archive)
+            devc->bench_pos %= devc->bench_samples;
+        now = g_get_monotonic_time();
+    }
+
+    if (end || (devc->limit_samples &&
+                devc->samples_counter >= devc->limit_samples)) {
+        if (!end)
+            sr_info("Requested number of samples reached.");
+        hw_dev_acquisition_stop(sdi, NULL);
+    }
+
+    return TRUE;
+}
+
 /* Callback handling data */
 static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
 {
@@ -835,15 +1438,16 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
     struct sr_datafeed_dso dso;
     struct sr_datafeed_analog analog;
     double samples_elaspsed;
-    uint64_t samples_to_send = 0, sending_now;
+    uint64_t samples_to_send = 0, sending_now, skip = 0;
 	int64_t time, elapsed;
-    static uint16_t last_sample = 0;
-    uint16_t cur_sample;
-    uint64_t i;
+    const uint16_t block_words = channel_modes[devc->ch_mode].num;
 
 	(void)fd;
 	(void)revents;
 
+    if (devc->bench_buf)
+        return receive_bench(sdi, devc);
+
     packet.status = SR_PKT_OK;
 	/* How many "virtual" samples should we have collected by now? */
 	time = g_get_monotonic_time();
@@ -893,45 +1497,24 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
         else
             samples_generator(devc->buf, sending_now, sdi, devc);
 
-        if (devc->trigger_stage != 0) {
-            for (i = 0; i < sending_now; i++) {
-                if (devc->trigger_edge == 0) {
-                    if ((*(devc->buf + i) | devc->trigger_mask) ==
-                            (devc->trigger_value | devc->trigger_mask)) {
-                        devc->trigger_stage = 0;
-                        break;
-                    }
-                } else {
-                    cur_sample = *(devc->buf + i);
-                    if (((last_sample & devc->trigger_edge) ==
-                         (~devc->trigger_value & devc->trigger_edge)) &&
-                        ((cur_sample | devc->trigger_mask) ==
-                         (devc->trigger_value | devc->trigger_mask)) &&
-                        ((cur_sample & devc->trigger_edge) ==
-                         (devc->trigger_value & devc->trigger_edge))) {
-                        devc->trigger_stage = 0;
-                        break;
-                    }
-                    last_sample = cur_sample;
-                }
-            }
-            if (devc->trigger_stage == 0) {
-                struct ds_trigger_pos demo_trigger_pos;
-                demo_trigger_pos.real_pos = i;
-                packet.type = SR_DF_TRIGGER;
-                packet.payload = &demo_trigger_pos;
-                sr_session_send(sdi, &packet);
-            }
+        /* Samples before the trigger are only kept for the pre-trigger data */
+        if (sdi->mode == LOGIC && devc->soft_trigger) {
+            devc->samples_counter -= sending_now;
+            skip = trigger_scan(sdi, devc, LA_CROSS_DATA, (uint64_t *)devc->buf,
+                                sending_now, block_words, 1);
+            sending_now = min(sending_now - skip,
+                              devc->limit_samples - devc->samples_counter);
+            devc->samples_counter += sending_now;
         }
 
-        if (devc->trigger_stage == 0){
+        if (sending_now > 0) {
             //samples_to_send -= sending_now;
             if (sdi->mode == LOGIC) {
                 packet.type = SR_DF_LOGIC;
                 packet.payload = &logic;
                 logic.length = sending_now * (channel_modes[devc->ch_mode].num >> 3);
                 logic.format = LA_CROSS_DATA;
-                logic.data = devc->buf;
+                logic.data = (uint64_t *)devc->buf + skip / 64 * block_words;
             } else if (sdi->mode == DSO) {
                 packet.type = SR_DF_DSO;
                 packet.payload = &dso;
@@ -969,7 +1552,7 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
 
             sr_session_send(sdi, &packet);
 
-            devc->mstatus.trig_hit = (devc->trigger_stage == 0);
+            devc->mstatus.trig_hit = !devc->soft_trigger;
             devc->mstatus.captured_cnt0 = devc->samples_counter;
             devc->mstatus.captured_cnt1 = devc->samples_counter >> 8;
             devc->mstatus.captured_cnt2 = devc->samples_counter >> 16;
@@ -1007,21 +1590,25 @@ static int hw_dev_acquisition_start(struct sr_dev_inst *sdi,
     devc->stop = FALSE;
     devc->samples_not_sent = 0;
 
+    devc->bench_buf = NULL;
+    if (sdi->mode == LOGIC && devc->sample_generator == PATTERN_BENCHMARK &&
+        bench_prepare(sdi, devc) != SR_OK) {
+        bench_free(devc);
+        return SR_ERR;
+    }
+
     /*
-     * trigger setting
+     * trigger setting, there is no trigger in hardware: the logic data
+     * runs through the software trigger until it fires
      */
-//    if (!trigger->trigger_en || sdi->mode != LOGIC) {
-//        devc->trigger_stage = 0;
-//    } else {
-//        devc->trigger_mask = ds_trigger_get_mask0(TriggerStages);
-//        devc->trigger_value = ds_trigger_get_value0(TriggerStages);
-//        devc->trigger_edge = ds_trigger_get_edge0(TriggerStages);
-//        if (devc->trigger_edge != 0)
-//            devc->trigger_stage = 2;
-//        else
-//            devc->trigger_stage = 1;
-//    }
-    devc->trigger_stage = 0;
+    devc->soft_trigger = NULL;
+    if (sdi->mode == LOGIC && trigger && trigger->trigger_en &&
+        !(devc->soft_trigger = sr_soft_trigger_new(trigger, sdi->channels,
+                devc->limit_samples * trigger->trigger_pos / 100))) {
+        bench_free(devc);
+        return SR_ERR;
+    }
+    devc->mstatus.trig_hit = !devc->soft_trigger;
 
 	/*
 	 * Setting two channels connected by a pipe is a remnant from when the
@@ -1032,7 +1619,7 @@ static int hw_dev_acquisition_start(struct sr_dev_inst *sdi,
 	 */
 
     sr_session_source_add_channel(devc->channel, G_IO_IN | G_IO_ERR,
-            50, receive_data, sdi);
+            devc->bench_buf ? BENCH_POLL_TIME : 50, receive_data, sdi);
 
 	/* Send header packet to the session bus. */
     //std_session_send_df_header(cb_data, LOG_PREFIX);
@@ -1065,6 +1652,9 @@ static int hw_dev_acquisition_stop(const struct sr_dev_inst *sdi, void *cb_data)
     sr_session_source_remove_channel(devc->channel);
 
     g_free(devc->buf);
+    bench_free(devc);
+    sr_soft_trigger_free(devc->soft_trigger);
+    devc->soft_trigger = NULL;
 
 	/* Send last packet. */
     packet.type = SR_DF_END;
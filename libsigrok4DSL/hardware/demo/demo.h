@@ -34,6 +34,7 @@
 
 #include <sys/stat.h>
 #include <inttypes.h>
+#include <zip.h>
 
 #include <unistd.h>
 #ifdef _WIN32
@@ -79,6 +80,7 @@ enum DEMO_PATTERN {
     PATTERN_TRIANGLE = 2,
     PATTERN_SAWTOOTH = 3,
     PATTERN_RANDOM = 4,
+    PATTERN_BENCHMARK = 5,
 };
 
 static const char *pattern_strings[] = {
@@ -87,6 +89,7 @@ static const char *pattern_strings[] = {
     "Triangle",
     "Sawtooth",
     "Random",
+    "Benchmark",
 };
 
 struct DEMO_caps {
@@ -207,14 +210,34 @@ struct demo_context {
     uint64_t pre_index;
     struct sr_status mstatus;
 
-    int trigger_stage;
-    uint16_t trigger_mask;
-    uint16_t trigger_value;
-    uint16_t trigger_edge;
+    /* Logic trigger, NULL once it fired */
+    struct sr_soft_trigger *soft_trigger;
     uint8_t trigger_slope;
     uint8_t trigger_source;
 
     int language;
+
+    /* Benchmark pattern, see bench_prepare() */
+    uint64_t bench_rate;
+    uint64_t bench_density;
+    int bench_format;
+    char *bench_replay;
+    uint64_t *bench_buf;
+    uint64_t bench_samples;
+    uint16_t bench_channels;
+    uint64_t bench_pos;
+    uint64_t bench_generated;
+    uint64_t bench_packet;
+
+    /* Replay of bench_replay, read one block at a time */
+    uint64_t replay_speed;
+    gboolean replay_loop;
+    struct zip *replay_archive;
+    GArray *replay_probes;
+    uint64_t replay_samples;
+    uint64_t replay_block_samples;
+    uint64_t replay_block;
+    uint64_t *replay_chunk;
 };
 
 static const uint64_t samplerates[] = {
@@ -41,6 +41,15 @@
  *              This can speed up analyzing of long captures.
  *              Default 0 = don't compress.
  *
+ * The value change section is memory mapped and read in windows of
+ * WINDOW_SIZE bytes, each split into chunks at '#' timestamp lines
+ * outside of $comment and similar sections. Chunks are tokenized in
+ * parallel into per-timestamp set/clear masks, which are merged in
+ * order into the changes of the probe values. The file is tokenized
+ * once, only the changes are kept until the sample count for the
+ * SR_DF_META packet is known, and then sent as SR_DF_LOGIC_EDGE
+ * packets, so idle periods cost nothing to transfer.
+ *
  * Based on Verilog standard IEEE Std 1364-2001 Version C
  *
  * Supported features:
@@ -75,6 +84,15 @@
 #define sr_err(s, args...) sr_err(LOG_PREFIX s, ## args)
 
 #define DEFAULT_NUM_PROBES 8
+/* Probe values are tracked as bits of a uint64_t. */
+#define MAX_NUM_PROBES 64
+/* Value change sections smaller than this are tokenized on one thread. */
+#define PARALLEL_MIN_SIZE (4 * 1024 * 1024)
+#define MAX_PARSE_THREADS 16
+#define EDGE_BATCH 8192
+/* Value change bytes tokenized and sent at a time. */
+#define WINDOW_SIZE (MAX_PARSE_THREADS * PARALLEL_MIN_SIZE)
+#define MAX_IDENTIFIER_LEN 63
 
 /* Read until specific type of character occurs in file.
  * Skip input if dest is NULL.
@@ -175,6 +193,42 @@ struct context
 	unsigned compress;
 	int64_t skip;
 	GSList *probes;
+	/* identifier => probe index + 1 */
+	GHashTable *identifiers;
+};
+
+/* Value changes following one timestamp. */
+struct step
+{
+	/* NO_TIMESTAMP for changes before the first timestamp */
+	uint64_t timestamp;
+	uint64_t set;
+	uint64_t clr;
+};
+
+#define NO_TIMESTAMP UINT64_MAX
+
+/* One range of the value change section and its tokenized steps. */
+struct chunk
+{
+	const struct context *ctx;
+	const char *start;
+	const char *end;
+	GArray *steps;
+};
+
+/* Replay of the steps, carried from one window to the next. */
+struct merge
+{
+	int64_t skip;
+	uint64_t prev_timestamp;
+	uint64_t prev_values;
+	uint64_t sample;
+	/* value of the last change collected, if any */
+	gboolean has_edge;
+	uint64_t last_values;
+	GArray *index;
+	GArray *data;
 };
 
 static void free_probe(void *data)
@@ -188,9 +242,21 @@ static void free_probe(void *data)
 static void release_context(struct context *ctx)
 {
 	g_slist_free_full(ctx->probes, free_probe);
+	if (ctx->identifiers)
+		g_hash_table_destroy(ctx->identifiers);
 	g_free(ctx);
 }
 
+/* Forget what the last parse_header() found, the options stay. */
+static void reset_header(struct context *ctx)
+{
+	g_hash_table_remove_all(ctx->identifiers);
+	g_slist_free_full(ctx->probes, free_probe);
+	ctx->probes = NULL;
+	ctx->probecount = 0;
+	ctx->samplerate = 0;
+}
+
 /* Remove empty parts from an array returned by g_strsplit. */
 static void remove_empty_parts(gchar **parts)
 {
@@ -278,6 +344,9 @@ static gboolean parse_header(FILE *file, struct context *ctx)
 				probe->identifier = g_strdup(parts[2]);
 				probe->name = g_strdup(parts[3]);
 				ctx->probes = g_slist_append(ctx->probes, probe);
+				if (!g_hash_table_lookup(ctx->identifiers, probe->identifier))
+					g_hash_table_insert(ctx->identifiers, probe->identifier,
+							GINT_TO_POINTER(ctx->probecount + 1));
 				ctx->probecount++;
 			}
 			
@@ -346,6 +415,11 @@ static int init(struct sr_input *in, const char *filename)
 				release_context(ctx);
 				return SR_ERR;
 			}
+			if (num_probes > MAX_NUM_PROBES)
+			{
+				sr_warn("Only %d probes supported.", MAX_NUM_PROBES);
+				num_probes = MAX_NUM_PROBES;
+			}
 		}
 		
 		param = g_hash_table_lookup(in->param, "downsample");
@@ -370,6 +444,7 @@ static int init(struct sr_input *in, const char *filename)
 	
 	/* Maximum number of probes to parse from the VCD */
 	ctx->maxprobes = num_probes;
+	ctx->identifiers = g_hash_table_new(g_str_hash, g_str_equal);
 
 	/* Create a virtual device. */
 	in->sdi = sr_dev_inst_new(LOGIC, 0, SR_ST_ACTIVE, NULL, NULL, NULL);
@@ -390,180 +465,425 @@ static int init(struct sr_input *in, const char *filename)
 	return SR_OK;
 }
 
-#define CHUNKSIZE 1024
+/* Find the next whitespace delimited token in [*pos, end). */
+static gboolean next_token(const char **pos, const char *end,
+		const char **token, size_t *len)
+{
+	const char *p = *pos;
+
+	while (p < end && isspace((unsigned char)*p))
+		p++;
+	if (p == end)
+		return FALSE;
+
+	*token = p;
+	while (p < end && !isspace((unsigned char)*p))
+		p++;
+	*len = p - *token;
+	*pos = p;
+
+	return TRUE;
+}
+
+static gboolean token_equal(const char *token, size_t len, const char *str)
+{
+	return len == strlen(str) && memcmp(token, str, len) == 0;
+}
 
-/* Send N samples of the given value. */
-static void send_samples(const struct sr_dev_inst *sdi, uint64_t sample, uint64_t count)
+/* Move *pos past the next "$end". */
+static void skip_section(const char **pos, const char *end)
 {
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
-	uint64_t buffer[CHUNKSIZE];
-	uint64_t i;
-	unsigned chunksize = CHUNKSIZE;
-		
-	if (count < chunksize)
-		chunksize = count;
+	const char *p = *pos;
 
-	for (i = 0; i < chunksize; i++)
-	{
-		buffer[i] = sample;
-	}
-	
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;	
-	logic.unitsize = sizeof(uint64_t);
-	logic.data = buffer;
-	
-	while (count)
-	{
-		if (count < chunksize)
-			chunksize = count;
-	
-		logic.length = sizeof(uint64_t) * chunksize;
-	
-		sr_session_send(sdi, &packet);
-		count -= chunksize;
+	while (end - p >= 4) {
+		if (p[0] == '$' && p[1] == 'e' && p[2] == 'n' && p[3] == 'd') {
+			*pos = p + 4;
+			return;
+		}
+		p++;
 	}
+	*pos = end;
 }
 
-/* Parse the data section of VCD */
-static void parse_contents(FILE *file, const struct sr_dev_inst *sdi, struct context *ctx)
+static uint64_t parse_u64(const char *str, size_t len)
 {
-	GString *token = g_string_sized_new(32);
-	
-	uint64_t prev_timestamp = 0;
-	uint64_t prev_values = 0;
-	
-	/* Read one space-delimited token at a time. */
-	while (read_until(file, NULL, 'N') && read_until(file, token, 'W'))
+	uint64_t v = 0;
+
+	while (len-- && isdigit((unsigned char)*str))
+		v = v * 10 + (*str++ - '0');
+
+	return v;
+}
+
+/* Tokenize one chunk of the value change section into steps. */
+static void tokenize_chunk(struct chunk *c)
+{
+	const struct context *ctx = c->ctx;
+	const char *p = c->start;
+	const char *token;
+	char identifier[MAX_IDENTIFIER_LEN + 1];
+	size_t len;
+	struct step step;
+	uint64_t mask;
+	int probe;
+
+	step.timestamp = NO_TIMESTAMP;
+	step.set = 0;
+	step.clr = 0;
+
+	while (next_token(&p, c->end, &token, &len))
 	{
-        if (token->str[0] == '#' && isdigit(token->str[1]))
+		if (token[0] == '#' && len > 1 && isdigit((unsigned char)token[1]))
 		{
 			/* Numeric value beginning with # is a new timestamp value */
-			uint64_t timestamp;
-			timestamp = strtoull(token->str + 1, NULL, 10);
-			
-			if (ctx->downsample > 1)
-				timestamp /= ctx->downsample;
-			
-			/* Skip < 0 => skip until first timestamp.
-			 * Skip = 0 => don't skip
-			 * Skip > 0 => skip until timestamp >= skip.
-			 */
-			if (ctx->skip < 0)
-			{
-				ctx->skip = timestamp;
-				prev_timestamp = timestamp;
-			}
-			else if (ctx->skip > 0 && timestamp < (uint64_t)ctx->skip)
-			{
-				prev_timestamp = ctx->skip;
-			}
-			else if (timestamp == prev_timestamp)
-			{
-				/* Ignore repeated timestamps (e.g. sigrok outputs these) */
-			}
-			else
-			{
-				if (ctx->compress != 0 && timestamp - prev_timestamp > ctx->compress)
-				{
-					/* Compress long idle periods */
-					prev_timestamp = timestamp - ctx->compress;
-				}
-			
-				sr_dbg("New timestamp: %" PRIu64, timestamp);
-			
-				/* Generate samples from prev_timestamp up to timestamp - 1. */
-				send_samples(sdi, prev_values, timestamp - prev_timestamp);
-				prev_timestamp = timestamp;
-			}
+			if (step.timestamp != NO_TIMESTAMP || step.set || step.clr)
+				g_array_append_val(c->steps, step);
+			step.timestamp = parse_u64(token + 1, len - 1);
+			step.set = 0;
+			step.clr = 0;
 		}
-		else if (token->str[0] == '$' && token->len > 1)
+		else if (token[0] == '$' && len > 1)
 		{
 			/* This is probably a $dumpvars, $comment or similar.
 			 * $dump* contain useful data, but other tags will be skipped until $end. */
-			if (g_strcmp0(token->str, "$dumpvars") == 0 ||
-			    g_strcmp0(token->str, "$dumpon") == 0 ||
-			    g_strcmp0(token->str, "$dumpoff") == 0 ||
-			    g_strcmp0(token->str, "$end") == 0)
-			{
-				/* Ignore, parse contents as normally. */
-			}
-			else
-			{
-				/* Skip until $end */
-				read_until(file, NULL, '$');
-			}
+			if (!token_equal(token, len, "$dumpvars") &&
+			    !token_equal(token, len, "$dumpon") &&
+			    !token_equal(token, len, "$dumpoff") &&
+			    !token_equal(token, len, "$end"))
+				skip_section(&p, c->end);
 		}
-		else if (strchr("bBrR", token->str[0]) != NULL)
+		else if (strchr("bBrR", token[0]) != NULL)
 		{
 			/* A vector value. Skip it and also the following identifier. */
-			read_until(file, NULL, 'N');
-			read_until(file, NULL, 'W');
+			next_token(&p, c->end, &token, &len);
 		}
-		else if (strchr("01xXzZ", token->str[0]) != NULL)
+		else if (strchr("01xXzZ", token[0]) != NULL)
 		{
 			/* A new 1-bit sample value */
-			int i, bit;
-			GSList *l;
-			struct probe *probe;
-
-			bit = (token->str[0] == '1');
-		
-			g_string_erase(token, 0, 1);
-			if (token->len == 0)
-			{
-				/* There was a space between value and identifier.
-				 * Read in the rest.
-				 */
-				read_until(file, NULL, 'N');
-				read_until(file, token, 'W');
+			const gboolean bit = (token[0] == '1');
+
+			if (len > 1) {
+				token++;
+				len--;
+			} else if (!next_token(&p, c->end, &token, &len)) {
+				/* There was a space between value and identifier. */
+				break;
 			}
-			
-			for (i = 0, l = ctx->probes; i < ctx->probecount && l; i++, l = l->next)
-			{
-				probe = l->data;
 
-				if (g_strcmp0(token->str, probe->identifier) == 0)
-				{
-					sr_dbg("Probe %d new value %d.", i, bit);
-				
-					/* Found our probe */
-					if (bit)
-						prev_values |= (1 << i);
-					else
-						prev_values &= ~(1 << i);
-					
-					break;
-				}
+			probe = 0;
+			if (len <= MAX_IDENTIFIER_LEN) {
+				memcpy(identifier, token, len);
+				identifier[len] = '\0';
+				probe = GPOINTER_TO_INT(g_hash_table_lookup(ctx->identifiers, identifier));
 			}
-			
-			if (i == ctx->probecount)
-			{
-				sr_dbg("Did not find probe for identifier '%s'.", token->str);
+			if (probe == 0)
+				continue;
+
+			/* Last change within a timestamp wins. */
+			mask = 1ULL << (probe - 1);
+			if (bit) {
+				step.set |= mask;
+				step.clr &= ~mask;
+			} else {
+				step.clr |= mask;
+				step.set &= ~mask;
 			}
 		}
 		else
 		{
-			sr_warn("Skipping unknown token '%s'.", token->str);
+			sr_warn("Skipping unknown token '%.*s'.", (int)len, token);
 		}
-		
-		g_string_truncate(token, 0);
 	}
-	
-	g_string_free(token, TRUE);
+
+	if (step.timestamp != NO_TIMESTAMP || step.set || step.clr)
+		g_array_append_val(c->steps, step);
 }
 
-static int loadfile(struct sr_input *in, const char *filename)
+static gpointer tokenize_thread(gpointer data)
+{
+	tokenize_chunk(data);
+
+	return NULL;
+}
+
+/*
+ * Find the start of the first timestamp line after from. p is a place
+ * before it which isn't within a section, the sections from there on
+ * are skipped like tokenize_chunk() does, so "#<digit>" lines in a
+ * $comment are not taken for timestamps.
+ */
+static const char *next_timestamp(const char *p, const char *from,
+		const char *end)
+{
+	const char *const lo = p;
+	const char *section, *token;
+	size_t len;
+
+	while (p < end) {
+		section = memchr(p, '$', end - p);
+		if (!section)
+			section = end;
+
+		for (p = MAX(p, from); p < section && end - p >= 3; p++)
+			if (p[0] == '\n' && p[1] == '#' && isdigit((unsigned char)p[2]))
+				return p + 1;
+
+		/* '$' may also be part of an identifier */
+		p = section;
+		if (p > lo && p < end && !isspace((unsigned char)p[-1])) {
+			p++;
+			continue;
+		}
+		if (!next_token(&p, end, &token, &len))
+			break;
+		if (len > 1 &&
+		    !token_equal(token, len, "$dumpvars") &&
+		    !token_equal(token, len, "$dumpon") &&
+		    !token_equal(token, len, "$dumpoff") &&
+		    !token_equal(token, len, "$end"))
+			skip_section(&p, end);
+	}
+
+	return end;
+}
+
+/*
+ * Split a window of the value change section at timestamp lines and
+ * tokenize the chunks in parallel. Returns the number of chunks filled in.
+ */
+static unsigned int tokenize_contents(const struct context *ctx,
+		const char *start, const char *end, struct chunk *chunks)
+{
+	GThread *threads[MAX_PARSE_THREADS];
+	const size_t size = end - start;
+	const char *p;
+	unsigned int num, n, i;
+
+	num = MIN(g_get_num_processors(), MAX_PARSE_THREADS);
+	num = MIN(num, size / PARALLEL_MIN_SIZE);
+	num = MAX(num, 1);
+
+	n = 0;
+	p = start;
+	for (i = 1; i <= num && p < end; i++) {
+		chunks[n].ctx = ctx;
+		chunks[n].start = p;
+		chunks[n].end = (i == num) ? end :
+				next_timestamp(p, start + size * i / num - 1, end);
+		chunks[n].steps = g_array_new(FALSE, FALSE, sizeof(struct step));
+		p = chunks[n].end;
+		n++;
+	}
+
+	for (i = 1; i < n; i++)
+		threads[i] = g_thread_new("vcd", tokenize_thread, &chunks[i]);
+	if (n > 0)
+		tokenize_chunk(&chunks[0]);
+	for (i = 1; i < n; i++)
+		g_thread_join(threads[i]);
+
+	return n;
+}
+
+static void merge_init(struct merge *m, const struct context *ctx,
+		GArray *index, GArray *data)
+{
+	memset(m, 0, sizeof(*m));
+	m->skip = ctx->skip;
+	m->index = index;
+	m->data = data;
+}
+
+/*
+ * Replay the steps in file order, applying skip, downsample and compress,
+ * and collect the sample index of every change of the probe values.
+ * m->sample is the number of samples covered so far.
+ */
+static void merge_steps(const struct context *ctx, struct merge *m,
+		const struct chunk *chunks, unsigned int num)
+{
+	const struct step *step;
+	uint64_t timestamp;
+	unsigned int i;
+	guint j;
+
+	for (i = 0; i < num; i++)
+	{
+		for (j = 0; j < chunks[i].steps->len; j++)
+		{
+			step = &g_array_index(chunks[i].steps, struct step, j);
+			if (step->timestamp != NO_TIMESTAMP)
+			{
+				timestamp = step->timestamp;
+				if (ctx->downsample > 1)
+					timestamp /= ctx->downsample;
+
+				/* Skip < 0 => skip until first timestamp.
+				 * Skip = 0 => don't skip
+				 * Skip > 0 => skip until timestamp >= skip.
+				 */
+				if (m->skip < 0)
+				{
+					m->skip = timestamp;
+					m->prev_timestamp = timestamp;
+				}
+				else if (m->skip > 0 && timestamp < (uint64_t)m->skip)
+				{
+					m->prev_timestamp = m->skip;
+				}
+				else if (timestamp == m->prev_timestamp)
+				{
+					/* Ignore repeated timestamps (e.g. sigrok outputs these) */
+				}
+				else
+				{
+					if (ctx->compress != 0 && timestamp - m->prev_timestamp > ctx->compress)
+					{
+						/* Compress long idle periods */
+						m->prev_timestamp = timestamp - ctx->compress;
+					}
+
+					/* Samples from prev_timestamp up to timestamp - 1. */
+					if (!m->has_edge || m->last_values != m->prev_values)
+					{
+						g_array_append_val(m->index, m->sample);
+						g_array_append_val(m->data, m->prev_values);
+						m->has_edge = TRUE;
+						m->last_values = m->prev_values;
+					}
+					m->sample += timestamp - m->prev_timestamp;
+					m->prev_timestamp = timestamp;
+				}
+			}
+
+			m->prev_values = (m->prev_values & ~step->clr) | step->set;
+		}
+	}
+}
+
+/*
+ * Send the changes in batches of SR_DF_LOGIC_EDGE packets, the last one
+ * covering up to sample end. Without changes a single empty packet
+ * moves the end.
+ */
+static void send_edges(const struct sr_dev_inst *sdi, GArray *index,
+		GArray *data, uint64_t end)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic_edge edge;
+	guint i;
+
+	packet.type = SR_DF_LOGIC_EDGE;
+	packet.status = SR_PKT_OK;
+	packet.payload = &edge;
+	edge.unitsize = sizeof(uint64_t);
+
+	i = 0;
+	do
+	{
+		edge.num_edges = MIN(EDGE_BATCH, index->len - i);
+		edge.index = (const uint64_t *)index->data + i;
+		edge.data = (const uint64_t *)data->data + i;
+		edge.end = (i + edge.num_edges < index->len) ?
+				g_array_index(index, uint64_t, i + edge.num_edges) : end;
+		sr_session_send(sdi, &packet);
+		i += edge.num_edges;
+	} while (i < index->len);
+}
+
+/*
+ * Tokenize and merge the value change section one window at a time,
+ * collecting the changes in index and data. Returns the sample count.
+ */
+static uint64_t scan_contents(const struct context *ctx, const char *start,
+		const char *end, GArray *index, GArray *data)
+{
+	struct chunk chunks[MAX_PARSE_THREADS];
+	struct merge m;
+	const char *p, *wend;
+	unsigned int num, i;
+
+	merge_init(&m, ctx, index, data);
+
+	for (p = start; p < end; p = wend)
+	{
+		wend = ((size_t)(end - p) <= WINDOW_SIZE) ? end :
+				next_timestamp(p, p + WINDOW_SIZE - 1, end);
+		num = tokenize_contents(ctx, p, wend, chunks);
+		merge_steps(ctx, &m, chunks, num);
+		for (i = 0; i < num; i++)
+			g_array_free(chunks[i].steps, TRUE);
+	}
+
+	return m.sample;
+}
+
+/* Parse the data section of VCD */
+static int parse_contents(const char *filename, long offset,
+		const struct sr_dev_inst *sdi, struct context *ctx)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_config *src;
+	GMappedFile *mapped;
+	GError *error = NULL;
+	GArray *index, *data;
+	const char *contents, *start, *end;
+	uint64_t samples;
+	gsize length;
+
+	if (!(mapped = g_mapped_file_new(filename, FALSE, &error)))
+	{
+		sr_err("Failed to map file: %s", error->message);
+		g_error_free(error);
+		return SR_ERR;
+	}
+
+	contents = g_mapped_file_get_contents(mapped);
+	length = g_mapped_file_get_length(mapped);
+	start = end = NULL;
+	if (contents && (gsize)offset < length) {
+		start = contents + offset;
+		end = contents + length;
+	}
+
+	index = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	data = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	samples = start ? scan_contents(ctx, start, end, index, data) : 0;
+	g_mapped_file_unref(mapped);
+
+	/* Send metadata about the SR_DF_LOGIC_EDGE packets to come. */
+	packet.type = SR_DF_META;
+	packet.status = SR_PKT_OK;
+	packet.payload = &meta;
+	src = sr_config_new(SR_CONF_SAMPLERATE,
+			g_variant_new_uint64(ctx->samplerate / ctx->downsample));
+	meta.config = g_slist_append(NULL, src);
+	src = sr_config_new(SR_CONF_LIMIT_SAMPLES, g_variant_new_uint64(samples));
+	meta.config = g_slist_append(meta.config, src);
+	sr_session_send(sdi, &packet);
+	g_slist_free_full(meta.config, (GDestroyNotify)sr_config_free);
+
+	if (index->len > 0 || samples > 0)
+		send_edges(sdi, index, data, samples);
+
+	g_array_free(index, TRUE);
+	g_array_free(data, TRUE);
+
+	return SR_OK;
+}
+
+static int loadfile(struct sr_input *in, const char *filename)
+{
+	struct sr_datafeed_packet packet;
 	FILE *file;
 	struct context *ctx;
-	uint64_t samplerate;
+	long offset;
+	int ret;
 
+	/* The context is kept for the next load, each load starts over. */
 	ctx = in->internal;
+	reset_header(ctx);
     packet.status = SR_PKT_OK;
 
     if ((file = fopen(filename, "r")) == NULL)
@@ -576,30 +896,22 @@ static int loadfile(struct sr_input *in, const char *filename)
 		return SR_ERR;
 	}
 
+	/* The value change section is read through a mapping. */
+	offset = ftell(file);
+	fclose(file);
+
 	/* Send header packet to the session bus. */
 	std_session_send_df_header(in->sdi, LOG_PREFIX);
 
-	/* Send metadata about the SR_DF_LOGIC packets to come. */
-	packet.type = SR_DF_META;
-	packet.payload = &meta;
-	samplerate = ctx->samplerate / ctx->downsample;
-	src = sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(samplerate));
-	meta.config = g_slist_append(NULL, src);
-	sr_session_send(in->sdi, &packet);
-	sr_config_free(src);
-
 	/* Parse the contents of the VCD file */
-	parse_contents(file, in->sdi, ctx);
-	
+	ret = parse_contents(filename, offset, in->sdi, ctx);
+
 	/* Send end packet to the session bus. */
 	packet.type = SR_DF_END;
+	packet.status = (ret == SR_OK) ? SR_PKT_OK : SR_PKT_DATA_ERROR;
 	sr_session_send(in->sdi, &packet);
 
-	fclose(file);
-	release_context(ctx);
-	in->internal = NULL;
-
-	return SR_OK;
+	return ret;
 }
 
 SR_PRIV struct sr_input_format input_vcd = {
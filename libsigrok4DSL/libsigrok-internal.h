@@ -118,6 +118,7 @@ SR_PRIV int sr_source_add(int fd, int events, int timeout,
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
 SR_PRIV int sr_session_stop_sync(void);
+SR_PRIV struct sr_session_stats *sr_session_stats(void);
 
 /*--- std.c -----------------------------------------------------------------*/
 
@@ -134,6 +135,12 @@ SR_PRIV int std_session_send_df_header(const struct sr_dev_inst *sdi,
 SR_PRIV int std_dev_clear(const struct sr_dev_driver *driver,
 		std_dev_clear_t clear_private);
 
+/*--- output/output.c ------------------------------------------------------*/
+
+SR_PRIV int sr_output_expand_edges(const struct sr_output *o,
+		const struct sr_datafeed_logic_edge *edge, uint64_t *pos,
+		uint8_t *value, GString **out);
+
 /*--- trigger.c -------------------------------------------------*/
 SR_PRIV uint64_t sr_trigger_get_mask0(uint16_t stage);
 SR_PRIV uint64_t sr_trigger_get_mask1(uint16_t stage);
@@ -187,6 +194,81 @@ SR_PRIV GSList *sr_usb_find(libusb_context *usb_ctx, const char *conn);
 SR_PRIV int sr_usb_open(libusb_context *usb_ctx, struct sr_usb_dev_inst *usb);
 #endif
 
+/*--- hardware/common/ingest.c ----------------------------------------------*/
+
+/* Single producer, single consumer ring of pointers. */
+struct sr_ring {
+	void **items;
+	unsigned int size;
+	volatile gint head;
+	volatile gint tail;
+};
+
+struct sr_ingest;
+
+typedef void (*sr_ingest_callback_t)(void *buf, uint64_t length,
+				     int type, void *cb_data);
+
+SR_PRIV int sr_ring_init(struct sr_ring *ring, unsigned int size);
+SR_PRIV void sr_ring_clear(struct sr_ring *ring);
+SR_PRIV gboolean sr_ring_push(struct sr_ring *ring, void *item);
+SR_PRIV void *sr_ring_pop(struct sr_ring *ring);
+SR_PRIV unsigned int sr_ring_count(struct sr_ring *ring);
+
+SR_PRIV struct sr_ingest *sr_ingest_new(unsigned int num_buffers,
+		size_t buffer_size, sr_ingest_callback_t cb, void *cb_data);
+SR_PRIV void *sr_ingest_swap(struct sr_ingest *ingest, void *buf,
+			     size_t *size, uint64_t length, int type);
+SR_PRIV unsigned int sr_ingest_backlog(struct sr_ingest *ingest);
+SR_PRIV unsigned int sr_ingest_backlog_max(struct sr_ingest *ingest);
+SR_PRIV void sr_ingest_free(struct sr_ingest *ingest);
+
+/*--- hardware/common/transfer.c --------------------------------------------*/
+
+/* Buffer length and count of the USB transfers of a stream. */
+struct sr_transfer_ctl {
+	/* Limits, times are in us of data */
+	unsigned int min_time;
+	unsigned int max_time;
+	unsigned int min_count;
+	unsigned int max_count;
+	uint64_t max_inflight;
+
+	/* Current settings */
+	unsigned int buffer_time;
+	unsigned int count;
+
+	/* Measurements */
+	int64_t window_start;
+	int64_t need_max;
+	unsigned int calm_windows;
+	const char *reason;
+};
+
+SR_PRIV void sr_transfer_ctl_init(struct sr_transfer_ctl *ctl,
+		unsigned int min_time, unsigned int max_time,
+		unsigned int min_count, unsigned int max_count);
+SR_PRIV void sr_transfer_ctl_start(struct sr_transfer_ctl *ctl, int64_t now,
+				   uint64_t max_inflight);
+SR_PRIV gboolean sr_transfer_ctl_sample(struct sr_transfer_ctl *ctl,
+		int64_t now, int64_t stall, int64_t lag);
+
+/*--- hardware/common/softtrigger.c -----------------------------------------*/
+
+struct sr_soft_trigger;
+
+SR_PRIV struct sr_soft_trigger *sr_soft_trigger_new(
+		const struct ds_trigger *trigger, const GSList *channels,
+		uint64_t pre_samples);
+SR_PRIV uint64_t sr_soft_trigger_feed(struct sr_soft_trigger *st,
+		const uint64_t *data, uint64_t num_blocks,
+		uint64_t block_stride, uint64_t channel_stride);
+SR_PRIV gboolean sr_soft_trigger_fired(const struct sr_soft_trigger *st);
+SR_PRIV uint64_t sr_soft_trigger_pos(const struct sr_soft_trigger *st);
+SR_PRIV const uint64_t *sr_soft_trigger_pre_data(struct sr_soft_trigger *st,
+						 uint64_t *num_blocks);
+SR_PRIV void sr_soft_trigger_free(struct sr_soft_trigger *st);
+
 
 
 #endif
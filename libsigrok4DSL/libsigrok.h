@@ -197,6 +197,7 @@ enum {
 	SR_DF_FRAME_BEGIN,
 	SR_DF_FRAME_END,
     SR_DF_OVERFLOW,
+    SR_DF_LOGIC_EDGE,
 };
 
 /** Values for sr_datafeed_analog.mq. */
@@ -372,6 +373,23 @@ struct sr_datafeed_logic {
 	void *data;
 };
 
+/**
+ * Sparse logic data, only the samples where the cross sample changes.
+ * The first packet of a stream starts with an edge at sample 0 which
+ * holds the initial value of every channel.
+ */
+struct sr_datafeed_logic_edge {
+    /** Number of changes in this packet */
+    uint64_t num_edges;
+    /** Sample index following the last sample covered by this packet */
+    uint64_t end;
+    uint16_t unitsize;
+    /** Sample index of each change */
+    const uint64_t *index;
+    /** New cross sample value of each change, unitsize bytes each */
+    const void *data;
+};
+
 struct sr_datafeed_dso {
     /** The probes for which data is included in this packet. */
     GSList *probes;
@@ -1008,6 +1026,21 @@ enum {
     /** language (string code) **/
     SR_CONF_LANGUAGE,
 
+    /** Samples per second of a benchmark pattern, 0 for no pacing. */
+    SR_CONF_BENCHMARK_RATE,
+
+    /** Toggles per million samples of each channel of a benchmark pattern. */
+    SR_CONF_TOGGLE_DENSITY,
+
+    /** Layout of the logic packets, enum LA_DATA_FORMAT. */
+    SR_CONF_LA_DATA_FORMAT,
+
+    /** Speed of a replay against the samplerate of its file, 0 for no pacing. */
+    SR_CONF_REPLAY_SPEED,
+
+    /** Whether a replay starts over at the end of its file. */
+    SR_CONF_REPLAY_LOOP,
+
 	/*--- Acquisition modes ---------------------------------------------*/
 
 	/**
@@ -1199,6 +1232,55 @@ struct sr_dev_driver {
 	void *priv;
 };
 
+/** Number of buckets of a struct sr_histogram. */
+#define SR_HISTOGRAM_BUCKETS 32
+
+/**
+ * A histogram of durations, in us.
+ *
+ * Bucket 0 counts the zero values, bucket i the values from 2^(i-1) to
+ * 2^i - 1. The last bucket also counts all larger values.
+ */
+struct sr_histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint64_t buckets[SR_HISTOGRAM_BUCKETS];
+};
+
+/**
+ * Counters of the acquisition pipeline within libsigrok, from the
+ * start of the last acquisition. See sr_session_stats_get().
+ */
+struct sr_session_stats {
+	/** Start of the acquisition, monotonic time in us. */
+	int64_t start_time;
+
+	/* Filled in by drivers which stream over USB. */
+	/** Completed USB transfers. */
+	uint64_t usb_transfers;
+	/** Bytes received with them. */
+	uint64_t usb_bytes;
+	/** Time between two completions, in us. */
+	struct sr_histogram usb_interval;
+	/** Transfers in flight. */
+	unsigned int transfer_count;
+	/** Data each transfer holds, in us. */
+	unsigned int transfer_time;
+	/** Completed buffers waiting to be sent to the session. */
+	unsigned int ingest_backlog;
+	unsigned int ingest_backlog_max;
+
+	/** Data packets sent to the datafeed callbacks. */
+	uint64_t packets;
+	/** Bytes of the logic packets among them. */
+	uint64_t bytes;
+	/** Time the datafeed callbacks took per data packet, in us. */
+	struct sr_histogram callback_time;
+	/** SR_DF_OVERFLOW packets sent. */
+	uint64_t overflows;
+};
+
 struct sr_session {
 	/** List of struct sr_dev pointers. */
 	GSList *devs;
@@ -1226,8 +1308,13 @@ struct sr_session {
 	 */
     GMutex stop_mutex;
 	gboolean abort_session;
+
+	struct sr_session_stats stats;
 };
 
+/** A session file written while capturing, see sr_session_writer_new(). */
+struct sr_session_writer;
+
 enum {
     SIMPLE_TRIGGER = 0,
     ADV_TRIGGER,
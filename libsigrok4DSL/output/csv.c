@@ -27,6 +27,18 @@
 
 #define LOG_PREFIX "output/csv"
 
+/* Rows below which a packet is formatted on the calling thread. */
+#define PARALLEL_MIN_ROWS (16 * 1024)
+#define MAX_FORMAT_THREADS 8
+/* Longest preformatted DSO/analog value, e.g. "-12345.678". */
+#define VALUE_STR_SIZE 16
+#define TIME_STR_SIZE 32
+
+struct value_str {
+	char str[VALUE_STR_SIZE];
+	uint8_t len;
+};
+
 struct context {
 	unsigned int num_enabled_channels;
 	uint64_t samplerate;
@@ -44,6 +56,28 @@ struct context {
     uint64_t pre_data;
     uint64_t index;
     int type;
+    /* emit logic rows only when a channel changed */
+    gboolean rle;
+    /* time = index * time_step, in units of 10^-time_digits s */
+    int time_digits;
+    uint64_t time_step;
+    uint64_t time_unit;
+    /* DSO/analog: formatted text of each possible 8-bit sample */
+    struct value_str (*value_lut)[256];
+    /* workers formatting the slices of large packets, kept until cleanup */
+    GThreadPool *pool;
+    GMutex pool_mutex;
+    GCond pool_cond;
+    unsigned int pool_pending;
+};
+
+/* One range of rows of a packet, formatted into its own buffer. */
+struct slice {
+	const struct context *ctx;
+	const struct sr_datafeed_packet *packet;
+	uint64_t start;
+	uint64_t end;
+	GString *out;
 };
 
 /*
@@ -52,17 +86,281 @@ struct context {
  *  - Option to (not) print metadata as comments.
  *  - Option to specify the comment character(s), e.g. # or ; or C/C++-style.
  *  - Option to (not) print samplenumber / time as extra column.
- *  - Option to "compress" output (only print changed samples, VCD-like).
  *  - Option to print comma-separated bits, or whole bytes/words (for 8/16
  *    channel LAs) as ASCII/hex etc. etc.
  *  - Trigger support.
  */
 
+/*
+ * Every DSO/analog sample is 8 bits wide, so each channel's values are
+ * formatted once here and rows are built by copying strings.
+ */
+static void gen_value_lut(struct context *ctx)
+{
+	unsigned int j, v;
+	double value;
+	int len;
+
+	ctx->value_lut = g_malloc(sizeof(*ctx->value_lut) * ctx->num_enabled_channels);
+	for (j = 0; j < ctx->num_enabled_channels; j++) {
+		for (v = 0; v < 256; v++) {
+			if (ctx->type == SR_CHANNEL_DSO) {
+				value = (ctx->channel_offset[j] - v) * ctx->channel_scale[j] /
+						((1 << ctx->channel_bits[j]) - 2.0);
+				len = snprintf(ctx->value_lut[j][v].str, VALUE_STR_SIZE,
+						"%0.3f", value);
+			} else {
+				value = ctx->channel_mmin[j] + (255.0 - v) / 255.0 *
+						(ctx->channel_mmax[j] - ctx->channel_mmin[j]);
+				len = snprintf(ctx->value_lut[j][v].str, VALUE_STR_SIZE,
+						"%0.2f", value);
+			}
+			ctx->value_lut[j][v].len = MIN(len, VALUE_STR_SIZE - 1);
+		}
+	}
+}
+
+/*
+ * Pick the shortest decimal resolution that represents the sample period
+ * exactly, so timestamps are computed with integers only.
+ */
+static void set_time_base(struct context *ctx)
+{
+	uint64_t unit;
+	int digits;
+
+	unit = 1;
+	for (digits = 0; digits < 12; digits++) {
+		if (ctx->samplerate != 0 && unit % ctx->samplerate == 0)
+			break;
+		unit *= 10;
+	}
+	ctx->time_digits = digits;
+	ctx->time_unit = unit;
+	ctx->time_step = (ctx->samplerate != 0 && unit % ctx->samplerate == 0) ?
+			unit / ctx->samplerate : 0;
+}
+
+static int u64_to_str(char *buf, uint64_t v)
+{
+	char tmp[20];
+	int n, i;
+
+	n = 0;
+	do {
+		tmp[n++] = '0' + (v % 10);
+		v /= 10;
+	} while (v);
+
+	for (i = 0; i < n; i++)
+		buf[i] = tmp[n - 1 - i];
+
+	return n;
+}
+
+/* Format the time of sample index in seconds, without trailing zeros. */
+static int time_to_str(const struct context *ctx, char *buf, uint64_t index)
+{
+	uint64_t t, sec, frac;
+	int len, i;
+
+	if (ctx->samplerate == 0)
+		return u64_to_str(buf, 0);
+
+	sec = index / ctx->samplerate;
+	if (ctx->time_step != 0) {
+		t = (index % ctx->samplerate) * ctx->time_step;
+	} else {
+		t = (uint64_t)((double)(index % ctx->samplerate) *
+				ctx->time_unit / ctx->samplerate + 0.5);
+		if (t >= ctx->time_unit) {
+			sec++;
+			t -= ctx->time_unit;
+		}
+	}
+
+	len = u64_to_str(buf, sec);
+	if (t == 0)
+		return len;
+
+	buf[len++] = '.';
+	frac = t;
+	for (i = ctx->time_digits - 1; i >= 0; i--) {
+		buf[len + i] = '0' + (frac % 10);
+		frac /= 10;
+	}
+	len += ctx->time_digits;
+	while (buf[len - 1] == '0')
+		len--;
+
+	return len;
+}
+
+static uint64_t logic_value(const uint8_t *sample, uint16_t unitsize)
+{
+	uint64_t value;
+
+	value = 0;
+	memcpy(&value, sample, MIN(unitsize, sizeof(value)));
+
+	return value;
+}
+
+static void format_logic_row(const struct context *ctx, GString *out,
+		const uint8_t *sample, uint64_t index)
+{
+	char line[TIME_STR_SIZE + 2 * 64 + 1];
+	unsigned int j;
+	int len;
+
+	len = time_to_str(ctx, line, index);
+	for (j = 0; j < ctx->num_enabled_channels; j++) {
+		line[len++] = ctx->separator;
+		line[len++] = (sample[j / 8] & (1 << (j % 8))) ? '1' : '0';
+	}
+	line[len++] = '\n';
+	g_string_append_len(out, line, len);
+}
+
+static void format_slice(struct slice *s)
+{
+	const struct context *ctx;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_dso *dso;
+	const struct sr_datafeed_analog *analog;
+	const struct value_str *v;
+	const uint8_t *data, *sample;
+	uint64_t i, j, value, pre_value;
+	char line[64 * VALUE_STR_SIZE];
+	int len, idx;
+
+	ctx = s->ctx;
+	switch (s->packet->type) {
+	case SR_DF_LOGIC:
+		logic = s->packet->payload;
+		data = logic->data;
+		pre_value = (s->start == 0) ? ctx->pre_data :
+				logic_value(data + (s->start - 1) * logic->unitsize,
+					logic->unitsize) & ctx->mask;
+		for (i = s->start; i < s->end; i++) {
+			sample = data + i * logic->unitsize;
+			value = logic_value(sample, logic->unitsize) & ctx->mask;
+			if (ctx->rle && value == pre_value && ctx->index + i > 0)
+				continue;
+			pre_value = value;
+			format_logic_row(ctx, s->out, sample, ctx->index + i);
+		}
+		break;
+	case SR_DF_DSO:
+	case SR_DF_ANALOG:
+		if (s->packet->type == SR_DF_DSO) {
+			dso = s->packet->payload;
+			data = dso->data;
+		} else {
+			analog = s->packet->payload;
+			data = analog->data;
+		}
+		for (i = s->start; i < s->end; i++) {
+			len = 0;
+			for (j = 0; j < ctx->num_enabled_channels; j++) {
+				idx = ctx->channel_index[j];
+				sample = data + i * ctx->num_enabled_channels +
+						idx * ((ctx->num_enabled_channels > 1) ? 1 : 0);
+				v = &ctx->value_lut[j][*sample];
+				memcpy(line + len, v->str, v->len);
+				len += v->len;
+				line[len++] = ctx->separator;
+			}
+			/* Replace last separator. */
+			line[len - 1] = '\n';
+			g_string_append_len(s->out, line, len);
+		}
+		break;
+	}
+}
+
+/* Rows of the samples [start, end) that keep the value of the last change. */
+static void format_held_rows(const struct context *ctx, GString *out,
+		uint64_t start, uint64_t end)
+{
+	uint8_t sample[sizeof(uint64_t)];
+	uint64_t i;
+
+	memcpy(sample, &ctx->pre_data, sizeof(sample));
+	for (i = start; i < end; i++)
+		format_logic_row(ctx, out, sample, i);
+}
+
+static void format_task(gpointer data, gpointer user_data)
+{
+	struct context *ctx = user_data;
+
+	format_slice(data);
+
+	g_mutex_lock(&ctx->pool_mutex);
+	if (--ctx->pool_pending == 0)
+		g_cond_signal(&ctx->pool_cond);
+	g_mutex_unlock(&ctx->pool_mutex);
+}
+
+/*
+ * Format the rows of a packet, split across the worker pool when it is
+ * large enough, and append the slices to out in order.
+ */
+static void format_packet(struct context *ctx,
+		const struct sr_datafeed_packet *packet, uint64_t rows,
+		GString *out)
+{
+	struct slice slices[MAX_FORMAT_THREADS];
+	unsigned int num, i;
+
+	num = MIN(g_get_num_processors(), MAX_FORMAT_THREADS);
+	num = MIN(num, rows / PARALLEL_MIN_ROWS);
+	if (num <= 1) {
+		slices[0].ctx = ctx;
+		slices[0].packet = packet;
+		slices[0].start = 0;
+		slices[0].end = rows;
+		slices[0].out = out;
+		format_slice(&slices[0]);
+		return;
+	}
+
+	if (!ctx->pool)
+		ctx->pool = g_thread_pool_new(format_task, ctx,
+				MAX_FORMAT_THREADS - 1, FALSE, NULL);
+
+	ctx->pool_pending = num - 1;
+	for (i = 0; i < num; i++) {
+		slices[i].ctx = ctx;
+		slices[i].packet = packet;
+		slices[i].start = rows * i / num;
+		slices[i].end = rows * (i + 1) / num;
+		slices[i].out = (i == 0) ? out :
+				g_string_sized_new((slices[i].end - slices[i].start) * 8);
+		if (i != 0)
+			g_thread_pool_push(ctx->pool, &slices[i], NULL);
+	}
+	format_slice(&slices[0]);
+
+	g_mutex_lock(&ctx->pool_mutex);
+	while (ctx->pool_pending != 0)
+		g_cond_wait(&ctx->pool_cond, &ctx->pool_mutex);
+	g_mutex_unlock(&ctx->pool_mutex);
+
+	/* Ordered write-out. */
+	for (i = 1; i < num; i++) {
+		g_string_append_len(out, slices[i].out->str, slices[i].out->len);
+		g_string_free(slices[i].out, TRUE);
+	}
+}
+
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
 	struct sr_channel *ch;
 	GSList *l;
+	GVariant *gvar;
 	int i;
     float range;
 
@@ -75,6 +373,10 @@ static int init(struct sr_output *o, GHashTable *options)
     ctx->mask = 0;
     ctx->index = 0;
     ctx->type = g_variant_get_int16(g_hash_table_lookup(options, "type"));
+    gvar = g_hash_table_lookup(options, "rle");
+    ctx->rle = gvar ? g_variant_get_boolean(gvar) : TRUE;
+    g_mutex_init(&ctx->pool_mutex);
+    g_cond_init(&ctx->pool_cond);
 
 	/* Get the number of channels, and the unitsize. */
 	for (l = o->sdi->channels; l; l = l->next) {
@@ -102,7 +404,7 @@ static int init(struct sr_output *o, GHashTable *options)
 			continue;
         ctx->channel_index[i] = ch->index;
         //ctx->mask |= (1 << ch->index);
-        ctx->mask |= (1 << i);
+        ctx->mask |= (1ULL << i);
         range = ch->vdiv * ch->vfactor * DS_CONF_DSO_VDIVS;
         ctx->channel_unit[i] = (range >= 5000000) ? 1000000 :
                                 (range >= 5000) ? 1000 : 1;
@@ -114,6 +416,9 @@ static int init(struct sr_output *o, GHashTable *options)
         i++;
 	}
 
+	if (ctx->type != SR_CHANNEL_LOGIC)
+		gen_value_lut(ctx);
+
 	return SR_OK;
 }
 
@@ -196,14 +501,14 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_edge *edge;
     const struct sr_datafeed_dso *dso;
     const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
+	const uint8_t *sample;
 	GSList *l;
 	struct context *ctx;
-	int idx;
-	uint64_t i, j;
-    unsigned char *p, c;
+	uint64_t i, rows, value;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -221,9 +526,11 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
             else if (src->key == SR_CONF_LIMIT_SAMPLES)
                 ctx->limit_samples = g_variant_get_uint64(src->data);
 		}
+		set_time_base(ctx);
 		break;
 	case SR_DF_LOGIC:
-		logic = packet->payload;
+	case SR_DF_DSO:
+	case SR_DF_ANALOG:
 		if (!ctx->header_done) {
 			*out = gen_header(o);
 			ctx->header_done = TRUE;
@@ -231,70 +538,52 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			*out = g_string_sized_new(512);
 		}
 
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-            ctx->index++;
-            if (ctx->index > 1 && (*(uint64_t *)(logic->data + i) & ctx->mask) == ctx->pre_data)
-                continue;
-            g_string_append_printf(*out, "%0.10g", (ctx->index-1)*1.0/ctx->samplerate);
-            for (j = 0; j < ctx->num_enabled_channels; j++) {
-                //idx = ctx->channel_index[j];
-                idx = j;
-				p = logic->data + i + idx / 8;
-				c = *p & (1 << (idx % 8));
-                g_string_append_c(*out, ctx->separator);
-                g_string_append_c(*out, c ? '1' : '0');
-			}
-			g_string_append_printf(*out, "\n");
-            ctx->pre_data = (*(uint64_t *)(logic->data + i) & ctx->mask);
+		if (packet->type == SR_DF_LOGIC) {
+			logic = packet->payload;
+			rows = logic->length / logic->unitsize;
+		} else if (packet->type == SR_DF_DSO) {
+			dso = packet->payload;
+			rows = dso->num_samples;
+		} else {
+			analog = packet->payload;
+			rows = analog->num_samples;
+		}
+		if (rows == 0)
+			break;
+
+		format_packet(ctx, packet, rows, *out);
+
+		if (packet->type == SR_DF_LOGIC) {
+			ctx->pre_data = logic_value((const uint8_t *)logic->data +
+					(rows - 1) * logic->unitsize, logic->unitsize) & ctx->mask;
+			ctx->index += rows;
 		}
 		break;
-     case SR_DF_DSO:
-        dso = packet->payload;
-        if (!ctx->header_done) {
-            *out = gen_header(o);
-            ctx->header_done = TRUE;
-        } else {
-            *out = g_string_sized_new(512);
-        }
+	case SR_DF_LOGIC_EDGE:
+		/* Rows straight from the changes, or every sample without rle. */
+		edge = packet->payload;
+		if (!ctx->header_done) {
+			*out = gen_header(o);
+			ctx->header_done = TRUE;
+		} else {
+			*out = g_string_sized_new(512);
+		}
 
-        for (i = 0; i < (uint64_t)dso->num_samples; i++) {
-            for (j = 0; j < ctx->num_enabled_channels; j++) {
-                idx = ctx->channel_index[j];
-                p = dso->data + i * ctx->num_enabled_channels + idx * ((ctx->num_enabled_channels > 1) ? 1 : 0);
-                g_string_append_printf(*out, "%0.3f", (ctx->channel_offset[j] - *p) *
-                                                       ctx->channel_scale[j] /
-                                                      ((1 << ctx->channel_bits[j]) - 2.0));
-                g_string_append_c(*out, ctx->separator);
-            }
-
-            /* Drop last separator. */
-            g_string_truncate(*out, (*out)->len - 1);
-            g_string_append_printf(*out, "\n");
-        }
-        break;
-    case SR_DF_ANALOG:
-       analog = packet->payload;
-       if (!ctx->header_done) {
-           *out = gen_header(o);
-           ctx->header_done = TRUE;
-       } else {
-           *out = g_string_sized_new(512);
-       }
-
-       for (i = 0; i < (uint64_t)analog->num_samples; i++) {
-           for (j = 0; j < ctx->num_enabled_channels; j++) {
-               idx = ctx->channel_index[j];
-               p = analog->data + i * ctx->num_enabled_channels + idx * ((ctx->num_enabled_channels > 1) ? 1 : 0);
-               g_string_append_printf(*out, "%0.2f",
-                                      ctx->channel_mmin[j] + (255.0 - *p) / 255.0 * (ctx->channel_mmax[j] - ctx->channel_mmin[j]));
-               g_string_append_c(*out, ctx->separator);
-           }
-
-           /* Drop last separator. */
-           g_string_truncate(*out, (*out)->len - 1);
-           g_string_append_printf(*out, "\n");
-       }
-       break;
+		for (i = 0; i < edge->num_edges; i++) {
+			sample = (const uint8_t *)edge->data + i * edge->unitsize;
+			value = logic_value(sample, edge->unitsize) & ctx->mask;
+			if (!ctx->rle)
+				format_held_rows(ctx, *out, ctx->index, edge->index[i]);
+			else if (value == ctx->pre_data && edge->index[i] > 0)
+				continue;
+			ctx->pre_data = value;
+			format_logic_row(ctx, *out, sample, edge->index[i]);
+			ctx->index = edge->index[i] + 1;
+		}
+		if (!ctx->rle)
+			format_held_rows(ctx, *out, ctx->index, edge->end);
+		ctx->index = edge->end;
+		break;
 	}
 
 	return SR_OK;
@@ -309,7 +598,18 @@ static int cleanup(struct sr_output *o)
 
 	if (o->priv) {
 		ctx = o->priv;
+		if (ctx->pool)
+			g_thread_pool_free(ctx->pool, FALSE, TRUE);
+		g_mutex_clear(&ctx->pool_mutex);
+		g_cond_clear(&ctx->pool_cond);
 		g_free(ctx->channel_index);
+		g_free(ctx->channel_unit);
+		g_free(ctx->channel_scale);
+		g_free(ctx->channel_offset);
+		g_free(ctx->channel_bits);
+		g_free(ctx->channel_mmax);
+		g_free(ctx->channel_mmin);
+		g_free(ctx->value_lut);
 		g_free(o->priv);
 		o->priv = NULL;
 	}
@@ -317,12 +617,28 @@ static int cleanup(struct sr_output *o)
 	return SR_OK;
 }
 
+static struct sr_option options[] = {
+	{ "type", "Type", "Channel type to export", NULL, NULL },
+	{ "rle", "Changes only", "Write logic rows only where a channel changes", NULL, NULL },
+	{0}
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_int16(SR_CHANNEL_LOGIC));
+		options[1].def = g_variant_ref_sink(g_variant_new_boolean(TRUE));
+	}
+
+	return options;
+}
+
 SR_PRIV struct sr_output_module output_csv = {
 	.id = "csv",
 	.name = "CSV",
 	.desc = "Comma-separated values",
 	.exts = (const char*[]){"csv", NULL},
-	.options = NULL,
+	.options = get_options,
 	.init = init,
 	.receive = receive,
 	.cleanup = cleanup,
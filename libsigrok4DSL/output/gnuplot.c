@@ -36,6 +36,9 @@ struct context {
 	gboolean header_done;
 	uint8_t *prevsample;
 	int *channel_index;
+	/* SR_DF_LOGIC_EDGE replay: next sample and the value held there */
+	uint64_t edge_pos;
+	uint8_t *edge_value;
 };
 
 static const char *gnuplot_header = "\
@@ -141,6 +144,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_edge *edge;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
@@ -162,6 +166,14 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		}
 	}
 
+	if (packet->type == SR_DF_LOGIC_EDGE) {
+		edge = packet->payload;
+		if (!ctx->edge_value)
+			ctx->edge_value = g_malloc0(edge->unitsize);
+		return sr_output_expand_edges(o, edge, &ctx->edge_pos,
+				ctx->edge_value, out);
+	}
+
 	if (packet->type != SR_DF_LOGIC)
 		return SR_OK;
 	logic = packet->payload;
@@ -217,6 +229,7 @@ static int cleanup(struct sr_output *o)
 	ctx = o->priv;
 	g_free(ctx->channel_index);
 	g_free(ctx->prevsample);
+	g_free(ctx->edge_value);
 	g_free(ctx);
 
 	return SR_OK;
@@ -21,6 +21,9 @@
 #include "libsigrok-internal.h"
 #include <string.h>
 
+/* Largest SR_DF_LOGIC packet built by sr_output_expand_edges(). */
+#define EXPAND_BUF_SIZE (1024 * 1024)
+
 /** @cond PRIVATE */
 #define LOG_PREFIX "output"
 /** @endcond */
@@ -340,4 +343,67 @@ SR_API int sr_output_free(const struct sr_output *o)
 	return ret;
 }
 
+/**
+ * Replay the changes of an SR_DF_LOGIC_EDGE packet as SR_DF_LOGIC packets
+ * holding every sample, for output modules that need all of them.
+ *
+ * The caller keeps *pos, the next sample to write, and value, the cross
+ * sample held since the last change (edge->unitsize bytes), across the
+ * packets of a stream.
+ */
+SR_PRIV int sr_output_expand_edges(const struct sr_output *o,
+		const struct sr_datafeed_logic_edge *edge, uint64_t *pos,
+		uint8_t *value, GString **out)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *chunk_out;
+	uint8_t *buf;
+	uint64_t i, k, end, max, n;
+	int ret;
+
+	*out = g_string_sized_new(512);
+	if (edge->unitsize == 0)
+		return SR_ERR_ARG;
+
+	max = MAX(EXPAND_BUF_SIZE / edge->unitsize, 1);
+	buf = g_malloc(max * edge->unitsize);
+
+	memset(&logic, 0, sizeof(logic));
+	logic.format = LA_CROSS_DATA;
+	logic.unitsize = edge->unitsize;
+	logic.data = buf;
+	packet.type = SR_DF_LOGIC;
+	packet.status = SR_PKT_OK;
+	packet.payload = &logic;
+
+	ret = SR_OK;
+	for (i = 0; i <= edge->num_edges && ret == SR_OK; i++) {
+		end = (i < edge->num_edges) ? edge->index[i] : edge->end;
+		if (*pos < end) {
+			/* The run keeps one value, fill the buffer once. */
+			n = MIN(end - *pos, max);
+			for (k = 0; k < n; k++)
+				memcpy(buf + k * edge->unitsize, value, edge->unitsize);
+		}
+		while (*pos < end && ret == SR_OK) {
+			n = MIN(end - *pos, max);
+			logic.length = n * edge->unitsize;
+			chunk_out = NULL;
+			ret = o->module->receive(o, &packet, &chunk_out);
+			if (chunk_out) {
+				g_string_append_len(*out, chunk_out->str, chunk_out->len);
+				g_string_free(chunk_out, TRUE);
+			}
+			*pos += n;
+		}
+		if (i < edge->num_edges)
+			memcpy(value, (const uint8_t *)edge->data + i * edge->unitsize,
+					edge->unitsize);
+	}
+	g_free(buf);
+
+	return ret;
+}
+
 /** @} */
@@ -33,6 +33,9 @@ struct out_context {
 	gboolean zip_created;
 	uint64_t samplerate;
 	char *filename;
+	/* SR_DF_LOGIC_EDGE replay: next sample and the value held there */
+	uint64_t edge_pos;
+	uint8_t *edge_value;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -252,6 +255,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	struct out_context *outc;
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_edge *edge;
 	const struct sr_config *src;
 	GSList *l;
 
@@ -280,6 +284,12 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		logic = packet->payload;
 		ret = zip_append(o, logic->data, logic->unitsize, logic->length);
 		break;
+	case SR_DF_LOGIC_EDGE:
+		edge = packet->payload;
+		if (!outc->edge_value)
+			outc->edge_value = g_malloc0(edge->unitsize);
+		return sr_output_expand_edges(o, edge, &outc->edge_pos,
+				outc->edge_value, out);
 	}
 
 	return SR_OK;
@@ -291,6 +301,7 @@ static int cleanup(struct sr_output *o)
 
 	outc = o->priv;
 	g_free(outc->filename);
+	g_free(outc->edge_value);
 	g_free(outc);
 	o->priv = NULL;
 
@@ -28,6 +28,10 @@
 
 #define LOG_PREFIX "output/vcd"
 
+/* Worst case line: '#', timestamp, 94 x " 0!" and '\n'. */
+#define MAX_LINE_SIZE (1 + 20 + 94 * 3 + 1)
+#define LINE_BUF_SIZE (64 * 1024)
+
 struct context {
 	int num_enabled_channels;
 	GArray *channelindices;
@@ -37,6 +41,10 @@ struct context {
 	int *channel_index;
 	uint64_t samplerate;
 	uint64_t samplecount;
+	/* timestamp = samplecount * ts_mul / ts_div */
+	uint64_t ts_mul;
+	uint64_t ts_div;
+	char *line_buf;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -65,6 +73,8 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx = g_malloc0(sizeof(struct context));
 	o->priv = ctx;
 	ctx->num_enabled_channels = num_enabled_channels;
+	ctx->ts_mul = 0;
+	ctx->ts_div = 1;
 	ctx->channel_index = g_malloc(sizeof(int) * ctx->num_enabled_channels);
 
 	/* Once more to map the enabled channels. */
@@ -80,6 +90,80 @@ static int init(struct sr_output *o, GHashTable *options)
 	return SR_OK;
 }
 
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+	uint64_t t;
+
+	while (b) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/* Write the decimal representation of v, returns the number of chars. */
+static int u64_to_str(char *buf, uint64_t v)
+{
+	char tmp[20];
+	int n, i;
+
+	n = 0;
+	do {
+		tmp[n++] = '0' + (v % 10);
+		v /= 10;
+	} while (v);
+
+	for (i = 0; i < n; i++)
+		buf[i] = tmp[n - 1 - i];
+
+	return n;
+}
+
+static int timestamp_to_str(const struct context *ctx, char *buf,
+		uint64_t samplecount)
+{
+	buf[0] = '#';
+	return 1 + u64_to_str(buf + 1,
+		(samplecount * ctx->ts_mul + ctx->ts_div / 2) / ctx->ts_div);
+}
+
+/*
+ * Write the changes between ctx->prevsample and sample as one VCD line,
+ * every channel when force is set. Returns the number of chars written.
+ */
+static int changes_to_str(struct context *ctx, char *buf,
+		const uint8_t *sample, uint16_t unitsize, gboolean force)
+{
+	int p, curbit, prevbit, len;
+
+	len = 0;
+	for (p = 0; p < ctx->num_enabled_channels; p++) {
+		curbit = ((unsigned)sample[p / 8] >> (p % 8)) & 1;
+		prevbit = ((unsigned)ctx->prevsample[p / 8] >> (p % 8)) & 1;
+
+		/* VCD only contains deltas/changes of signals. */
+		if (prevbit == curbit && !force)
+			continue;
+
+		/* Output timestamp of subsequent signal changes. */
+		if (len == 0)
+			len = timestamp_to_str(ctx, buf, ctx->samplecount);
+
+		/* Output which signal changed to which value. */
+		buf[len++] = ' ';
+		buf[len++] = '0' + curbit;
+		buf[len++] = '!' + p;
+	}
+
+	if (len != 0)
+		buf[len++] = '\n';
+	memcpy(ctx->prevsample, sample, unitsize);
+
+	return len;
+}
+
 static GString *gen_header(const struct sr_output *o)
 {
 	struct context *ctx;
@@ -136,6 +220,14 @@ static GString *gen_header(const struct sr_output *o)
 	g_string_append_printf(header, "$timescale %s $end\n", frequency_s);
 	g_free(frequency_s);
 
+	if (ctx->samplerate != 0) {
+		ctx->ts_mul = ctx->period / gcd(ctx->period, ctx->samplerate);
+		ctx->ts_div = ctx->samplerate / gcd(ctx->period, ctx->samplerate);
+	} else {
+		ctx->ts_mul = 0;
+		ctx->ts_div = 1;
+	}
+
 	/* scope */
 	g_string_append_printf(header, "$scope module %s $end\n", PACKAGE);
 
@@ -160,13 +252,13 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_edge *edge;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	unsigned int i;
-	int p, curbit, prevbit, index;
-	uint8_t *sample;
-	gboolean timestamp_written;
+	uint64_t i;
+	int len;
+	char ts_buf[24];
 
 	*out = NULL;
 	if (!o || !o->priv)
@@ -196,51 +288,58 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		if (!ctx->prevsample) {
 			/* Can't allocate this until we know the stream's unitsize. */
 			ctx->prevsample = g_malloc0(logic->unitsize);
+			ctx->line_buf = g_malloc(LINE_BUF_SIZE);
 		}
 
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			sample = logic->data + i;
-			timestamp_written = FALSE;
-
-			for (p = 0; p < ctx->num_enabled_channels; p++) {
-                //index = ctx->channel_index[p];
-                index = p;
-
-				curbit = ((unsigned)sample[index / 8]
-						>> (index % 8)) & 1;
-				prevbit = ((unsigned)ctx->prevsample[index / 8]
-						>> (index % 8)) & 1;
-
-				/* VCD only contains deltas/changes of signals. */
-				if (prevbit == curbit && ctx->samplecount > 0)
-					continue;
+		len = 0;
+		for (i = 0; i + logic->unitsize <= logic->length; i += logic->unitsize) {
+			len += changes_to_str(ctx, ctx->line_buf + len,
+					(uint8_t *)logic->data + i, logic->unitsize,
+					ctx->samplecount == 0);
+			if (len > LINE_BUF_SIZE - MAX_LINE_SIZE) {
+				g_string_append_len(*out, ctx->line_buf, len);
+				len = 0;
+			}
+			ctx->samplecount++;
+		}
+		g_string_append_len(*out, ctx->line_buf, len);
+		break;
+	case SR_DF_LOGIC_EDGE:
+		edge = packet->payload;
 
-				/* Output timestamp of subsequent signal changes. */
-				if (!timestamp_written)
-					g_string_append_printf(*out, "#%.0f",
-						(double)ctx->samplecount /
-							ctx->samplerate * ctx->period);
+		if (!ctx->header_done) {
+			*out = gen_header(o);
+			ctx->header_done = TRUE;
+		} else {
+			*out = g_string_sized_new(512);
+		}
 
-				/* Output which signal changed to which value. */
-				g_string_append_c(*out, ' ');
-				g_string_append_c(*out, '0' + curbit);
-				g_string_append_c(*out, '!' + p);
+		if (!ctx->prevsample) {
+			ctx->prevsample = g_malloc0(edge->unitsize);
+			ctx->line_buf = g_malloc(LINE_BUF_SIZE);
+		}
 
-				timestamp_written = TRUE;
+		/* Work is proportional to the number of changes only. */
+		len = 0;
+		for (i = 0; i < edge->num_edges; i++) {
+			ctx->samplecount = edge->index[i];
+			len += changes_to_str(ctx, ctx->line_buf + len,
+					(const uint8_t *)edge->data + i * edge->unitsize,
+					edge->unitsize, edge->index[i] == 0);
+			if (len > LINE_BUF_SIZE - MAX_LINE_SIZE) {
+				g_string_append_len(*out, ctx->line_buf, len);
+				len = 0;
 			}
-
-			if (timestamp_written)
-				g_string_append_c(*out, '\n');
-
-			ctx->samplecount++;
-			memcpy(ctx->prevsample, sample, logic->unitsize);
 		}
+		g_string_append_len(*out, ctx->line_buf, len);
+		ctx->samplecount = edge->end;
 		break;
 	case SR_DF_END:
 		/* Write final timestamp as length indicator. */
 		*out = g_string_sized_new(512);
-		g_string_printf(*out, "#%.0f\n",
-				(double)ctx->samplecount / ctx->samplerate * ctx->period);
+		len = timestamp_to_str(ctx, ts_buf, ctx->samplecount);
+		ts_buf[len++] = '\n';
+		g_string_append_len(*out, ts_buf, len);
 		break;
 	}
 
@@ -256,6 +355,7 @@ static int cleanup(struct sr_output *o)
 
 	ctx = o->priv;
 	g_free(ctx->prevsample);
+	g_free(ctx->line_buf);
 	g_free(ctx->channel_index);
 	g_free(ctx);
 
@@ -107,6 +107,14 @@ SR_API int sr_session_stop(void);
 SR_API int sr_session_save_init(const char *filename, const char *metafile, const char *decfile, const char *sesfile);
 SR_API int sr_session_append(const char *filename, const unsigned char *buf,
         uint64_t size, int chunk_num, int index, int type, int version);
+SR_API int sr_session_writer_new(const char *filename, int threads,
+		struct sr_session_writer **writer);
+SR_API int sr_session_writer_append(struct sr_session_writer *writer,
+		const unsigned char *buf, uint64_t size, int chunk_num,
+		int index, int type);
+SR_API int sr_session_writer_finish(struct sr_session_writer *writer,
+		const char *metafile, const char *decfile, const char *sesfile);
+SR_API void sr_session_writer_free(struct sr_session_writer *writer);
 SR_API int sr_session_source_add(int fd, int events, int timeout,
 		sr_receive_data_callback_t cb, const struct sr_dev_inst *sdi);
 SR_API int sr_session_source_add_pollfd(GPollFD *pollfd, int timeout,
@@ -117,6 +125,12 @@ SR_API int sr_session_source_remove(int fd);
 SR_API int sr_session_source_remove_pollfd(GPollFD *pollfd);
 SR_API int sr_session_source_remove_channel(GIOChannel *channel);
 
+/* Statistics */
+SR_API int sr_session_stats_get(struct sr_session_stats *stats);
+SR_API void sr_histogram_add(struct sr_histogram *hist, uint64_t value);
+SR_API uint64_t sr_histogram_percentile(const struct sr_histogram *hist,
+		unsigned int percent);
+
 /*--- input/input.c ---------------------------------------------------------*/
 
 SR_API struct sr_input_format **sr_input_list(void);
@@ -364,6 +364,9 @@ SR_API int sr_session_start(void)
 
 	sr_info("Starting...");
 
+	memset(&session->stats, 0, sizeof(session->stats));
+	session->stats.start_time = g_get_monotonic_time();
+
 	ret = SR_OK;
 	for (l = session->devs; l; l = l->next) {
 		sdi = l->data;
@@ -498,6 +501,7 @@ SR_API int sr_session_stop(void)
 static void datafeed_dump(const struct sr_datafeed_packet *packet)
 {
     const struct sr_datafeed_logic *logic;
+    const struct sr_datafeed_logic_edge *edge;
     const struct sr_datafeed_dso *dso;
     const struct sr_datafeed_analog *analog;
 
@@ -538,12 +542,39 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
     case SR_DF_OVERFLOW:
         sr_dbg("bus: Received SR_DF_OVERFLOW packet.");
         break;
+    case SR_DF_LOGIC_EDGE:
+        edge = packet->payload;
+        sr_dbg("bus: Received SR_DF_LOGIC_EDGE packet (%" PRIu64 " edges).",
+               edge->num_edges);
+        break;
     default:
 		sr_dbg("bus: Received unknown packet type: %d.", packet->type);
 		break;
 	}
 }
 
+static void stats_add_packet(const struct sr_datafeed_packet *packet,
+			     int64_t time)
+{
+	struct sr_session_stats *stats = &session->stats;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		stats->bytes += ((const struct sr_datafeed_logic *)
+				 packet->payload)->length;
+		/* Fall through */
+	case SR_DF_LOGIC_EDGE:
+	case SR_DF_DSO:
+	case SR_DF_ANALOG:
+		stats->packets++;
+		sr_histogram_add(&stats->callback_time, MAX(time, 0));
+		break;
+	case SR_DF_OVERFLOW:
+		stats->overflows++;
+		break;
+	}
+}
+
 /**
  * Send a packet to whatever is listening on the datafeed bus.
  *
@@ -561,6 +592,7 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 {
 	GSList *l;
 	struct datafeed_callback *cb_struct;
+	int64_t start;
 
 	if (!sdi) {
 		sr_err("%s: sdi was NULL", __func__);
@@ -572,16 +604,96 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		return SR_ERR_ARG;
 	}
 
+	start = g_get_monotonic_time();
 	for (l = session->datafeed_callbacks; l; l = l->next) {
 		if (sr_log_loglevel_get() >= SR_LOG_DBG)
 			datafeed_dump(packet);
 		cb_struct = l->data;
 		cb_struct->cb(sdi, packet, cb_struct->cb_data);
 	}
+	stats_add_packet(packet, g_get_monotonic_time() - start);
+
+	return SR_OK;
+}
+
+/**
+ * Returns the counters of the acquisition pipeline.
+ *
+ * Drivers and the datafeed callbacks update them while the acquisition
+ * runs, they are copied without a lock. A counter may be one packet
+ * ahead of another one.
+ *
+ * @param stats The copy of the counters.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG if stats is NULL, SR_ERR_BUG
+ *         if no session exists.
+ */
+SR_API int sr_session_stats_get(struct sr_session_stats *stats)
+{
+	if (!stats)
+		return SR_ERR_ARG;
+
+	if (!session)
+		return SR_ERR_BUG;
+
+	*stats = session->stats;
 
 	return SR_OK;
 }
 
+/**
+ * Returns the counters of the current session for drivers to update,
+ * or NULL if no session exists.
+ */
+SR_PRIV struct sr_session_stats *sr_session_stats(void)
+{
+	return session ? &session->stats : NULL;
+}
+
+/**
+ * Counts a value in a histogram.
+ *
+ * @param hist The histogram.
+ * @param value The value, in us.
+ */
+SR_API void sr_histogram_add(struct sr_histogram *hist, uint64_t value)
+{
+	unsigned int i;
+
+	for (i = 0; i < SR_HISTOGRAM_BUCKETS - 1 && (value >> i); i++);
+
+	hist->buckets[i]++;
+	hist->count++;
+	hist->sum += value;
+	hist->max = MAX(hist->max, value);
+}
+
+/**
+ * Returns a value which the given share of the counted values doesn't
+ * exceed. That is the upper end of a bucket, or the maximum value.
+ *
+ * @param hist The histogram.
+ * @param percent The share, in percent.
+ *
+ * @return The value, 0 for an empty histogram.
+ */
+SR_API uint64_t sr_histogram_percentile(const struct sr_histogram *hist,
+		unsigned int percent)
+{
+	uint64_t n, rank;
+	unsigned int i;
+
+	rank = (hist->count * MIN(percent, 100) + 99) / 100;
+	n = 0;
+	for (i = 0; i < SR_HISTOGRAM_BUCKETS - 1; i++) {
+		n += hist->buckets[i];
+		if (n >= rank && n > 0)
+			return MIN((1ULL << i) - 1, hist->max);
+	}
+
+	return hist->max;
+}
+
 /**
  * Add an event source for a file descriptor.
  *
@@ -23,6 +23,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <zip.h>
+#include <zlib.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <errno.h>
@@ -635,4 +637,480 @@ err:
     return SR_ERR;
 }
 
+/*
+ * Session file writer.
+ *
+ * sr_session_save_init() and sr_session_append() open the archive again
+ * for every chunk, and libzip rewrites it each time it is closed. The
+ * writer keeps the file open instead: chunks are compressed by a pool of
+ * threads and appended as they come out, so a capture can be stored while
+ * it is running. The header and the zip central directory are written by
+ * sr_session_writer_finish(), with the ZIP64 records once the file or the
+ * number of chunks gets too big for the plain ones.
+ */
+
+#define ZIP_LOCAL_HEADER_SIZE 30
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_END_SIZE 22
+#define ZIP64_END_SIZE 56
+#define ZIP64_LOCATOR_SIZE 20
+#define ZIP64_EXTRA_SIZE 12
+#define ZIP_MAX16 0xffff
+#define ZIP_MAX32 0xffffffffULL
+
+/* One chunk in the central directory. */
+struct writer_entry {
+	char name[16];
+	uint16_t method;
+	uint32_t crc;
+	uint64_t size;
+	uint64_t csize;
+	uint64_t offset;
+};
+
+/* A chunk waiting for the pool. */
+struct writer_job {
+	char name[16];
+	unsigned char *buf;
+	uint64_t size;
+};
+
+struct sr_session_writer {
+	FILE *file;
+	char *filename;
+	GThreadPool *pool;
+	/* Protects everything below, and the file. */
+	GMutex mutex;
+	GCond cond;
+	GArray *entries;
+	uint64_t offset;
+	int pending;
+	int max_pending;
+	int error;
+	uint16_t dos_time;
+	uint16_t dos_date;
+};
+
+static void put16(unsigned char *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void put32(unsigned char *p, uint32_t v)
+{
+	put16(p, v);
+	put16(p + 2, v >> 16);
+}
+
+static void put64(unsigned char *p, uint64_t v)
+{
+	put32(p, v);
+	put32(p + 4, v >> 32);
+}
+
+static int writer_deflate(const unsigned char *buf, uint64_t size,
+		unsigned char **out, uint64_t *out_size)
+{
+	z_stream zs;
+	uLong bound;
+	int ret;
+
+	memset(&zs, 0, sizeof(zs));
+	/* Raw deflate, zip has its own header. Speed matters more than
+	 * ratio here, the data keeps coming. */
+	if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8,
+			Z_DEFAULT_STRATEGY) != Z_OK)
+		return SR_ERR;
+
+	bound = deflateBound(&zs, size);
+	if (!(*out = g_try_malloc(bound))) {
+		deflateEnd(&zs);
+		return SR_ERR_MALLOC;
+	}
+
+	zs.next_in = (Bytef *)buf;
+	zs.avail_in = size;
+	zs.next_out = *out;
+	zs.avail_out = bound;
+	ret = deflate(&zs, Z_FINISH);
+	*out_size = zs.total_out;
+	deflateEnd(&zs);
+
+	if (ret != Z_STREAM_END) {
+		g_free(*out);
+		return SR_ERR;
+	}
+	return SR_OK;
+}
+
+/* Writes a local header and the data. Called with the mutex held. */
+static int writer_put(struct sr_session_writer *writer,
+		const struct writer_entry *entry, const unsigned char *data)
+{
+	unsigned char hdr[ZIP_LOCAL_HEADER_SIZE];
+	const size_t name_len = strlen(entry->name);
+
+	put32(hdr, 0x04034b50);
+	put16(hdr + 4, 20);
+	put16(hdr + 6, 0);
+	put16(hdr + 8, entry->method);
+	put16(hdr + 10, writer->dos_time);
+	put16(hdr + 12, writer->dos_date);
+	put32(hdr + 14, entry->crc);
+	put32(hdr + 18, entry->csize);
+	put32(hdr + 22, entry->size);
+	put16(hdr + 26, name_len);
+	put16(hdr + 28, 0);
+
+	if (fwrite(hdr, 1, sizeof(hdr), writer->file) != sizeof(hdr) ||
+	    fwrite(entry->name, 1, name_len, writer->file) != name_len ||
+	    fwrite(data, 1, entry->csize, writer->file) != entry->csize) {
+		sr_err("Unable to write %s: %s.", writer->filename,
+			g_strerror(errno));
+		return SR_ERR;
+	}
+
+	g_array_append_val(writer->entries, *entry);
+	writer->offset += sizeof(hdr) + name_len + entry->csize;
+	return SR_OK;
+}
+
+/* Compresses a chunk and appends it to the file. */
+static int writer_add(struct sr_session_writer *writer, const char *name,
+		const unsigned char *buf, uint64_t size)
+{
+	struct writer_entry entry;
+	unsigned char *cbuf;
+	int ret;
+
+	memset(&entry, 0, sizeof(entry));
+	g_strlcpy(entry.name, name, sizeof(entry.name));
+	entry.size = size;
+	entry.crc = crc32(0L, buf, size);
+	if ((ret = writer_deflate(buf, size, &cbuf, &entry.csize)) != SR_OK)
+		return ret;
+	entry.method = Z_DEFLATED;
+	/* Noise doesn't shrink, it is stored as it is. */
+	if (entry.csize >= size) {
+		entry.method = 0;
+		entry.csize = size;
+	}
+
+	g_mutex_lock(&writer->mutex);
+	if ((ret = writer->error) == SR_OK) {
+		entry.offset = writer->offset;
+		ret = writer_put(writer, &entry, entry.method ? cbuf : buf);
+	}
+	g_mutex_unlock(&writer->mutex);
+
+	g_free(cbuf);
+	return ret;
+}
+
+static void writer_job_run(gpointer data, gpointer user_data)
+{
+	struct writer_job *job = data;
+	struct sr_session_writer *writer = user_data;
+	int ret;
+
+	ret = writer_add(writer, job->name, job->buf, job->size);
+	g_free(job->buf);
+	g_free(job);
+
+	g_mutex_lock(&writer->mutex);
+	if (writer->error == SR_OK)
+		writer->error = ret;
+	writer->pending--;
+	g_cond_broadcast(&writer->cond);
+	g_mutex_unlock(&writer->mutex);
+}
+
+/* The central directory and the end records. */
+static int writer_end(struct sr_session_writer *writer)
+{
+	unsigned char hdr[ZIP_CENTRAL_HEADER_SIZE + ZIP64_EXTRA_SIZE];
+	unsigned char end[ZIP64_END_SIZE + ZIP64_LOCATOR_SIZE + ZIP_END_SIZE];
+	const uint64_t num = writer->entries->len;
+	const uint64_t cd_offset = writer->offset;
+	uint64_t cd_size = 0, i;
+	struct writer_entry *entry;
+	unsigned char *p;
+	size_t name_len;
+	int zip64;
+
+	for (i = 0; i < num; i++) {
+		entry = &g_array_index(writer->entries, struct writer_entry, i);
+		name_len = strlen(entry->name);
+		zip64 = entry->offset >= ZIP_MAX32;
+
+		put32(hdr, 0x02014b50);
+		put16(hdr + 4, 45);
+		put16(hdr + 6, zip64 ? 45 : 20);
+		put16(hdr + 8, 0);
+		put16(hdr + 10, entry->method);
+		put16(hdr + 12, writer->dos_time);
+		put16(hdr + 14, writer->dos_date);
+		put32(hdr + 16, entry->crc);
+		put32(hdr + 20, entry->csize);
+		put32(hdr + 24, entry->size);
+		put16(hdr + 28, name_len);
+		put16(hdr + 30, zip64 ? ZIP64_EXTRA_SIZE : 0);
+		put16(hdr + 32, 0);
+		put16(hdr + 34, 0);
+		put16(hdr + 36, 0);
+		put32(hdr + 38, 0);
+		put32(hdr + 42, zip64 ? ZIP_MAX32 : entry->offset);
+		/* The offset goes to the extra field, after the name. */
+		p = hdr + ZIP_CENTRAL_HEADER_SIZE;
+		put16(p, 0x0001);
+		put16(p + 2, 8);
+		put64(p + 4, entry->offset);
+
+		if (fwrite(hdr, 1, ZIP_CENTRAL_HEADER_SIZE, writer->file) != ZIP_CENTRAL_HEADER_SIZE ||
+		    fwrite(entry->name, 1, name_len, writer->file) != name_len ||
+		    (zip64 && fwrite(p, 1, ZIP64_EXTRA_SIZE, writer->file) != ZIP64_EXTRA_SIZE))
+			return SR_ERR;
+		cd_size += ZIP_CENTRAL_HEADER_SIZE + name_len + (zip64 ? ZIP64_EXTRA_SIZE : 0);
+	}
+
+	p = end;
+	if (num >= ZIP_MAX16 || cd_offset >= ZIP_MAX32 || cd_size >= ZIP_MAX32) {
+		put32(p, 0x06064b50);
+		put64(p + 4, ZIP64_END_SIZE - 12);
+		put16(p + 12, 45);
+		put16(p + 14, 45);
+		put32(p + 16, 0);
+		put32(p + 20, 0);
+		put64(p + 24, num);
+		put64(p + 32, num);
+		put64(p + 40, cd_size);
+		put64(p + 48, cd_offset);
+		p += ZIP64_END_SIZE;
+
+		put32(p, 0x07064b50);
+		put32(p + 4, 0);
+		put64(p + 8, cd_offset + cd_size);
+		put32(p + 16, 1);
+		p += ZIP64_LOCATOR_SIZE;
+	}
+	put32(p, 0x06054b50);
+	put16(p + 4, 0);
+	put16(p + 6, 0);
+	put16(p + 8, MIN(num, ZIP_MAX16));
+	put16(p + 10, MIN(num, ZIP_MAX16));
+	put32(p + 12, MIN(cd_size, ZIP_MAX32));
+	put32(p + 16, MIN(cd_offset, ZIP_MAX32));
+	put16(p + 20, 0);
+	p += ZIP_END_SIZE;
+
+	if (fwrite(end, 1, p - end, writer->file) != (size_t)(p - end))
+		return SR_ERR;
+	return SR_OK;
+}
+
+/**
+ * Create a session file which is written while capturing.
+ *
+ * @param filename The name of the file, an existing one is replaced.
+ *                 Must not be NULL.
+ * @param threads Number of threads compressing the chunks.
+ * @param writer Pointer where the new writer is stored. Must not be NULL.
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid arguments
+ * @retval SR_ERR_MALLOC Memory allocation error
+ * @retval SR_ERR Other errors
+ */
+SR_API int sr_session_writer_new(const char *filename, int threads,
+		struct sr_session_writer **writer)
+{
+	struct sr_session_writer *w;
+	struct tm *tm;
+	time_t now;
+
+	if (!filename || !writer) {
+		sr_err("%s: invalid arguments", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!(w = g_try_malloc0(sizeof(struct sr_session_writer))))
+		return SR_ERR_MALLOC;
+	if (!(w->file = fopen(filename, "wb"))) {
+		sr_err("Unable to create %s: %s.", filename, g_strerror(errno));
+		g_free(w);
+		return SR_ERR;
+	}
+	w->filename = g_strdup(filename);
+	w->entries = g_array_new(FALSE, FALSE, sizeof(struct writer_entry));
+	g_mutex_init(&w->mutex);
+	g_cond_init(&w->cond);
+
+	threads = MAX(threads, 1);
+	/* Two chunks for each thread, one being compressed and one waiting. */
+	w->max_pending = 2 * threads;
+
+	now = time(NULL);
+	tm = localtime(&now);
+	w->dos_time = (tm->tm_hour << 11) | (tm->tm_min << 5) | (tm->tm_sec / 2);
+	w->dos_date = ((tm->tm_year - 80) << 9) | ((tm->tm_mon + 1) << 5) | tm->tm_mday;
+
+	if (!(w->pool = g_thread_pool_new(writer_job_run, w, threads, FALSE, NULL))) {
+		sr_session_writer_free(w);
+		return SR_ERR;
+	}
+
+	*writer = w;
+	return SR_OK;
+}
+
+/**
+ * Append a chunk of data to a session file being written.
+ *
+ * The data is copied, compressed and written in the background. When the
+ * threads fall behind, the call waits for one of them to be done.
+ *
+ * @param writer The writer from sr_session_writer_new().
+ * @param buf The data to be appended.
+ * @param size Buffer size.
+ * @param chunk_num chunk number
+ * @param index channel index
+ * @param type channel type
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid arguments
+ * @retval SR_ERR_MALLOC Memory allocation error
+ * @retval SR_ERR A chunk could not be written
+ */
+SR_API int sr_session_writer_append(struct sr_session_writer *writer,
+		const unsigned char *buf, uint64_t size, int chunk_num,
+		int index, int type)
+{
+	struct writer_job *job;
+	int ret;
+
+	if (!writer || !buf || size == 0 || size >= ZIP_MAX32)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&writer->mutex);
+	while (writer->error == SR_OK && writer->pending >= writer->max_pending)
+		g_cond_wait(&writer->cond, &writer->mutex);
+	if ((ret = writer->error) == SR_OK)
+		writer->pending++;
+	g_mutex_unlock(&writer->mutex);
+	if (ret != SR_OK)
+		return ret;
+
+	job = g_try_malloc(sizeof(struct writer_job));
+	if (job && !(job->buf = g_try_malloc(size))) {
+		g_free(job);
+		job = NULL;
+	}
+	if (!job) {
+		g_mutex_lock(&writer->mutex);
+		writer->pending--;
+		g_mutex_unlock(&writer->mutex);
+		return SR_ERR_MALLOC;
+	}
+
+	memcpy(job->buf, buf, size);
+	job->size = size;
+	snprintf(job->name, sizeof(job->name), "%s-%d/%d",
+		(type == SR_CHANNEL_LOGIC) ? "L" :
+		(type == SR_CHANNEL_DSO) ? "O" :
+		(type == SR_CHANNEL_ANALOG) ? "A" : "U", index, chunk_num);
+	g_thread_pool_push(writer->pool, job, NULL);
+
+	return SR_OK;
+}
+
+/**
+ * Finish a session file being written.
+ *
+ * Waits for the chunks to be written, adds the header, decoders and
+ * session files and closes the archive. The temporary header and
+ * decoders files are removed. On error the session file is removed.
+ *
+ * @param writer The writer from sr_session_writer_new().
+ * @param metafile The header of the session file. Must not be NULL.
+ * @param decfile The decoders, or NULL.
+ * @param sesfile The session settings, or NULL.
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid arguments
+ * @retval SR_ERR Other errors
+ */
+SR_API int sr_session_writer_finish(struct sr_session_writer *writer,
+		const char *metafile, const char *decfile, const char *sesfile)
+{
+	const char *names[] = {"header", "decoders", "session"};
+	const char *files[] = {metafile, decfile, sesfile};
+	gchar *contents;
+	gsize length;
+	int i, ret;
+
+	if (!writer || !writer->file || !metafile)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&writer->mutex);
+	while (writer->pending > 0)
+		g_cond_wait(&writer->cond, &writer->mutex);
+	ret = writer->error;
+	g_mutex_unlock(&writer->mutex);
+
+	for (i = 0; i < 3; i++) {
+		if (!files[i])
+			continue;
+		if (ret == SR_OK) {
+			if (g_file_get_contents(files[i], &contents, &length, NULL)) {
+				ret = writer_add(writer, names[i],
+						(unsigned char *)contents, length);
+				g_free(contents);
+			} else {
+				ret = SR_ERR;
+			}
+		}
+		if (files[i] != sesfile)
+			unlink(files[i]);
+	}
+
+	if (ret == SR_OK)
+		ret = writer_end(writer);
+	if (fclose(writer->file) != 0 && ret == SR_OK)
+		ret = SR_ERR;
+	writer->file = NULL;
+
+	if (ret != SR_OK) {
+		sr_err("Failed to write %s.", writer->filename);
+		unlink(writer->filename);
+	}
+	return ret;
+}
+
+/**
+ * Free a session file writer.
+ *
+ * A file which wasn't finished with sr_session_writer_finish() is
+ * removed.
+ *
+ * @param writer The writer from sr_session_writer_new().
+ */
+SR_API void sr_session_writer_free(struct sr_session_writer *writer)
+{
+	if (!writer)
+		return;
+
+	if (writer->pool)
+		g_thread_pool_free(writer->pool, FALSE, TRUE);
+	if (writer->file) {
+		fclose(writer->file);
+		unlink(writer->filename);
+	}
+	g_array_free(writer->entries, TRUE);
+	g_mutex_clear(&writer->mutex);
+	g_cond_clear(&writer->cond);
+	g_free(writer->filename);
+	g_free(writer);
+}
+
 /** @} */
@@ -0,0 +1,325 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+#include <check.h>
+#include "../libsigrok.h"
+#include "../libsigrok-internal.h"
+
+#define RING_ITEMS 100000
+
+START_TEST(test_ring_basic)
+{
+	struct sr_ring ring;
+	unsigned int i, j;
+
+	fail_unless(sr_ring_init(&ring, 5) == SR_OK);
+	fail_unless(ring.size == 8, "Ring size not rounded up: %u.", ring.size);
+	fail_unless(sr_ring_pop(&ring) == NULL);
+
+	/* Fill and drain it a few times, so the positions wrap. */
+	for (j = 0; j < 3; j++) {
+		for (i = 0; i < 8; i++)
+			fail_unless(sr_ring_push(&ring, GUINT_TO_POINTER(i + 1)));
+		fail_unless(!sr_ring_push(&ring, GUINT_TO_POINTER(9)),
+			    "Pushed onto a full ring.");
+		fail_unless(sr_ring_count(&ring) == 8);
+		for (i = 0; i < 8; i++)
+			fail_unless(sr_ring_pop(&ring) == GUINT_TO_POINTER(i + 1));
+		fail_unless(sr_ring_pop(&ring) == NULL);
+		fail_unless(sr_ring_count(&ring) == 0);
+	}
+
+	sr_ring_clear(&ring);
+}
+END_TEST
+
+static gpointer ring_producer(gpointer data)
+{
+	struct sr_ring *ring = data;
+	unsigned int i;
+
+	for (i = 0; i < RING_ITEMS; i++)
+		while (!sr_ring_push(ring, GUINT_TO_POINTER(i + 1)))
+			g_thread_yield();
+
+	return NULL;
+}
+
+/* Items pushed on one thread are popped on another one in order. */
+START_TEST(test_ring_threads)
+{
+	struct sr_ring ring;
+	GThread *thread;
+	unsigned int i;
+	void *item;
+
+	fail_unless(sr_ring_init(&ring, 16) == SR_OK);
+	thread = g_thread_new("producer", ring_producer, &ring);
+
+	for (i = 0; i < RING_ITEMS; i++) {
+		while (!(item = sr_ring_pop(&ring)))
+			g_thread_yield();
+		fail_unless(item == GUINT_TO_POINTER(i + 1),
+			    "Item %u popped as %u.", i, GPOINTER_TO_UINT(item));
+	}
+
+	g_thread_join(thread);
+	sr_ring_clear(&ring);
+}
+END_TEST
+
+/*
+ * A simulated USB device, which completes one of the submitted buffers
+ * per period. When no buffer is submitted at a completion time, the
+ * device's FIFO overflows and that buffer's data is lost.
+ *
+ * The host side handles completions like receive_transfer() does,
+ * either sending the data from the completion handler before it
+ * resubmits the buffer, or swapping it for a spare buffer of an ingest.
+ */
+struct usb_sim {
+	/* Settings */
+	unsigned int period;		/* us between completions */
+	unsigned int num_completions;
+	unsigned int num_transfers;
+	unsigned int hiccup_interval;	/* Buffers between ingest stalls */
+	unsigned int hiccup_time;	/* us */
+	struct sr_ingest *ingest;	/* NULL to send from the handler */
+
+	/* State */
+	struct sr_ring submitted;
+	struct sr_ring completed;
+	volatile gint done;
+	unsigned int overflows;
+	unsigned int received;
+	unsigned int next_seq;
+	gboolean in_order;
+};
+
+#define SIM_BUFFER_SIZE 64
+
+static gpointer usb_sim_device(gpointer data)
+{
+	struct usb_sim *sim = data;
+	const gint64 start = g_get_monotonic_time();
+	unsigned int i;
+	gint64 now;
+	void *buf;
+
+	for (i = 0; i < sim->num_completions; i++) {
+		now = g_get_monotonic_time();
+		if (now < start + (gint64)i * sim->period)
+			g_usleep(start + (gint64)i * sim->period - now);
+
+		if (!(buf = sr_ring_pop(&sim->submitted))) {
+			sim->overflows++;
+			continue;
+		}
+		memcpy(buf, &i, sizeof(i));
+		while (!sr_ring_push(&sim->completed, buf))
+			g_thread_yield();
+	}
+
+	g_atomic_int_set(&sim->done, 1);
+	return NULL;
+}
+
+/* Takes the role of sr_session_send(), stalls now and then. */
+static void usb_sim_ingest(void *buf, uint64_t length, int type, void *cb_data)
+{
+	struct usb_sim *sim = cb_data;
+	unsigned int seq;
+
+	(void)length;
+	(void)type;
+
+	memcpy(&seq, buf, sizeof(seq));
+	if (seq < sim->next_seq)
+		sim->in_order = FALSE;
+	sim->next_seq = seq + 1;
+
+	if (++sim->received % sim->hiccup_interval == 0)
+		g_usleep(sim->hiccup_time);
+}
+
+static void usb_sim_run(struct usb_sim *sim)
+{
+	GThread *device;
+	unsigned int i;
+	size_t size = SIM_BUFFER_SIZE;
+	void *buf;
+
+	fail_unless(sr_ring_init(&sim->submitted, sim->num_transfers) == SR_OK);
+	fail_unless(sr_ring_init(&sim->completed, sim->num_transfers) == SR_OK);
+	for (i = 0; i < sim->num_transfers; i++)
+		sr_ring_push(&sim->submitted, g_malloc(SIM_BUFFER_SIZE));
+	sim->done = 0;
+	sim->overflows = 0;
+	sim->received = 0;
+	sim->next_seq = 0;
+	sim->in_order = TRUE;
+
+	device = g_thread_new("usb_sim", usb_sim_device, sim);
+
+	/* The USB event thread */
+	while (TRUE) {
+		if (!(buf = sr_ring_pop(&sim->completed))) {
+			if (g_atomic_int_get(&sim->done) &&
+			    sr_ring_count(&sim->completed) == 0)
+				break;
+			g_usleep(50);
+			continue;
+		}
+
+		if (sim->ingest)
+			buf = sr_ingest_swap(sim->ingest, buf, &size,
+					     SIM_BUFFER_SIZE, SR_DF_LOGIC);
+		else
+			usb_sim_ingest(buf, SIM_BUFFER_SIZE, SR_DF_LOGIC, sim);
+		sr_ring_push(&sim->submitted, buf);
+	}
+
+	g_thread_join(device);
+	if (sim->ingest) {
+		sr_ingest_free(sim->ingest);
+		sim->ingest = NULL;
+	}
+
+	while ((buf = sr_ring_pop(&sim->submitted)))
+		g_free(buf);
+	sr_ring_clear(&sim->submitted);
+	sr_ring_clear(&sim->completed);
+}
+
+static void usb_sim_init(struct usb_sim *sim)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->period = 2000;
+	sim->num_completions = 200;
+	sim->num_transfers = 8;
+	sim->hiccup_interval = 50;
+	sim->hiccup_time = 50000;
+}
+
+/* Sending from the completion handler drains the transfers. */
+START_TEST(test_usb_sim_sync)
+{
+	struct usb_sim sim;
+
+	usb_sim_init(&sim);
+	usb_sim_run(&sim);
+
+	fail_unless(sim.overflows > 0, "No overflow without ingest thread.");
+	fail_unless(sim.received + sim.overflows == sim.num_completions);
+	fail_unless(sim.in_order);
+}
+END_TEST
+
+/*
+ * The spare buffers absorb the stalls of the ingest. The host thread
+ * may still miss a completion when the machine is busy, so this only
+ * asks for far fewer overflows than sending from the handler.
+ */
+START_TEST(test_usb_sim_ingest)
+{
+	struct usb_sim sim;
+	unsigned int sync_overflows;
+
+	usb_sim_init(&sim);
+	usb_sim_run(&sim);
+	sync_overflows = sim.overflows;
+
+	usb_sim_init(&sim);
+	sim.ingest = sr_ingest_new(64, SIM_BUFFER_SIZE, usb_sim_ingest, &sim);
+	fail_unless(sim.ingest != NULL);
+	usb_sim_run(&sim);
+
+	fail_unless(sim.overflows * 4 < sync_overflows,
+		    "%u overflows with ingest thread, %u without.",
+		    sim.overflows, sync_overflows);
+	fail_unless(sim.received + sim.overflows == sim.num_completions,
+		    "Received %u of %u buffers.", sim.received,
+		    sim.num_completions - sim.overflows);
+	fail_unless(sim.in_order, "Buffers ingested out of order.");
+}
+END_TEST
+
+/* Buffers still queued are delivered before the ingest is freed. */
+START_TEST(test_ingest_drain)
+{
+	struct usb_sim sim;
+	unsigned int i;
+	size_t size;
+	void *buf;
+
+	usb_sim_init(&sim);
+	sim.hiccup_interval = 1;
+	sim.hiccup_time = 1000;
+	sim.in_order = TRUE;
+	sim.ingest = sr_ingest_new(8, SIM_BUFFER_SIZE, usb_sim_ingest, &sim);
+	fail_unless(sim.ingest != NULL);
+
+	/* The spare of another size comes back after a round through the pool. */
+	buf = g_malloc(2 * SIM_BUFFER_SIZE);
+	size = 2 * SIM_BUFFER_SIZE;
+	for (i = 0; i < 32; i++) {
+		memcpy(buf, &i, sizeof(i));
+		buf = sr_ingest_swap(sim.ingest, buf, &size, SIM_BUFFER_SIZE,
+				     SR_DF_LOGIC);
+		fail_unless(buf != NULL);
+		fail_unless(size == (i == 8 ? 2 : 1) * SIM_BUFFER_SIZE,
+			    "Spare %u has size %zu.", i, size);
+		if (i == 8) {
+			buf = g_realloc(buf, SIM_BUFFER_SIZE);
+			size = SIM_BUFFER_SIZE;
+		}
+	}
+	fail_unless(sr_ingest_backlog_max(sim.ingest) > 1);
+	sr_ingest_free(sim.ingest);
+	g_free(buf);
+
+	fail_unless(sim.received == 32, "Received %u of 32 buffers.",
+		    sim.received);
+	fail_unless(sim.in_order);
+}
+END_TEST
+
+Suite *suite_ingest(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("ingest");
+
+	tc = tcase_create("ring");
+	tcase_add_test(tc, test_ring_basic);
+	tcase_add_test(tc, test_ring_threads);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("usb_sim");
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, test_usb_sim_sync);
+	tcase_add_test(tc, test_usb_sim_ingest);
+	tcase_add_test(tc, test_ingest_drain);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
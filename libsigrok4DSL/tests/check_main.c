@@ -25,6 +25,10 @@
 Suite *suite_core(void);
 Suite *suite_strutil(void);
 Suite *suite_driver_all(void);
+Suite *suite_ingest(void);
+Suite *suite_transfer(void);
+Suite *suite_softtrigger(void);
+Suite *suite_session(void);
 
 int main(void)
 {
@@ -39,6 +43,10 @@ int main(void)
 	srunner_add_suite(srunner, suite_core());
 	srunner_add_suite(srunner, suite_strutil());
 	srunner_add_suite(srunner, suite_driver_all());
+	srunner_add_suite(srunner, suite_ingest());
+	srunner_add_suite(srunner, suite_transfer());
+	srunner_add_suite(srunner, suite_softtrigger());
+	srunner_add_suite(srunner, suite_session());
 
 	srunner_run_all(srunner, CK_VERBOSE);
 	ret = srunner_ntests_failed(srunner);
@@ -0,0 +1,177 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 Uwe Hermann <uwe@hermann-uwe.de>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <zip.h>
+#include <check.h>
+#include "../libsigrok.h"
+
+/* Values land in the bucket of their highest bit. */
+START_TEST(test_histogram_buckets)
+{
+	struct sr_histogram hist;
+
+	memset(&hist, 0, sizeof(hist));
+	sr_histogram_add(&hist, 0);
+	sr_histogram_add(&hist, 1);
+	sr_histogram_add(&hist, 2);
+	sr_histogram_add(&hist, 3);
+	sr_histogram_add(&hist, 1000);
+	sr_histogram_add(&hist, UINT64_MAX);
+
+	fail_unless(hist.buckets[0] == 1);
+	fail_unless(hist.buckets[1] == 1);
+	fail_unless(hist.buckets[2] == 2);
+	fail_unless(hist.buckets[10] == 1, "1000 not in bucket 10.");
+	fail_unless(hist.buckets[SR_HISTOGRAM_BUCKETS - 1] == 1);
+	fail_unless(hist.count == 6);
+	fail_unless(hist.max == UINT64_MAX);
+}
+END_TEST
+
+START_TEST(test_histogram_percentile)
+{
+	struct sr_histogram hist;
+	unsigned int i;
+
+	memset(&hist, 0, sizeof(hist));
+	fail_unless(sr_histogram_percentile(&hist, 50) == 0);
+
+	for (i = 0; i < 99; i++)
+		sr_histogram_add(&hist, 100);
+	sr_histogram_add(&hist, 5000);
+
+	fail_unless(sr_histogram_percentile(&hist, 50) == 127);
+	fail_unless(sr_histogram_percentile(&hist, 99) == 127);
+	fail_unless(sr_histogram_percentile(&hist, 100) == 5000);
+	fail_unless(hist.sum == 99 * 100 + 5000);
+}
+END_TEST
+
+/* The counters start out empty and go away with the session. */
+START_TEST(test_session_stats)
+{
+	struct sr_session_stats stats;
+
+	fail_unless(sr_session_new() != NULL);
+	memset(&stats, 0xff, sizeof(stats));
+	fail_unless(sr_session_stats_get(&stats) == SR_OK);
+	fail_unless(stats.packets == 0 && stats.usb_transfers == 0);
+	fail_unless(sr_session_stats_get(NULL) == SR_ERR_ARG);
+
+	fail_unless(sr_session_destroy() == SR_OK);
+	fail_unless(sr_session_stats_get(&stats) == SR_ERR_BUG);
+}
+END_TEST
+
+/* Chunks written by the pool of threads read back from the archive. */
+START_TEST(test_writer)
+{
+	const char *filename = "check_writer.dsl";
+	const char *metafile = "check_writer.meta";
+	struct sr_session_writer *writer;
+	static unsigned char buf[3][8][4096], out[4096];
+	struct zip *archive;
+	struct zip_file *zf;
+	char name[16];
+	uint32_t seed = 1;
+	int ch, i, k, ret;
+
+	for (ch = 0; ch < 3; ch++) {
+		for (i = 0; i < 8; i++) {
+			for (k = 0; k < 4096; k++) {
+				seed = seed * 1103515245 + 12345;
+				/* Runs, noise which is stored and zeros */
+				buf[ch][i][k] = (ch == 0) ? k / 100 + i :
+						(ch == 1) ? seed >> 16 : 0;
+			}
+		}
+	}
+
+	fail_unless(sr_session_writer_new(filename, 2, &writer) == SR_OK);
+	for (i = 0; i < 8; i++)
+		for (ch = 0; ch < 3; ch++)
+			fail_unless(sr_session_writer_append(writer, buf[ch][i],
+					4096 - i, i, ch, SR_CHANNEL_LOGIC) == SR_OK);
+	fail_unless(sr_session_writer_append(writer, out, 0, 8, 0,
+			SR_CHANNEL_LOGIC) == SR_ERR_ARG);
+	fail_unless(g_file_set_contents(metafile, "[version]\nversion = 2\n", -1, NULL));
+	fail_unless(sr_session_writer_finish(writer, metafile, NULL, NULL) == SR_OK);
+	sr_session_writer_free(writer);
+	fail_unless(!g_file_test(metafile, G_FILE_TEST_EXISTS));
+
+	fail_unless((archive = zip_open(filename, 0, &ret)) != NULL);
+	fail_unless(zip_get_num_entries(archive, 0) == 3 * 8 + 1);
+	for (i = 0; i < 8; i++) {
+		for (ch = 0; ch < 3; ch++) {
+			snprintf(name, sizeof(name), "L-%d/%d", ch, i);
+			fail_unless((zf = zip_fopen(archive, name, 0)) != NULL,
+				    "%s is missing.", name);
+			fail_unless(zip_fread(zf, out, sizeof(out)) == 4096 - i);
+			fail_unless(memcmp(out, buf[ch][i], 4096 - i) == 0,
+				    "%s differs.", name);
+			zip_fclose(zf);
+		}
+	}
+	fail_unless((zf = zip_fopen(archive, "header", 0)) != NULL);
+	fail_unless(zip_fread(zf, out, sizeof(out)) == 22);
+	zip_fclose(zf);
+	zip_close(archive);
+	unlink(filename);
+}
+END_TEST
+
+/* A writer which isn't finished leaves no file behind. */
+START_TEST(test_writer_abort)
+{
+	const char *filename = "check_writer.dsl";
+	struct sr_session_writer *writer;
+	unsigned char buf[64];
+
+	memset(buf, 0x55, sizeof(buf));
+	fail_unless(sr_session_writer_new(filename, 1, &writer) == SR_OK);
+	fail_unless(sr_session_writer_append(writer, buf, sizeof(buf), 0, 0,
+			SR_CHANNEL_LOGIC) == SR_OK);
+	sr_session_writer_free(writer);
+	fail_unless(!g_file_test(filename, G_FILE_TEST_EXISTS));
+}
+END_TEST
+
+Suite *suite_session(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("session");
+
+	tc = tcase_create("stats");
+	tcase_add_test(tc, test_histogram_buckets);
+	tcase_add_test(tc, test_histogram_percentile);
+	tcase_add_test(tc, test_session_stats);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("writer");
+	tcase_add_test(tc, test_writer);
+	tcase_add_test(tc, test_writer_abort);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
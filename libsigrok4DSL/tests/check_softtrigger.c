@@ -0,0 +1,269 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+#include <check.h>
+#include "../libsigrok.h"
+#include "../libsigrok-internal.h"
+
+#define CHANNELS 4
+#define BLOCKS 64
+#define SAMPLES (BLOCKS * 64)
+
+/* Cross data of CHANNELS channels, BLOCKS blocks. */
+struct capture {
+	uint64_t data[BLOCKS * CHANNELS];
+	struct sr_channel probes[CHANNELS];
+	GSList *channels;
+};
+
+static void capture_init(struct capture *cap)
+{
+	int i;
+
+	memset(cap, 0, sizeof(*cap));
+	for (i = 0; i < CHANNELS; i++) {
+		cap->probes[i].index = i;
+		cap->probes[i].type = SR_CHANNEL_LOGIC;
+		cap->probes[i].enabled = TRUE;
+		cap->channels = g_slist_append(cap->channels, &cap->probes[i]);
+	}
+}
+
+static int level(const struct capture *cap, int ch, uint64_t i)
+{
+	return (cap->data[(i / 64) * CHANNELS + ch] >> (i % 64)) & 1;
+}
+
+static void set_level(struct capture *cap, int ch, uint64_t from, uint64_t to)
+{
+	for (; from < to; from++)
+		cap->data[(from / 64) * CHANNELS + ch] |= 1ULL << (from % 64);
+}
+
+static void trigger_init(struct ds_trigger *t, int mode)
+{
+	int i, j;
+
+	memset(t, 0, sizeof(*t));
+	t->trigger_en = 1;
+	t->trigger_mode = mode;
+	for (i = 0; i <= TriggerStages; i++) {
+		for (j = 0; j < TriggerProbes; j++) {
+			t->trigger0[i][j] = 'X';
+			t->trigger1[i][j] = 'X';
+		}
+		t->trigger_logic[i] = 1;
+	}
+}
+
+/* The trigger checked sample by sample, returns the sample or -1. */
+static int64_t model_trigger(const struct capture *cap,
+			     const struct ds_trigger *t)
+{
+	const int simple = (t->trigger_mode == SIMPLE_TRIGGER);
+	const int num_stages = simple ? 1 : t->trigger_stages + 1;
+	int stage = 0, k, ch, row, cur, prev, m[2];
+	uint32_t count, matched = 0;
+	const char *probes;
+	uint64_t i;
+
+	for (i = 0; i < SAMPLES; i++) {
+		row = simple ? TriggerStages : stage;
+		for (k = 0; k < 2; k++) {
+			probes = k ? t->trigger1[row] : t->trigger0[row];
+			m[k] = 1;
+			for (ch = 0; ch < CHANNELS; ch++) {
+				cur = level(cap, ch, i);
+				prev = i ? level(cap, ch, i - 1) : -1;
+				switch (probes[ch]) {
+				case '1': m[k] &= cur; break;
+				case '0': m[k] &= !cur; break;
+				case 'R': m[k] &= (prev == 0 && cur); break;
+				case 'F': m[k] &= (prev == 1 && !cur); break;
+				case 'C': m[k] &= (prev >= 0 && prev != cur); break;
+				}
+			}
+			if (k ? t->trigger1_inv[row] : t->trigger0_inv[row])
+				m[k] = !m[k];
+		}
+
+		count = MAX(t->trigger0_count[row], 1);
+		if ((t->trigger_logic[row] & 1) ? (m[0] && m[1]) : (m[0] || m[1]))
+			matched++;
+		else if (t->trigger_logic[row] & 2)
+			matched = 0;
+
+		if (matched == count) {
+			matched = 0;
+			if (++stage == num_stages)
+				return i;
+		}
+	}
+	return -1;
+}
+
+static uint32_t rand_next(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+/* A simple rising edge, right at a block boundary. */
+START_TEST(test_edge)
+{
+	struct capture cap;
+	struct ds_trigger t;
+	struct sr_soft_trigger *st;
+
+	capture_init(&cap);
+	set_level(&cap, 1, 0, 10);
+	set_level(&cap, 1, 128, 200);
+	trigger_init(&t, SIMPLE_TRIGGER);
+	t.trigger0[TriggerStages][1] = 'R';
+
+	st = sr_soft_trigger_new(&t, cap.channels, 0);
+	fail_unless(st != NULL);
+	/* Not at the first sample, high isn't an edge there */
+	fail_unless(sr_soft_trigger_feed(st, cap.data, 2, CHANNELS, 1) == 2);
+	fail_unless(!sr_soft_trigger_fired(st));
+	fail_unless(sr_soft_trigger_feed(st, cap.data + 2 * CHANNELS, BLOCKS - 2,
+					 CHANNELS, 1) == 0);
+	fail_unless(sr_soft_trigger_fired(st));
+	fail_unless(sr_soft_trigger_pos(st) == 0);
+	sr_soft_trigger_free(st);
+}
+END_TEST
+
+/* The blocks before the trigger come back in order, and the position
+ * counts from the first one. */
+START_TEST(test_pre_trigger)
+{
+	struct capture cap;
+	struct ds_trigger t;
+	struct sr_soft_trigger *st;
+	const uint64_t *pre;
+	uint64_t num_blocks, b, n, fed;
+
+	capture_init(&cap);
+	for (b = 0; b < BLOCKS * CHANNELS; b++)
+		if (b % CHANNELS != 3)
+			cap.data[b] = b << 8;
+	set_level(&cap, 3, 40 * 64 + 5, 40 * 64 + 6);
+	trigger_init(&t, SIMPLE_TRIGGER);
+	t.trigger0[TriggerStages][3] = '1';
+
+	st = sr_soft_trigger_new(&t, cap.channels, 10 * 64 + 63);
+	fail_unless(st != NULL);
+	for (b = 0; b < BLOCKS; b += n) {
+		n = MIN(3, BLOCKS - b);
+		fed = sr_soft_trigger_feed(st, cap.data + b * CHANNELS, n,
+					   CHANNELS, 1);
+		if (sr_soft_trigger_fired(st)) {
+			b += fed;
+			break;
+		}
+	}
+	fail_unless(sr_soft_trigger_fired(st));
+	fail_unless(b == 40, "Fired at block %llu.", (unsigned long long)b);
+	fail_unless(sr_soft_trigger_pos(st) == 10 * 64 + 5);
+
+	pre = sr_soft_trigger_pre_data(st, &num_blocks);
+	fail_unless(num_blocks == 10);
+	fail_unless(memcmp(pre, cap.data + 30 * CHANNELS,
+			   10 * CHANNELS * sizeof(uint64_t)) == 0);
+	sr_soft_trigger_free(st);
+}
+END_TEST
+
+/* Random stages against the model, with cross and split data. */
+START_TEST(test_random_stages)
+{
+	static const char conds[] = "XXXX01RFC";
+	struct capture cap;
+	struct ds_trigger t;
+	struct sr_soft_trigger *st;
+	uint64_t split[BLOCKS * CHANNELS];
+	uint32_t seed = 1;
+	int64_t expect, got;
+	uint64_t i, b;
+	int run, stage, ch, fired = 0;
+
+	capture_init(&cap);
+	for (ch = 0; ch < CHANNELS; ch++)
+		for (i = 0; i < SAMPLES; i += 1 + rand_next(&seed) % (8 << ch))
+			if (rand_next(&seed) & 1)
+				set_level(&cap, ch, i, MIN(i + 1 + rand_next(&seed) % (8 << ch), SAMPLES));
+	for (b = 0; b < BLOCKS; b++)
+		for (ch = 0; ch < CHANNELS; ch++)
+			split[ch * BLOCKS + b] = cap.data[b * CHANNELS + ch];
+
+	for (run = 0; run < 500; run++) {
+		trigger_init(&t, (run % 5) ? ADV_TRIGGER : SIMPLE_TRIGGER);
+		t.trigger_stages = rand_next(&seed) % 3;
+		for (stage = 0; stage <= TriggerStages; stage++) {
+			for (ch = 0; ch < CHANNELS; ch++) {
+				t.trigger0[stage][ch] = conds[rand_next(&seed) % 9];
+				t.trigger1[stage][ch] = conds[rand_next(&seed) % 9];
+			}
+			t.trigger_logic[stage] = rand_next(&seed) % 4;
+			t.trigger0_inv[stage] = rand_next(&seed) % 4 == 0;
+			t.trigger1_inv[stage] = rand_next(&seed) % 4 == 0;
+			t.trigger0_count[stage] = rand_next(&seed) % 100;
+		}
+		expect = model_trigger(&cap, &t);
+
+		st = sr_soft_trigger_new(&t, cap.channels, 0);
+		b = sr_soft_trigger_feed(st, cap.data, BLOCKS, CHANNELS, 1);
+		got = sr_soft_trigger_fired(st) ? (int64_t)(b * 64 + sr_soft_trigger_pos(st)) : -1;
+		fail_unless(got == expect, "Run %d: cross data fired at %lld, not %lld.",
+			    run, (long long)got, (long long)expect);
+		sr_soft_trigger_free(st);
+
+		st = sr_soft_trigger_new(&t, cap.channels, 0);
+		b = sr_soft_trigger_feed(st, split, BLOCKS, 1, BLOCKS);
+		got = sr_soft_trigger_fired(st) ? (int64_t)(b * 64 + sr_soft_trigger_pos(st)) : -1;
+		fail_unless(got == expect, "Run %d: split data fired at %lld, not %lld.",
+			    run, (long long)got, (long long)expect);
+		sr_soft_trigger_free(st);
+
+		fired += (expect >= 0);
+	}
+
+	/* Both outcomes should be covered. */
+	fail_unless(fired > 50 && fired < 450, "%d runs fired.", fired);
+}
+END_TEST
+
+Suite *suite_softtrigger(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("softtrigger");
+
+	tc = tcase_create("soft_trigger");
+	tcase_add_test(tc, test_edge);
+	tcase_add_test(tc, test_pre_trigger);
+	tcase_add_test(tc, test_random_stages);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
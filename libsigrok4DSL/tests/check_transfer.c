@@ -0,0 +1,222 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+#include <check.h>
+#include "../libsigrok.h"
+#include "../libsigrok-internal.h"
+
+#define MIN_TIME 10000
+#define MAX_TIME 80000
+#define MIN_COUNT 4
+#define MAX_COUNT 64
+
+/*
+ * A simulated completion timing source, in virtual time (us).
+ *
+ * The device completes a transfer each buffer_time. Every stall_interval
+ * the host handles a completion stall_time late, the transfers still in
+ * flight keep the stream going meanwhile. When the stall is as long as
+ * the time in flight, the device overflows.
+ */
+struct timing_sim {
+	int64_t now;
+	unsigned int stall_interval;	/* 0 for a host which keeps up */
+	unsigned int stall_time;
+	unsigned int lag;		/* Data waiting for the consumer */
+	int64_t next_stall;
+	unsigned int overflows;
+	unsigned int changes;
+};
+
+static void timing_sim_run(struct sr_transfer_ctl *ctl, struct timing_sim *sim,
+			   int64_t duration)
+{
+	const int64_t end = sim->now + duration;
+	int64_t stall;
+
+	while (sim->now < end) {
+		sim->now += ctl->buffer_time;
+
+		stall = 0;
+		if (sim->stall_interval && sim->now >= sim->next_stall) {
+			stall = sim->stall_time;
+			if (stall >= (int64_t)ctl->buffer_time * ctl->count)
+				sim->overflows++;
+			sim->now += stall;
+			sim->next_stall = sim->now + sim->stall_interval;
+		}
+
+		if (sr_transfer_ctl_sample(ctl, sim->now, stall, sim->lag))
+			sim->changes++;
+
+		fail_unless(ctl->buffer_time >= ctl->min_time &&
+			    ctl->buffer_time <= ctl->max_time,
+			    "Buffer time %u out of limits.", ctl->buffer_time);
+		fail_unless(ctl->count >= ctl->min_count &&
+			    ctl->count <= ctl->max_count,
+			    "Count %u out of limits.", ctl->count);
+		fail_unless((uint64_t)ctl->buffer_time * ctl->count <=
+			    ctl->max_inflight, "Too much data in flight.");
+	}
+}
+
+static void setup_ctl(struct sr_transfer_ctl *ctl, struct timing_sim *sim)
+{
+	sr_transfer_ctl_init(ctl, MIN_TIME, MAX_TIME, MIN_COUNT, MAX_COUNT);
+	sr_transfer_ctl_start(ctl, 0, 0);
+	memset(sim, 0, sizeof(*sim));
+}
+
+/* A host which keeps up gets the smallest settings. */
+START_TEST(test_light_load)
+{
+	struct sr_transfer_ctl ctl;
+	struct timing_sim sim;
+
+	setup_ctl(&ctl, &sim);
+	timing_sim_run(&ctl, &sim, 60000000);
+
+	fail_unless(sim.changes == 0, "%u changes.", sim.changes);
+	fail_unless(ctl.buffer_time == MIN_TIME);
+	fail_unless(ctl.count == MIN_COUNT);
+}
+END_TEST
+
+/* Only the first stall overflows, the next ones are covered. */
+START_TEST(test_busy_host)
+{
+	struct sr_transfer_ctl ctl;
+	struct timing_sim sim;
+
+	setup_ctl(&ctl, &sim);
+	sim.stall_interval = 1000000;
+	sim.stall_time = 150000;
+	timing_sim_run(&ctl, &sim, 30000000);
+
+	fail_unless(sim.overflows == 1, "%u overflows.", sim.overflows);
+	fail_unless((uint64_t)ctl.buffer_time * ctl.count > 150000);
+	/* More transfers come before longer buffers. */
+	fail_unless(ctl.buffer_time == MIN_TIME);
+}
+END_TEST
+
+/* Once the host keeps up again, the settings go back to the smallest. */
+START_TEST(test_recovery)
+{
+	struct sr_transfer_ctl ctl;
+	struct timing_sim sim;
+	unsigned int count;
+
+	setup_ctl(&ctl, &sim);
+	sim.stall_interval = 1000000;
+	sim.stall_time = 150000;
+	timing_sim_run(&ctl, &sim, 10000000);
+	count = ctl.count;
+	fail_unless(count > MIN_COUNT);
+
+	/* Not right away */
+	sim.stall_interval = 0;
+	timing_sim_run(&ctl, &sim, 2000000);
+	fail_unless(ctl.count == count);
+
+	timing_sim_run(&ctl, &sim, 120000000);
+	fail_unless(ctl.buffer_time == MIN_TIME);
+	fail_unless(ctl.count == MIN_COUNT, "Count is %u.", ctl.count);
+}
+END_TEST
+
+/* Longer buffers once the count is at its limit. */
+START_TEST(test_long_stalls)
+{
+	struct sr_transfer_ctl ctl;
+	struct timing_sim sim;
+	unsigned int overflows;
+
+	setup_ctl(&ctl, &sim);
+	sim.stall_interval = 4000000;
+	sim.stall_time = 2000000;
+	timing_sim_run(&ctl, &sim, 40000000);
+
+	fail_unless(ctl.count == MAX_COUNT);
+	fail_unless(ctl.buffer_time > MIN_TIME);
+	overflows = sim.overflows;
+	fail_unless(overflows < 5, "%u overflows.", overflows);
+
+	timing_sim_run(&ctl, &sim, 40000000);
+	fail_unless(sim.overflows == overflows);
+
+	/* A later stream at a higher rate gets less time in flight. */
+	sr_transfer_ctl_start(&ctl, sim.now, 200000);
+	fail_unless(ctl.buffer_time * MIN_COUNT <= 200000);
+	fail_unless((uint64_t)ctl.buffer_time * ctl.count <= 200000);
+}
+END_TEST
+
+/* The limit of the time in flight holds when stalls are longer. */
+START_TEST(test_inflight_limit)
+{
+	struct sr_transfer_ctl ctl;
+	struct timing_sim sim;
+
+	setup_ctl(&ctl, &sim);
+	sr_transfer_ctl_start(&ctl, 0, 1000000);
+	sim.stall_interval = 4000000;
+	sim.stall_time = 2000000;
+	timing_sim_run(&ctl, &sim, 40000000);
+
+	fail_unless((uint64_t)ctl.buffer_time * ctl.count <= 1000000);
+	fail_unless((uint64_t)ctl.buffer_time * ctl.count > 500000);
+}
+END_TEST
+
+/* A consumer which falls behind counts like a stall. */
+START_TEST(test_consumer_lag)
+{
+	struct sr_transfer_ctl ctl;
+	struct timing_sim sim;
+
+	setup_ctl(&ctl, &sim);
+	sim.lag = 100000;
+	timing_sim_run(&ctl, &sim, 1000000);
+
+	fail_unless(sim.changes > 0);
+	fail_unless((uint64_t)ctl.buffer_time * ctl.count >= 2 * 100000);
+}
+END_TEST
+
+Suite *suite_transfer(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("transfer");
+
+	tc = tcase_create("transfer_ctl");
+	tcase_add_test(tc, test_light_load);
+	tcase_add_test(tc, test_busy_host);
+	tcase_add_test(tc, test_recovery);
+	tcase_add_test(tc, test_long_stalls);
+	tcase_add_test(tc, test_inflight_limit);
+	tcase_add_test(tc, test_consumer_lag);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -23,6 +23,7 @@
 #include "libsigrokdecode-internal.h" /* First, so we avoid a _POSIX_C_SOURCE warning. */
 #include "libsigrokdecode.h"
 #include <glib.h>
+#include <glib/gstdio.h>
 
 /**
  * @file
@@ -43,6 +44,15 @@
 /* The list of loaded protocol decoders. */
 static GSList *pd_list = NULL;
 
+/*
+ * Decoder metadata cache, one group per decoder directory. Bump the
+ * version whenever the layout of a group changes.
+ */
+#define DECODER_CACHE_VERSION 1
+#define DECODER_CACHE_GROUP "libsigrokdecode"
+static GKeyFile *pd_cache = NULL;
+static gboolean pd_cache_dirty = FALSE;
+
 /* srd.c */
 extern SRD_PRIV GSList *searchpaths;
 
@@ -178,6 +188,7 @@ static void decoder_free(struct srd_decoder *dec)
 	g_free(dec->longname);
 	g_free(dec->name);
 	g_free(dec->id);
+	g_free(dec->module);
 
 	g_free(dec);
 }
@@ -684,64 +695,41 @@ SRD_PRIV long srd_decoder_apiver(const struct srd_decoder *d)
 	return apiver;
 }
 
-/**
- * Load a protocol decoder module into the embedded Python interpreter.
- *
- * @param module_name The module name to be loaded.
- *
- * @return SRD_OK upon success, a (negative) error code otherwise.
- *
- * @since 0.1.0
+/*
+ * Import the decoder module and check its Decoder class. Returns
+ * SRD_ERR_PYTHON with a Python exception pending, SRD_ERR after
+ * logging, or SRD_OK. Must be called with the GIL held.
  */
-SRD_API int srd_decoder_load(const char *module_name)
+static int import_module(struct srd_decoder *d, const char *module_name,
+		const char **fail_txt)
 {
 	PyObject *py_basedec;
-	struct srd_decoder *d;
 	long apiver;
 	int is_subclass;
-	const char *fail_txt;
-	PyGILState_STATE gstate;
-
-	if (!srd_check_init())
-		return SRD_ERR;
-
-	if (!module_name)
-		return SRD_ERR_ARG;
-
-	gstate = PyGILState_Ensure();
-
-	if (PyDict_GetItemString(PyImport_GetModuleDict(), module_name)) {
-		/* Module was already imported. */
-		PyGILState_Release(gstate);
-		return SRD_OK;
-	}
-
-	d = g_malloc0(sizeof(struct srd_decoder));
-	fail_txt = NULL;
 
 	d->py_mod = py_import_by_name(module_name);
 	if (!d->py_mod) {
-		fail_txt = "import by name failed";
-		goto except_out;
+		*fail_txt = "import by name failed";
+		return SRD_ERR_PYTHON;
 	}
 
 	if (!mod_sigrokdecode) {
 		srd_err("sigrokdecode module not loaded.");
-		fail_txt = "sigrokdecode(3) not loaded";
-		goto err_out;
+		*fail_txt = "sigrokdecode(3) not loaded";
+		return SRD_ERR;
 	}
 
 	/* Get the 'Decoder' class as Python object. */
 	d->py_dec = PyObject_GetAttrString(d->py_mod, "Decoder");
 	if (!d->py_dec) {
-		fail_txt = "no 'Decoder' attribute in imported module";
-		goto except_out;
+		*fail_txt = "no 'Decoder' attribute in imported module";
+		return SRD_ERR_PYTHON;
 	}
 
 	py_basedec = PyObject_GetAttrString(mod_sigrokdecode, "Decoder");
 	if (!py_basedec) {
-		fail_txt = "no 'Decoder' attribute in sigrokdecode(3)";
-		goto except_out;
+		*fail_txt = "no 'Decoder' attribute in sigrokdecode(3)";
+		return SRD_ERR_PYTHON;
 	}
 
 	is_subclass = PyObject_IsSubclass(d->py_dec, py_basedec);
@@ -750,8 +738,8 @@ SRD_API int srd_decoder_load(const char *module_name)
 	if (!is_subclass) {
 		srd_err("Decoder class in protocol decoder module %s is not "
 			"a subclass of sigrokdecode.Decoder.", module_name);
-		fail_txt = "not a subclass of sigrokdecode.Decoder";
-		goto err_out;
+		*fail_txt = "not a subclass of sigrokdecode.Decoder";
+		return SRD_ERR;
 	}
 
 	/*
@@ -762,10 +750,111 @@ SRD_API int srd_decoder_load(const char *module_name)
 	if (apiver != 3) {
         srd_exception_catch(NULL, "Only PD API version 3 is supported, "
 			"decoder %s has version %ld", module_name, apiver);
-		fail_txt = "API version mismatch";
-		goto err_out;
+		*fail_txt = "API version mismatch";
+		return SRD_ERR;
 	}
 
+	return SRD_OK;
+}
+
+/**
+ * Import the Python module of a decoder that was described by the
+ * metadata cache. Does nothing if it was imported already.
+ *
+ * @param d The decoder to use. Must not be NULL.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @private
+ */
+SRD_PRIV int srd_decoder_import(struct srd_decoder *d)
+{
+	const char *fail_txt;
+	int ret;
+	PyGILState_STATE gstate;
+
+	gstate = PyGILState_Ensure();
+
+	if (d->py_dec) {
+		PyGILState_Release(gstate);
+		return SRD_OK;
+	}
+
+	fail_txt = NULL;
+	ret = import_module(d, d->module, &fail_txt);
+	if (ret == SRD_ERR_PYTHON)
+		srd_exception_catch(NULL, "Failed to load decoder %s: %s",
+				d->module, fail_txt);
+	else if (ret != SRD_OK)
+		srd_err("Failed to load decoder %s: %s", d->module, fail_txt);
+
+	if (ret != SRD_OK) {
+		Py_CLEAR(d->py_dec);
+		Py_CLEAR(d->py_mod);
+	} else {
+		srd_dbg("Imported decoder %s on first use.", d->module);
+	}
+
+	PyGILState_Release(gstate);
+
+	return ret;
+}
+
+static struct srd_decoder *decoder_get_by_module(const char *module_name)
+{
+	GSList *l;
+	struct srd_decoder *dec;
+
+	for (l = pd_list; l; l = l->next) {
+		dec = l->data;
+		if (dec->module && !strcmp(dec->module, module_name))
+			return dec;
+	}
+
+	return NULL;
+}
+
+/**
+ * Load a protocol decoder module into the embedded Python interpreter.
+ *
+ * @param module_name The module name to be loaded.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ *
+ * @since 0.1.0
+ */
+SRD_API int srd_decoder_load(const char *module_name)
+{
+	struct srd_decoder *d;
+	const char *fail_txt;
+	int ret;
+	PyGILState_STATE gstate;
+
+	if (!srd_check_init())
+		return SRD_ERR;
+
+	if (!module_name)
+		return SRD_ERR_ARG;
+
+	gstate = PyGILState_Ensure();
+
+	if (PyDict_GetItemString(PyImport_GetModuleDict(), module_name) ||
+			decoder_get_by_module(module_name)) {
+		/* Module was already imported, or is pending from the cache. */
+		PyGILState_Release(gstate);
+		return SRD_OK;
+	}
+
+	d = g_malloc0(sizeof(struct srd_decoder));
+	d->module = g_strdup(module_name);
+	fail_txt = NULL;
+
+	ret = import_module(d, module_name, &fail_txt);
+	if (ret == SRD_ERR_PYTHON)
+		goto except_out;
+	if (ret != SRD_OK)
+		goto err_out;
+
 	/* Check Decoder class for required methods. */
 
 	if (check_method(d->py_dec, module_name, "reset") != SRD_OK) {
@@ -904,6 +993,9 @@ SRD_API char *srd_decoder_doc_get(const struct srd_decoder *dec)
 	if (!dec)
 		return NULL;
 
+	if (srd_decoder_import((struct srd_decoder *)dec) != SRD_OK)
+		return NULL;
+
 	gstate = PyGILState_Ensure();
 
 	if (!PyObject_HasAttrString(dec->py_mod, "__doc__"))
@@ -968,6 +1060,473 @@ SRD_API int srd_decoder_unload(struct srd_decoder *dec)
 	return SRD_OK;
 }
 
+static char *cache_file_name(void)
+{
+	return g_build_filename(g_get_user_cache_dir(), "libsigrokdecode4DSL",
+			"decoders.cache", NULL);
+}
+
+static void cache_open(void)
+{
+	char *file_name, *python;
+	gboolean valid;
+
+	if (pd_cache)
+		return;
+
+	pd_cache = g_key_file_new();
+	pd_cache_dirty = FALSE;
+	file_name = cache_file_name();
+	valid = g_key_file_load_from_file(pd_cache, file_name, G_KEY_FILE_NONE, NULL);
+	python = g_key_file_get_value(pd_cache, DECODER_CACHE_GROUP, "python", NULL);
+	valid = valid && !g_strcmp0(python, PY_VERSION) &&
+			g_key_file_get_integer(pd_cache, DECODER_CACHE_GROUP,
+				"version", NULL) == DECODER_CACHE_VERSION;
+	g_free(python);
+	if (!valid) {
+		/* Missing or stale, start over. */
+		g_key_file_free(pd_cache);
+		pd_cache = g_key_file_new();
+		g_key_file_set_integer(pd_cache, DECODER_CACHE_GROUP,
+				"version", DECODER_CACHE_VERSION);
+		g_key_file_set_value(pd_cache, DECODER_CACHE_GROUP,
+				"python", PY_VERSION);
+	}
+	g_free(file_name);
+}
+
+static void cache_close(void)
+{
+	char *file_name, *dir_name, *data;
+	gsize length;
+
+	if (!pd_cache)
+		return;
+
+	if (pd_cache_dirty) {
+		file_name = cache_file_name();
+		dir_name = g_path_get_dirname(file_name);
+		data = g_key_file_to_data(pd_cache, &length, NULL);
+		if (g_mkdir_with_parents(dir_name, 0755) != 0 ||
+				!g_file_set_contents(file_name, data, length, NULL))
+			srd_dbg("Failed to write decoder cache %s.", file_name);
+		g_free(data);
+		g_free(dir_name);
+		g_free(file_name);
+	}
+
+	g_key_file_free(pd_cache);
+	pd_cache = NULL;
+}
+
+/*
+ * Identify the current content of a decoder directory by the newest
+ * modification time and the total size of its files.
+ */
+static char *module_stamp(const char *path)
+{
+	GDir *dir;
+	GStatBuf st;
+	const gchar *name;
+	char *file;
+	gint64 mtime, size;
+
+	if (!(dir = g_dir_open(path, 0, NULL)))
+		return NULL;
+
+	mtime = size = 0;
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		file = g_build_filename(path, name, NULL);
+		if (g_stat(file, &st) == 0 && S_ISREG(st.st_mode)) {
+			mtime = MAX(mtime, (gint64)st.st_mtime);
+			size += st.st_size;
+		}
+		g_free(file);
+	}
+	g_dir_close(dir);
+
+	return g_strdup_printf("%" G_GINT64_FORMAT "-%" G_GINT64_FORMAT,
+			mtime, size);
+}
+
+static void cache_set_strlist(const char *group, const char *key, GSList *list)
+{
+	const gchar **strv;
+	GSList *l;
+	gsize i;
+
+	strv = g_new(const gchar *, g_slist_length(list) + 1);
+	for (i = 0, l = list; l; l = l->next)
+		strv[i++] = l->data;
+	strv[i] = NULL;
+	g_key_file_set_string_list(pd_cache, group, key, strv, i);
+	g_free(strv);
+}
+
+static GSList *cache_get_strlist(const char *group, const char *key)
+{
+	gchar **strv;
+	GSList *list;
+	gsize i;
+
+	list = NULL;
+	if (!(strv = g_key_file_get_string_list(pd_cache, group, key, NULL, NULL)))
+		return NULL;
+	for (i = 0; strv[i]; i++)
+		list = g_slist_append(list, strv[i]);
+	g_free(strv);
+
+	return list;
+}
+
+static void cache_set_variant(const char *group, const char *key, GVariant *var)
+{
+	gchar *str;
+
+	str = g_variant_print(var, TRUE);
+	g_key_file_set_string(pd_cache, group, key, str);
+	g_free(str);
+}
+
+static GVariant *cache_get_variant(const char *group, const char *key)
+{
+	GVariant *var;
+	gchar *str;
+
+	if (!(str = g_key_file_get_string(pd_cache, group, key, NULL)))
+		return NULL;
+	var = g_variant_parse(NULL, str, NULL, NULL, NULL);
+	g_free(str);
+
+	return var ? g_variant_ref_sink(var) : NULL;
+}
+
+static void cache_set_channels(const char *group, const char *prefix,
+		GSList *channels)
+{
+	const struct srd_channel *pdch;
+	const gchar *strv[3];
+	gchar *key;
+	GSList *l;
+	int i;
+
+	g_key_file_set_integer(pd_cache, group, prefix, g_slist_length(channels));
+	for (i = 0, l = channels; l; l = l->next, i++) {
+		pdch = l->data;
+		strv[0] = pdch->id;
+		strv[1] = pdch->name;
+		strv[2] = pdch->desc;
+		key = g_strdup_printf("%s_%d", prefix, i);
+		g_key_file_set_string_list(pd_cache, group, key, strv, 3);
+		g_free(key);
+		key = g_strdup_printf("%s_%d_type", prefix, i);
+		g_key_file_set_integer(pd_cache, group, key, pdch->type);
+		g_free(key);
+		key = g_strdup_printf("%s_%d_order", prefix, i);
+		g_key_file_set_integer(pd_cache, group, key, pdch->order);
+		g_free(key);
+	}
+}
+
+static int cache_get_channels(const char *group, const char *prefix,
+		GSList **channels)
+{
+	struct srd_channel *pdch;
+	gchar **strv;
+	gchar *key;
+	int i, num;
+
+	num = g_key_file_get_integer(pd_cache, group, prefix, NULL);
+	for (i = 0; i < num; i++) {
+		key = g_strdup_printf("%s_%d", prefix, i);
+		strv = g_key_file_get_string_list(pd_cache, group, key, NULL, NULL);
+		g_free(key);
+		if (!strv || g_strv_length(strv) != 3) {
+			g_strfreev(strv);
+			return SRD_ERR;
+		}
+		pdch = g_malloc(sizeof(struct srd_channel));
+		pdch->id = strv[0];
+		pdch->name = strv[1];
+		pdch->desc = strv[2];
+		g_free(strv);
+		key = g_strdup_printf("%s_%d_type", prefix, i);
+		pdch->type = g_key_file_get_integer(pd_cache, group, key, NULL);
+		g_free(key);
+		key = g_strdup_printf("%s_%d_order", prefix, i);
+		pdch->order = g_key_file_get_integer(pd_cache, group, key, NULL);
+		g_free(key);
+		*channels = g_slist_append(*channels, pdch);
+	}
+
+	return SRD_OK;
+}
+
+/* Store everything srd_decoder_load() read from the Decoder class. */
+static void cache_save_decoder(const char *group, const char *stamp,
+		const struct srd_decoder *d)
+{
+	const struct srd_decoder_option *o;
+	const struct srd_decoder_annotation_row *row;
+	gint *ints;
+	gchar *key;
+	GSList *l, *ll;
+	gsize n;
+	int i;
+
+	g_key_file_remove_group(pd_cache, group, NULL);
+	g_key_file_set_string(pd_cache, group, "stamp", stamp);
+	pd_cache_dirty = TRUE;
+	if (!d) {
+		/* Not a decoder, e.g. the "common" directory. */
+		g_key_file_set_boolean(pd_cache, group, "invalid", TRUE);
+		return;
+	}
+
+	g_key_file_set_string(pd_cache, group, "module", d->module);
+	g_key_file_set_string(pd_cache, group, "id", d->id);
+	g_key_file_set_string(pd_cache, group, "name", d->name);
+	g_key_file_set_string(pd_cache, group, "longname", d->longname);
+	g_key_file_set_string(pd_cache, group, "desc", d->desc);
+	g_key_file_set_string(pd_cache, group, "license", d->license);
+	cache_set_strlist(group, "inputs", d->inputs);
+	cache_set_strlist(group, "outputs", d->outputs);
+	cache_set_strlist(group, "tags", d->tags);
+	cache_set_channels(group, "channel", d->channels);
+	cache_set_channels(group, "opt_channel", d->opt_channels);
+
+	g_key_file_set_integer(pd_cache, group, "option", g_slist_length(d->options));
+	for (i = 0, l = d->options; l; l = l->next, i++) {
+		o = l->data;
+		key = g_strdup_printf("option_%d", i);
+		g_key_file_set_string(pd_cache, group, key, o->id);
+		g_free(key);
+		if (o->desc) {
+			key = g_strdup_printf("option_%d_desc", i);
+			g_key_file_set_string(pd_cache, group, key, o->desc);
+			g_free(key);
+		}
+		if (o->def) {
+			key = g_strdup_printf("option_%d_def", i);
+			cache_set_variant(group, key, o->def);
+			g_free(key);
+		}
+		key = g_strdup_printf("option_%d_values", i);
+		g_key_file_set_integer(pd_cache, group, key, g_slist_length(o->values));
+		g_free(key);
+		n = 0;
+		for (ll = o->values; ll; ll = ll->next) {
+			key = g_strdup_printf("option_%d_value_%" G_GSIZE_FORMAT, i, n++);
+			cache_set_variant(group, key, ll->data);
+			g_free(key);
+		}
+	}
+
+	g_key_file_set_integer(pd_cache, group, "annotation", g_slist_length(d->annotations));
+	for (i = 0, l = d->annotations; l; l = l->next, i++) {
+		key = g_strdup_printf("annotation_%d", i);
+		g_key_file_set_string_list(pd_cache, group, key,
+				(const gchar * const *)l->data, g_strv_length(l->data));
+		g_free(key);
+	}
+
+	n = g_slist_length(d->ann_types);
+	ints = g_new0(gint, n + 1);
+	for (i = 0, l = d->ann_types; l; l = l->next)
+		ints[i++] = GPOINTER_TO_INT(l->data);
+	g_key_file_set_integer_list(pd_cache, group, "ann_types", ints, n);
+	g_free(ints);
+
+	g_key_file_set_integer(pd_cache, group, "annotation_row",
+			g_slist_length(d->annotation_rows));
+	for (i = 0, l = d->annotation_rows; l; l = l->next, i++) {
+		row = l->data;
+		key = g_strdup_printf("annotation_row_%d", i);
+		g_key_file_set_string(pd_cache, group, key, row->id);
+		g_free(key);
+		key = g_strdup_printf("annotation_row_%d_desc", i);
+		g_key_file_set_string(pd_cache, group, key, row->desc);
+		g_free(key);
+		n = g_slist_length(row->ann_classes);
+		ints = g_new0(gint, n + 1);
+		n = 0;
+		for (ll = row->ann_classes; ll; ll = ll->next)
+			ints[n++] = GPOINTER_TO_SIZE(ll->data);
+		key = g_strdup_printf("annotation_row_%d_classes", i);
+		g_key_file_set_integer_list(pd_cache, group, key, ints, n);
+		g_free(key);
+		g_free(ints);
+	}
+
+	g_key_file_set_integer(pd_cache, group, "binary", g_slist_length(d->binary));
+	for (i = 0, l = d->binary; l; l = l->next, i++) {
+		key = g_strdup_printf("binary_%d", i);
+		g_key_file_set_string_list(pd_cache, group, key,
+				(const gchar * const *)l->data, g_strv_length(l->data));
+		g_free(key);
+	}
+}
+
+/*
+ * Build a decoder from its cache group, without importing the module.
+ * Returns NULL if any entry is missing.
+ */
+static struct srd_decoder *cache_load_decoder(const char *group)
+{
+	struct srd_decoder *d;
+	struct srd_decoder_option *o;
+	struct srd_decoder_annotation_row *row;
+	gchar **strv;
+	gint *ints;
+	gchar *key;
+	gsize n, k;
+	int i, num, num_values;
+
+	d = g_malloc0(sizeof(struct srd_decoder));
+	d->module = g_key_file_get_string(pd_cache, group, "module", NULL);
+	d->id = g_key_file_get_string(pd_cache, group, "id", NULL);
+	d->name = g_key_file_get_string(pd_cache, group, "name", NULL);
+	d->longname = g_key_file_get_string(pd_cache, group, "longname", NULL);
+	d->desc = g_key_file_get_string(pd_cache, group, "desc", NULL);
+	d->license = g_key_file_get_string(pd_cache, group, "license", NULL);
+	if (!d->module || !d->id || !d->name || !d->longname || !d->desc || !d->license)
+		goto err_out;
+
+	d->inputs = cache_get_strlist(group, "inputs");
+	d->outputs = cache_get_strlist(group, "outputs");
+	d->tags = cache_get_strlist(group, "tags");
+	if (cache_get_channels(group, "channel", &d->channels) != SRD_OK ||
+			cache_get_channels(group, "opt_channel", &d->opt_channels) != SRD_OK)
+		goto err_out;
+
+	num = g_key_file_get_integer(pd_cache, group, "option", NULL);
+	for (i = 0; i < num; i++) {
+		o = g_malloc0(sizeof(struct srd_decoder_option));
+		d->options = g_slist_append(d->options, o);
+		key = g_strdup_printf("option_%d", i);
+		o->id = g_key_file_get_string(pd_cache, group, key, NULL);
+		g_free(key);
+		if (!o->id)
+			goto err_out;
+		key = g_strdup_printf("option_%d_desc", i);
+		o->desc = g_key_file_get_string(pd_cache, group, key, NULL);
+		g_free(key);
+		key = g_strdup_printf("option_%d_def", i);
+		o->def = cache_get_variant(group, key);
+		g_free(key);
+		key = g_strdup_printf("option_%d_values", i);
+		num_values = g_key_file_get_integer(pd_cache, group, key, NULL);
+		g_free(key);
+		for (k = 0; k < (gsize)num_values; k++) {
+			GVariant *var;
+			key = g_strdup_printf("option_%d_value_%" G_GSIZE_FORMAT, i, k);
+			var = cache_get_variant(group, key);
+			g_free(key);
+			if (!var)
+				goto err_out;
+			o->values = g_slist_append(o->values, var);
+		}
+	}
+
+	num = g_key_file_get_integer(pd_cache, group, "annotation", NULL);
+	for (i = 0; i < num; i++) {
+		key = g_strdup_printf("annotation_%d", i);
+		strv = g_key_file_get_string_list(pd_cache, group, key, NULL, NULL);
+		g_free(key);
+		if (!strv)
+			goto err_out;
+		d->annotations = g_slist_append(d->annotations, strv);
+	}
+
+	ints = g_key_file_get_integer_list(pd_cache, group, "ann_types", &n, NULL);
+	for (k = 0; ints && k < n; k++)
+		d->ann_types = g_slist_append(d->ann_types, GINT_TO_POINTER(ints[k]));
+	g_free(ints);
+
+	num = g_key_file_get_integer(pd_cache, group, "annotation_row", NULL);
+	for (i = 0; i < num; i++) {
+		row = g_malloc0(sizeof(struct srd_decoder_annotation_row));
+		d->annotation_rows = g_slist_append(d->annotation_rows, row);
+		key = g_strdup_printf("annotation_row_%d", i);
+		row->id = g_key_file_get_string(pd_cache, group, key, NULL);
+		g_free(key);
+		key = g_strdup_printf("annotation_row_%d_desc", i);
+		row->desc = g_key_file_get_string(pd_cache, group, key, NULL);
+		g_free(key);
+		if (!row->id || !row->desc)
+			goto err_out;
+		key = g_strdup_printf("annotation_row_%d_classes", i);
+		ints = g_key_file_get_integer_list(pd_cache, group, key, &n, NULL);
+		g_free(key);
+		for (k = 0; ints && k < n; k++)
+			row->ann_classes = g_slist_append(row->ann_classes,
+					GSIZE_TO_POINTER(ints[k]));
+		g_free(ints);
+	}
+
+	num = g_key_file_get_integer(pd_cache, group, "binary", NULL);
+	for (i = 0; i < num; i++) {
+		key = g_strdup_printf("binary_%d", i);
+		strv = g_key_file_get_string_list(pd_cache, group, key, NULL, NULL);
+		g_free(key);
+		if (!strv)
+			goto err_out;
+		d->binary = g_slist_append(d->binary, strv);
+	}
+
+	return d;
+
+err_out:
+	decoder_free(d);
+
+	return NULL;
+}
+
+/*
+ * Add the decoder in directory path/module_name, from the metadata cache
+ * when its files are unchanged, otherwise by importing it.
+ */
+static void decoder_load_cached(const char *path, const char *module_name)
+{
+	struct srd_decoder *d;
+	char *group, *stamp, *cached_stamp;
+	int ret;
+
+	if (decoder_get_by_module(module_name))
+		return;
+
+	group = g_build_filename(path, module_name, NULL);
+	stamp = module_stamp(group);
+	if (!stamp) {
+		/* Not a directory, let the importer decide. */
+		srd_decoder_load(module_name);
+		g_free(group);
+		return;
+	}
+
+	cached_stamp = g_key_file_get_string(pd_cache, group, "stamp", NULL);
+	d = NULL;
+	if (!g_strcmp0(stamp, cached_stamp)) {
+		if (g_key_file_get_boolean(pd_cache, group, "invalid", NULL))
+			goto out;
+		if ((d = cache_load_decoder(group))) {
+			pd_list = g_slist_append(pd_list, d);
+			goto out;
+		}
+	}
+
+	ret = srd_decoder_load(module_name);
+	d = decoder_get_by_module(module_name);
+	/* A module imported by another PD first says nothing about itself. */
+	if (d || ret != SRD_OK)
+		cache_save_decoder(group, stamp, d);
+
+out:
+	g_free(cached_stamp);
+	g_free(stamp);
+	g_free(group);
+}
+
 static void srd_decoder_load_all_zip_path(char *zip_path)
 {
 	PyObject *zipimport_mod, *zipimporter_class, *zipimporter;
@@ -1070,7 +1629,7 @@ static void srd_decoder_load_all_path(char *path)
 	 */
 	while ((direntry = g_dir_read_name(dir)) != NULL) {
 		/* The directory name is the module name (e.g. "i2c"). */
-		srd_decoder_load(direntry);
+		decoder_load_cached(path, direntry);
 	}
 	g_dir_close(dir);
 }
@@ -1078,6 +1637,10 @@ static void srd_decoder_load_all_path(char *path)
 /**
  * Load all installed protocol decoders.
  *
+ * Decoders found in a search path directory are described from an
+ * on-disk metadata cache while their files are unchanged; their Python
+ * module is only imported when the first instance is created.
+ *
  * @return SRD_OK upon success, a (negative) error code otherwise.
  *
  * @since 0.1.0
@@ -1089,8 +1652,10 @@ SRD_API int srd_decoder_load_all(void)
 	if (!srd_check_init())
 		return SRD_ERR;
 
+	cache_open();
 	for (l = searchpaths; l; l = l->next)
 		srd_decoder_load_all_path(l->data);
+	cache_close();
 
 	return SRD_OK;
 }
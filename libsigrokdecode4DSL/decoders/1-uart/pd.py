@@ -211,7 +211,7 @@ class Decoder(srd.Decoder):
             self.frame_valid = False
             es = self.samplenum + ceil(self.bit_width / 2.0)
             self.putpse(self.frame_start, es, ['FRAME', 0,
-                (self.datavalue[rxtx], self.frame_valid[rxtx])])
+                (self.datavalue, self.frame_valid)])
             self.state = 'WAIT FOR START BIT'
             return
 
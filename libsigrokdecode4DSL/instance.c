@@ -26,6 +26,7 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 /** @cond PRIVATE */
 
@@ -33,6 +34,8 @@ extern SRD_PRIV GSList *sessions;
 
 /** @endcond */
 
+static void srd_inst_stack_start(struct srd_decoder_inst *di);
+
 /**
  * @file
  *
@@ -337,6 +340,7 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 	struct srd_decoder *dec;
 	struct srd_decoder_inst *di;
 	char *inst_id;
+	GSList *l;
 	PyGILState_STATE gstate;
 
 	i = 1;
@@ -349,6 +353,10 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 		return NULL;
 	}
 
+	/* Decoders listed from the metadata cache are imported here. */
+	if (srd_decoder_import(dec) != SRD_OK)
+		return NULL;
+
 	di = g_malloc0(sizeof(struct srd_decoder_inst));
 
 	di->decoder = dec;
@@ -389,6 +397,13 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 	/* Default to the initial pins being the same as in sample 0. */
 	oldpins_array_seed(di);
 
+	/* Lookup tables for put(), which runs for every PD output. */
+	di->pd_output_array = g_ptr_array_new();
+	di->num_ann_types = g_slist_length(dec->ann_types);
+	di->ann_types = g_malloc0(sizeof(int) * (di->num_ann_types + 1));
+	for (i = 0, l = dec->ann_types; l; l = l->next)
+		di->ann_types[i++] = GPOINTER_TO_INT(l->data);
+
 	gstate = PyGILState_Ensure();
 
 	/* Create a new instance of this decoder class. */
@@ -398,6 +413,7 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 					decoder_id);
         goto err;
 	}
+	srd_Decoder_set_inst(di->py_inst, di);
 
     if (options && srd_inst_option_set(di, options) != SRD_OK) {
         goto err;
@@ -435,8 +451,15 @@ SRD_API struct srd_decoder_inst *srd_inst_new(struct srd_session *sess,
 	return di;
 
 err:
+    if (di->py_inst) {
+        srd_Decoder_set_inst(di->py_inst, NULL);
+        Py_DecRef(di->py_inst);
+    }
     PyGILState_Release(gstate);
+    g_ptr_array_free(di->pd_output_array, TRUE);
+    g_free(di->ann_types);
     g_free(di->dec_channelmap);
+    g_free(di->inst_id);
     g_free(di);
     return NULL;
 }
@@ -496,6 +519,9 @@ static void srd_inst_reset_state(struct srd_decoder_inst *di)
 	di->handled_all_samples = FALSE;
 	di->want_wait_terminate = FALSE;
 	di->decoder_state = SRD_OK;
+	g_free(di->stack_error);
+	di->stack_error = NULL;
+	memset(&di->stats, 0, sizeof(di->stats));
 	/* Conditions and mutex got reset after joining the thread. */
 }
 
@@ -671,6 +697,31 @@ SRD_API int srd_inst_initial_pins_set_all(struct srd_decoder_inst *di, GArray *i
 	return SRD_OK;
 }
 
+/**
+ * Get the work counters of a decoder instance.
+ *
+ * The counters start at zero when the instance is created or reset,
+ * and can be read while the instance is decoding. Stacked instances
+ * have their own counters, the Python time of an instance doesn't
+ * include the decode() calls of the instances stacked on top of it.
+ * Native decoders don't hold the GIL.
+ *
+ * @param di The decoder instance. Must not be NULL.
+ * @param stats Receives a copy of the counters. Must not be NULL.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ */
+SRD_API int srd_inst_stats_get(const struct srd_decoder_inst *di,
+		struct srd_inst_stats *stats)
+{
+	if (!di || !stats)
+		return SRD_ERR_ARG;
+
+	*stats = di->stats;
+
+	return SRD_OK;
+}
+
 /** @private */
 SRD_PRIV int srd_inst_start(struct srd_decoder_inst *di, char **error)
 {
@@ -708,6 +759,9 @@ SRD_PRIV int srd_inst_start(struct srd_decoder_inst *di, char **error)
     /* Set self.matched to 0. */
     PyObject_SetAttrString(di->py_inst, "matched", PyLong_FromLong(0));
 
+	/* Replace decode() by a native implementation if possible. */
+	srd_native_start(di);
+
 	PyGILState_Release(gstate);
 
 	/* Start all the PDs stacked on top of this one. */
@@ -715,6 +769,7 @@ SRD_PRIV int srd_inst_start(struct srd_decoder_inst *di, char **error)
 		next_di = l->data;
         if ((ret = srd_inst_start(next_di, error)) != SRD_OK)
 			return ret;
+		srd_inst_stack_start(next_di);
 	}
 
 	return SRD_OK;
@@ -783,6 +838,7 @@ static inline gboolean sample_matches(uint8_t old_sample, uint8_t sample, struct
 SRD_PRIV void condition_list_free(struct srd_decoder_inst *di)
 {
 	GSList *l, *ll;
+	PyGILState_STATE gstate;
 
 	if (!di)
 		return;
@@ -795,6 +851,13 @@ SRD_PRIV void condition_list_free(struct srd_decoder_inst *di)
 
     g_slist_free(di->condition_list);
 	di->condition_list = NULL;
+
+	if (di->py_conds) {
+		gstate = PyGILState_Ensure();
+		Py_DecRef(di->py_conds);
+		PyGILState_Release(gstate);
+		di->py_conds = NULL;
+	}
 }
 
 static gboolean have_non_null_conds(const struct srd_decoder_inst *di)
@@ -947,6 +1010,7 @@ static gboolean find_match(struct srd_decoder_inst *di)
         di->abs_cur_samplenum++;
 
     while (di->abs_cur_samplenum < di->abs_end_samplenum) {
+        di->stats.match_iterations++;
 
         /* Check whether the current sample matches at least one of the conditions (logical OR). */
         /* IMPORTANT: We need to check all conditions, even if there was a match already! */
@@ -999,6 +1063,8 @@ static gboolean find_match(struct srd_decoder_inst *di)
  */
 SRD_PRIV int process_samples_until_condition_match(struct srd_decoder_inst *di, gboolean *found_match)
 {
+	uint64_t start;
+
 	if (!di || !found_match)
 		return SRD_ERR_ARG;
 
@@ -1006,6 +1072,8 @@ SRD_PRIV int process_samples_until_condition_match(struct srd_decoder_inst *di,
 	if (di->want_wait_terminate)
 		return SRD_OK;
 
+	start = di->abs_cur_samplenum;
+
 	/* Check if any of the current condition(s) match. */
 	while (TRUE) {
 		/* Feed the (next chunk of the) buffer to find_match(). */
@@ -1016,7 +1084,7 @@ SRD_PRIV int process_samples_until_condition_match(struct srd_decoder_inst *di,
 			srd_dbg("Done, handled all samples (abs cur %" PRIu64
 				" / abs end %" PRIu64 ").",
 				di->abs_cur_samplenum, di->abs_end_samplenum);
-			return SRD_OK;
+			break;
 		}
 
 		/* If we didn't find a match, continue looking. */
@@ -1024,12 +1092,43 @@ SRD_PRIV int process_samples_until_condition_match(struct srd_decoder_inst *di,
 			continue;
 
 		/* At least one condition matched, return. */
-		return SRD_OK;
+		break;
 	}
 
+	if (di->abs_cur_samplenum > start)
+		di->stats.samples += di->abs_cur_samplenum - start;
+
 	return SRD_OK;
 }
 
+/* Let the worker thread run the native implementation of decode(). */
+static gpointer native_thread(struct srd_decoder_inst *di)
+{
+	int ret, wanted_term;
+
+	srd_dbg("%s: Calling native decode().", di->inst_id);
+	ret = di->native->decode(di, di->native_state);
+	srd_dbg("%s: Native decode() terminated.", di->inst_id);
+
+	if (ret != SRD_OK)
+		di->decoder_state = SRD_ERR;
+
+	srd_inst_deliver_annotations(di);
+
+	/* Unblock pending srd_inst_decode() calls, like di_thread() does. */
+	g_mutex_lock(&di->data_mutex);
+	wanted_term = di->want_wait_terminate;
+	di->want_wait_terminate = TRUE;
+	di->handled_all_samples = TRUE;
+	g_cond_signal(&di->handled_all_samples_cond);
+	g_mutex_unlock(&di->data_mutex);
+
+	srd_dbg("%s: Thread done (ret %d, req %d).", di->inst_id, ret,
+		wanted_term);
+
+	return NULL;
+}
+
 /**
  * Worker thread (per PD-stack).
  *
@@ -1052,6 +1151,9 @@ static gpointer di_thread(gpointer data)
 
 	srd_dbg("%s: Starting thread routine for decoder.", di->inst_id);
 
+	if (di->native)
+		return native_thread(di);
+
 	gstate = PyGILState_Ensure();
 
 	/*
@@ -1060,12 +1162,18 @@ static gpointer di_thread(gpointer data)
 	 */
     //Py_IncRef(di->py_inst);
 	srd_dbg("%s: Calling decode().", di->inst_id);
+	di->python_since = g_get_monotonic_time();
 	py_res = PyObject_CallMethod(di->py_inst, "decode", NULL);
+	di->stats.python_time += g_get_monotonic_time() - di->python_since;
 	srd_dbg("%s: decode() terminated.", di->inst_id);
 
 	if (!py_res)
 		di->decoder_state = SRD_ERR;
 
+	/* Don't lose annotations which were put() since the last chunk. */
+	srd_inst_stack_drain(di);
+	srd_inst_flush_annotations(di);
+
 	/*
 	 * Make sure to unblock potentially pending srd_inst_decode()
 	 * calls in application threads after the decode() method might
@@ -1124,6 +1232,225 @@ static gpointer di_thread(gpointer data)
 	return NULL;
 }
 
+static gpointer stack_thread(gpointer data)
+{
+	PyObject *py_res;
+	struct srd_decoder_inst *di;
+	struct srd_stack_queue *q;
+	struct srd_stack_item *item;
+	gboolean idle;
+	int64_t start;
+	PyGILState_STATE gstate;
+
+	di = data;
+	q = di->stack_queue;
+
+	srd_dbg("%s: Starting thread routine for stacked decoder.", di->inst_id);
+
+	g_mutex_lock(&q->mutex);
+	while (1) {
+		while (!q->items.length && !q->stop)
+			g_cond_wait(&q->cond, &q->mutex);
+		if (q->stop)
+			break;
+		item = g_queue_pop_head(&q->items);
+		q->busy = TRUE;
+		g_cond_broadcast(&q->cond);
+		g_mutex_unlock(&q->mutex);
+
+		gstate = PyGILState_Ensure();
+		start = g_get_monotonic_time();
+		if (!(py_res = PyObject_CallMethod(di->py_inst, "decode", "KKO",
+				item->start_sample, item->end_sample, item->data)))
+			srd_inst_stack_fail(di);
+		di->stats.python_time += g_get_monotonic_time() - start;
+		Py_XDECREF(py_res);
+		Py_DecRef(item->data);
+
+		/* Hand over annotations before the queue looks drained. */
+		g_mutex_lock(&q->mutex);
+		idle = !q->items.length;
+		g_mutex_unlock(&q->mutex);
+		if (idle)
+			srd_inst_flush_annotations(di);
+		PyGILState_Release(gstate);
+		g_free(item);
+
+		g_mutex_lock(&q->mutex);
+		q->busy = FALSE;
+		g_cond_broadcast(&q->cond);
+	}
+	g_mutex_unlock(&q->mutex);
+
+	gstate = PyGILState_Ensure();
+	srd_inst_flush_annotations(di);
+	PyGILState_Release(gstate);
+
+	srd_dbg("%s: Stacked decoder thread done.", di->inst_id);
+
+	return NULL;
+}
+
+static void srd_inst_stack_start(struct srd_decoder_inst *di)
+{
+	struct srd_stack_queue *q;
+
+	if (di->stack_queue || !di->sess->pipeline_depth)
+		return;
+
+	q = g_malloc0(sizeof(struct srd_stack_queue));
+	g_mutex_init(&q->mutex);
+	g_cond_init(&q->cond);
+	g_queue_init(&q->items);
+	q->depth = di->sess->pipeline_depth;
+	di->stack_queue = q;
+
+	q->thread = g_thread_new(di->inst_id, stack_thread, di);
+}
+
+/* Stop the threads of di and of the instances stacked on top of it. */
+static void srd_inst_stack_stop(struct srd_decoder_inst *di)
+{
+	GSList *l;
+	struct srd_stack_queue *q;
+	struct srd_stack_item *item;
+	PyGILState_STATE gstate;
+
+	for (l = di->next_di; l; l = l->next)
+		srd_inst_stack_stop(l->data);
+
+	if (!(q = di->stack_queue))
+		return;
+
+	srd_dbg("%s: Joining stacked decoder thread.", di->inst_id);
+
+	g_mutex_lock(&q->mutex);
+	q->stop = TRUE;
+	g_cond_broadcast(&q->cond);
+	g_mutex_unlock(&q->mutex);
+	(void)g_thread_join(q->thread);
+
+	/* Drop data which was not processed. */
+	gstate = PyGILState_Ensure();
+	while ((item = g_queue_pop_head(&q->items))) {
+		Py_DecRef(item->data);
+		g_free(item);
+	}
+	PyGILState_Release(gstate);
+
+	g_cond_clear(&q->cond);
+	g_mutex_clear(&q->mutex);
+	g_free(q);
+	di->stack_queue = NULL;
+}
+
+/**
+ * Queue data for a stacked instance which runs in its own thread.
+ * Blocks while the queue is full. Must be called with the GIL held.
+ *
+ * @private
+ */
+SRD_PRIV void srd_inst_stack_push(struct srd_decoder_inst *di,
+		uint64_t start_sample, uint64_t end_sample, PyObject *data)
+{
+	struct srd_stack_queue *q;
+	struct srd_stack_item *item;
+
+	q = di->stack_queue;
+
+	item = g_malloc(sizeof(struct srd_stack_item));
+	item->start_sample = start_sample;
+	item->end_sample = end_sample;
+	item->data = data;
+	Py_IncRef(data);
+
+	Py_BEGIN_ALLOW_THREADS
+	g_mutex_lock(&q->mutex);
+	while (q->items.length >= q->depth && !q->stop)
+		g_cond_wait(&q->cond, &q->mutex);
+	g_queue_push_tail(&q->items, item);
+	g_cond_broadcast(&q->cond);
+	g_mutex_unlock(&q->mutex);
+	Py_END_ALLOW_THREADS
+}
+
+/**
+ * Record the pending exception of a stacked instance's decode(), so
+ * that srd_session_send() fails with it. Must be called with the GIL held.
+ *
+ * @private
+ */
+SRD_PRIV void srd_inst_stack_fail(struct srd_decoder_inst *di)
+{
+	char *error;
+
+	error = NULL;
+	srd_exception_catch(&error, "Calling %s decode() failed", di->inst_id);
+
+	/* Keep the first error, later ones are mostly follow-ups. */
+	if (di->stack_queue)
+		g_mutex_lock(&di->stack_queue->mutex);
+	di->decoder_state = SRD_ERR_PYTHON;
+	if (!di->stack_error)
+		di->stack_error = error;
+	else
+		g_free(error);
+	if (di->stack_queue)
+		g_mutex_unlock(&di->stack_queue->mutex);
+}
+
+/* Find the first error of the instances stacked on top of di. */
+static int srd_inst_stack_status(struct srd_decoder_inst *di, char **error)
+{
+	GSList *l;
+	struct srd_decoder_inst *next_di;
+	int ret;
+
+	for (l = di->next_di; l; l = l->next) {
+		next_di = l->data;
+		if (next_di->stack_queue)
+			g_mutex_lock(&next_di->stack_queue->mutex);
+		ret = next_di->decoder_state;
+		if (ret != SRD_OK && error && !*error)
+			*error = g_strdup(next_di->stack_error);
+		if (next_di->stack_queue)
+			g_mutex_unlock(&next_di->stack_queue->mutex);
+		if (ret != SRD_OK)
+			return ret;
+		if ((ret = srd_inst_stack_status(next_di, error)) != SRD_OK)
+			return ret;
+	}
+
+	return SRD_OK;
+}
+
+/**
+ * Wait until the threads of the instances stacked on top of di have
+ * processed all queued data. Must be called with the GIL held.
+ *
+ * @private
+ */
+SRD_PRIV void srd_inst_stack_drain(struct srd_decoder_inst *di)
+{
+	GSList *l;
+	struct srd_decoder_inst *next_di;
+	struct srd_stack_queue *q;
+
+	for (l = di->next_di; l; l = l->next) {
+		next_di = l->data;
+		if ((q = next_di->stack_queue)) {
+			Py_BEGIN_ALLOW_THREADS
+			g_mutex_lock(&q->mutex);
+			while ((q->items.length || q->busy) && !q->stop)
+				g_cond_wait(&q->cond, &q->mutex);
+			g_mutex_unlock(&q->mutex);
+			Py_END_ALLOW_THREADS
+		}
+		/* Nothing new arrives up there, now drain the next layer. */
+		srd_inst_stack_drain(next_di);
+	}
+}
+
 /**
  * Decode a chunk of samples.
  *
@@ -1179,6 +1506,8 @@ SRD_PRIV int srd_inst_decode(struct srd_decoder_inst *di,
         const uint8_t **inbuf, const uint8_t *inbuf_const, uint64_t inbuflen,
         char **error)
 {
+	int64_t start;
+
 	/* Return an error upon unusable input. */
 	if (!di) {
         *error = g_strdup("empty decoder instance");
@@ -1219,6 +1548,7 @@ SRD_PRIV int srd_inst_decode(struct srd_decoder_inst *di,
 	}
 
 	/* Push the new sample chunk to the worker thread. */
+	start = g_get_monotonic_time();
 	g_mutex_lock(&di->data_mutex);
     di->abs_start_samplenum = abs_start_samplenum & ~7ULL;
 	di->abs_end_samplenum = abs_end_samplenum;
@@ -1236,12 +1566,14 @@ SRD_PRIV int srd_inst_decode(struct srd_decoder_inst *di,
 	g_mutex_lock(&di->data_mutex);
 	while (!di->handled_all_samples && !di->want_wait_terminate)
 		g_cond_wait(&di->handled_all_samples_cond, &di->data_mutex);
+	di->stats.handoff_time += g_get_monotonic_time() - start;
 	g_mutex_unlock(&di->data_mutex);
 
 	if (di->want_wait_terminate)
 		return SRD_ERR_TERM_REQ;
 
-	return SRD_OK;
+	/* The whole stack handled the chunk, report its failures. */
+	return srd_inst_stack_status(di, error);
 }
 
 /**
@@ -1281,6 +1613,7 @@ SRD_PRIV int srd_inst_terminate_reset(struct srd_decoder_inst *di)
 	 */
 	srd_dbg("Terminating instance %s", di->inst_id);
 	srd_inst_join_decode_thread(di);
+	srd_inst_stack_stop(di);
 	srd_inst_reset_state(di);
 
 	/*
@@ -1308,24 +1641,57 @@ SRD_PRIV int srd_inst_terminate_reset(struct srd_decoder_inst *di)
 	return di->decoder_state;
 }
 
+/**
+ * Request termination of decoder work without waiting for it.
+ *
+ * The worker thread leaves decode() at its next wait(), and pending
+ * srd_inst_decode() calls return SRD_ERR_TERM_REQ right away. The
+ * current chunk is dropped here, the worker only reads it with
+ * data_mutex held, so the caller may free it as soon as this returns.
+ *
+ * @private
+ */
+SRD_PRIV void srd_inst_interrupt(struct srd_decoder_inst *di)
+{
+	g_mutex_lock(&di->data_mutex);
+	di->want_wait_terminate = TRUE;
+	di->got_new_samples = FALSE;
+	di->inbuf = NULL;
+	di->inbuf_const = NULL;
+	di->inbuflen = 0;
+	di->abs_start_samplenum = 0;
+	di->abs_end_samplenum = 0;
+	g_cond_signal(&di->got_new_samples_cond);
+	g_cond_signal(&di->handled_all_samples_cond);
+	g_mutex_unlock(&di->data_mutex);
+}
+
 /** @private */
 SRD_PRIV void srd_inst_free(struct srd_decoder_inst *di)
 {
 	GSList *l;
 	struct srd_pd_output *pdo;
 	PyGILState_STATE gstate;
+	unsigned int i;
 
 	srd_dbg("Freeing instance %s.", di->inst_id);
 
 	srd_inst_join_decode_thread(di);
+	srd_inst_stack_stop(di);
 
 	srd_inst_reset_state(di);
+	srd_native_free(di);
 
 	gstate = PyGILState_Ensure();
+	srd_Decoder_set_inst(di->py_inst, NULL);
 	Py_DecRef(di->py_inst);
     if (di->py_pinvalues) {
         Py_DecRef(di->py_pinvalues);
     }
+	for (i = 0; i < G_N_ELEMENTS(di->py_pin_ints); i++)
+		Py_XDECREF(di->py_pin_ints[i]);
+	Py_XDECREF(di->py_samplenum_attr);
+	Py_XDECREF(di->py_matched_attr);
 	PyGILState_Release(gstate);
 
 	g_free(di->inst_id);
@@ -1341,6 +1707,15 @@ SRD_PRIV void srd_inst_free(struct srd_decoder_inst *di)
 		g_free(pdo);
 	}
 	g_slist_free(di->pd_output);
+	g_ptr_array_free(di->pd_output_array, TRUE);
+	g_free(di->ann_types);
+	g_free(di->ann_batch);
+	g_free(di->ann_batch_data);
+	if (di->ann_batch_text)
+		g_string_free(di->ann_batch_text, TRUE);
+	if (di->ann_batch_strv)
+		g_ptr_array_free(di->ann_batch_strv, TRUE);
+	g_free(di->pin_values);
 	g_free(di);
 }
 
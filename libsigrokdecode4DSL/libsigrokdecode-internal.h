@@ -39,6 +39,9 @@ enum {
 	SRD_TERM_SKIP,
 };
 
+/* Annotations an instance queues before handing them to the frontend. */
+#define SRD_ANN_BATCH_SIZE 256
+
 struct srd_term {
 	int type;
 	int channel;
@@ -46,6 +49,47 @@ struct srd_term {
 	uint64_t num_samples_already_skipped;
 };
 
+/* Input of a stacked decoder instance which runs in its own thread. */
+struct srd_stack_queue {
+	GThread *thread;
+	GMutex mutex;
+	GCond cond;
+	/* Pending struct srd_stack_item, at most 'depth' of them. */
+	GQueue items;
+	unsigned int depth;
+	/* The thread is running decode() for an item. */
+	gboolean busy;
+	gboolean stop;
+};
+
+struct srd_stack_item {
+	uint64_t start_sample;
+	uint64_t end_sample;
+	PyObject *data;
+};
+
+/*
+ * Native implementation of a Python protocol decoder. It uses the
+ * metadata (options, annotation classes and rows) and the start() and
+ * metadata() methods of the Python class, and replaces its decode().
+ */
+struct srd_native_decoder {
+	/* ID of the Python decoder. */
+	const char *id;
+	/*
+	 * Called after start() with the GIL held. Returns the state of
+	 * the instance, or NULL to run the Python decode() instead (e.g.
+	 * for option values which aren't supported).
+	 */
+	void *(*start)(struct srd_decoder_inst *di);
+	/*
+	 * Runs in the instance's worker thread without holding the GIL.
+	 * Returns upon error, or SRD_ERR_TERM_REQ upon termination.
+	 */
+	int (*decode)(struct srd_decoder_inst *di, void *state);
+	void (*free)(void *state);
+};
+
 /* Custom Python types: */
 
 typedef struct {
@@ -73,8 +117,13 @@ SRD_PRIV int srd_inst_decode(struct srd_decoder_inst *di,
         const uint8_t **inbuf, const uint8_t *inbuf_const, uint64_t inbuflen, char **error);
 SRD_PRIV int process_samples_until_condition_match(struct srd_decoder_inst *di, gboolean *found_match);
 SRD_PRIV int srd_inst_terminate_reset(struct srd_decoder_inst *di);
+SRD_PRIV void srd_inst_interrupt(struct srd_decoder_inst *di);
 SRD_PRIV void srd_inst_free(struct srd_decoder_inst *di);
 SRD_PRIV void srd_inst_free_all(struct srd_session *sess);
+SRD_PRIV void srd_inst_stack_push(struct srd_decoder_inst *di,
+		uint64_t start_sample, uint64_t end_sample, PyObject *data);
+SRD_PRIV void srd_inst_stack_drain(struct srd_decoder_inst *di);
+SRD_PRIV void srd_inst_stack_fail(struct srd_decoder_inst *di);
 
 /* log.c */
 #if defined(G_OS_WIN32) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 4))
@@ -96,10 +145,43 @@ SRD_PRIV int srd_log(int loglevel, const char *format, ...) G_GNUC_PRINTF(2, 3);
 
 /* decoder.c */
 SRD_PRIV long srd_decoder_apiver(const struct srd_decoder *d);
+SRD_PRIV int srd_decoder_import(struct srd_decoder *d);
 
 /* type_decoder.c */
 SRD_PRIV PyObject *srd_Decoder_type_new(void);
 SRD_PRIV const char *output_type_name(unsigned int idx);
+SRD_PRIV void srd_Decoder_set_inst(PyObject *obj, struct srd_decoder_inst *di);
+SRD_PRIV void srd_inst_flush_annotations(struct srd_decoder_inst *di);
+SRD_PRIV void srd_inst_deliver_annotations(struct srd_decoder_inst *di);
+SRD_PRIV struct srd_proto_data *srd_inst_annotation_slot(
+		struct srd_decoder_inst *di);
+SRD_PRIV void srd_inst_annotation_text(struct srd_decoder_inst *di,
+		const char *str, gssize len);
+
+/* native.c */
+SRD_PRIV void srd_native_start(struct srd_decoder_inst *di);
+SRD_PRIV void srd_native_free(struct srd_decoder_inst *di);
+SRD_PRIV int srd_native_option_double(struct srd_decoder_inst *di,
+		const char *key, double *out);
+SRD_PRIV int srd_native_option_str(struct srd_decoder_inst *di,
+		const char *key, char **out);
+SRD_PRIV int srd_native_samplerate(struct srd_decoder_inst *di,
+		uint64_t *samplerate);
+SRD_PRIV struct srd_pd_output *srd_native_output(struct srd_decoder_inst *di,
+		int output_type);
+SRD_PRIV int srd_native_wait(struct srd_decoder_inst *di, uint8_t *pins);
+SRD_PRIV void srd_native_put_ann(struct srd_decoder_inst *di,
+		struct srd_pd_output *pdo, uint64_t start_sample,
+		uint64_t end_sample, int ann_class, const char *const *ann_text);
+
+/* native/uart.c */
+extern SRD_PRIV const struct srd_native_decoder srd_native_uart;
+
+/* native/spi.c */
+extern SRD_PRIV const struct srd_native_decoder srd_native_spi;
+
+/* native/i2c.c */
+extern SRD_PRIV const struct srd_native_decoder srd_native_i2c;
 
 /* type_logic.c */
 SRD_PRIV PyObject *srd_logic_type_new(void);
@@ -37,6 +37,12 @@ struct srd_session {
 
     /* List of frontend callbacks to receive decoder output. */
     GSList *callbacks;
+
+    /* Queue depth for stacked decoders in their own threads, 0 if inline. */
+    unsigned int pipeline_depth;
+
+    /* Run native implementations of decoders where available. */
+    gboolean native;
 };
 
 /**
@@ -215,6 +221,13 @@ struct srd_decoder {
 
 	/** sigrokdecode.Decoder class. */
 	void *py_dec;
+
+	/**
+	 * Python module name. Decoders described by the metadata cache
+	 * are imported from it on first use, until then py_mod and py_dec
+	 * are NULL.
+	 */
+	char *module;
 };
 
 enum srd_initial_pin {
@@ -253,6 +266,31 @@ struct srd_decoder_annotation_row {
 	GSList *ann_classes;
 };
 
+struct srd_stack_queue;
+struct srd_native_decoder;
+
+/**
+ * Counters of the work done by a decoder instance, see
+ * srd_inst_stats_get().
+ */
+struct srd_inst_stats {
+	/** Number of samples the condition matching went through. */
+	uint64_t samples;
+	/** Number of samples the condition matching checked one by one. */
+	uint64_t match_iterations;
+	/** Number of wait() calls which returned a match. */
+	uint64_t wait_returns;
+	/** Number of put() calls, indexed by output type (SRD_OUTPUT_*). */
+	uint64_t puts[4];
+	/**
+	 * Wall time the decoder spent in Python code (µs). It includes
+	 * waiting for the GIL while other decoders run Python.
+	 */
+	uint64_t python_time;
+	/** Time srd_inst_decode() waited for chunks to be handled (µs). */
+	uint64_t handoff_time;
+};
+
 struct srd_decoder_inst {
 	struct srd_decoder *decoder;
 	struct srd_session *sess;
@@ -260,6 +298,8 @@ struct srd_decoder_inst {
     void *py_pinvalues;
 	char *inst_id;
 	GSList *pd_output;
+	/** Same outputs as pd_output, indexed by output ID. */
+	GPtrArray *pd_output_array;
 	int dec_num_channels;
 	int *dec_channelmap;
 	GSList *next_di;
@@ -315,6 +355,43 @@ struct srd_decoder_inst {
 	/** Indicates the current state of the decoder stack. */
 	int decoder_state;
 
+	/** Objects reused by wait(): ints 0, 1, 0xff and attribute names. */
+	void *py_pin_ints[3];
+	void *py_samplenum_attr;
+	void *py_matched_attr;
+
+	/** Pin values currently stored in py_pinvalues. */
+	uint8_t *pin_values;
+
+	/** Copy of the wait() conditions which condition_list was built from. */
+	void *py_conds;
+
+	/** Input queue of a stacked instance running in its own thread. */
+	struct srd_stack_queue *stack_queue;
+
+	/** First exception of this stacked instance's decode(), or NULL. */
+	char *stack_error;
+
+	/** Work counters, and start of the current Python time interval. */
+	struct srd_inst_stats stats;
+	int64_t python_since;
+
+	/** Native implementation which replaces decode(), or NULL. */
+	const struct srd_native_decoder *native;
+	void *native_state;
+
+	/** Annotation types, indexed by annotation class. */
+	int *ann_types;
+	unsigned int num_ann_types;
+
+	/** Annotations put() by the PD, not yet handed to the frontend. */
+	struct srd_proto_data *ann_batch;
+	struct srd_proto_data_annotation *ann_batch_data;
+	unsigned int ann_batch_len;
+	/** Strings of the batch, and their offsets in it until delivered. */
+	GString *ann_batch_text;
+	GPtrArray *ann_batch_strv;
+
 	GCond got_new_samples_cond;
 	GCond handled_all_samples_cond;
 	GMutex data_mutex;
@@ -350,10 +427,13 @@ struct srd_proto_data_binary {
 
 typedef void (*srd_pd_output_callback)(struct srd_proto_data *pdata,
 					void *cb_data);
+typedef void (*srd_pd_output_batch_callback)(struct srd_proto_data *pdata,
+					unsigned int num, void *cb_data);
 
 struct srd_pd_callback {
 	int output_type;
 	srd_pd_output_callback cb;
+	srd_pd_output_batch_callback batch_cb;
 	void *cb_data;
 };
 
@@ -371,9 +451,16 @@ SRD_API int srd_session_send(struct srd_session *sess,
         uint64_t abs_start_samplenum, uint64_t abs_end_samplenum,
         const uint8_t **inbuf, const uint8_t *inbuf_const, uint64_t inbuflen, char **error);
 SRD_API int srd_session_terminate_reset(struct srd_session *sess);
+SRD_API int srd_session_interrupt(struct srd_session *sess);
+SRD_API int srd_session_pipeline_set(struct srd_session *sess,
+		unsigned int depth);
+SRD_API int srd_session_native_set(struct srd_session *sess,
+		gboolean enable);
 SRD_API int srd_session_destroy(struct srd_session *sess);
 SRD_API int srd_pd_output_callback_add(struct srd_session *sess,
 		int output_type, srd_pd_output_callback cb, void *cb_data);
+SRD_API int srd_pd_output_batch_callback_add(struct srd_session *sess,
+		int output_type, srd_pd_output_batch_callback cb, void *cb_data);
 
 /* decoder.c */
 SRD_API const GSList *srd_decoder_list(void);
@@ -397,6 +484,8 @@ SRD_API struct srd_decoder_inst *srd_inst_find_by_id(struct srd_session *sess,
 		const char *inst_id);
 SRD_API int srd_inst_initial_pins_set_all(struct srd_decoder_inst *di,
 		GArray *initial_pins);
+SRD_API int srd_inst_stats_get(const struct srd_decoder_inst *di,
+		struct srd_inst_stats *stats);
 
 /* log.c */
 typedef int (*srd_log_callback)(void *cb_data, int loglevel,
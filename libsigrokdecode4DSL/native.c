@@ -0,0 +1,352 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "libsigrokdecode-internal.h" /* First, so we avoid a _POSIX_C_SOURCE warning. */
+#include <string.h>
+
+/**
+ * @file
+ *
+ * Native implementations of protocol decoders.
+ */
+
+/**
+ * @defgroup grp_native Native decoders
+ *
+ * C implementations of frequently used protocol decoders.
+ *
+ * A native decoder has the same ID as a Python decoder, and replaces
+ * its decode() method. Everything else (options, channels, annotation
+ * classes and rows, start() and metadata()) comes from the Python
+ * class, and the native code must put() exactly the same annotations.
+ * The Python decoder is used when the instance has decoders stacked on
+ * top of it, when the frontend wants OUTPUT_PYTHON, OUTPUT_BINARY or
+ * OUTPUT_META data, or when the native code doesn't support the option
+ * values.
+ *
+ * @{
+ */
+
+static const struct srd_native_decoder *native_decoders[] = {
+	&srd_native_uart,
+	&srd_native_spi,
+	&srd_native_i2c,
+	NULL,
+};
+
+/**
+ * Select the native implementation of an instance, if there is one
+ * which can be used. Called from srd_inst_start() with the GIL held.
+ *
+ * @private
+ */
+SRD_PRIV void srd_native_start(struct srd_decoder_inst *di)
+{
+	const struct srd_native_decoder *native;
+	PyObject *py_options;
+	void *state;
+	int i;
+
+	srd_native_free(di);
+
+	if (!di->sess->native || di->next_di)
+		return;
+	if (srd_pd_output_callback_find(di->sess, SRD_OUTPUT_PYTHON) ||
+	    srd_pd_output_callback_find(di->sess, SRD_OUTPUT_BINARY) ||
+	    srd_pd_output_callback_find(di->sess, SRD_OUTPUT_META))
+		return;
+
+	native = NULL;
+	for (i = 0; native_decoders[i]; i++) {
+		if (!strcmp(native_decoders[i]->id, di->decoder->id)) {
+			native = native_decoders[i];
+			break;
+		}
+	}
+	if (!native)
+		return;
+
+	/* Options are a dict once srd_inst_option_set() ran. */
+	if (!(py_options = PyObject_GetAttrString(di->py_inst, "options"))) {
+		PyErr_Clear();
+		return;
+	}
+	i = PyDict_Check(py_options);
+	Py_DecRef(py_options);
+	if (!i)
+		return;
+
+	if (!(state = native->start(di))) {
+		srd_dbg("%s: Options not supported natively, using Python.",
+			di->inst_id);
+		return;
+	}
+
+	srd_dbg("%s: Using native decoder.", di->inst_id);
+	di->native = native;
+	di->native_state = state;
+}
+
+/** @private */
+SRD_PRIV void srd_native_free(struct srd_decoder_inst *di)
+{
+	if (di->native && di->native_state)
+		di->native->free(di->native_state);
+	di->native = NULL;
+	di->native_state = NULL;
+}
+
+static PyObject *native_option(struct srd_decoder_inst *di, const char *key)
+{
+	PyObject *py_options, *py_value;
+
+	if (!(py_options = PyObject_GetAttrString(di->py_inst, "options")))
+		return NULL;
+	py_value = PyDict_GetItemString(py_options, key);
+	Py_DecRef(py_options);
+
+	return py_value;
+}
+
+/**
+ * Get the value of a numeric option of an instance.
+ *
+ * @private
+ */
+SRD_PRIV int srd_native_option_double(struct srd_decoder_inst *di,
+		const char *key, double *out)
+{
+	PyObject *py_value;
+	PyGILState_STATE gstate;
+	int ret;
+
+	gstate = PyGILState_Ensure();
+
+	ret = SRD_ERR_PYTHON;
+	py_value = native_option(di, key);
+	if (py_value && (PyLong_Check(py_value) || PyFloat_Check(py_value))) {
+		*out = PyFloat_AsDouble(py_value);
+		ret = SRD_OK;
+	}
+	if (PyErr_Occurred()) {
+		PyErr_Clear();
+		ret = SRD_ERR_PYTHON;
+	}
+
+	PyGILState_Release(gstate);
+
+	return ret;
+}
+
+/**
+ * Get the value of a string option of an instance. The caller must
+ * g_free() it.
+ *
+ * @private
+ */
+SRD_PRIV int srd_native_option_str(struct srd_decoder_inst *di,
+		const char *key, char **out)
+{
+	PyObject *py_value;
+	PyGILState_STATE gstate;
+	int ret;
+
+	gstate = PyGILState_Ensure();
+
+	ret = SRD_ERR_PYTHON;
+	py_value = native_option(di, key);
+	if (py_value && PyUnicode_Check(py_value))
+		ret = py_str_as_str(py_value, out);
+	if (PyErr_Occurred())
+		PyErr_Clear();
+
+	PyGILState_Release(gstate);
+
+	return ret;
+}
+
+/**
+ * Get the samplerate the metadata() method of an instance received.
+ *
+ * @retval SRD_OK Upon success.
+ * @retval SRD_ERR The instance didn't get a samplerate.
+ *
+ * @private
+ */
+SRD_PRIV int srd_native_samplerate(struct srd_decoder_inst *di,
+		uint64_t *samplerate)
+{
+	PyObject *py_value;
+	PyGILState_STATE gstate;
+
+	gstate = PyGILState_Ensure();
+
+	*samplerate = 0;
+	if ((py_value = PyObject_GetAttrString(di->py_inst, "samplerate"))) {
+		if (PyLong_Check(py_value))
+			*samplerate = PyLong_AsUnsignedLongLong(py_value);
+		Py_DecRef(py_value);
+	}
+	if (PyErr_Occurred()) {
+		PyErr_Clear();
+		*samplerate = 0;
+	}
+
+	PyGILState_Release(gstate);
+
+	return *samplerate ? SRD_OK : SRD_ERR;
+}
+
+/**
+ * Get the first output of the given type an instance registered, or
+ * NULL when the frontend doesn't receive that output type.
+ *
+ * @private
+ */
+SRD_PRIV struct srd_pd_output *srd_native_output(struct srd_decoder_inst *di,
+		int output_type)
+{
+	struct srd_pd_output *pdo;
+	guint i;
+
+	if (!srd_pd_output_callback_find(di->sess, output_type))
+		return NULL;
+
+	for (i = 0; i < di->pd_output_array->len; i++) {
+		pdo = g_ptr_array_index(di->pd_output_array, i);
+		if (pdo->output_type == output_type)
+			return pdo;
+	}
+
+	return NULL;
+}
+
+/**
+ * Wait until one of the conditions in di->condition_list matches, the
+ * native counterpart of Decoder.wait(). Must be called without holding
+ * the GIL.
+ *
+ * Upon a match di->abs_cur_samplenum and di->match_array are set, and
+ * the pin values at the matching sample are stored in 'pins' (0xff for
+ * unused optional channels).
+ *
+ * @retval SRD_OK A condition matched.
+ * @retval SRD_ERR_TERM_REQ Termination was requested.
+ *
+ * @private
+ */
+SRD_PRIV int srd_native_wait(struct srd_decoder_inst *di, uint8_t *pins)
+{
+	gboolean found_match;
+	uint64_t offset;
+	int i;
+
+	if (di->want_wait_terminate)
+		return SRD_ERR_TERM_REQ;
+
+	while (TRUE) {
+		/* Wait for new samples to process, or termination request. */
+		g_mutex_lock(&di->data_mutex);
+		while (!di->got_new_samples && !di->want_wait_terminate)
+			g_cond_wait(&di->got_new_samples_cond, &di->data_mutex);
+
+		found_match = FALSE;
+		(void)process_samples_until_condition_match(di, &found_match);
+
+		if (found_match) {
+			/* Read the pins while the chunk is known to be valid. */
+			offset = di->abs_cur_samplenum - di->abs_start_samplenum;
+			for (i = 0; i < di->dec_num_channels; i++) {
+				if (di->dec_channelmap[i] == -1)
+					pins[i] = 0xff;
+				else if (!di->inbuf[i])
+					pins[i] = di->inbuf_const[i] ? 1 : 0;
+				else
+					pins[i] = (di->inbuf[i][offset / 8] >>
+						(offset % 8)) & 1;
+			}
+			g_mutex_unlock(&di->data_mutex);
+			di->stats.wait_returns++;
+			return SRD_OK;
+		}
+
+		srd_inst_deliver_annotations(di);
+
+		/* No match, reset state for the next chunk. */
+		di->got_new_samples = FALSE;
+		di->handled_all_samples = TRUE;
+		di->abs_start_samplenum = 0;
+		di->abs_end_samplenum = 0;
+		di->inbuf = NULL;
+		di->inbuflen = 0;
+
+		/* Signal the main thread that we handled all samples. */
+		g_cond_signal(&di->handled_all_samples_cond);
+
+		if (di->want_wait_terminate) {
+			g_mutex_unlock(&di->data_mutex);
+			return SRD_ERR_TERM_REQ;
+		}
+
+		g_mutex_unlock(&di->data_mutex);
+	}
+}
+
+/**
+ * Queue an annotation, like put() does for Python decoders.
+ *
+ * @param di The decoder instance.
+ * @param pdo The annotation output, from srd_native_output(). Nothing
+ *            is queued if it's NULL.
+ * @param start_sample The start sample of the annotation.
+ * @param end_sample The end sample of the annotation.
+ * @param ann_class The annotation class.
+ * @param ann_text NULL-terminated array of strings, which gets copied.
+ *
+ * @private
+ */
+SRD_PRIV void srd_native_put_ann(struct srd_decoder_inst *di,
+		struct srd_pd_output *pdo, uint64_t start_sample,
+		uint64_t end_sample, int ann_class, const char *const *ann_text)
+{
+	struct srd_proto_data *pdata;
+	struct srd_proto_data_annotation *pda;
+	unsigned int i;
+
+	di->stats.puts[SRD_OUTPUT_ANN]++;
+	if (!pdo)
+		return;
+
+	pdata = srd_inst_annotation_slot(di);
+	pdata->start_sample = start_sample;
+	pdata->end_sample = end_sample;
+	pdata->pdo = pdo;
+	pda = pdata->data;
+	pda->ann_class = ann_class;
+	pda->ann_type = di->ann_types[ann_class];
+	for (i = 0; ann_text[i]; i++)
+		srd_inst_annotation_text(di, ann_text[i], -1);
+	srd_inst_annotation_text(di, NULL, 0);
+
+	if (++di->ann_batch_len == SRD_ANN_BATCH_SIZE)
+		srd_inst_deliver_annotations(di);
+}
+
+/** @} */
@@ -0,0 +1,327 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Native implementation of the decode() method of decoders/1-i2c.
+ * It follows the Python code step by step, any change to the Python
+ * decoder's annotations has to be made here as well.
+ */
+
+#include "config.h"
+#include "../libsigrokdecode-internal.h" /* First, so we avoid a _POSIX_C_SOURCE warning. */
+#include <inttypes.h>
+#include <string.h>
+
+/* Decoder channels. */
+enum {
+	CH_SCL,
+	CH_SDA,
+};
+
+enum {
+	FIND_START,
+	FIND_ADDRESS,
+	FIND_DATA,
+	FIND_ACK,
+};
+
+/* Annotation classes. */
+enum {
+	ANN_START,
+	ANN_START_REPEAT,
+	ANN_STOP,
+	ANN_ACK,
+	ANN_NACK,
+	ANN_BIT,
+	ANN_ADDRESS_READ,
+	ANN_ADDRESS_WRITE,
+	ANN_DATA_READ,
+	ANN_DATA_WRITE,
+};
+
+struct i2c_options {
+	gboolean shifted;
+};
+
+struct i2c_bit {
+	int value;
+	int64_t ss;
+	int64_t es;
+};
+
+struct i2c_state {
+	struct srd_decoder_inst *di;
+	struct srd_pd_output *out_ann;
+	const struct i2c_options *options;
+	int state;
+	int64_t samplenum;
+	int64_t ss_byte;
+	int64_t bitwidth;
+	int bitcount;
+	unsigned int databyte;
+	int wr;
+	gboolean is_repeat_start;
+	/* Bits of the current byte in the order they were received. */
+	struct i2c_bit bits[8];
+};
+
+static const char *const ann_start[] = { "Start", "S", NULL };
+static const char *const ann_start_repeat[] = { "Start repeat", "Sr", NULL };
+static const char *const ann_stop[] = { "Stop", "P", NULL };
+static const char *const ann_ack[] = { "ACK", "A", NULL };
+static const char *const ann_nack[] = { "NACK", "N", NULL };
+static const char *const ann_write[] = { "Write", "Wr", "W", NULL };
+static const char *const ann_read[] = { "Read", "Rd", "R", NULL };
+static const char *const ann_bit_values[2][2] = {
+	{ "0", NULL },
+	{ "1", NULL },
+};
+
+/* Long and short names of the address and data annotations. */
+static const char *const cmd_names[][2] = {
+	[ANN_ADDRESS_READ] = { "Address read", "AR" },
+	[ANN_ADDRESS_WRITE] = { "Address write", "AW" },
+	[ANN_DATA_READ] = { "Data read", "DR" },
+	[ANN_DATA_WRITE] = { "Data write", "DW" },
+};
+
+static void *i2c_start(struct srd_decoder_inst *di)
+{
+	struct i2c_options *o;
+	char *address_format;
+
+	if (di->dec_num_channels != 2)
+		return NULL;
+
+	if (srd_native_option_str(di, "address_format", &address_format) != SRD_OK)
+		return NULL;
+
+	o = g_malloc0(sizeof(*o));
+	o->shifted = !strcmp(address_format, "shifted");
+	g_free(address_format);
+
+	return o;
+}
+
+static void i2c_free(void *state)
+{
+	g_free(state);
+}
+
+static void handle_start(struct i2c_state *s)
+{
+	srd_native_put_ann(s->di, s->out_ann, s->samplenum, s->samplenum,
+			s->is_repeat_start ? ANN_START_REPEAT : ANN_START,
+			s->is_repeat_start ? ann_start_repeat : ann_start);
+	s->state = FIND_ADDRESS;
+	s->bitcount = 0;
+	s->databyte = 0;
+	s->is_repeat_start = TRUE;
+	s->wr = -1;
+}
+
+/* Gather 8 bits of data, like handle_address_or_data() of the PD. */
+static void handle_address_or_data(struct i2c_state *s, int sda)
+{
+	char long_text[32], short_text[16], text[8];
+	const char *ann_text[4];
+	unsigned int d;
+	int ann_class, i;
+	int64_t es;
+
+	/* Address and data are transmitted MSB-first. */
+	s->databyte = (s->databyte << 1) | sda;
+
+	if (s->bitcount == 0)
+		s->ss_byte = s->samplenum;
+
+	s->bits[s->bitcount].value = sda;
+	s->bits[s->bitcount].ss = s->samplenum;
+	s->bits[s->bitcount].es = s->samplenum;
+	if (s->bitcount > 0)
+		s->bits[s->bitcount - 1].es = s->samplenum;
+	if (s->bitcount == 7) {
+		s->bitwidth = s->bits[6].es - s->bits[5].es;
+		s->bits[7].es += s->bitwidth;
+	}
+
+	if (s->bitcount < 7) {
+		s->bitcount++;
+		return;
+	}
+
+	d = s->databyte;
+	if (s->state == FIND_ADDRESS) {
+		/* The READ/WRITE bit is only in address bytes. */
+		s->wr = (s->databyte & 1) ? 0 : 1;
+		if (s->options->shifted)
+			d >>= 1;
+	}
+
+	if (s->state == FIND_ADDRESS)
+		ann_class = s->wr ? ANN_ADDRESS_WRITE : ANN_ADDRESS_READ;
+	else
+		ann_class = s->wr ? ANN_DATA_WRITE : ANN_DATA_READ;
+
+	/* The PD's list holds the last bit first. */
+	for (i = 7; i >= 0; i--) {
+		srd_native_put_ann(s->di, s->out_ann, s->bits[i].ss,
+				s->bits[i].es, ANN_BIT,
+				ann_bit_values[s->bits[i].value]);
+	}
+
+	es = s->samplenum + s->bitwidth;
+	if (s->state == FIND_ADDRESS) {
+		srd_native_put_ann(s->di, s->out_ann, s->samplenum,
+				s->samplenum + s->bitwidth, ann_class,
+				s->wr ? ann_write : ann_read);
+		es = s->samplenum;
+	}
+
+	g_snprintf(long_text, sizeof(long_text), "%s: %02X",
+			cmd_names[ann_class][0], d);
+	g_snprintf(short_text, sizeof(short_text), "%s: %02X",
+			cmd_names[ann_class][1], d);
+	g_snprintf(text, sizeof(text), "%02X", d);
+	ann_text[0] = long_text;
+	ann_text[1] = short_text;
+	ann_text[2] = text;
+	ann_text[3] = NULL;
+	srd_native_put_ann(s->di, s->out_ann, s->ss_byte, es, ann_class,
+			ann_text);
+
+	s->bitcount = 0;
+	s->databyte = 0;
+	s->state = FIND_ACK;
+}
+
+static void get_ack(struct i2c_state *s, int sda)
+{
+	srd_native_put_ann(s->di, s->out_ann, s->samplenum,
+			s->samplenum + s->bitwidth,
+			sda ? ANN_NACK : ANN_ACK, sda ? ann_nack : ann_ack);
+	s->state = FIND_DATA;
+}
+
+static void handle_stop(struct i2c_state *s)
+{
+	srd_native_put_ann(s->di, s->out_ann, s->samplenum, s->samplenum,
+			ANN_STOP, ann_stop);
+	s->state = FIND_START;
+	s->is_repeat_start = FALSE;
+	s->wr = -1;
+}
+
+static GSList *add_term(GSList *cond, int type, int channel)
+{
+	struct srd_term *term;
+
+	term = g_malloc0(sizeof(*term));
+	term->type = type;
+	term->channel = channel;
+
+	return g_slist_append(cond, term);
+}
+
+static void free_conditions(GSList *conds)
+{
+	GSList *l;
+
+	for (l = conds; l; l = l->next)
+		g_slist_free_full(l->data, g_free);
+	g_slist_free(conds);
+}
+
+static int i2c_decode(struct srd_decoder_inst *di, void *data)
+{
+	struct i2c_state s;
+	GSList *find_start, *find_bit, *find_ack;
+	uint8_t pins[2];
+	int ret;
+
+	memset(&s, 0, sizeof(s));
+	s.di = di;
+	s.out_ann = srd_native_output(di, SRD_OUTPUT_ANN);
+	s.options = data;
+	s.ss_byte = -1;
+	s.wr = -1;
+	s.state = FIND_START;
+
+	/*
+	 * The condition lists of the states, switched without rebuilding
+	 * them. A START condition is SCL high with SDA falling, a STOP
+	 * condition SCL high with SDA rising, bits are sampled on the
+	 * rising SCL edge.
+	 */
+	find_start = g_slist_append(NULL, add_term(
+			add_term(NULL, SRD_TERM_HIGH, CH_SCL),
+			SRD_TERM_FALLING_EDGE, CH_SDA));
+	find_bit = g_slist_append(NULL,
+			add_term(NULL, SRD_TERM_RISING_EDGE, CH_SCL));
+	find_bit = g_slist_append(find_bit, add_term(
+			add_term(NULL, SRD_TERM_HIGH, CH_SCL),
+			SRD_TERM_FALLING_EDGE, CH_SDA));
+	find_bit = g_slist_append(find_bit, add_term(
+			add_term(NULL, SRD_TERM_HIGH, CH_SCL),
+			SRD_TERM_RISING_EDGE, CH_SDA));
+	find_ack = g_slist_append(NULL,
+			add_term(NULL, SRD_TERM_RISING_EDGE, CH_SCL));
+	condition_list_free(di);
+
+	while (TRUE) {
+		if (s.state == FIND_START)
+			di->condition_list = find_start;
+		else if (s.state == FIND_ACK)
+			di->condition_list = find_ack;
+		else
+			di->condition_list = find_bit;
+
+		if ((ret = srd_native_wait(di, pins)) != SRD_OK)
+			break;
+		s.samplenum = di->abs_cur_samplenum;
+
+		if (s.state == FIND_START) {
+			handle_start(&s);
+		} else if (s.state == FIND_ACK) {
+			get_ack(&s, pins[CH_SDA]);
+		} else {
+			if (di->match_array & (1 << 0))
+				handle_address_or_data(&s, pins[CH_SDA]);
+			else if (di->match_array & (1 << 1))
+				handle_start(&s);
+			else if (di->match_array & (1 << 2))
+				handle_stop(&s);
+		}
+	}
+
+	/* The lists are owned here, not by the instance. */
+	di->condition_list = NULL;
+	free_conditions(find_start);
+	free_conditions(find_bit);
+	free_conditions(find_ack);
+
+	return ret;
+}
+
+SRD_PRIV const struct srd_native_decoder srd_native_i2c = {
+	.id = "1:i2c",
+	.start = i2c_start,
+	.decode = i2c_decode,
+	.free = i2c_free,
+};
@@ -0,0 +1,380 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Native implementation of the decode() method of decoders/1-spi.
+ * It follows the Python code step by step, any change to the Python
+ * decoder's annotations has to be made here as well.
+ */
+
+#include "config.h"
+#include "../libsigrokdecode-internal.h" /* First, so we avoid a _POSIX_C_SOURCE warning. */
+#include <inttypes.h>
+#include <string.h>
+
+/* Decoder channels. */
+enum {
+	CH_CLK,
+	CH_MISO,
+	CH_MOSI,
+	CH_CS,
+};
+
+/* Annotation classes. */
+enum {
+	ANN_MISO_DATA,
+	ANN_MOSI_DATA,
+	ANN_MISO_BITS,
+	ANN_MOSI_BITS,
+	ANN_WARNING,
+	ANN_MISO_TRANSFER,
+	ANN_MOSI_TRANSFER,
+};
+
+/* Data words are kept in 64 bits here. */
+#define MAX_WORDSIZE 64
+
+struct spi_options {
+	gboolean cs_active_low;
+	/* Sample on the rising clock edge (SPI mode 0 and 3). */
+	gboolean rising;
+	gboolean msb_first;
+	int wordsize;
+	gboolean frame;
+};
+
+struct spi_bit {
+	int value;
+	int64_t ss;
+	int64_t es;
+};
+
+struct spi_state {
+	struct srd_decoder_inst *di;
+	struct srd_pd_output *out_ann;
+	const struct spi_options *options;
+	gboolean have_miso;
+	gboolean have_mosi;
+	gboolean have_cs;
+	int64_t samplenum;
+	int64_t ss_block;
+	int64_t ss_transfer;
+	gboolean cs_was_deasserted;
+	int bitcount;
+	uint64_t misodata;
+	uint64_t mosidata;
+	/* Bits of the current word in the order they were received. */
+	struct spi_bit misobits[MAX_WORDSIZE];
+	struct spi_bit mosibits[MAX_WORDSIZE];
+	/* Data words of the current transfer, formatted like the PD does. */
+	GString *misobytes;
+	GString *mosibytes;
+};
+
+static const char *const ann_cs_deasserted[] = {
+	"CS# was deasserted during this data word!", NULL,
+};
+static const char *const ann_bit_values[2][2] = {
+	{ "0", NULL },
+	{ "1", NULL },
+};
+
+static void *spi_start(struct srd_decoder_inst *di)
+{
+	struct spi_options *o;
+	double cpol, cpha, wordsize;
+	char *cs_polarity, *bitorder, *frame;
+	void *ret;
+
+	/* Let the Python code raise its errors for missing channels. */
+	if (di->dec_num_channels != 4 || di->dec_channelmap[CH_CLK] == -1 ||
+	    (di->dec_channelmap[CH_MISO] == -1 &&
+	     di->dec_channelmap[CH_MOSI] == -1))
+		return NULL;
+
+	o = g_malloc0(sizeof(*o));
+	cs_polarity = bitorder = frame = NULL;
+	ret = NULL;
+
+	if (srd_native_option_double(di, "cpol", &cpol) != SRD_OK ||
+	    srd_native_option_double(di, "cpha", &cpha) != SRD_OK ||
+	    srd_native_option_double(di, "wordsize", &wordsize) != SRD_OK ||
+	    srd_native_option_str(di, "cs_polarity", &cs_polarity) != SRD_OK ||
+	    srd_native_option_str(di, "bitorder", &bitorder) != SRD_OK ||
+	    srd_native_option_str(di, "frame", &frame) != SRD_OK)
+		goto out;
+
+	/* The PD fails for other modes, and handles bigger words. */
+	if ((cpol != 0 && cpol != 1) || (cpha != 0 && cpha != 1) ||
+	    wordsize < 1 || wordsize > MAX_WORDSIZE ||
+	    wordsize != (int)wordsize)
+		goto out;
+
+	o->cs_active_low = !strcmp(cs_polarity, "active-low");
+	o->rising = cpol == cpha;
+	o->msb_first = !strcmp(bitorder, "msb-first");
+	o->wordsize = wordsize;
+	o->frame = !strcmp(frame, "yes");
+	ret = o;
+
+out:
+	g_free(cs_polarity);
+	g_free(bitorder);
+	g_free(frame);
+	if (!ret)
+		g_free(o);
+
+	return ret;
+}
+
+static void spi_free(void *state)
+{
+	g_free(state);
+}
+
+static gboolean cs_asserted(const struct spi_state *s, int cs)
+{
+	return s->options->cs_active_low ? cs == 0 : cs == 1;
+}
+
+/* Same as reset_decoder_state() of the Python decoder. */
+static void reset_decoder_state(struct spi_state *s)
+{
+	s->misodata = 0;
+	s->mosidata = 0;
+	s->bitcount = 0;
+}
+
+static void put_word(struct spi_state *s, int ann_class, uint64_t value)
+{
+	char buf[24];
+	const char *text[2];
+
+	g_snprintf(buf, sizeof(buf), "%02" PRIX64, value);
+	text[0] = buf;
+	text[1] = NULL;
+	srd_native_put_ann(s->di, s->out_ann, s->misobits[0].ss,
+			s->misobits[s->bitcount - 1].es, ann_class, text);
+}
+
+static void put_bits(struct spi_state *s, int ann_class,
+		const struct spi_bit *bits)
+{
+	int i;
+
+	/* The PD's list holds the last bit first. */
+	for (i = s->bitcount - 1; i >= 0; i--) {
+		srd_native_put_ann(s->di, s->out_ann, bits[i].ss, bits[i].es,
+				ann_class, ann_bit_values[bits[i].value]);
+	}
+}
+
+static void append_word(GString *transfer, uint64_t value)
+{
+	if (transfer->len)
+		g_string_append_c(transfer, ' ');
+	g_string_append_printf(transfer, "%02" PRIX64, value);
+}
+
+/* Same as putdata() of the Python decoder, without the other outputs. */
+static void putdata(struct spi_state *s)
+{
+	/* MISO and MOSI bits have the same sample numbers. */
+	if (!s->have_miso)
+		memcpy(s->misobits, s->mosibits,
+			s->bitcount * sizeof(struct spi_bit));
+
+	if (s->options->frame) {
+		if (s->have_miso)
+			append_word(s->misobytes, s->misodata);
+		if (s->have_mosi)
+			append_word(s->mosibytes, s->mosidata);
+	}
+
+	if (s->have_miso)
+		put_bits(s, ANN_MISO_BITS, s->misobits);
+	if (s->have_mosi)
+		put_bits(s, ANN_MOSI_BITS, s->mosibits);
+
+	if (s->have_miso)
+		put_word(s, ANN_MISO_DATA, s->misodata);
+	if (s->have_mosi)
+		put_word(s, ANN_MOSI_DATA, s->mosidata);
+}
+
+static void handle_bit(struct spi_state *s, const uint8_t *pins)
+{
+	const struct spi_options *o;
+	int shift;
+	int64_t es;
+
+	o = s->options;
+
+	if (s->bitcount == 0) {
+		s->ss_block = s->samplenum;
+		s->cs_was_deasserted = s->have_cs ?
+				!cs_asserted(s, pins[CH_CS]) : FALSE;
+	}
+
+	shift = o->msb_first ? o->wordsize - 1 - s->bitcount : s->bitcount;
+	if (s->have_miso)
+		s->misodata |= (uint64_t)pins[CH_MISO] << shift;
+	if (s->have_mosi)
+		s->mosidata |= (uint64_t)pins[CH_MOSI] << shift;
+
+	/* Guesstimate the end of this bit, the next one corrects it. */
+	es = s->samplenum;
+	if (s->bitcount > 0) {
+		es += s->samplenum - s->misobits[s->bitcount - 1].ss;
+		s->misobits[s->bitcount - 1].es = s->samplenum;
+		s->mosibits[s->bitcount - 1].es = s->samplenum;
+	}
+	s->misobits[s->bitcount].value = s->have_miso ? pins[CH_MISO] : 0;
+	s->misobits[s->bitcount].ss = s->samplenum;
+	s->misobits[s->bitcount].es = es;
+	s->mosibits[s->bitcount].value = s->have_mosi ? pins[CH_MOSI] : 0;
+	s->mosibits[s->bitcount].ss = s->samplenum;
+	s->mosibits[s->bitcount].es = es;
+
+	if (++s->bitcount != o->wordsize)
+		return;
+
+	putdata(s);
+
+	if (s->have_cs && s->cs_was_deasserted)
+		srd_native_put_ann(s->di, s->out_ann, s->ss_block, s->samplenum,
+				ANN_WARNING, ann_cs_deasserted);
+
+	reset_decoder_state(s);
+}
+
+static void put_transfer(struct spi_state *s, int ann_class,
+		GString *transfer)
+{
+	const char *text[2];
+
+	text[0] = transfer->str;
+	text[1] = NULL;
+	srd_native_put_ann(s->di, s->out_ann, s->ss_transfer, s->samplenum,
+			ann_class, text);
+}
+
+/* Same as find_clk_edge() of the Python decoder. */
+static void find_clk_edge(struct spi_state *s, const uint8_t *pins,
+		gboolean first)
+{
+	if (s->have_cs && (first || (s->di->match_array & (1 << 1)))) {
+		if (s->options->frame) {
+			if (cs_asserted(s, pins[CH_CS])) {
+				s->ss_transfer = s->samplenum;
+				g_string_truncate(s->misobytes, 0);
+				g_string_truncate(s->mosibytes, 0);
+			} else if (s->ss_transfer != -1) {
+				if (s->have_miso)
+					put_transfer(s, ANN_MISO_TRANSFER,
+						s->misobytes);
+				if (s->have_mosi)
+					put_transfer(s, ANN_MOSI_TRANSFER,
+						s->mosibytes);
+			}
+		}
+
+		/* Reset decoder state when CS# changes. */
+		reset_decoder_state(s);
+	}
+
+	/* Only samples while CS# is asserted are of interest. */
+	if (s->have_cs && !cs_asserted(s, pins[CH_CS]))
+		return;
+
+	if (first || !(s->di->match_array & (1 << 0)))
+		return;
+
+	handle_bit(s, pins);
+}
+
+static int spi_decode(struct srd_decoder_inst *di, void *data)
+{
+	struct spi_state *s;
+	struct srd_term *skip_term, *clk_term, *cs_term;
+	uint8_t pins[4];
+	int ret;
+
+	s = g_malloc0(sizeof(*s));
+	s->di = di;
+	s->out_ann = srd_native_output(di, SRD_OUTPUT_ANN);
+	s->options = data;
+	s->have_miso = di->dec_channelmap[CH_MISO] != -1;
+	s->have_mosi = di->dec_channelmap[CH_MOSI] != -1;
+	s->have_cs = di->dec_channelmap[CH_CS] != -1;
+	s->ss_block = -1;
+	s->ss_transfer = -1;
+	s->misobytes = g_string_new(NULL);
+	s->mosibytes = g_string_new(NULL);
+
+	/*
+	 * Like the PD's wait({}), grab the very first sample before
+	 * checking for edges.
+	 */
+	condition_list_free(di);
+	skip_term = g_malloc0(sizeof(*skip_term));
+	skip_term->type = SRD_TERM_SKIP;
+	di->condition_list = g_slist_append(NULL,
+			g_slist_append(NULL, skip_term));
+
+	if ((ret = srd_native_wait(di, pins)) != SRD_OK)
+		goto out;
+	s->samplenum = di->abs_cur_samplenum;
+	find_clk_edge(s, pins, TRUE);
+
+	/* Condition 0 is the sampling clock edge, 1 any CS# edge. */
+	condition_list_free(di);
+	clk_term = g_malloc0(sizeof(*clk_term));
+	clk_term->type = s->options->rising ?
+		SRD_TERM_RISING_EDGE : SRD_TERM_FALLING_EDGE;
+	clk_term->channel = CH_CLK;
+	di->condition_list = g_slist_append(NULL,
+			g_slist_append(NULL, clk_term));
+	if (s->have_cs) {
+		cs_term = g_malloc0(sizeof(*cs_term));
+		cs_term->type = SRD_TERM_EITHER_EDGE;
+		cs_term->channel = CH_CS;
+		di->condition_list = g_slist_append(di->condition_list,
+				g_slist_append(NULL, cs_term));
+	}
+
+	while ((ret = srd_native_wait(di, pins)) == SRD_OK) {
+		s->samplenum = di->abs_cur_samplenum;
+		find_clk_edge(s, pins, FALSE);
+	}
+
+out:
+	g_string_free(s->misobytes, TRUE);
+	g_string_free(s->mosibytes, TRUE);
+	g_free(s);
+
+	return ret;
+}
+
+SRD_PRIV const struct srd_native_decoder srd_native_spi = {
+	.id = "1:spi",
+	.start = spi_start,
+	.decode = spi_decode,
+	.free = spi_free,
+};
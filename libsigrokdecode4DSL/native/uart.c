@@ -0,0 +1,444 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Native implementation of the decode() method of decoders/1-uart.
+ * It follows the Python code step by step, any change to the Python
+ * decoder's annotations has to be made here as well.
+ */
+
+#include "config.h"
+#include "../libsigrokdecode-internal.h" /* First, so we avoid a _POSIX_C_SOURCE warning. */
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+enum {
+	PARITY_NONE,
+	PARITY_ODD,
+	PARITY_EVEN,
+	PARITY_ZERO,
+	PARITY_ONE,
+	/* Unknown values, parity_ok() returns None for them. */
+	PARITY_INVALID,
+};
+
+enum {
+	FORMAT_ASCII,
+	FORMAT_DEC,
+	FORMAT_HEX,
+	FORMAT_OCT,
+	FORMAT_BIN,
+	/* Unknown values, no data annotations are put. */
+	FORMAT_NONE,
+};
+
+enum {
+	WAIT_FOR_START_BIT,
+	GET_START_BIT,
+	GET_DATA_BITS,
+	GET_PARITY_BIT,
+	GET_STOP_BITS,
+};
+
+/* Annotation classes. */
+enum {
+	ANN_DATA,
+	ANN_START,
+	ANN_PARITY_OK,
+	ANN_PARITY_ERR,
+	ANN_STOP,
+	ANN_WARNING,
+	ANN_DATA_BIT,
+	ANN_BREAK,
+};
+
+struct uart_options {
+	double baudrate;
+	int num_data_bits;
+	int parity_type;
+	double num_stop_bits;
+	gboolean msb_first;
+	int format;
+	gboolean invert;
+};
+
+struct uart_state {
+	struct srd_decoder_inst *di;
+	struct srd_pd_output *out_ann;
+	const struct uart_options *options;
+	double bit_width;
+	int64_t samplenum;
+	int64_t frame_start;
+	int64_t startsample;
+	int state;
+	int cur_data_bit;
+	uint64_t datavalue;
+	/*
+	 * Data bits received since the last data value. Like in the Python
+	 * decoder these aren't cleared when a break interrupts a frame.
+	 */
+	uint64_t databits;
+	int num_databits;
+};
+
+static const char *const ann_frame_error[] = {
+	"Frame error", "Frame err", "FE", NULL,
+};
+static const char *const ann_start_bit[] = {
+	"Start bit", "Start", "S", NULL,
+};
+static const char *const ann_parity_bit[] = {
+	"Parity bit", "Parity", "P", NULL,
+};
+static const char *const ann_parity_error[] = {
+	"Parity error", "Parity err", "PE", NULL,
+};
+static const char *const ann_stop_bit[] = {
+	"Stop bit", "Stop", "T", NULL,
+};
+static const char *const ann_break[] = {
+	"Break condition", "Break", "Brk", "B", NULL,
+};
+static const char *const ann_bit_values[2][2] = {
+	{ "0", NULL },
+	{ "1", NULL },
+};
+
+static int option_index(const char *value, const char *const *values, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++) {
+		if (!strcmp(value, values[i]))
+			return i;
+	}
+
+	return num;
+}
+
+static void *uart_start(struct srd_decoder_inst *di)
+{
+	static const char *const parity_types[] = {
+		"none", "odd", "even", "zero", "one",
+	};
+	static const char *const formats[] = {
+		"ascii", "dec", "hex", "oct", "bin",
+	};
+	struct uart_options *o;
+	double num_data_bits;
+	char *parity_type, *bit_order, *format, *invert;
+	void *ret;
+
+	if (di->dec_num_channels != 1)
+		return NULL;
+
+	o = g_malloc0(sizeof(*o));
+	parity_type = bit_order = format = invert = NULL;
+	ret = NULL;
+
+	if (srd_native_option_double(di, "baudrate", &o->baudrate) != SRD_OK ||
+	    srd_native_option_double(di, "num_data_bits", &num_data_bits) != SRD_OK ||
+	    srd_native_option_double(di, "num_stop_bits", &o->num_stop_bits) != SRD_OK ||
+	    srd_native_option_str(di, "parity_type", &parity_type) != SRD_OK ||
+	    srd_native_option_str(di, "bit_order", &bit_order) != SRD_OK ||
+	    srd_native_option_str(di, "format", &format) != SRD_OK ||
+	    srd_native_option_str(di, "invert", &invert) != SRD_OK)
+		goto out;
+
+	/*
+	 * The decoder offers 5 to 9 data bits. Values are kept in 64 bits,
+	 * more than 32 data bits is taken as a bad option all the same.
+	 */
+	if (o->baudrate <= 0 || num_data_bits < 1 || num_data_bits > 32 ||
+	    num_data_bits != (int)num_data_bits)
+		goto out;
+
+	o->num_data_bits = num_data_bits;
+	o->parity_type = option_index(parity_type, parity_types,
+			G_N_ELEMENTS(parity_types));
+	o->msb_first = !strcmp(bit_order, "msb-first");
+	o->format = option_index(format, formats, G_N_ELEMENTS(formats));
+	o->invert = !strcmp(invert, "yes");
+	ret = o;
+
+out:
+	g_free(parity_type);
+	g_free(bit_order);
+	g_free(format);
+	g_free(invert);
+	if (!ret)
+		g_free(o);
+
+	return ret;
+}
+
+static void uart_free(void *state)
+{
+	g_free(state);
+}
+
+/* Put an annotation around the current sample, like putg() does. */
+static void putg(struct uart_state *s, int ann_class,
+		const char *const *ann_text)
+{
+	double halfbit;
+
+	halfbit = s->bit_width / 2.0;
+	srd_native_put_ann(s->di, s->out_ann,
+			s->samplenum - (int64_t)floor(halfbit),
+			s->samplenum + (int64_t)ceil(halfbit), ann_class, ann_text);
+}
+
+/* Put an annotation for all data bits, like putx() does. */
+static void putx(struct uart_state *s, int ann_class,
+		const char *const *ann_text)
+{
+	double halfbit;
+
+	halfbit = s->bit_width / 2.0;
+	srd_native_put_ann(s->di, s->out_ann,
+			s->startsample - (int64_t)floor(halfbit),
+			s->samplenum + (int64_t)ceil(halfbit), ann_class, ann_text);
+}
+
+/* Same as format_value() of the Python decoder. */
+static gboolean format_value(const struct uart_options *o, uint64_t v,
+		char *buf, size_t len)
+{
+	int i, digits;
+
+	switch (o->format) {
+	case FORMAT_ASCII:
+		if (v >= 32 && v <= 126)
+			g_snprintf(buf, len, "%c", (char)v);
+		else if (o->num_data_bits <= 8)
+			g_snprintf(buf, len, "[%02" PRIX64 "]", v);
+		else
+			g_snprintf(buf, len, "[%03" PRIX64 "]", v);
+		return TRUE;
+	case FORMAT_DEC:
+		g_snprintf(buf, len, "%" PRIu64, v);
+		return TRUE;
+	case FORMAT_HEX:
+		digits = (o->num_data_bits + 4 - 1) / 4;
+		g_snprintf(buf, len, "%0*" PRIX64, digits, v);
+		return TRUE;
+	case FORMAT_OCT:
+		digits = (o->num_data_bits + 3 - 1) / 3;
+		g_snprintf(buf, len, "%0*" PRIo64, digits, v);
+		return TRUE;
+	case FORMAT_BIN:
+		digits = o->num_data_bits;
+		while (digits < 64 && (v >> digits))
+			digits++;
+		for (i = 0; i < digits; i++)
+			buf[i] = (v >> (digits - 1 - i)) & 1 ? '1' : '0';
+		buf[i] = '\0';
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/* Same as parity_ok() of the Python decoder. */
+static gboolean parity_ok(int parity_type, int parity_bit, uint64_t data)
+{
+	int ones;
+
+	switch (parity_type) {
+	case PARITY_ZERO:
+		return parity_bit == 0;
+	case PARITY_ONE:
+		return parity_bit == 1;
+	case PARITY_ODD:
+	case PARITY_EVEN:
+		ones = parity_bit;
+		for (; data; data &= data - 1)
+			ones++;
+		return (ones % 2) == (parity_type == PARITY_ODD);
+	default:
+		return FALSE;
+	}
+}
+
+static void inspect_sample(struct uart_state *s, int signal)
+{
+	const struct uart_options *o;
+	char buf[72];
+	const char *text[2];
+
+	o = s->options;
+
+	switch (s->state) {
+	case WAIT_FOR_START_BIT:
+		s->frame_start = s->samplenum;
+		s->state = GET_START_BIT;
+		break;
+	case GET_START_BIT:
+		if (signal != 0) {
+			putg(s, ANN_WARNING, ann_frame_error);
+			s->state = WAIT_FOR_START_BIT;
+			break;
+		}
+		s->cur_data_bit = 0;
+		s->datavalue = 0;
+		s->startsample = -1;
+		putg(s, ANN_START, ann_start_bit);
+		s->state = GET_DATA_BITS;
+		break;
+	case GET_DATA_BITS:
+		if (s->startsample == -1)
+			s->startsample = s->samplenum;
+		putg(s, ANN_DATA_BIT, ann_bit_values[signal]);
+		if (o->msb_first)
+			s->databits = (s->databits << 1) | signal;
+		else if (s->num_databits < 64)
+			s->databits |= (uint64_t)signal << s->num_databits;
+		s->num_databits++;
+		if (++s->cur_data_bit < o->num_data_bits)
+			break;
+		s->datavalue = s->databits;
+		s->databits = 0;
+		s->num_databits = 0;
+		if (format_value(o, s->datavalue, buf, sizeof(buf))) {
+			text[0] = buf;
+			text[1] = NULL;
+			putx(s, ANN_DATA, text);
+		}
+		s->state = o->parity_type == PARITY_NONE ?
+				GET_STOP_BITS : GET_PARITY_BIT;
+		break;
+	case GET_PARITY_BIT:
+		if (parity_ok(o->parity_type, signal, s->datavalue))
+			putg(s, ANN_PARITY_OK, ann_parity_bit);
+		else
+			putg(s, ANN_PARITY_ERR, ann_parity_error);
+		s->state = GET_STOP_BITS;
+		break;
+	case GET_STOP_BITS:
+		if (signal != 1)
+			putg(s, ANN_WARNING, ann_frame_error);
+		/* The Python decoder uses the parity OK class here. */
+		putg(s, ANN_PARITY_OK, ann_stop_bit);
+		s->state = WAIT_FOR_START_BIT;
+		break;
+	}
+}
+
+static int uart_decode(struct srd_decoder_inst *di, void *data)
+{
+	const struct uart_options *o;
+	struct uart_state s;
+	struct srd_term *data_term, *edge_term;
+	uint64_t samplerate;
+	double frame_samples, bitpos;
+	int64_t break_min_sample_count, break_start, want_num;
+	int bitnum, ret, signal;
+	uint8_t pins[1];
+
+	o = data;
+
+	if (srd_native_samplerate(di, &samplerate) != SRD_OK) {
+		srd_err("Protocol decoder instance %s: "
+			"Cannot decode without samplerate.", di->inst_id);
+		return SRD_ERR;
+	}
+
+	memset(&s, 0, sizeof(s));
+	s.di = di;
+	s.out_ann = srd_native_output(di, SRD_OUTPUT_ANN);
+	s.options = o;
+	s.bit_width = (double)samplerate / o->baudrate;
+	s.frame_start = -1;
+	s.startsample = -1;
+	s.state = WAIT_FOR_START_BIT;
+
+	/* A period of low signal as long as a frame is a break condition. */
+	frame_samples = 1 + o->num_data_bits +
+			(o->parity_type == PARITY_NONE ? 0 : 1);
+	frame_samples += o->num_stop_bits;
+	frame_samples *= s.bit_width;
+	break_min_sample_count = ceil(frame_samples);
+	break_start = -1;
+
+	/* Condition 0 is a bit's sample point or start bit, 1 any edge. */
+	condition_list_free(di);
+	data_term = g_malloc0(sizeof(*data_term));
+	edge_term = g_malloc0(sizeof(*edge_term));
+	edge_term->type = SRD_TERM_EITHER_EDGE;
+	di->condition_list = g_slist_append(NULL,
+			g_slist_append(NULL, data_term));
+	di->condition_list = g_slist_append(di->condition_list,
+			g_slist_append(NULL, edge_term));
+
+	while (TRUE) {
+		if (s.state == WAIT_FOR_START_BIT) {
+			data_term->type = o->invert ?
+				SRD_TERM_RISING_EDGE : SRD_TERM_FALLING_EDGE;
+		} else {
+			bitnum = 0;
+			if (s.state == GET_DATA_BITS)
+				bitnum = 1 + s.cur_data_bit;
+			else if (s.state == GET_PARITY_BIT)
+				bitnum = 1 + o->num_data_bits;
+			else if (s.state == GET_STOP_BITS)
+				bitnum = 1 + o->num_data_bits +
+					(o->parity_type == PARITY_NONE ? 0 : 1);
+			bitpos = s.frame_start + (s.bit_width - 1) / 2.0;
+			bitpos += bitnum * s.bit_width;
+			want_num = ceil(bitpos);
+			data_term->type = SRD_TERM_SKIP;
+			data_term->num_samples_to_skip = want_num - s.samplenum;
+			data_term->num_samples_already_skipped = di->abs_cur_matched ?
+				(data_term->num_samples_to_skip != 0) : 0;
+		}
+
+		if ((ret = srd_native_wait(di, pins)) != SRD_OK)
+			return ret;
+
+		s.samplenum = di->abs_cur_samplenum;
+		signal = o->invert ? !pins[0] : pins[0];
+
+		if (di->match_array & (1 << 0))
+			inspect_sample(&s, signal);
+
+		/* Edges are inspected independently to detect breaks. */
+		if (di->match_array & (1 << 1)) {
+			if (!signal) {
+				break_start = s.samplenum;
+			} else if (break_start != -1) {
+				if (s.samplenum - break_start >= break_min_sample_count) {
+					srd_native_put_ann(di, s.out_ann,
+						s.frame_start, s.samplenum,
+						ANN_BREAK, ann_break);
+					s.state = WAIT_FOR_START_BIT;
+				}
+				break_start = -1;
+			}
+		}
+	}
+}
+
+SRD_PRIV const struct srd_native_decoder srd_native_uart = {
+	.id = "1:uart",
+	.start = uart_start,
+	.decode = uart_decode,
+	.free = uart_free,
+};
@@ -66,6 +66,8 @@ SRD_API int srd_session_new(struct srd_session **sess)
 	*sess = g_malloc(sizeof(struct srd_session));
 	(*sess)->session_id = ++max_session_id;
 	(*sess)->di_list = (*sess)->callbacks = NULL;
+	(*sess)->pipeline_depth = 0;
+	(*sess)->native = TRUE;
 
 	/* Keep a list of all sessions, so we can clean up as needed. */
 	sessions = g_slist_append(sessions, *sess);
@@ -317,6 +319,91 @@ SRD_API int srd_session_terminate_reset(struct srd_session *sess)
 	return SRD_OK;
 }
 
+/**
+ * Interrupt decoding in a session.
+ *
+ * Unlike srd_session_terminate_reset() this doesn't wait for the
+ * decoders, and may be called from another thread while
+ * srd_session_send() is running, which then returns SRD_ERR_TERM_REQ
+ * instead of finishing its chunk. The session has to be reset or
+ * destroyed afterwards.
+ *
+ * @param sess The session. Must not be NULL.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ */
+SRD_API int srd_session_interrupt(struct srd_session *sess)
+{
+	GSList *d;
+
+	if (!sess)
+		return SRD_ERR_ARG;
+
+	for (d = sess->di_list; d; d = d->next)
+		srd_inst_interrupt(d->data);
+
+	return SRD_OK;
+}
+
+/**
+ * Run stacked decoders in their own threads.
+ *
+ * By default the decode() method of a stacked decoder is called from
+ * the put() of the decoder below it, so a whole stack runs in one
+ * thread. In pipelined mode every stacked decoder instance gets a
+ * thread which takes the lower decoder's OUTPUT_PYTHON data from a
+ * queue, and the lower decoder keeps working while it's processed.
+ * srd_session_send() still returns only after all decoders of the
+ * stack processed the chunk.
+ *
+ * The data objects are passed by reference, so this may only be used
+ * with decoders which don't modify objects after they put() them.
+ *
+ * Must be called before srd_session_start().
+ *
+ * @param sess The session. Must not be NULL.
+ * @param depth Maximum number of queued objects per stacked decoder,
+ *              0 runs stacked decoders inline.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ */
+SRD_API int srd_session_pipeline_set(struct srd_session *sess,
+		unsigned int depth)
+{
+	if (!sess)
+		return SRD_ERR_ARG;
+
+	sess->pipeline_depth = depth;
+
+	return SRD_OK;
+}
+
+/**
+ * Enable or disable native decoder implementations.
+ *
+ * Some protocol decoders have native implementations which replace
+ * the decode() method of the Python code, and put the same
+ * annotations. They're used by default where possible. Disabling them
+ * runs the Python decoders, e.g. to compare the output of both.
+ *
+ * Must be called before srd_session_start().
+ *
+ * @param sess The session. Must not be NULL.
+ * @param enable TRUE to use native implementations where available.
+ *
+ * @return SRD_OK upon success, a (negative) error code otherwise.
+ */
+SRD_API int srd_session_native_set(struct srd_session *sess,
+		gboolean enable)
+{
+	if (!sess)
+		return SRD_ERR_ARG;
+
+	sess->native = enable;
+
+	return SRD_OK;
+}
+
 /**
  * Destroy a decoding session.
  *
@@ -375,7 +462,7 @@ SRD_API int srd_pd_output_callback_add(struct srd_session *sess,
 	srd_dbg("Registering new callback for output type %s.",
 		output_type_name(output_type));
 
-	pd_cb = g_malloc(sizeof(struct srd_pd_callback));
+	pd_cb = g_malloc0(sizeof(struct srd_pd_callback));
 	pd_cb->output_type = output_type;
 	pd_cb->cb = cb;
 	pd_cb->cb_data = cb_data;
@@ -384,6 +471,42 @@ SRD_API int srd_pd_output_callback_add(struct srd_session *sess,
 	return SRD_OK;
 }
 
+/**
+ * Register/add a decoder output callback function which receives
+ * annotations in batches.
+ *
+ * Decoder instances queue the annotations their PD puts, and hand
+ * them over once per input chunk (or when the queue fills up), so the
+ * frontend can store a whole batch while taking its locks only once.
+ * The records and their strings are only valid during the callback.
+ *
+ * @param sess The output session in which to register the callback.
+ *             Must not be NULL.
+ * @param output_type The output type this callback will receive. Only
+ *                    SRD_OUTPUT_ANN is supported.
+ * @param cb The function to call. Must not be NULL.
+ * @param cb_data Private data for the callback function. Can be NULL.
+ */
+SRD_API int srd_pd_output_batch_callback_add(struct srd_session *sess,
+		int output_type, srd_pd_output_batch_callback cb, void *cb_data)
+{
+	struct srd_pd_callback *pd_cb;
+
+	if (!sess || !cb || output_type != SRD_OUTPUT_ANN)
+		return SRD_ERR_ARG;
+
+	srd_dbg("Registering new batch callback for output type %s.",
+		output_type_name(output_type));
+
+	pd_cb = g_malloc0(sizeof(struct srd_pd_callback));
+	pd_cb->output_type = output_type;
+	pd_cb->batch_cb = cb;
+	pd_cb->cb_data = cb_data;
+	sess->callbacks = g_slist_append(sess->callbacks, pd_cb);
+
+	return SRD_OK;
+}
+
 /** @private */
 SRD_PRIV struct srd_pd_callback *srd_pd_output_callback_find(
 		struct srd_session *sess, int output_type)
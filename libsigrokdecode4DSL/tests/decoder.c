@@ -148,6 +148,37 @@ START_TEST(test_load_nonexisting_pd_dir)
 }
 END_TEST
 
+/*
+ * Check whether a second srd_decoder_load_all(), served from the
+ * metadata cache, lists the same decoders and can still instantiate them.
+ */
+START_TEST(test_load_all_cached)
+{
+	struct srd_session *sess;
+	struct srd_decoder *dec;
+	guint num_decoders, num_annotations;
+
+	srd_init(DECODERS_TESTDIR);
+	srd_decoder_load_all();
+	num_decoders = g_slist_length((GSList *)srd_decoder_list());
+	dec = srd_decoder_get_by_id("uart");
+	fail_unless(dec != NULL);
+	num_annotations = g_slist_length(dec->annotations);
+	srd_exit();
+
+	srd_init(DECODERS_TESTDIR);
+	srd_decoder_load_all();
+	fail_unless(g_slist_length((GSList *)srd_decoder_list()) == num_decoders);
+	dec = srd_decoder_get_by_id("uart");
+	fail_unless(dec != NULL);
+	fail_unless(g_slist_length(dec->annotations) == num_annotations);
+	srd_session_new(&sess);
+	fail_unless(srd_inst_new(sess, "uart", NULL) != NULL);
+	fail_unless(dec->py_dec != NULL);
+	srd_exit();
+}
+END_TEST
+
 /*
  * Check whether srd_decoder_unload_all() works.
  * If it returns != SRD_OK (or segfaults) this test will fail.
@@ -425,6 +456,7 @@ Suite *suite_decoder(void)
 	tcase_add_checked_fixture(tc, srdtest_setup, srdtest_teardown);
 	tcase_add_test(tc, test_load_all);
 	tcase_add_test(tc, test_load_all_no_init);
+	tcase_add_test(tc, test_load_all_cached);
 	tcase_add_test(tc, test_load);
 	tcase_add_test(tc, test_load_bogus);
 	tcase_add_test(tc, test_load_valid_and_bogus);
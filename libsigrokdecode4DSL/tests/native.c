@@ -0,0 +1,577 @@
+/*
+ * This file is part of the libsigrokdecode project.
+ *
+ * Copyright (C) 2022 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <libsigrokdecode.h> /* First, to avoid compiler warning. */
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include "lib.h"
+
+#define SAMPLERATE 1000000
+#define NUM_SAMPLES 8192
+#define MAX_CHANNELS 4
+
+#define UART_BAUDRATE 115200
+
+/* Set samples [from, to) of a channel. */
+static void set_level(uint8_t *buf, double from, double to, int level)
+{
+	uint64_t i;
+
+	for (i = (uint64_t)from; i < (uint64_t)to && i < NUM_SAMPLES; i++) {
+		if (level)
+			buf[i / 8] |= 1 << (i % 8);
+		else
+			buf[i / 8] &= ~(1 << (i % 8));
+	}
+}
+
+/* Set a channel from 'pos' to the end, later changes override it. */
+static void change(uint8_t *buf, double pos, int level)
+{
+	set_level(buf, pos, NUM_SAMPLES, level);
+}
+
+static int last_level(const uint8_t *buf)
+{
+	return (buf[(NUM_SAMPLES - 1) / 8] >> ((NUM_SAMPLES - 1) % 8)) & 1;
+}
+
+static GHashTable *options_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+}
+
+static void option_set(GHashTable *options, const char *key, GVariant *value)
+{
+	g_hash_table_insert(options, (char *)key, g_variant_ref_sink(value));
+}
+
+static void append_annotation(struct srd_proto_data *pdata, void *cb_data)
+{
+	struct srd_proto_data_annotation *pda;
+	GString *s;
+	char *text;
+
+	s = cb_data;
+	pda = pdata->data;
+	text = g_strjoinv("|", pda->ann_text);
+	g_string_append_printf(s, "%" PRIu64 "-%" PRIu64 " %d %d %s\n",
+		pdata->start_sample, pdata->end_sample, pda->ann_class,
+		pda->ann_type, text);
+	g_free(text);
+}
+
+/*
+ * Decode the channels in 'bufs' with decoder 'id', return the
+ * annotations. 'channels' maps the connected channels, all of them
+ * are used when it's NULL.
+ */
+static GString *decode(const char *id, GHashTable *options,
+		GHashTable *channels, uint8_t bufs[][NUM_SAMPLES / 8],
+		gboolean native)
+{
+	struct srd_session *sess;
+	struct srd_decoder_inst *di;
+	GString *s;
+	const uint8_t *inbuf[MAX_CHANNELS];
+	uint8_t inbuf_const[MAX_CHANNELS];
+	char *error;
+	int i, ret;
+
+	s = g_string_new(NULL);
+	error = NULL;
+
+	srd_session_new(&sess);
+	srd_session_native_set(sess, native);
+	srd_pd_output_callback_add(sess, SRD_OUTPUT_ANN, append_annotation, s);
+	di = srd_inst_new(sess, id, options);
+	fail_unless(di != NULL, "srd_inst_new() failed.");
+	fail_unless(di->dec_num_channels <= MAX_CHANNELS);
+	if (channels) {
+		ret = srd_inst_channel_set_all(di, channels);
+		fail_unless(ret == SRD_OK, "srd_inst_channel_set_all() failed.");
+	}
+	srd_session_metadata_set(sess, SRD_CONF_SAMPLERATE,
+			g_variant_new_uint64(SAMPLERATE));
+	ret = srd_session_start(sess, NULL);
+	fail_unless(ret == SRD_OK, "srd_session_start() failed: %d.", ret);
+	fail_unless((di->native != NULL) == native,
+			"Native decoder %sused.", native ? "not " : "");
+
+	/* A chunk of sample data, followed by a constant one. */
+	for (i = 0; i < di->dec_num_channels; i++) {
+		inbuf[i] = bufs[i];
+		inbuf_const[i] = 0;
+	}
+	ret = srd_session_send(sess, 0, NUM_SAMPLES, inbuf, inbuf_const,
+			NUM_SAMPLES / 8, &error);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	for (i = 0; i < di->dec_num_channels; i++) {
+		inbuf[i] = NULL;
+		inbuf_const[i] = last_level(bufs[i]);
+	}
+	ret = srd_session_send(sess, NUM_SAMPLES, 2 * NUM_SAMPLES, inbuf,
+			inbuf_const, NUM_SAMPLES / 8, &error);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+
+	srd_session_destroy(sess);
+	g_free(error);
+
+	return s;
+}
+
+/* Check that the native and the Python decoder put the same annotations. */
+static void check_native(const char *id, GHashTable *options,
+		GHashTable *channels, uint8_t bufs[][NUM_SAMPLES / 8],
+		const char *config)
+{
+	GString *native, *python;
+
+	python = decode(id, options, channels, bufs, FALSE);
+	native = decode(id, options, channels, bufs, TRUE);
+
+	fail_unless(python->len > 0, "No annotations (%s).", config);
+	fail_unless(!strcmp(native->str, python->str),
+		"Annotations differ (%s):\n%s\n%s", config, native->str,
+		python->str);
+
+	g_string_free(native, TRUE);
+	g_string_free(python, TRUE);
+}
+
+struct uart_config {
+	int num_data_bits;
+	/* 'n'one, 'o'dd or 'e'ven. */
+	char parity;
+	gboolean invert;
+	const char *format;
+};
+
+/*
+ * Put a frame at 'pos', return the position after the stop bit.
+ * 'parity_error' flips the parity bit, 'stop' is the stop bit level.
+ */
+static double put_frame(uint8_t *buf, double pos,
+		const struct uart_config *c, unsigned int value,
+		gboolean parity_error, int stop)
+{
+	double bit_width;
+	int i, ones;
+
+	bit_width = (double)SAMPLERATE / UART_BAUDRATE;
+	set_level(buf, pos, pos + bit_width, c->invert);
+	pos += bit_width;
+	ones = 0;
+	for (i = 0; i < c->num_data_bits; i++) {
+		ones += (value >> i) & 1;
+		set_level(buf, pos, pos + bit_width,
+			((value >> i) & 1) ^ c->invert);
+		pos += bit_width;
+	}
+	if (c->parity != 'n') {
+		/* The bit which makes the number of ones odd or even. */
+		i = (ones % 2) ^ (c->parity == 'o') ^ parity_error;
+		set_level(buf, pos, pos + bit_width, i ^ c->invert);
+		pos += bit_width;
+	}
+	set_level(buf, pos, pos + bit_width, stop ^ c->invert);
+
+	return pos + bit_width;
+}
+
+/* Put valid frames, errors, a glitch and a break condition. */
+static void put_uart_frames(uint8_t *buf, const struct uart_config *c)
+{
+	unsigned int mask;
+	double pos;
+
+	mask = (1 << c->num_data_bits) - 1;
+	memset(buf, c->invert ? 0x00 : 0xff, NUM_SAMPLES / 8);
+	pos = put_frame(buf, 100, c, 0x55 & mask, FALSE, 1);
+	pos = put_frame(buf, pos + 20, c, 'A' & mask, FALSE, 1);
+	pos = put_frame(buf, pos, c, 0x1a3 & mask, FALSE, 1);
+	pos = put_frame(buf, pos, c, mask, FALSE, 1);
+	/* Parity error (where there is parity), then a missing stop bit. */
+	pos = put_frame(buf, pos + 50, c, 0x0f & mask, TRUE, 1);
+	pos = put_frame(buf, pos + 50, c, 0x81 & mask, FALSE, 0);
+	/* Glitch, seen as a start bit which is idle at its sample point. */
+	set_level(buf, pos + 100, pos + 102, c->invert);
+	/* Break condition, with the line active for about two frames. */
+	set_level(buf, pos + 300, pos + 550, c->invert);
+	put_frame(buf, pos + 750, c, 0x7e & mask, FALSE, 1);
+	/* A frame which continues in the second chunk. */
+	put_frame(buf, NUM_SAMPLES - 40, c, 0x12 & mask, FALSE, 1);
+}
+
+static void check_native_uart(const struct uart_config *c)
+{
+	uint8_t bufs[1][NUM_SAMPLES / 8];
+	GHashTable *options;
+	char *config;
+
+	put_uart_frames(bufs[0], c);
+
+	options = options_new();
+	option_set(options, "baudrate", g_variant_new_int64(UART_BAUDRATE));
+	option_set(options, "num_data_bits",
+		g_variant_new_int64(c->num_data_bits));
+	option_set(options, "parity_type", g_variant_new_string(
+		c->parity == 'n' ? "none" : c->parity == 'o' ? "odd" : "even"));
+	option_set(options, "invert",
+		g_variant_new_string(c->invert ? "yes" : "no"));
+	option_set(options, "format", g_variant_new_string(c->format));
+	config = g_strdup_printf("%d%c1, invert %d, %s", c->num_data_bits,
+		c->parity, c->invert, c->format);
+
+	check_native("1:uart", options, NULL, bufs, config);
+
+	g_free(config);
+	g_hash_table_destroy(options);
+}
+
+/*
+ * Check whether the native UART decoder puts the same annotations as
+ * the Python one, for valid frames, parity and frame errors, a glitch
+ * and a break condition.
+ */
+START_TEST(test_native_uart)
+{
+	static const struct uart_config c = { 8, 'e', FALSE, "hex" };
+
+	srd_init(DECODERS_TESTDIR);
+	srd_decoder_load("1-uart");
+	check_native_uart(&c);
+	srd_exit();
+}
+END_TEST
+
+/*
+ * Same as above, for all data bit counts from 5 to 9, without and
+ * with odd parity, inverted signals and the ASCII and decimal formats.
+ */
+START_TEST(test_native_uart_options)
+{
+	static const char parities[] = { 'n', 'o' };
+	static const char *const formats[] = { "ascii", "dec" };
+	struct uart_config c;
+	unsigned int p, f;
+
+	srd_init(DECODERS_TESTDIR);
+	srd_decoder_load("1-uart");
+	for (c.num_data_bits = 5; c.num_data_bits <= 9; c.num_data_bits++) {
+		for (p = 0; p < G_N_ELEMENTS(parities); p++) {
+			for (c.invert = FALSE; c.invert <= TRUE; c.invert++) {
+				for (f = 0; f < G_N_ELEMENTS(formats); f++) {
+					c.parity = parities[p];
+					c.format = formats[f];
+					check_native_uart(&c);
+				}
+			}
+		}
+	}
+	srd_exit();
+}
+END_TEST
+
+/* SPI channels, in the order of the decoder. */
+enum {
+	SPI_CLK,
+	SPI_MISO,
+	SPI_MOSI,
+	SPI_CS,
+};
+
+#define SPI_PERIOD 10
+
+struct spi_config {
+	int mode;
+	gboolean cs_active_low;
+	int wordsize;
+	gboolean msb_first;
+};
+
+/*
+ * Clock 'num_bits' bits of a word at 'pos' out, return the position
+ * after the last bit.
+ */
+static int put_spi_word(uint8_t bufs[][NUM_SAMPLES / 8], int pos,
+		const struct spi_config *c, int num_bits, unsigned int mosi,
+		unsigned int miso)
+{
+	int cpol, cpha, i, bit;
+
+	cpol = c->mode >> 1;
+	cpha = c->mode & 1;
+	for (i = 0; i < num_bits; i++) {
+		bit = c->msb_first ? c->wordsize - 1 - i : i;
+		/* Data is valid around the sampling edge. */
+		set_level(bufs[SPI_MOSI], pos + cpha * 5, pos + cpha * 5 +
+			SPI_PERIOD, (mosi >> bit) & 1);
+		set_level(bufs[SPI_MISO], pos + cpha * 5, pos + cpha * 5 +
+			SPI_PERIOD, (miso >> bit) & 1);
+		set_level(bufs[SPI_CLK], pos + 5, pos + SPI_PERIOD, !cpol);
+		pos += SPI_PERIOD;
+	}
+
+	return pos;
+}
+
+static void put_spi_transfers(uint8_t bufs[][NUM_SAMPLES / 8],
+		const struct spi_config *c)
+{
+	int i, pos, cs;
+
+	cs = c->cs_active_low ? 0 : 1;
+	memset(bufs[SPI_CLK], (c->mode >> 1) ? 0xff : 0x00, NUM_SAMPLES / 8);
+	memset(bufs[SPI_MISO], 0x00, NUM_SAMPLES / 8);
+	memset(bufs[SPI_MOSI], 0x00, NUM_SAMPLES / 8);
+	memset(bufs[SPI_CS], cs ? 0x00 : 0xff, NUM_SAMPLES / 8);
+
+	/* Two transfers of three words. */
+	pos = 100;
+	for (i = 0; i < 2; i++) {
+		change(bufs[SPI_CS], pos - 7, cs);
+		pos = put_spi_word(bufs, pos, c, c->wordsize, 0xa55 + i, 0x3c);
+		pos = put_spi_word(bufs, pos + 20, c, c->wordsize, 0x0ff, 0x801);
+		pos = put_spi_word(bufs, pos, c, c->wordsize, 0x123 << i, 0xfed);
+		change(bufs[SPI_CS], pos + 7, !cs);
+		pos += 100;
+	}
+
+	/* A word cut short by CS#, then a transfer without words. */
+	change(bufs[SPI_CS], pos - 7, cs);
+	pos = put_spi_word(bufs, pos, c, c->wordsize / 2, 0xfff, 0x555);
+	change(bufs[SPI_CS], pos + 7, !cs);
+	change(bufs[SPI_CS], pos + 50, cs);
+	change(bufs[SPI_CS], pos + 80, !cs);
+
+	/* A transfer which continues in the second chunk. */
+	change(bufs[SPI_CS], NUM_SAMPLES - 100, cs);
+	put_spi_word(bufs, NUM_SAMPLES - 90, c, c->wordsize, 0x5a, 0xa5);
+}
+
+static GHashTable *spi_channels(gboolean miso, gboolean cs)
+{
+	GHashTable *channels;
+
+	channels = options_new();
+	option_set(channels, "clk", g_variant_new_int32(SPI_CLK));
+	if (miso)
+		option_set(channels, "miso", g_variant_new_int32(SPI_MISO));
+	option_set(channels, "mosi", g_variant_new_int32(SPI_MOSI));
+	if (cs)
+		option_set(channels, "cs", g_variant_new_int32(SPI_CS));
+
+	return channels;
+}
+
+/*
+ * Check whether the native SPI decoder puts the same annotations as
+ * the Python one, for all modes, word sizes, bit orders, with and
+ * without transfer annotations, and without the MISO or CS# channel.
+ */
+START_TEST(test_native_spi)
+{
+	static const int wordsizes[] = { 8, 12 };
+	uint8_t bufs[MAX_CHANNELS][NUM_SAMPLES / 8];
+	struct spi_config c;
+	GHashTable *options, *channels[3];
+	gboolean frame;
+	char *config;
+	unsigned int w, ch;
+
+	channels[0] = spi_channels(TRUE, TRUE);
+	channels[1] = spi_channels(FALSE, TRUE);
+	channels[2] = spi_channels(TRUE, FALSE);
+
+	srd_init(DECODERS_TESTDIR);
+	srd_decoder_load("1-spi");
+	for (c.mode = 0; c.mode < 4; c.mode++) {
+		/* Active-high CS# for the odd modes. */
+		c.cs_active_low = !(c.mode & 1);
+		for (w = 0; w < G_N_ELEMENTS(wordsizes); w++) {
+			c.wordsize = wordsizes[w];
+			c.msb_first = c.wordsize == 8;
+			put_spi_transfers(bufs, &c);
+			for (frame = FALSE; frame <= TRUE; frame++) {
+				options = options_new();
+				option_set(options, "cs_polarity",
+					g_variant_new_string(c.cs_active_low ?
+						"active-low" : "active-high"));
+				option_set(options, "cpol",
+					g_variant_new_int64(c.mode >> 1));
+				option_set(options, "cpha",
+					g_variant_new_int64(c.mode & 1));
+				option_set(options, "bitorder",
+					g_variant_new_string(c.msb_first ?
+						"msb-first" : "lsb-first"));
+				option_set(options, "wordsize",
+					g_variant_new_int64(c.wordsize));
+				option_set(options, "frame",
+					g_variant_new_string(frame ? "yes" : "no"));
+				for (ch = 0; ch < G_N_ELEMENTS(channels); ch++) {
+					config = g_strdup_printf("mode %d, "
+						"wordsize %d, frame %d, "
+						"channels %u", c.mode,
+						c.wordsize, frame, ch);
+					check_native("1:spi", options,
+						channels[ch], bufs, config);
+					g_free(config);
+				}
+				g_hash_table_destroy(options);
+			}
+		}
+	}
+	srd_exit();
+
+	for (ch = 0; ch < G_N_ELEMENTS(channels); ch++)
+		g_hash_table_destroy(channels[ch]);
+}
+END_TEST
+
+/* I2C channels, in the order of the decoder. */
+enum {
+	I2C_SCL,
+	I2C_SDA,
+};
+
+#define I2C_PERIOD 10
+
+/* START condition, or repeated START after a bit, at 'pos'. */
+static int put_i2c_start(uint8_t bufs[][NUM_SAMPLES / 8], int pos)
+{
+	change(bufs[I2C_SDA], pos, 1);
+	change(bufs[I2C_SCL], pos + 2, 1);
+	change(bufs[I2C_SDA], pos + 5, 0);
+	change(bufs[I2C_SCL], pos + 8, 0);
+
+	return pos + I2C_PERIOD;
+}
+
+static int put_i2c_bits(uint8_t bufs[][NUM_SAMPLES / 8], int pos,
+		unsigned int value, int num_bits)
+{
+	int i;
+
+	/* MSB first, SDA changes while SCL is low. */
+	for (i = num_bits - 1; i >= 0; i--) {
+		change(bufs[I2C_SDA], pos + 1, (value >> i) & 1);
+		change(bufs[I2C_SCL], pos + 3, 1);
+		change(bufs[I2C_SCL], pos + 7, 0);
+		pos += I2C_PERIOD;
+	}
+
+	return pos;
+}
+
+/* A byte, followed by the ACK (0) or NACK (1) bit. */
+static int put_i2c_byte(uint8_t bufs[][NUM_SAMPLES / 8], int pos,
+		unsigned int value, int nack)
+{
+	pos = put_i2c_bits(bufs, pos, value, 8);
+
+	return put_i2c_bits(bufs, pos, nack, 1);
+}
+
+static int put_i2c_stop(uint8_t bufs[][NUM_SAMPLES / 8], int pos)
+{
+	change(bufs[I2C_SDA], pos + 1, 0);
+	change(bufs[I2C_SCL], pos + 3, 1);
+	change(bufs[I2C_SDA], pos + 6, 1);
+
+	return pos + I2C_PERIOD;
+}
+
+/*
+ * Check whether the native I2C decoder puts the same annotations as
+ * the Python one, for writes, reads, NACKs, a repeated START and a
+ * byte interrupted by a STOP condition, with both address formats.
+ */
+START_TEST(test_native_i2c)
+{
+	static const char *const address_formats[] = {
+		"shifted", "unshifted",
+	};
+	uint8_t bufs[MAX_CHANNELS][NUM_SAMPLES / 8];
+	GHashTable *options;
+	unsigned int i;
+	int pos;
+
+	memset(bufs, 0xff, sizeof(bufs));
+	pos = put_i2c_start(bufs, 100);
+	pos = put_i2c_byte(bufs, pos, 0x50 << 1, 0);
+	pos = put_i2c_byte(bufs, pos, 0x12, 0);
+	pos = put_i2c_byte(bufs, pos, 0x34, 1);
+	pos = put_i2c_start(bufs, pos);
+	pos = put_i2c_byte(bufs, pos, (0x50 << 1) | 1, 0);
+	pos = put_i2c_byte(bufs, pos, 0xa5, 0);
+	pos = put_i2c_byte(bufs, pos, 0x5a, 1);
+	pos = put_i2c_stop(bufs, pos);
+
+	pos = put_i2c_start(bufs, pos + 100);
+	pos = put_i2c_bits(bufs, pos, 0x0b, 4);
+	pos = put_i2c_stop(bufs, pos);
+	pos = put_i2c_start(bufs, pos + 100);
+	pos = put_i2c_stop(bufs, pos);
+
+	/* A transfer which continues in the second chunk. */
+	pos = put_i2c_start(bufs, NUM_SAMPLES - 60);
+	put_i2c_byte(bufs, pos, 0x3c << 1, 0);
+
+	srd_init(DECODERS_TESTDIR);
+	srd_decoder_load("1-i2c");
+	for (i = 0; i < G_N_ELEMENTS(address_formats); i++) {
+		options = options_new();
+		option_set(options, "address_format",
+			g_variant_new_string(address_formats[i]));
+		check_native("1:i2c", options, NULL, bufs, address_formats[i]);
+		g_hash_table_destroy(options);
+	}
+	srd_exit();
+}
+END_TEST
+
+Suite *suite_native(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("native");
+
+	tc = tcase_create("uart");
+	tcase_add_checked_fixture(tc, srdtest_setup, srdtest_teardown);
+	tcase_add_test(tc, test_native_uart);
+	tcase_add_test(tc, test_native_uart_options);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("spi");
+	tcase_add_checked_fixture(tc, srdtest_setup, srdtest_teardown);
+	tcase_add_test(tc, test_native_spi);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("i2c");
+	tcase_add_checked_fixture(tc, srdtest_setup, srdtest_teardown);
+	tcase_add_test(tc, test_native_i2c);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
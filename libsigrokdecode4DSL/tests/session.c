@@ -22,6 +22,7 @@
 #include <libsigrokdecode.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include "lib.h"
 
@@ -260,6 +261,239 @@ START_TEST(test_session_reset_nodata)
 }
 END_TEST
 
+/*
+ * Check whether srd_session_pipeline_set() works, and whether a
+ * pipelined session can be started, reset and destroyed without
+ * decoders.
+ */
+START_TEST(test_session_pipeline_set)
+{
+	struct srd_session *sess;
+	int ret;
+
+	srd_init(NULL);
+	ret = srd_session_pipeline_set(NULL, 16);
+	fail_unless(ret != SRD_OK, "NULL session accepted.");
+	srd_session_new(&sess);
+	ret = srd_session_pipeline_set(sess, 16);
+	fail_unless(ret == SRD_OK, "srd_session_pipeline_set() failed: %d.", ret);
+	ret = srd_session_start(sess, NULL);
+	fail_unless(ret == SRD_OK, "srd_session_start() failed: %d.", ret);
+	ret = srd_session_terminate_reset(sess);
+	fail_unless(ret == SRD_OK, "srd_session_terminate_reset() failed: %d.", ret);
+	ret = srd_session_destroy(sess);
+	fail_unless(ret == SRD_OK, "srd_session_destroy() failed: %d.", ret);
+	srd_exit();
+}
+END_TEST
+
+#define STACK_SAMPLERATE 1000000
+#define STACK_BAUDRATE 31250
+#define STACK_SAMPLES 8192
+
+/* Put an 8N1 frame at 'pos', return the position after the stop bit. */
+static uint64_t put_frame(uint8_t *buf, uint64_t pos, unsigned int value)
+{
+	uint64_t i, bit_width;
+	unsigned int bits;
+
+	bit_width = STACK_SAMPLERATE / STACK_BAUDRATE;
+	/* Start bit, data bits LSB first, stop bit. */
+	bits = (value << 1) | (1 << 9);
+	for (i = 0; i < 10 * bit_width; i++, pos++) {
+		if ((bits >> (i / bit_width)) & 1)
+			buf[pos / 8] |= 1 << (pos % 8);
+		else
+			buf[pos / 8] &= ~(1 << (pos % 8));
+	}
+
+	return pos;
+}
+
+struct stack_result {
+	struct srd_decoder_inst *top;
+	GString *s;
+};
+
+static void append_top_annotation(struct srd_proto_data *pdata,
+		void *cb_data)
+{
+	struct stack_result *r;
+	struct srd_proto_data_annotation *pda;
+	char *text;
+
+	r = cb_data;
+	if (pdata->pdo->di != r->top)
+		return;
+	pda = pdata->data;
+	text = g_strjoinv("|", pda->ann_text);
+	g_string_append_printf(r->s, "%" PRIu64 "-%" PRIu64 " %d %s\n",
+		pdata->start_sample, pdata->end_sample, pda->ann_class, text);
+	g_free(text);
+}
+
+/*
+ * Decode 'buf' with 'top_id' stacked on 1:uart, return the annotations
+ * of the upper decoder, and the result of srd_session_send().
+ */
+static GString *decode_stacked(const uint8_t *buf, const char *top_id,
+		unsigned int depth, int *ret_send, char **error)
+{
+	struct srd_session *sess;
+	struct srd_decoder_inst *di;
+	struct stack_result r;
+	GHashTable *options;
+	const uint8_t *inbuf[1];
+	uint8_t inbuf_const[1];
+	int ret;
+
+	r.s = g_string_new(NULL);
+
+	srd_session_new(&sess);
+	ret = srd_session_pipeline_set(sess, depth);
+	fail_unless(ret == SRD_OK, "srd_session_pipeline_set() failed: %d.", ret);
+	srd_pd_output_callback_add(sess, SRD_OUTPUT_ANN,
+			append_top_annotation, &r);
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "baudrate",
+			g_variant_ref_sink(g_variant_new_int64(STACK_BAUDRATE)));
+	di = srd_inst_new(sess, "1:uart", options);
+	g_hash_table_destroy(options);
+	fail_unless(di != NULL, "srd_inst_new() failed.");
+	r.top = srd_inst_new(sess, top_id, NULL);
+	fail_unless(r.top != NULL, "srd_inst_new() failed.");
+	ret = srd_inst_stack(sess, di, r.top);
+	fail_unless(ret == SRD_OK, "srd_inst_stack() failed: %d.", ret);
+	srd_session_metadata_set(sess, SRD_CONF_SAMPLERATE,
+			g_variant_new_uint64(STACK_SAMPLERATE));
+	ret = srd_session_start(sess, NULL);
+	fail_unless(ret == SRD_OK, "srd_session_start() failed: %d.", ret);
+	fail_unless((r.top->stack_queue != NULL) == (depth != 0),
+			"Stacked decoder %sin its own thread.",
+			depth ? "not " : "");
+
+	inbuf[0] = buf;
+	inbuf_const[0] = 0;
+	*ret_send = srd_session_send(sess, 0, STACK_SAMPLES, inbuf,
+			inbuf_const, STACK_SAMPLES / 8, error);
+
+	srd_session_destroy(sess);
+
+	return r.s;
+}
+
+/*
+ * Check whether a pipelined stack (midi on top of uart) puts the same
+ * annotations as the same stack running inline.
+ */
+START_TEST(test_session_pipeline_stacked)
+{
+	static const unsigned int bytes[] = {
+		0x90, 0x3c, 0x40, 0x3e, 0x40, 0x80, 0x3c, 0x00, 0xf8,
+	};
+	uint8_t buf[STACK_SAMPLES / 8];
+	GString *inline_ann, *pipelined_ann;
+	uint64_t pos;
+	unsigned int i;
+	char *error;
+	int ret;
+
+	memset(buf, 0xff, sizeof(buf));
+	pos = 100;
+	for (i = 0; i < G_N_ELEMENTS(bytes); i++)
+		pos = put_frame(buf, pos + 10, bytes[i]);
+
+	srd_init(DECODERS_TESTDIR);
+	srd_decoder_load("1-uart");
+	srd_decoder_load("midi");
+	error = NULL;
+	inline_ann = decode_stacked(buf, "midi", 0, &ret, &error);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	pipelined_ann = decode_stacked(buf, "midi", 4, &ret, &error);
+	fail_unless(ret == SRD_OK, "srd_session_send() failed: %d.", ret);
+	srd_exit();
+
+	fail_unless(inline_ann->len > 0, "No annotations.");
+	fail_unless(!strcmp(inline_ann->str, pipelined_ann->str),
+		"Annotations differ:\n%s\n%s", inline_ann->str,
+		pipelined_ann->str);
+
+	g_string_free(inline_ann, TRUE);
+	g_string_free(pipelined_ann, TRUE);
+	g_free(error);
+}
+END_TEST
+
+/*
+ * Check whether an exception in the decode() of a stacked decoder fails
+ * srd_session_send(), inline and pipelined. A logic decoder stacked on
+ * uart has a decode() which takes no sample data, so every call raises.
+ */
+START_TEST(test_session_pipeline_stacked_error)
+{
+	uint8_t buf[STACK_SAMPLES / 8];
+	GString *ann;
+	unsigned int depth;
+	char *error;
+	int ret;
+
+	memset(buf, 0xff, sizeof(buf));
+	put_frame(buf, 100, 0x55);
+
+	srd_init(DECODERS_TESTDIR);
+	srd_decoder_load("1-uart");
+	srd_decoder_load("0-uart");
+	for (depth = 0; depth <= 4; depth += 4) {
+		error = NULL;
+		ann = decode_stacked(buf, "0:uart", depth, &ret, &error);
+		fail_unless(ret == SRD_ERR_PYTHON,
+			"srd_session_send() returned %d, depth %u.", ret, depth);
+		fail_unless(error != NULL, "No error message, depth %u.", depth);
+		g_string_free(ann, TRUE);
+		g_free(error);
+	}
+	srd_exit();
+}
+END_TEST
+
+static void dummy_batch_callback(struct srd_proto_data *pdata,
+		unsigned int num, void *cb_data)
+{
+	(void)pdata;
+	(void)num;
+	(void)cb_data;
+}
+
+/*
+ * Check whether srd_pd_output_batch_callback_add() accepts annotation
+ * callbacks, and fails with invalid input.
+ */
+START_TEST(test_session_batch_callback_add)
+{
+	struct srd_session *sess;
+	int ret;
+
+	srd_init(NULL);
+	srd_session_new(&sess);
+	ret = srd_pd_output_batch_callback_add(NULL, SRD_OUTPUT_ANN,
+			dummy_batch_callback, NULL);
+	fail_unless(ret != SRD_OK, "NULL session accepted.");
+	ret = srd_pd_output_batch_callback_add(sess, SRD_OUTPUT_ANN,
+			NULL, NULL);
+	fail_unless(ret != SRD_OK, "NULL callback accepted.");
+	ret = srd_pd_output_batch_callback_add(sess, SRD_OUTPUT_BINARY,
+			dummy_batch_callback, NULL);
+	fail_unless(ret != SRD_OK, "Batched binary output accepted.");
+	ret = srd_pd_output_batch_callback_add(sess, SRD_OUTPUT_ANN,
+			dummy_batch_callback, NULL);
+	fail_unless(ret == SRD_OK, "srd_pd_output_batch_callback_add() "
+			"failed: %d.", ret);
+	srd_session_destroy(sess);
+	srd_exit();
+}
+END_TEST
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -280,11 +514,19 @@ Suite *suite_session(void)
 	tcase_add_checked_fixture(tc, srdtest_setup, srdtest_teardown);
 	tcase_add_test(tc, test_session_metadata_set);
 	tcase_add_test(tc, test_session_metadata_set_bogus);
+	tcase_add_test(tc, test_session_batch_callback_add);
+	tcase_add_test(tc, test_session_pipeline_set);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("reset");
 	tcase_add_test(tc, test_session_reset_nodata);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("pipeline");
+	tcase_add_checked_fixture(tc, srdtest_setup, srdtest_teardown);
+	tcase_add_test(tc, test_session_pipeline_stacked);
+	tcase_add_test(tc, test_session_pipeline_stacked_error);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -29,6 +29,8 @@ extern SRD_PRIV GSList *sessions;
 
 typedef struct {
         PyObject_HEAD
+        /* The instance this object belongs to, saves tree walks. */
+        struct srd_decoder_inst *di;
 } srd_Decoder;
 
 /* This is only used for nicer srd_dbg() output. */
@@ -45,12 +47,48 @@ SRD_PRIV const char *output_type_name(unsigned int idx)
 	return names[MIN(idx, G_N_ELEMENTS(names) - 1)];
 }
 
-static void release_annotation(struct srd_proto_data_annotation *pda)
+/*
+ * Add the strings of a Python sequence to the annotation being queued,
+ * see srd_inst_annotation_text(). Nothing is added on failure.
+ */
+static int queue_annotation_text(struct srd_decoder_inst *di,
+		PyObject *py_strseq)
 {
-	if (!pda)
-		return;
-	if (pda->ann_text)
-		g_strfreev(pda->ann_text);
+	PyObject *py_item, *py_bytes;
+	char *str;
+	Py_ssize_t seq_len, len, i;
+	const guint strv_len = di->ann_batch_strv->len;
+	const gsize text_len = di->ann_batch_text->len;
+
+	if (!PySequence_Check(py_strseq) ||
+	    (seq_len = PySequence_Size(py_strseq)) < 0)
+		goto err;
+
+	for (i = 0; i < seq_len; i++) {
+		if (!(py_item = PySequence_GetItem(py_strseq, i)))
+			goto err;
+		py_bytes = PyUnicode_Check(py_item) ?
+			PyUnicode_AsUTF8String(py_item) : NULL;
+		Py_DECREF(py_item);
+		if (!py_bytes)
+			goto err;
+		if (PyBytes_AsStringAndSize(py_bytes, &str, &len) == -1) {
+			Py_DECREF(py_bytes);
+			goto err;
+		}
+		srd_inst_annotation_text(di, str, len);
+		Py_DECREF(py_bytes);
+	}
+	srd_inst_annotation_text(di, NULL, 0);
+
+	return SRD_OK;
+
+err:
+	g_ptr_array_set_size(di->ann_batch_strv, strv_len);
+	g_string_truncate(di->ann_batch_text, text_len);
+	srd_exception_catch(NULL, "Failed to obtain string item");
+
+	return SRD_ERR_PYTHON;
 }
 
 static int convert_annotation(struct srd_decoder_inst *di, PyObject *obj,
@@ -59,8 +97,6 @@ static int convert_annotation(struct srd_decoder_inst *di, PyObject *obj,
 	PyObject *py_tmp;
 	struct srd_proto_data_annotation *pda;
 	unsigned int ann_class;
-    char **ann_text;
-	gpointer ann_type_ptr;
 	PyGILState_STATE gstate;
 
 	gstate = PyGILState_Ensure();
@@ -96,12 +132,11 @@ static int convert_annotation(struct srd_decoder_inst *di, PyObject *obj,
 //			"annotation class %d.", di->decoder->name, ann_class);
 //		return SRD_ERR_PYTHON;
 //	}
-	if (ann_class >= g_slist_length(di->decoder->ann_types)) {
+	if (ann_class >= di->num_ann_types) {
 		srd_err("Protocol decoder %s submitted data to unregistered "
 			"annotation class %d.", di->decoder->name, ann_class);
 		goto err;
 	}
-	ann_type_ptr = g_slist_nth_data(di->decoder->ann_types, ann_class);
 
 	/* Second element must be a list. */
 	py_tmp = PyList_GetItem(obj, 1);
@@ -110,7 +145,7 @@ static int convert_annotation(struct srd_decoder_inst *di, PyObject *obj,
 			"second element was not a list.", di->decoder->name);
 		goto err;
 	}
-    if (py_strseq_to_char(py_tmp, &ann_text) != SRD_OK) {
+    if (queue_annotation_text(di, py_tmp) != SRD_OK) {
         srd_err("Protocol decoder %s submitted annotation list, but "
             "second element was malformed.", di->decoder->name);
         goto err;
@@ -118,8 +153,7 @@ static int convert_annotation(struct srd_decoder_inst *di, PyObject *obj,
 
 	pda = pdata->data;
 	pda->ann_class = ann_class;
-	pda->ann_type = GPOINTER_TO_INT(ann_type_ptr);
-    pda->ann_text = ann_text;
+	pda->ann_type = di->ann_types[ann_class];
 
 	PyGILState_Release(gstate);
 
@@ -273,6 +307,159 @@ static inline struct srd_decoder_inst *srd_inst_find_by_obj(
 	return di;
 }
 
+/** @private */
+SRD_PRIV void srd_Decoder_set_inst(PyObject *obj, struct srd_decoder_inst *di)
+{
+	((srd_Decoder *)obj)->di = di;
+}
+
+static inline struct srd_decoder_inst *decoder_inst(PyObject *self)
+{
+	struct srd_decoder_inst *di;
+
+	if ((di = ((srd_Decoder *)self)->di))
+		return di;
+
+	return srd_inst_find_by_obj(NULL, self);
+}
+
+/**
+ * Hand the queued annotations of an instance (and the instances stacked
+ * on top of it) to the frontend. Must be called with the GIL held.
+ *
+ * @private
+ */
+SRD_PRIV void srd_inst_flush_annotations(struct srd_decoder_inst *di)
+{
+	GSList *l;
+
+	/* Stacked instances with their own thread flush themselves. */
+	for (l = di->next_di; l; l = l->next) {
+		if (!((struct srd_decoder_inst *)l->data)->stack_queue)
+			srd_inst_flush_annotations(l->data);
+	}
+
+	if (!di->ann_batch_len)
+		return;
+
+	Py_BEGIN_ALLOW_THREADS
+	srd_inst_deliver_annotations(di);
+	Py_END_ALLOW_THREADS
+}
+
+/**
+ * Hand the queued annotations of an instance to the frontend. Unlike
+ * srd_inst_flush_annotations() this doesn't need the GIL, and doesn't
+ * handle stacked instances.
+ *
+ * @private
+ */
+SRD_PRIV void srd_inst_deliver_annotations(struct srd_decoder_inst *di)
+{
+	struct srd_pd_callback *cb;
+	unsigned int i, num;
+
+	gpointer *strv;
+	unsigned int j;
+
+	if (!(num = di->ann_batch_len))
+		return;
+	di->ann_batch_len = 0;
+
+	/* The text buffer is complete, turn the offsets into strings. */
+	strv = di->ann_batch_strv->pdata;
+	for (i = 0, j = 0; i < num; i++, j++) {
+		di->ann_batch_data[i].ann_text = (char **)&strv[j];
+		for (; strv[j]; j++)
+			strv[j] = di->ann_batch_text->str +
+				GPOINTER_TO_SIZE(strv[j]) - 1;
+	}
+
+	cb = srd_pd_output_callback_find(di->sess, SRD_OUTPUT_ANN);
+
+	if (cb && cb->batch_cb) {
+		cb->batch_cb(di->ann_batch, num, cb->cb_data);
+	} else if (cb) {
+		for (i = 0; i < num; i++)
+			cb->cb(&di->ann_batch[i], cb->cb_data);
+	}
+	for (i = 0; i < num; i++)
+		di->ann_batch_data[i].ann_text = NULL;
+	g_ptr_array_set_size(di->ann_batch_strv, 0);
+	g_string_truncate(di->ann_batch_text, 0);
+}
+
+/**
+ * Get the next free entry of an instance's annotation batch. The caller
+ * fills it in, and increments ann_batch_len.
+ *
+ * @private
+ */
+SRD_PRIV struct srd_proto_data *srd_inst_annotation_slot(
+		struct srd_decoder_inst *di)
+{
+	unsigned int i;
+
+	if (!di->ann_batch) {
+		di->ann_batch = g_malloc0(SRD_ANN_BATCH_SIZE * sizeof(*di->ann_batch));
+		di->ann_batch_data = g_malloc0(SRD_ANN_BATCH_SIZE *
+				sizeof(*di->ann_batch_data));
+		for (i = 0; i < SRD_ANN_BATCH_SIZE; i++)
+			di->ann_batch[i].data = &di->ann_batch_data[i];
+		di->ann_batch_text = g_string_sized_new(SRD_ANN_BATCH_SIZE * 32);
+		di->ann_batch_strv = g_ptr_array_sized_new(SRD_ANN_BATCH_SIZE * 4);
+	}
+
+	return &di->ann_batch[di->ann_batch_len];
+}
+
+/**
+ * Add a string to the annotation being queued, in the slot from
+ * srd_inst_annotation_slot(). The strings of a batch share one buffer,
+ * which may move while it grows, so they are kept by offset until the
+ * batch is delivered. A NULL str ends the strings of the annotation.
+ *
+ * @param len Length of str, or -1 if it's NUL-terminated.
+ *
+ * @private
+ */
+SRD_PRIV void srd_inst_annotation_text(struct srd_decoder_inst *di,
+		const char *str, gssize len)
+{
+	if (!str) {
+		g_ptr_array_add(di->ann_batch_strv, NULL);
+		return;
+	}
+
+	/* Offset + 1, NULL is the end of an annotation's strings. */
+	g_ptr_array_add(di->ann_batch_strv,
+			GSIZE_TO_POINTER(di->ann_batch_text->len + 1));
+	g_string_append_len(di->ann_batch_text, str,
+			len < 0 ? (gssize)strlen(str) : len);
+	g_string_append_c(di->ann_batch_text, '\0');
+}
+
+/* Queue an annotation, it's handed to the frontend in batches. */
+static void queue_annotation(struct srd_decoder_inst *di, PyObject *obj,
+		struct srd_proto_data *proto)
+{
+	struct srd_proto_data *pdata;
+
+	pdata = srd_inst_annotation_slot(di);
+	pdata->start_sample = proto->start_sample;
+	pdata->end_sample = proto->end_sample;
+	pdata->pdo = proto->pdo;
+
+	/* Convert from PyDict to srd_proto_data_annotation. */
+	if (convert_annotation(di, obj, pdata) != SRD_OK) {
+		/* An error was already logged. */
+		return;
+	}
+
+	if (++di->ann_batch_len == SRD_ANN_BATCH_SIZE)
+		srd_inst_flush_annotations(di);
+}
+
 static int convert_meta(struct srd_proto_data *pdata, PyObject *obj)
 {
 	long long intvalue;
@@ -327,18 +514,18 @@ static PyObject *Decoder_put(PyObject *self, PyObject *args)
 	struct srd_decoder_inst *di, *next_di;
 	struct srd_pd_output *pdo;
 	struct srd_proto_data pdata;
-	struct srd_proto_data_annotation pda;
 	struct srd_proto_data_binary pdb;
 	uint64_t start_sample, end_sample;
 	int output_id;
 	struct srd_pd_callback *cb;
+	int64_t call_start, call_time;
 	PyGILState_STATE gstate;
 
 	py_data = NULL;
 
 	gstate = PyGILState_Ensure();
 
-	if (!(di = srd_inst_find_by_obj(NULL, self))) {
+	if (!(di = decoder_inst(self))) {
 		/* Shouldn't happen. */
 		srd_dbg("put(): self instance not found.");
 		goto err;
@@ -354,12 +541,14 @@ static PyObject *Decoder_put(PyObject *self, PyObject *args)
 		goto err;
 	}
 
-	if (!(l = g_slist_nth(di->pd_output, output_id))) {
+	if (output_id < 0 || (guint)output_id >= di->pd_output_array->len) {
 		srd_err("Protocol decoder %s submitted invalid output ID %d.",
 			di->decoder->name, output_id);
 		goto err;
 	}
-	pdo = l->data;
+	pdo = g_ptr_array_index(di->pd_output_array, output_id);
+	if ((guint)pdo->output_type < G_N_ELEMENTS(di->stats.puts))
+		di->stats.puts[pdo->output_type]++;
 
 	/* Upon SRD_OUTPUT_PYTHON for stacked PDs, we have a nicer log message later. */
 	if (pdo->output_type != SRD_OUTPUT_PYTHON && di->next_di != NULL) {
@@ -377,18 +566,8 @@ static PyObject *Decoder_put(PyObject *self, PyObject *args)
 	switch (pdo->output_type) {
 	case SRD_OUTPUT_ANN:
 		/* Annotations are only fed to callbacks. */
-		if ((cb = srd_pd_output_callback_find(di->sess, pdo->output_type))) {
-			pdata.data = &pda;
-			/* Convert from PyDict to srd_proto_data_annotation. */
-			if (convert_annotation(di, py_data, &pdata) != SRD_OK) {
-				/* An error was already logged. */
-				break;
-			}
-			Py_BEGIN_ALLOW_THREADS
-			cb->cb(&pdata, cb->cb_data);
-			Py_END_ALLOW_THREADS
-			release_annotation(pdata.data);
-		}
+		if (srd_pd_output_callback_find(di->sess, pdo->output_type))
+			queue_annotation(di, py_data, &pdata);
 		break;
 
     case SRD_OUTPUT_PYTHON:
@@ -399,13 +578,21 @@ static PyObject *Decoder_put(PyObject *self, PyObject *args)
                  start_sample,
                  end_sample, output_type_name(pdo->output_type),
                  output_id, pdo->proto_id, next_di->inst_id);
+            if (next_di->stack_queue) {
+                srd_inst_stack_push(next_di, start_sample, end_sample,
+                        py_data);
+                continue;
+            }
+            call_start = g_get_monotonic_time();
             if (!(py_res = PyObject_CallMethod(
                 next_di->py_inst, "decode", "KKO", start_sample,
-                end_sample, py_data))) {
-                srd_exception_catch(NULL, "Calling %s decode() failed",
-                            next_di->inst_id);
-            }
+                end_sample, py_data)))
+                srd_inst_stack_fail(next_di);
             Py_XDECREF(py_res);
+            /* Account the time to the stacked instance. */
+            call_time = g_get_monotonic_time() - call_start;
+            next_di->stats.python_time += call_time;
+            di->python_since += call_time;
         }
         if ((cb = srd_pd_output_callback_find(di->sess, pdo->output_type))) {
             /*
@@ -481,7 +668,7 @@ static PyObject *Decoder_register(PyObject *self, PyObject *args,
 	meta_type_gv = NULL;
 	meta_name = meta_descr = NULL;
 
-	if (!(di = srd_inst_find_by_obj(NULL, self))) {
+	if (!(di = decoder_inst(self))) {
 		PyErr_SetString(PyExc_Exception, "decoder instance not found");
 		goto err;
 	}
@@ -547,6 +734,7 @@ static PyObject *Decoder_register(PyObject *self, PyObject *args,
 	}
 
 	di->pd_output = g_slist_append(di->pd_output, pdo);
+	g_ptr_array_add(di->pd_output_array, pdo);
 	py_new_output_id = Py_BuildValue("i", pdo->pdo_id);
 
 	PyGILState_Release(gstate);
@@ -585,21 +773,29 @@ static int get_term_type(const char *v)
 	return -1;
 }
 
+/* Marks pin_values entries whose tuple item was not set yet. */
+#define PIN_VALUE_UNSET 0xfe
+
 /**
  * Get the pin values at the current sample number.
  *
+ * The values are stored in the instance's PyTuple, which is updated in
+ * place where values changed. The items are shared int objects for 0,
+ * 1 and 0xff. When the PD still holds a reference to the tuple from a
+ * previous wait(), a new tuple is created instead.
+ *
  * @param di The decoder instance to use. Must not be NULL.
  *           The number of channels must be >= 1.
  *
- * @return A newly allocated PyTuple containing the pin values at the
- *         current sample number.
+ * @return SRD_OK upon success, a (negative) error code otherwise.
  */
-static int get_current_pinvalues(const struct srd_decoder_inst *di)
+static int get_current_pinvalues(struct srd_decoder_inst *di)
 {
 	int i;
 	uint8_t sample;
 	const uint8_t *sample_pos;
     int bit_offset;
+	PyObject *py_int;
 	PyGILState_STATE gstate;
 
 	if (!di) {
@@ -609,22 +805,41 @@ static int get_current_pinvalues(const struct srd_decoder_inst *di)
 
 	gstate = PyGILState_Ensure();
 
+	if (!di->py_pin_ints[0]) {
+		di->py_pin_ints[0] = PyLong_FromLong(0);
+		di->py_pin_ints[1] = PyLong_FromLong(1);
+		di->py_pin_ints[2] = PyLong_FromLong(0xff);
+	}
+	if (!di->pin_values) {
+		di->pin_values = g_malloc(di->dec_num_channels);
+		memset(di->pin_values, PIN_VALUE_UNSET, di->dec_num_channels);
+	}
+	if (di->py_pinvalues && Py_REFCNT((PyObject *)di->py_pinvalues) != 1) {
+		Py_DecRef(di->py_pinvalues);
+		di->py_pinvalues = PyTuple_New(di->dec_num_channels);
+		memset(di->pin_values, PIN_VALUE_UNSET, di->dec_num_channels);
+	}
+
 	for (i = 0; i < di->dec_num_channels; i++) {
 		/* A channelmap value of -1 means "unused optional channel". */
 		if (di->dec_channelmap[i] == -1) {
 			/* Value of unused channel is 0xff, instead of 0 or 1. */
-            PyTuple_SetItem(di->py_pinvalues, i, PyLong_FromLong(0xff));
+			sample = 0xff;
 		} else {
             if (*(di->inbuf + i) == NULL) {
                 sample = *(di->inbuf_const + i) ? 1 : 0;
-                PyTuple_SetItem(di->py_pinvalues, i, PyLong_FromLong(sample));
             } else {
                 sample_pos = *(di->inbuf + i) + ((di->abs_cur_samplenum - di->abs_start_samplenum) / 8);
                 bit_offset = (di->abs_cur_samplenum - di->abs_start_samplenum) % 8;
                 sample = *sample_pos & (1 << bit_offset) ? 1 : 0;
-                PyTuple_SetItem(di->py_pinvalues, i, PyLong_FromLong(sample));
             }
 		}
+		if (sample == di->pin_values[i])
+			continue;
+		py_int = di->py_pin_ints[sample == 0xff ? 2 : sample];
+		Py_IncRef(py_int);
+		PyTuple_SetItem(di->py_pinvalues, i, py_int);
+		di->pin_values[i] = sample;
 	}
 
 	PyGILState_Release(gstate);
@@ -705,6 +920,41 @@ err:
 	return SRD_ERR;
 }
 
+/* Copy the conditions a condition list is built from, see below. */
+static PyObject *copy_conditions(PyObject *py_conds)
+{
+	PyObject *py_copy;
+	Py_ssize_t i, num;
+
+	if (PyDict_Check(py_conds))
+		return PyDict_Copy(py_conds);
+
+	num = PyList_Size(py_conds);
+	if (!(py_copy = PyList_New(num)))
+		return NULL;
+	for (i = 0; i < num; i++)
+		PyList_SetItem(py_copy, i, PyDict_Copy(PyList_GetItem(py_conds, i)));
+
+	return py_copy;
+}
+
+/* Restart the skip terms of a reused condition list. */
+static void reset_skip_terms(struct srd_decoder_inst *di)
+{
+	GSList *l, *ll;
+	struct srd_term *term;
+
+	for (l = di->condition_list; l; l = l->next) {
+		for (ll = l->data; ll; ll = ll->next) {
+			term = ll->data;
+			if (term->type != SRD_TERM_SKIP)
+				continue;
+			term->num_samples_already_skipped = di->abs_cur_matched ?
+				(term->num_samples_to_skip != 0) : 0;
+		}
+	}
+}
+
 /**
  * Replace the current condition list with the new one.
  *
@@ -773,6 +1023,24 @@ static int set_new_condition_list(struct srd_decoder_inst *di, PyObject *args)
 		goto err;
 	}
 
+	/*
+	 * PDs mostly pass the same conditions on every call. Compare them
+	 * against a copy of the ones the current list was built from (the
+	 * PD may have modified its list in place), and only reset the
+	 * skip counters when they're still equal.
+	 */
+	if (di->py_conds && di->condition_list) {
+		ret = PyObject_RichCompareBool(py_conds, di->py_conds, Py_EQ);
+		if (ret == 1) {
+			reset_skip_terms(di);
+			Py_DecRef(py_conditionlist);
+			PyGILState_Release(gstate);
+			return SRD_OK;
+		}
+		if (ret < 0)
+			PyErr_Clear();
+	}
+
 	/* Free the old condition list. */
 	condition_list_free(di);
 
@@ -796,6 +1064,9 @@ static int set_new_condition_list(struct srd_decoder_inst *di, PyObject *args)
 		di->condition_list = g_slist_append(di->condition_list, term_list);
 	}
 
+	if (ret == SRD_OK)
+		di->py_conds = copy_conditions(py_conds);
+
 	Py_DecRef(py_conditionlist);
 
 	PyGILState_Release(gstate);
@@ -861,12 +1132,15 @@ static PyObject *Decoder_wait(PyObject *self, PyObject *args)
 
     gstate = PyGILState_Ensure();
 
-	if (!(di = srd_inst_find_by_obj(NULL, self))) {
+	if (!(di = decoder_inst(self))) {
 		PyErr_SetString(PyExc_Exception, "decoder instance not found");
         PyGILState_Release(gstate);
 		Py_RETURN_NONE;
 	}
 
+	/* The decoder ran Python code since wait() last returned. */
+	di->stats.python_time += g_get_monotonic_time() - di->python_since;
+
     ret = set_new_condition_list(di, args);
     if (ret < 0) {
         srd_dbg("%s: %s: Aborting wait().", di->inst_id, __func__);
@@ -921,26 +1195,41 @@ static PyObject *Decoder_wait(PyObject *self, PyObject *args)
 
         /* If there's a match, set self.samplenum etc. and return. */
         if (found_match) {
+            if (!di->py_samplenum_attr) {
+                di->py_samplenum_attr = PyUnicode_InternFromString("samplenum");
+                di->py_matched_attr = PyUnicode_InternFromString("matched");
+            }
+
             /* Set self.samplenum to the (absolute) sample number that matched. */
             PyObject *py_cur_samplenum = PyLong_FromUnsignedLongLong(di->abs_cur_samplenum);
-            PyObject_SetAttrString(di->py_inst, "samplenum", py_cur_samplenum);
+            PyObject_SetAttr(di->py_inst, di->py_samplenum_attr, py_cur_samplenum);
             Py_DECREF(py_cur_samplenum);
 
             /* Set self.matched to math_array. */
             PyObject *py_matched = PyLong_FromUnsignedLongLong(di->match_array);
-            PyObject_SetAttrString(di->py_inst, "matched", py_matched);
+            PyObject_SetAttr(di->py_inst, di->py_matched_attr, py_matched);
             Py_DECREF(py_matched);
 
             get_current_pinvalues(di);
 
             g_mutex_unlock(&di->data_mutex);
 
+            di->stats.wait_returns++;
+            di->python_since = g_get_monotonic_time();
+
             PyGILState_Release(gstate);
 
             Py_INCREF(di->py_pinvalues);
             return (PyObject *)di->py_pinvalues;
         }
 
+		/*
+		 * Hand this chunk's annotations to the frontend before
+		 * it learns that the chunk was handled.
+		 */
+		srd_inst_stack_drain(di);
+		srd_inst_flush_annotations(di);
+
 		/* No match, reset state for the next chunk. */
 		di->got_new_samples = FALSE;
 		di->handled_all_samples = TRUE;
@@ -971,6 +1260,7 @@ static PyObject *Decoder_wait(PyObject *self, PyObject *args)
 	Py_RETURN_NONE;
 
 err:
+    di->python_since = g_get_monotonic_time();
     PyGILState_Release(gstate);
 
 	return NULL;
@@ -997,7 +1287,7 @@ static PyObject *Decoder_has_channel(PyObject *self, PyObject *args)
 
 	gstate = PyGILState_Ensure();
 
-	if (!(di = srd_inst_find_by_obj(NULL, self))) {
+	if (!(di = decoder_inst(self))) {
 		PyErr_SetString(PyExc_Exception, "decoder instance not found");
 		goto err;
 	}